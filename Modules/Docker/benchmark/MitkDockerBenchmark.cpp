@@ -0,0 +1,430 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkCommandLineParser.h>
+#include <mitkDockerHelper.h>
+#include <mitkDockerImageManager.h>
+#include <mitkDockerStagingWriter.h>
+#include <mitkIOUtil.h>
+#include <mitkImage.h>
+#include <mitkImageWriteAccessor.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+/** \brief Benchmarks of the Docker module
+ *
+ * Measures CanRunDocker, the start of a minimal container, staging and loading
+ * throughput for synthetic images, the staging writer codecs against IOUtil::Save
+ * and DockerImageManager operations. The results are written as JSON (one entry
+ * per benchmark and parameter set) so that runs of different releases can be compared.
+ */
+
+namespace
+{
+  using json = nlohmann::json;
+
+  double Seconds(std::chrono::steady_clock::time_point start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // min, median, mean and max of the samples
+  json Summarize(std::vector<double> samples)
+  {
+    if (samples.empty())
+      return json::object();
+    std::sort(samples.begin(), samples.end());
+    const auto n = samples.size();
+    const double median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    return {{"min", samples.front()},
+            {"median", median},
+            {"mean", std::accumulate(samples.begin(), samples.end(), 0.0) / n},
+            {"max", samples.back()},
+            {"samples", samples}};
+  }
+
+  std::vector<unsigned int> ParseList(const std::string &value)
+  {
+    std::vector<unsigned int> values;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+      if (!item.empty())
+        values.push_back(static_cast<unsigned int>(std::stoul(item)));
+    return values;
+  }
+
+  mitk::Image::Pointer CreateImage(unsigned int edge, std::mt19937 &random)
+  {
+    auto image = mitk::Image::New();
+    unsigned int dimensions[3] = {edge, edge, edge};
+    image->Initialize(mitk::MakeScalarPixelType<float>(), 3, dimensions);
+
+    mitk::ImageWriteAccessor accessor(image);
+    auto *data = static_cast<float *>(accessor.GetData());
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::generate(data, data + std::size_t(edge) * edge * edge, [&]() { return distribution(random); });
+    return image;
+  }
+
+  // int16 volume with air, soft tissue and a bone shell, compresses like a CT
+  mitk::Image::Pointer CreateCTLikeImage(unsigned int edge, std::mt19937 &random)
+  {
+    auto image = mitk::Image::New();
+    unsigned int dimensions[3] = {edge, edge, edge};
+    image->Initialize(mitk::MakeScalarPixelType<short>(), 3, dimensions);
+
+    mitk::ImageWriteAccessor accessor(image);
+    auto *data = static_cast<short *>(accessor.GetData());
+    std::normal_distribution<float> noise(0.0f, 20.0f);
+    const double center = 0.5 * edge;
+    for (unsigned int z = 0; z < edge; ++z)
+      for (unsigned int y = 0; y < edge; ++y)
+        for (unsigned int x = 0; x < edge; ++x)
+        {
+          const double r = std::sqrt((x - center) * (x - center) + (y - center) * (y - center)) / center;
+          float value = -1000.0f;
+          if (r < 0.8)
+            value = 40.0f + noise(random);
+          else if (r < 0.85)
+            value = 1000.0f + noise(random);
+          *data++ = static_cast<short>(value);
+        }
+    return image;
+  }
+
+  json BenchmarkStagingWriter(unsigned int edge, unsigned int repetitions)
+  {
+    std::mt19937 random(42);
+    const auto image = CreateCTLikeImage(edge, random);
+    const auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_bench_%%%%%%");
+    boost::filesystem::create_directories(directory);
+
+    using Codec = mitk::DockerStagingWriter::Codec;
+    struct Variant
+    {
+      std::string name;
+      std::string fileName;
+      // IOUtil::Save if false
+      bool stagingWriter;
+      Codec codec;
+      int level;
+    };
+    const std::vector<Variant> variants = {{"ioutil_nrrd", "image.nrrd", false, Codec::Raw, 0},
+                                           {"ioutil_nii_gz", "image.nii.gz", false, Codec::Raw, 0},
+                                           {"raw_nii", "image.nii", true, Codec::Raw, 0},
+                                           {"raw_nrrd", "image.nrrd", true, Codec::Raw, 0},
+                                           {"gzip1_nrrd", "image.nrrd", true, Codec::Gzip, 1},
+                                           {"gzip6_nrrd", "image.nrrd", true, Codec::Gzip, 6},
+                                           {"gzip1_nii_gz", "image.nii.gz", true, Codec::Gzip, 1}};
+
+    const double pixelMiB = double(edge) * edge * edge * sizeof(short) / (1024.0 * 1024.0);
+    json codecs = json::array();
+    for (const auto &variant : variants)
+    {
+      std::vector<double> seconds, throughput;
+      std::uintmax_t bytes = 0;
+      for (unsigned int r = 0; r < repetitions; ++r)
+      {
+        const auto path = directory / variant.fileName;
+        const auto start = std::chrono::steady_clock::now();
+        if (variant.stagingWriter)
+        {
+          mitk::DockerStagingWriter::Options options;
+          options.codec = variant.codec;
+          options.level = variant.level;
+          mitk::DockerStagingWriter::Write(image, path, options);
+        }
+        else
+        {
+          mitk::IOUtil::Save(image, path.string());
+        }
+        seconds.push_back(Seconds(start));
+        throughput.push_back(pixelMiB / seconds.back());
+        bytes = boost::filesystem::file_size(path);
+        boost::filesystem::remove(path);
+      }
+      codecs.push_back({{"name", variant.name},
+                        {"bytes", bytes},
+                        {"seconds", Summarize(seconds)},
+                        {"pixelMiBPerSecond", Summarize(throughput)}});
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(directory, ec);
+    return {{"name", "staging_writer"}, {"edge", edge}, {"repetitions", repetitions}, {"writers", codecs}};
+  }
+
+  json BenchmarkCanRunDocker(unsigned int repetitions)
+  {
+    std::vector<double> seconds;
+    for (unsigned int i = 0; i < repetitions; ++i)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      mitk::DockerHelper::CanRunDocker();
+      seconds.push_back(Seconds(start));
+    }
+    return {{"name", "can_run_docker"}, {"repetitions", repetitions}, {"seconds", Summarize(seconds)}};
+  }
+
+  json BenchmarkContainerStart(const std::string &image, unsigned int repetitions)
+  {
+    std::vector<double> total, running, containerStart;
+    std::string backend;
+    for (unsigned int i = 0; i < repetitions; ++i)
+    {
+      mitk::DockerHelper helper(image);
+      helper.EnableAutoRemoveContainer(true);
+      helper.EnableJobScheduler(false);
+      helper.AddApplicationArgument("true");
+      helper.GetResults();
+
+      const auto &report = helper.GetRunReport();
+      total.push_back(report.totalSeconds);
+      running.push_back(report.runningSeconds);
+      if (report.containerStartSeconds >= 0)
+        containerStart.push_back(report.containerStartSeconds);
+      backend = report.backend;
+    }
+    return {{"name", "container_start"},
+            {"image", image},
+            {"backend", backend},
+            {"repetitions", repetitions},
+            {"seconds", Summarize(total)},
+            {"runningSeconds", Summarize(running)},
+            {"containerStartSeconds", Summarize(containerStart)}};
+  }
+
+  json BenchmarkStagingAndLoading(const std::string &image,
+                                  unsigned int edge,
+                                  unsigned int count,
+                                  unsigned int repetitions)
+  {
+    std::mt19937 random(42);
+    std::vector<mitk::BaseData::Pointer> images;
+    std::vector<std::string> expectedFilenames;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      images.push_back(CreateImage(edge, random).GetPointer());
+      expectedFilenames.push_back((boost::format("image_%1%") % i).str() + ".nrrd");
+    }
+
+    std::vector<double> staging, loading, running, stagingThroughput, loadingThroughput;
+    std::uintmax_t stagedBytes = 0, loadedBytes = 0;
+    for (unsigned int r = 0; r < repetitions; ++r)
+    {
+      // the container copies the staged inputs to the output directory:
+      //   sh -c 'cp "$2"/* "$4"/' bench --input <inputs> --output <outputs>
+      mitk::DockerHelper helper(image);
+      helper.EnableAutoRemoveContainer(true);
+      helper.EnableJobScheduler(false);
+      helper.AddApplicationArgument("sh", "-c");
+      helper.AddApplicationArgument("cp \"$2\"/* \"$4\"/", "bench");
+      helper.AddAutoSaveData(images, "--input", "inputs/image_%1%", ".nrrd");
+      helper.AddAutoLoadOutputFolder("--output", "outputs", expectedFilenames);
+      helper.GetResults();
+
+      const auto &report = helper.GetRunReport();
+      staging.push_back(report.stagingSeconds);
+      loading.push_back(report.loadingSeconds);
+      running.push_back(report.runningSeconds);
+      stagedBytes = report.stagingBytesWritten;
+      loadedBytes = report.loadingBytesRead;
+      if (report.stagingSeconds > 0)
+        stagingThroughput.push_back(report.stagingBytesWritten / report.stagingSeconds / (1024.0 * 1024.0));
+      if (report.loadingSeconds > 0)
+        loadingThroughput.push_back(report.loadingBytesRead / report.loadingSeconds / (1024.0 * 1024.0));
+
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(helper.GetWorkingDirectory(), ec);
+    }
+
+    return {{"name", "staging_loading"},
+            {"image", image},
+            {"edge", edge},
+            {"count", count},
+            {"repetitions", repetitions},
+            {"stagedBytes", stagedBytes},
+            {"loadedBytes", loadedBytes},
+            {"stagingSeconds", Summarize(staging)},
+            {"runningSeconds", Summarize(running)},
+            {"loadingSeconds", Summarize(loading)},
+            {"stagingMiBPerSecond", Summarize(stagingThroughput)},
+            {"loadingMiBPerSecond", Summarize(loadingThroughput)}};
+  }
+
+  json BenchmarkImageManager(unsigned int count, unsigned int repetitions)
+  {
+    std::vector<double> add, lookup, serialize, deserialize, remove;
+    for (unsigned int r = 0; r < repetitions; ++r)
+    {
+      mitk::DockerImageManager manager;
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < count; ++i)
+        manager.AddImage(mitk::DockerImageManager::DockerImage("benchmark/image_" + std::to_string(i)));
+      add.push_back(Seconds(start));
+
+      start = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < count; ++i)
+        manager.HasImage("benchmark/image_" + std::to_string(count - 1 - i));
+      lookup.push_back(Seconds(start));
+
+      start = std::chrono::steady_clock::now();
+      const auto serialized = manager.ToJson();
+      serialize.push_back(Seconds(start));
+
+      start = std::chrono::steady_clock::now();
+      manager.FromJson(serialized);
+      deserialize.push_back(Seconds(start));
+
+      start = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < count; ++i)
+        manager.RemoveImage("benchmark/image_" + std::to_string(i));
+      remove.push_back(Seconds(start));
+    }
+
+    return {{"name", "image_manager"},
+            {"count", count},
+            {"repetitions", repetitions},
+            {"addSeconds", Summarize(add)},
+            {"hasImageSeconds", Summarize(lookup)},
+            {"toJsonSeconds", Summarize(serialize)},
+            {"fromJsonSeconds", Summarize(deserialize)},
+            {"removeSeconds", Summarize(remove)}};
+  }
+
+  // runs a benchmark; failures are recorded instead of aborting the remaining benchmarks
+  void Record(json &results, const std::string &name, const std::function<json()> &benchmark)
+  {
+    std::cerr << "Running " << name << std::endl;
+    try
+    {
+      results.push_back(benchmark());
+    }
+    catch (const std::exception &e)
+    {
+      results.push_back({{"name", name}, {"error", e.what()}});
+    }
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  mitkCommandLineParser parser;
+
+  parser.setCategory("Docker");
+  parser.setTitle("Docker Benchmark");
+  parser.setContributor("M2aia");
+  parser.setDescription(
+    "Measures container start latency, staging/loading throughput, staging writer codecs and DockerImageManager "
+    "operations. "
+    "Results are written as JSON.");
+
+  parser.setArgumentPrefix("--", "-");
+
+  parser.addArgument("output", "o", mitkCommandLineParser::File, "Output file", "JSON result file (default: stdout).");
+  parser.addArgument("image", "i", mitkCommandLineParser::String, "Image", "Image with sh, cp and true (default: alpine).");
+  parser.addArgument("repetitions", "r", mitkCommandLineParser::Int, "Repetitions", "Repetitions per benchmark (default: 5).");
+  parser.addArgument("edges", "e", mitkCommandLineParser::String, "Image edges", "Edge lengths of the synthetic float images (default: 32,128).");
+  parser.addArgument("counts", "c", mitkCommandLineParser::String, "Image counts", "Number of images staged per run (default: 1,8).");
+  parser.addArgument("writerEdges", "w", mitkCommandLineParser::String, "Writer edges", "Edge lengths of the int16 volumes of the staging writer benchmark (default: 128,256).");
+  parser.addArgument("managerCounts", "m", mitkCommandLineParser::String, "Manager sizes", "Number of images in DockerImageManager (default: 100,1000).");
+  parser.addArgument("skipDocker", "s", mitkCommandLineParser::Bool, "Skip Docker", "Only run benchmarks that do not need a daemon.");
+
+  auto parsedArgs = parser.parseArguments(argc, argv);
+  if (parsedArgs.empty())
+    return EXIT_FAILURE;
+
+  auto getString = [&parsedArgs](const std::string &name, const std::string &defaultValue) {
+    return parsedArgs.count(name) ? us::any_cast<std::string>(parsedArgs[name]) : defaultValue;
+  };
+
+  try
+  {
+    const auto image = getString("image", "alpine");
+    const unsigned int repetitions = parsedArgs.count("repetitions") ? us::any_cast<int>(parsedArgs["repetitions"]) : 5;
+    const auto edges = ParseList(getString("edges", "32,128"));
+    const auto counts = ParseList(getString("counts", "1,8"));
+    const auto writerEdges = ParseList(getString("writerEdges", "128,256"));
+    const auto managerCounts = ParseList(getString("managerCounts", "100,1000"));
+    const bool skipDocker = parsedArgs.count("skipDocker") && us::any_cast<bool>(parsedArgs["skipDocker"]);
+
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+
+    json results = json::array();
+    Record(results, "can_run_docker", [&]() { return BenchmarkCanRunDocker(repetitions); });
+
+    const bool runDocker = !skipDocker && mitk::DockerHelper::CanRunDocker();
+    if (runDocker)
+    {
+      Record(results, "container_start", [&]() { return BenchmarkContainerStart(image, repetitions); });
+      for (auto edge : edges)
+        for (auto count : counts)
+          Record(results, "staging_loading", [&]() { return BenchmarkStagingAndLoading(image, edge, count, repetitions); });
+    }
+
+    for (auto edge : writerEdges)
+      Record(results, "staging_writer", [&]() { return BenchmarkStagingWriter(edge, repetitions); });
+
+    for (auto count : managerCounts)
+      Record(results, "image_manager", [&]() { return BenchmarkImageManager(count, repetitions); });
+
+    json document = {{"timestamp", std::time(nullptr)},
+                     {"host", {{"name", hostname}, {"cpus", std::thread::hardware_concurrency()}}},
+                     {"dockerAvailable", runDocker},
+                     {"benchmarks", results}};
+
+    if (parsedArgs.count("output"))
+    {
+      const auto outputPath = us::any_cast<std::string>(parsedArgs["output"]);
+      boost::filesystem::ofstream file(outputPath);
+      file << document.dump(2) << "\n";
+      if (!file)
+      {
+        MITK_ERROR << "Could not write " << outputPath;
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      std::cout << document.dump(2) << std::endl;
+    }
+    return EXIT_SUCCESS;
+  }
+  catch (const std::exception &e)
+  {
+    MITK_ERROR << e.what();
+    return EXIT_FAILURE;
+  }
+}
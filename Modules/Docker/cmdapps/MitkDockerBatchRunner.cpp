@@ -0,0 +1,218 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkCommandLineParser.h>
+#include <mitkDockerBatchRunner.h>
+#include <mitkDockerHelper.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <glob.h>
+
+/** \brief Runs a Docker job for every input file without a GUI session
+ *
+ * The job spec and the layout of the output directory are described at mitk::DockerBatchRunner.
+ * A second invocation with the same spec skips finished jobs. A summary with the run report of
+ * every job is written to <output>/batch_report.json.
+ */
+
+namespace
+{
+  using json = nlohmann::json;
+
+  std::atomic<bool> s_Interrupted{false};
+
+  void OnInterrupt(int)
+  {
+    s_Interrupted = true;
+  }
+
+  std::vector<boost::filesystem::path> ReadInputList(const boost::filesystem::path &listPath)
+  {
+    boost::filesystem::ifstream file(listPath);
+    if (!file)
+      mitkThrow() << "Could not read input list " << listPath;
+
+    std::vector<boost::filesystem::path> inputs;
+    std::string line;
+    while (std::getline(file, line))
+    {
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (!line.empty() && line.front() != '#')
+        inputs.emplace_back(line);
+    }
+    return inputs;
+  }
+
+  std::vector<boost::filesystem::path> ExpandGlob(const std::string &pattern)
+  {
+    std::vector<boost::filesystem::path> inputs;
+    glob_t result = {};
+    if (glob(pattern.c_str(), 0, nullptr, &result) == 0)
+      for (std::size_t i = 0; i < result.gl_pathc; ++i)
+        inputs.emplace_back(result.gl_pathv[i]);
+    globfree(&result);
+    return inputs;
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  mitkCommandLineParser parser;
+
+  parser.setCategory("Docker");
+  parser.setTitle("Docker Batch Runner");
+  parser.setContributor("M2aia");
+  parser.setDescription(
+    "Runs the Docker job described by a job spec for every input file with a configurable number of parallel "
+    "containers. Interrupted batches are resumed by running the same command again.");
+
+  parser.setArgumentPrefix("--", "-");
+
+  parser.addArgument("spec", "s", mitkCommandLineParser::File, "Job spec", "JSON job spec (image, arguments, inputs, outputs).", us::Any(), false);
+  parser.addArgument("output", "o", mitkCommandLineParser::Directory, "Output directory", "Outputs, batch_state.json and batch_report.json.", us::Any(), false);
+  parser.addArgument("inputs", "i", mitkCommandLineParser::String, "Inputs", "Glob pattern of the input files (e.g. \"/data/*.nii.gz\").");
+  parser.addArgument("inputList", "l", mitkCommandLineParser::File, "Input list", "Text file with one input path per line.");
+  parser.addArgument("jobs", "j", mitkCommandLineParser::Int, "Parallel jobs", "Number of containers running in parallel (default: 1).");
+  parser.addArgument("keepWorkingDirectories", "k", mitkCommandLineParser::Bool, "Keep working directories", "Do not remove the working directories of finished jobs.");
+
+  auto parsedArgs = parser.parseArguments(argc, argv);
+  if (parsedArgs.empty())
+    return EXIT_FAILURE;
+
+  if (!parsedArgs.count("inputs") && !parsedArgs.count("inputList"))
+  {
+    MITK_INFO << parser.helpText();
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    const boost::filesystem::path specPath = us::any_cast<std::string>(parsedArgs["spec"]);
+    const auto outputDirectory = boost::filesystem::absolute(us::any_cast<std::string>(parsedArgs["output"]));
+    const unsigned int parallelJobs = parsedArgs.count("jobs") ? std::max(1, us::any_cast<int>(parsedArgs["jobs"])) : 1;
+    const bool keepWorkingDirectories = parsedArgs.count("keepWorkingDirectories") && us::any_cast<bool>(parsedArgs["keepWorkingDirectories"]);
+
+    boost::filesystem::ifstream specFile(specPath);
+    if (!specFile)
+      mitkThrow() << "Could not read job spec " << specPath;
+    mitk::DockerBatchRunner runner(json::parse(specFile), outputDirectory);
+    runner.KeepWorkingDirectories(keepWorkingDirectories);
+    const auto &spec = runner.GetJobSpec();
+
+    std::vector<boost::filesystem::path> inputs;
+    if (parsedArgs.count("inputs"))
+      inputs = ExpandGlob(us::any_cast<std::string>(parsedArgs["inputs"]));
+    if (parsedArgs.count("inputList"))
+    {
+      const auto listed = ReadInputList(us::any_cast<std::string>(parsedArgs["inputList"]));
+      inputs.insert(inputs.end(), listed.begin(), listed.end());
+    }
+    const auto jobs = mitk::DockerBatchRunner::CreateJobs(inputs);
+    if (jobs.empty())
+      mitkThrow() << "No input files found";
+
+    if (!mitk::DockerHelper::CanRunDocker())
+      mitkThrow() << "Docker is not available";
+
+    boost::filesystem::create_directories(outputDirectory);
+
+    std::vector<const mitk::DockerBatchRunner::Job *> pending;
+    for (const auto &job : jobs)
+      if (!runner.IsFinished(job))
+        pending.push_back(&job);
+    MITK_INFO << jobs.size() << " jobs, " << jobs.size() - pending.size() << " already finished, " << pending.size()
+              << " to run with " << parallelJobs << " parallel containers";
+
+    std::signal(SIGINT, OnInterrupt);
+    std::signal(SIGTERM, OnInterrupt);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::min<std::size_t>(parallelJobs, pending.size()); ++i)
+    {
+      workers.emplace_back([&]() {
+        for (auto index = next++; index < pending.size() && !s_Interrupted; index = next++)
+        {
+          const auto &job = *pending[index];
+          MITK_INFO << "[" << index + 1 << "/" << pending.size() << "] " << job.name;
+          const auto entry = runner.RunJob(job);
+          MITK_INFO << "[" << done + 1 << "/" << pending.size() << "] " << job.name << ": " << entry["status"].get<std::string>();
+          ++done;
+        }
+      });
+    }
+
+    // the signal handler only sets the flag; running containers are cancelled from here
+    while (done < pending.size() && !s_Interrupted)
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if (s_Interrupted)
+    {
+      MITK_WARN << "Interrupted, cancelling running jobs; run the same command again to resume";
+      runner.CancelAll();
+    }
+    for (auto &worker : workers)
+      worker.join();
+
+    std::map<std::string, std::size_t> counts;
+    json jobReports = json::array();
+    const auto states = runner.GetJobStates();
+    for (const auto &job : jobs)
+    {
+      const auto status = states.contains(job.name) ? states.at(job.name).value("status", std::string("pending")) : "pending";
+      ++counts[status];
+      json jobReport = states.contains(job.name) ? states.at(job.name) : json{{"input", job.input.string()}};
+      jobReport["name"] = job.name;
+      jobReport["status"] = status;
+      jobReports.push_back(jobReport);
+    }
+
+    json report = {{"spec", specPath.string()},
+                   {"image", spec.image},
+                   {"parallelJobs", parallelJobs},
+                   {"interrupted", s_Interrupted.load()},
+                   {"seconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()},
+                   {"counts", counts},
+                   {"jobs", jobReports}};
+    boost::filesystem::ofstream reportFile(outputDirectory / "batch_report.json");
+    reportFile << report.dump(2) << "\n";
+    if (!reportFile)
+      mitkThrow() << "Could not write " << (outputDirectory / "batch_report.json");
+
+    for (const auto &kv : counts)
+      MITK_INFO << kv.first << ": " << kv.second;
+
+    return counts["finished"] == jobs.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  catch (const std::exception &e)
+  {
+    MITK_ERROR << e.what();
+    return EXIT_FAILURE;
+  }
+}
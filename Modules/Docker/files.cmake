@@ -1,6 +1,26 @@
 set(CPP_FILES
+  mitkDockerBatchHelper.cpp
+  mitkDockerBatchRunner.cpp
+  mitkDockerContainerPool.cpp
+  mitkDockerEngineClient.cpp
   mitkDockerHelper.cpp
   mitkDockerImageManager.cpp
+  mitkDockerInputStore.cpp
+  mitkDockerJobExecutor.cpp
+  mitkDockerJobScheduler.cpp
+  mitkDockerMountPlanner.cpp
+  mitkDockerParameterSweep.cpp
+  mitkDockerProcess.cpp
+  mitkDockerResourceLimits.cpp
+  mitkDockerResourceSampler.cpp
+  mitkDockerResultCache.cpp
+  mitkDockerResultHandle.cpp
+  mitkDockerRunReport.cpp
+  mitkDockerScratchPolicy.cpp
+  mitkDockerStagingCache.cpp
+  mitkDockerStagingWriter.cpp
+  mitkDockerWorker.cpp
+  mitkDockerWorkingDirectoryManager.cpp
 )
 
 # set(UI_FILES
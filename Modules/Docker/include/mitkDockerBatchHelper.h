@@ -0,0 +1,76 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <mitkDockerHelper.h>
+
+namespace mitk
+{
+  /**
+   * @brief Runs many input sets through a single container invocation
+   *
+   * Each job is staged into its own subdirectory (job_0000, job_0001, ...) of the
+   * working directory. Outputs declared with AddAutoLoadOutput, AddAutoLoadOutputFolder
+   * etc. are created per job relative to its subdirectory. Inputs added with
+   * AddAutoSaveData are staged once and shared by all jobs.
+   *
+   * The container is started once and receives the path of a manifest file:
+   *
+   *   <program> <application arguments> <shared inputs> --manifest /<workdir>/batch_manifest.json
+   *
+   *   {"jobs": [{"id": "job_0000", "workdir": "/<workdir>/job_0000", "args": ["-i", "...", "-o", "..."]}, ...]}
+   *
+   * The tool iterates the jobs and processes each with its argument list. Results are
+   * returned per job by GetBatchResults.
+   */
+  class MITKDOCKER_EXPORT DockerBatchHelper : public DockerHelper
+  {
+  public:
+    DockerBatchHelper(std::string image) : DockerHelper(image) {}
+
+    // adds an empty job and returns its index
+    std::size_t AddJob();
+    std::size_t GetNumberOfJobs() const;
+
+    SaveDataInfo *AddJobAutoSaveData(std::size_t job, mitk::BaseData::Pointer data, std::string targetArgument, std::string name, std::string extension);
+    SaveDataInfo *AddJobAutoSaveData(std::size_t job, std::vector<mitk::BaseData::Pointer> data, std::string targetArgument, std::string name, std::string extension);
+
+    // argument used to pass the manifest file to the container (default: "--manifest")
+    void SetManifestArgument(std::string argument);
+
+    // directory of a job on the host system
+    boost::filesystem::path GetJobDirectory(std::size_t job) const;
+
+    /**
+     * @brief Runs all jobs in one container.
+     * @return the auto-load outputs of each job, indexed like the jobs
+     */
+    std::vector<std::vector<mitk::BaseData::Pointer>> GetBatchResults();
+
+  protected:
+    void GenerateRunData() override;
+    void LoadData() override;
+    std::vector<std::string> GetResultCacheOutputPaths() const override;
+    std::uint64_t EstimateStagingBytes() const override;
+
+    static std::string GetJobName(std::size_t job);
+
+    std::vector<std::map<std::string, SaveDataInfo>> m_JobSaveDataInfo;
+    std::vector<std::vector<mitk::BaseData::Pointer>> m_BatchOutputData;
+    std::string m_ManifestArgument = "--manifest";
+  };
+
+} // namespace mitk
@@ -0,0 +1,156 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkDockerResourceLimits.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <nlohmann/json.hpp>
+
+namespace mitk
+{
+  class DockerHelper;
+
+  /**
+   * @brief Runs the Docker job of a job spec for every input file (see MitkDockerBatchRunner)
+   *
+   * The job spec (JSON) declares the image, the application and run arguments, resource
+   * limits and the inputs/outputs of a run, mirroring DockerHelper::SaveDataInfo and
+   * DockerHelper::LoadDataInfo:
+   *
+   * \code
+   * {
+   *   "image": "wasserth/totalsegmentator:2.0.0",
+   *   "arguments": ["--fast"],
+   *   "runArguments": [],
+   *   "gpus": false,
+   *   "timeout": 3600,
+   *   "stallTimeout": 600,
+   *   "limits": {"cpus": 4, "memoryBytes": 17179869184, "shmSizeBytes": 2147483648},
+   *   "inputs": [{"argument": "-i", "name": "image", "extension": ".nii.gz", "source": "{input}"}],
+   *   "outputs": [{"argument": "-o", "path": "segmentations", "directory": true}]
+   * }
+   * \endcode
+   *
+   * "source" may use {input} (the path of the input file), {stem} (its file name without
+   * extension) and {dir} (its directory), e.g. to pair every image with a mask. Outputs are
+   * moved to <output>/<job>/. The state of every job is kept in <output>/batch_state.json;
+   * a runner created later with the same spec skips finished jobs whose outputs still exist.
+   * RunJob may be called from several threads.
+   */
+  class MITKDOCKER_EXPORT DockerBatchRunner
+  {
+  public:
+    struct InputSpec
+    {
+      std::string argument;
+      std::string name;
+      std::string extension;
+      std::string source = "{input}";
+    };
+
+    struct OutputSpec
+    {
+      std::string argument;
+      std::string path;
+      bool isDirectory = false;
+      bool isFlagOnly = false;
+      std::vector<std::string> files;
+    };
+
+    struct JobSpec
+    {
+      std::string image;
+      std::vector<std::string> arguments;
+      std::vector<std::string> runArguments;
+      bool gpus = false;
+      double timeoutSeconds = 0;
+      double stallTimeoutSeconds = 0;
+      DockerResourceLimits limits;
+      std::vector<InputSpec> inputs;
+      std::vector<OutputSpec> outputs;
+    };
+
+    struct Job
+    {
+      std::string name;
+      boost::filesystem::path input;
+    };
+
+    // throws a mitk::Exception if a required entry is missing or the limits are invalid
+    static JobSpec ParseJobSpec(const nlohmann::json &document);
+
+    // file name without the (compound) extension, e.g. "case_01" for "case_01.nii.gz"
+    static std::string Stem(const boost::filesystem::path &path);
+    static std::string Extension(const boost::filesystem::path &path);
+    static std::string ExpandSource(std::string source, const Job &job);
+
+    // one job per distinct input; names are the input stems, made unique with a counter
+    static std::vector<Job> CreateJobs(std::vector<boost::filesystem::path> inputs);
+
+    // rename if possible, otherwise copy (the working directory may be on another file system)
+    static void MoveOutput(const boost::filesystem::path &source, const boost::filesystem::path &target);
+
+    /**
+     * @brief Reads the state of an earlier invocation from <outputDirectory>/batch_state.json.
+     * The state is discarded if the spec changed since.
+     */
+    DockerBatchRunner(const nlohmann::json &specDocument, const boost::filesystem::path &outputDirectory);
+
+    const JobSpec &GetJobSpec() const;
+    const boost::filesystem::path &GetOutputDirectory() const;
+
+    // do not remove the working directories of finished jobs (failed ones are always kept)
+    void KeepWorkingDirectories(bool value);
+
+    // finished in an earlier invocation and all outputs are still there
+    bool IsFinished(const Job &job) const;
+
+    /**
+     * @brief Runs the job, moves its outputs and records its state.
+     * @return the state entry of the job (status, outputs, report, ...)
+     */
+    nlohmann::json RunJob(const Job &job);
+
+    // cancels the running jobs; can be called from any thread
+    void CancelAll();
+
+    // state entries by job name
+    nlohmann::json GetJobStates() const;
+
+  private:
+    void SetJobState(const std::string &name, nlohmann::json entry);
+    void WriteState() const;
+
+    JobSpec m_JobSpec;
+    nlohmann::json m_SpecDocument;
+    boost::filesystem::path m_OutputDirectory;
+    boost::filesystem::path m_StatePath;
+    bool m_KeepWorkingDirectories = false;
+
+    mutable std::mutex m_Mutex;
+    nlohmann::json m_Jobs = nlohmann::json::object();
+    std::set<DockerHelper *> m_RunningHelpers;
+  };
+
+} // namespace mitk
@@ -0,0 +1,133 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Process-wide pool of long-lived (warm) containers
+   *
+   * Containers are started detached with a keep-alive command and the shared
+   * pool directory mounted at GetSharedDirectoryContainerPath(). Jobs are
+   * dispatched into them with "docker exec", so the container start-up is
+   * paid only once per container instead of once per job.
+   *
+   * Containers are grouped by a key consisting of the image name and the
+   * docker run arguments. A container is
+   * - checked for health (state "running") before it is handed out,
+   * - removed after it was idle for longer than Options::idleTimeout,
+   * - recycled after Options::maxJobsPerContainer jobs.
+   */
+  class MITKDOCKER_EXPORT DockerContainerPool
+  {
+  public:
+    struct Options
+    {
+      // upper limit of containers per key; Acquire blocks if all are busy
+      unsigned int maxContainersPerKey = 2;
+
+      // a container is removed after it has executed this number of jobs
+      unsigned int maxJobsPerContainer = 50;
+
+      // idle containers are removed after this time
+      std::chrono::seconds idleTimeout{300};
+
+      // command that keeps the container alive, the first element is used as entrypoint
+      std::vector<std::string> keepAliveCommand = {"tail", "-f", "/dev/null"};
+    };
+
+    static DockerContainerPool &GetInstance();
+
+    ~DockerContainerPool();
+
+    void SetOptions(const Options &options);
+    Options GetOptions() const;
+
+    /**
+     * @brief Host directory mounted into every pool container.
+     * Working directories of pooled jobs have to be created inside this directory.
+     */
+    boost::filesystem::path GetSharedDirectory();
+
+    // mount point of the shared directory inside the containers (without leading slash)
+    static std::string GetSharedDirectoryContainerPath();
+
+    /**
+     * @brief Returns the name of a healthy, idle container for image and run arguments.
+     * A new container is started if none is available and the limit is not reached;
+     * otherwise the call blocks until a container is released.
+     */
+    std::string Acquire(const std::string &image, const std::vector<std::string> &runArguments);
+
+    /**
+     * @brief Hands a container back to the pool.
+     * @param failed if true, the container is removed instead of reused
+     */
+    void Release(const std::string &containerName, bool failed = false);
+
+    // removes containers that have been idle for longer than Options::idleTimeout
+    void ReapIdle();
+
+    // removes all pool containers
+    void Shutdown();
+
+    // number of containers (busy and idle) currently managed by the pool
+    std::size_t Count() const;
+
+    static bool IsHealthy(const std::string &containerName);
+
+  private:
+    DockerContainerPool() = default;
+    DockerContainerPool(const DockerContainerPool &) = delete;
+    DockerContainerPool &operator=(const DockerContainerPool &) = delete;
+
+    struct Container
+    {
+      std::string name;
+      std::string key;
+      bool busy = false;
+      unsigned int jobs = 0;
+      std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    std::string StartContainer(const std::string &image, const std::vector<std::string> &runArguments);
+    static void RemoveContainer(const std::string &containerName);
+    static std::string CreateKey(const std::string &image, const std::vector<std::string> &runArguments);
+
+    // requires m_Mutex to be locked
+    std::vector<std::string> CollectIdleContainers();
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Released;
+    Options m_Options;
+    std::map<std::string, Container> m_Containers;
+    std::map<std::string, unsigned int> m_Starting;
+    boost::filesystem::path m_SharedDirectory;
+    unsigned int m_Counter = 0;
+  };
+
+} // namespace mitk
@@ -0,0 +1,117 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkDockerProcess.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Minimal client for the Docker Engine HTTP API on a UNIX domain socket
+   *
+   * Avoids starting the docker CLI for every operation. Each request uses its own
+   * connection ("Connection: close"). Errors (connection failures and HTTP status
+   * codes >= 400) are reported as mitk::Exception.
+   */
+  class MITKDOCKER_EXPORT DockerEngineClient
+  {
+  public:
+    struct Response
+    {
+      int status = 0;
+      std::string body;
+    };
+
+    // receives decoded body data while a streaming request is running
+    using DataCallback = std::function<void(const char *data, std::size_t size)>;
+
+    explicit DockerEngineClient(const std::string &socketPath = GetDefaultSocketPath());
+
+    /**
+     * @brief Socket from DOCKER_HOST (unix://...) or /var/run/docker.sock
+     */
+    static std::string GetDefaultSocketPath();
+
+    std::string GetSocketPath() const;
+
+    // true if the socket exists and the daemon answers /_ping
+    bool IsAvailable() const;
+
+    Response Request(const std::string &method,
+                     const std::string &path,
+                     const std::string &body = "",
+                     DataCallback callback = nullptr) const;
+
+    bool Ping() const;
+
+    // "repository:tag" of all local images
+    std::vector<std::string> ListImages() const;
+    bool HasImage(const std::string &image) const;
+    // content addressed id ("sha256:...") of a local image
+    std::string GetImageId(const std::string &image) const;
+    void PullImage(const std::string &image) const;
+    void RemoveImage(const std::string &image, bool force = true) const;
+
+    // returns the container id
+    std::string CreateContainer(const std::string &name, const nlohmann::json &config) const;
+    void StartContainer(const std::string &id) const;
+
+    // blocks until the container has stopped and returns its exit code
+    int WaitContainer(const std::string &id) const;
+
+    // follows the container output until the container stops
+    void FollowLogs(const std::string &id, DockerProcess::LineCallback callback) const;
+    std::string GetLogs(const std::string &id) const;
+
+    nlohmann::json InspectContainer(const std::string &id) const;
+    // one sample of GET /containers/{id}/stats (memory, cpu and blkio counters)
+    nlohmann::json GetContainerStats(const std::string &id) const;
+    void KillContainer(const std::string &id) const;
+    // sends SIGTERM and kills the container after timeoutSeconds
+    void StopContainer(const std::string &id, int timeoutSeconds) const;
+    void RemoveContainer(const std::string &id, bool force = true) const;
+
+    /**
+     * @brief Translates "docker run" arguments into a create-container configuration.
+     * Supported: -v/--volume, --rm, --name, --gpus, --ipc, -e/--env, --entrypoint, -w/--workdir
+     * and the resource limits of DockerResourceLimits.
+     * @return false if an argument is not supported; the caller should use the CLI instead
+     */
+    static bool TranslateRunArguments(const std::vector<std::string> &runArguments,
+                                      const std::string &image,
+                                      const std::vector<std::string> &command,
+                                      nlohmann::json &config,
+                                      std::string &name);
+
+    // splits "name:tag" into name and tag ("latest" if missing); the tag of "name@sha256:..." is the digest
+    static void SplitImageName(const std::string &image, std::string &name, std::string &tag);
+
+    static std::string EncodeUrl(const std::string &value);
+
+  private:
+    static void ThrowOnError(const Response &response, const std::string &what);
+
+    std::string m_SocketPath;
+  };
+
+} // namespace mitk
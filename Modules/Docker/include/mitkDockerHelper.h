@@ -20,18 +20,58 @@ See LICENSE.txt for details.
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
 
 #include <MitkDockerExports.h>
 #include <mitkBaseData.h>
 
 #include <mitkPointSet.h>
 #include <mitkHelperUtils.h>
+#include <mitkDockerJobScheduler.h>
+#include <mitkDockerInputStore.h>
+#include <mitkDockerProcess.h>
+#include <mitkDockerStagingWriter.h>
+#include <mitkDockerResourceLimits.h>
+#include <mitkDockerResultHandle.h>
+#include <mitkDockerRunReport.h>
+#include <mitkDockerScratchPolicy.h>
+#include <mitkDockerWorkingDirectoryManager.h>
 #include <boost/filesystem.hpp>
 
 
 namespace mitk
 {
+  struct DockerJobSpec;
+
+  /**
+   * @brief Thrown by DockerHelper::GetResults if the run was cancelled with DockerHelper::Cancel
+   */
+  class MITKDOCKER_EXPORT DockerCancelledException : public mitk::Exception
+  {
+  public:
+    mitkExceptionClassMacro(DockerCancelledException, mitk::Exception);
+  };
+
+  /**
+   * @brief Thrown by DockerHelper::GetResults if the container exceeded its run or stall timeout.
+   * The output written until the timeout is kept in the log file of the working directory.
+   */
+  class MITKDOCKER_EXPORT DockerTimeoutException : public mitk::Exception
+  {
+  public:
+    mitkExceptionClassMacro(DockerTimeoutException, mitk::Exception);
+  };
+
   /**
    * @brief This class manages docker container
    *
@@ -46,10 +86,32 @@ namespace mitk
     const bool DIRECTORY = true;
     const bool FLAG_ONLY = true;
 
-    virtual ~DockerHelper(){}
-    DockerHelper(std::string image):m_ImageName(image){
-      m_WorkingDirectory = boost::filesystem::path(mitk::HelperUtils::TempDirPath());
-    }
+    // phases reported to the progress callback
+    enum class Phase
+    {
+      Staging,
+      Queued,
+      Running,
+      Loading,
+      Finished,
+      Cancelled,
+      Failed
+    };
+
+    using ProgressCallback = std::function<void(Phase, const std::string &)>;
+
+    // how containers are run and images are removed
+    enum class Backend
+    {
+      Auto,      // Engine API if the docker socket answers, otherwise the docker CLI
+      EngineApi, // Engine API only
+      Cli        // docker CLI only
+    };
+
+    virtual ~DockerHelper();
+    // the working directory is created when the inputs are staged (see SetScratchPolicy)
+    DockerHelper(std::string image):m_ImageName(image){}
+    explicit DockerHelper(const DockerJobSpec &spec);
 
     struct SaveDataInfo{
       SaveDataInfo(const std::string & name, const std::string & extension, const std::vector<mitk::BaseData::Pointer> & data, bool useAutoSave = false, bool isSingleFile = true)
@@ -128,9 +190,8 @@ namespace mitk
       // path is a directory
       bool isDirectory;
       // list of files expected in the directory
+      // if empty, all files found in the directory are listed in the result manifest (not auto-loaded)
       std::vector<std::string> directoryFileNames;
-      // TODO: auto search folder for all loadable data items
-      // if the directoryFileNames vector is empty
 
 
     };
@@ -141,6 +202,8 @@ namespace mitk
     // void SetData(mitk::BaseData::Pointer data, std::string targetArgument, std::string extension);
     SaveDataInfo* AddAutoSaveData(mitk::BaseData::Pointer data, std::string targetArgument, std::string name, std::string extension);
     SaveDataInfo* AddAutoSaveData(std::vector<mitk::BaseData::Pointer> data, std::string targetArgument, std::string name, std::string extension);
+    // input on disk: linked without loading it if it has the extension, otherwise loaded and written
+    SaveDataInfo* AddAutoSaveFile(const boost::filesystem::path &file, std::string targetArgument, std::string name, std::string extension);
     SaveDataInfo* AddSaveLaterData(mitk::BaseData::Pointer data, std::string targetArgument, std::string name, std::string extension);
     
     LoadDataInfo* AddAutoLoadOutput(std::string targetArgument, std::string nameWithExtension,  bool isFlagOnly=false);
@@ -149,11 +212,210 @@ namespace mitk
     
     void AddAutoLoadFileFormWorkingDirectory(std::string expectedFilename);
 
+    /**
+     * @brief Stages the inputs, runs the container and loads the outputs.
+     * Can be called again: the run arguments are generated anew, the outputs of the previous
+     * run are removed from the working directory and inputs written by the previous run are
+     * kept if their data object is unchanged (same object and modification time).
+     * If result handles of the previous run are still held, their outputs stay in place and
+     * the run gets a new working directory, the written inputs are moved there.
+     */
     std::vector<mitk::BaseData::Pointer> GetResults();
+
+    /**
+     * @brief Replaces image, arguments, run options, inputs and outputs (see DockerJobSpec).
+     * Execution settings (timeouts, callbacks, backend, scheduler, caches) are kept, as is the
+     * working directory with its staged inputs.
+     */
+    void SetJobSpec(const DockerJobSpec &spec);
+    DockerJobSpec GetJobSpec() const;
+
+    /**
+     * @brief Runs GetResults (save, docker run, load) on a worker thread.
+     * The helper has to outlive the returned future. If the run is cancelled,
+     * the future throws a DockerCancelledException. Throws if the previous run has not finished.
+     */
+    std::future<std::vector<mitk::BaseData::Pointer>> GetResultsAsync();
+
+    /**
+     * @brief Runs like GetResults but does not load the outputs.
+     * Returns a handle for every output found in the working directory: auto-load and
+     * load-later outputs, files of output directories and files of the working directory.
+     * The handles load their data on first access; the working directory has to be kept
+     * until then.
+     */
+    DockerResultManifest GetResultManifest();
+
+    // handles of the outputs of the last run (after GetResults the auto-load handles are loaded)
+    const DockerResultManifest &GetResultHandles() const;
+
+    /**
+     * @brief Kills the running container (if any) and removes the working directory.
+     * Can be called from any thread. A cancel before GetResults cancels that run; once the
+     * cancelled run has thrown, the helper can be run again.
+     */
+    void Cancel();
+    bool IsCancelled() const;
+
+    /**
+     * @brief Stops the container if the run phase takes longer than timeout (0: no limit).
+     * GetResults throws a DockerTimeoutException; the working directory and its log file are kept.
+     */
+    void SetRunTimeout(std::chrono::milliseconds timeout);
+
+    // stops the container if it writes no output for longer than timeout (0: no limit)
+    void SetStallTimeout(std::chrono::milliseconds timeout);
+
+    // time between "docker stop" and killing the container (default: 10 s)
+    void SetStopGracePeriod(std::chrono::seconds gracePeriod);
+    bool IsTimedOut() const;
+
+    // callback is invoked on the thread that executes GetResults
+    void SetProgressCallback(ProgressCallback callback);
+
+    // name passed to "docker run --name", derived from the working directory
+    std::string GetContainerName() const;
+
+    /**
+     * @brief Receives the container output line by line while it runs.
+     * The callback is invoked on a reader thread.
+     */
+    void SetLogCallback(DockerProcess::LineCallback callback);
+
+    // the container output is also written to docker.log in the working directory (default limit: 10 MB)
+    void SetMaxLogFileSize(std::uintmax_t bytes);
+    boost::filesystem::path GetLogFilePath() const;
+
+    /**
+     * @brief Selects how the container is run. With Auto, "docker run" is replaced by
+     * DockerEngineClient requests if all run arguments can be translated (see
+     * DockerEngineClient::TranslateRunArguments); otherwise the CLI is used.
+     */
+    void SetBackend(Backend backend);
+    Backend GetBackend() const;
+
     void EnableAutoRemoveImage(bool value);
     void EnableGPUs(bool value);
     void EnableAutoRemoveContainer(bool value);
+
+    /**
+     * @brief Dispatch the run with "docker exec" into a warm container of the DockerContainerPool.
+     * The working directory is moved into the shared pool directory, so this has to be called
+     * before GetResults. The image entrypoint is not applied by "docker exec"; it has to be
+     * passed as entryPoint (or as application argument). Runs that require additional volume
+     * mappings (inputs linked from disk) fall back to "docker run".
+     */
+    void EnableContainerPool(bool value, const std::vector<std::string> &entryPoint = {});
+
+    /**
+     * @brief Run the job in a persistent DockerWorker instead of a new container.
+     * The worker is started once per image, run arguments and worker arguments and keeps
+     * its application resident between jobs (see DockerWorker for the protocol). The
+     * program arguments of this helper are sent as job request. Has to be called before
+     * GetResults. Inputs that require additional volume mappings are not supported.
+     * Cancel() and timeouts cancel only the job of this helper (see DockerWorker).
+     * @param workerArguments command that starts the worker loop inside the container
+     */
+    void EnablePersistentWorker(bool value, const std::vector<std::string> &workerArguments = {});
+
+    /**
+     * @brief Declares the resources the container needs while running.
+     * The run phase waits in the process-wide DockerJobScheduler until the host budget allows it.
+     * If not set, the requirements are derived from the resource limits (CPU quota or cpuset, memory).
+     */
+    void SetResourceRequirements(double cpus, std::uint64_t memoryBytes = 0);
+    DockerJobScheduler::Requirements GetResourceRequirements() const;
+
+    /**
+     * @brief Limits the resources of the container (CPU quota, cpuset, memory, shm, pids, tmpfs).
+     * The limits are validated immediately and again before the inputs are staged.
+     * Use this instead of passing the equivalent raw strings to AddRunArgument.
+     */
+    void SetResourceLimits(const DockerResourceLimits &limits);
+    const DockerResourceLimits &GetResourceLimits() const;
+
+    // image, container name, arguments, limits and requirements of the run (also written to job.json)
+    nlohmann::json GetJobMetadata() const;
+    boost::filesystem::path GetJobMetadataPath() const;
+
+    // enabled by default; if disabled, the run phase is not coordinated with other helpers
+    void EnableJobScheduler(bool value);
+
+    /**
+     * @brief Reuse the outputs of an earlier run with identical inputs (see DockerResultCache).
+     * The key covers the staged input bytes, the image id and the argument vectors (with the
+     * random working directory and mount names normalized). On a hit no container is started.
+     * Only use it for deterministic containers. Disabled by default.
+     */
+    void EnableResultCache(bool value);
+
+    // true if the last GetResults was answered from the result cache
+    bool IsResultCacheHit() const;
+
+    // phase durations, staged and loaded bytes, container start and exit code of the last GetResults
+    const DockerRunReport &GetRunReport() const;
+
+    /**
+     * @brief Samples CPU time, peak memory, block I/O and CPU throttling of the container
+     * while it runs and adds them to the run report (see DockerResourceSampler).
+     * Only containers started for this run are sampled, not pooled or persistent ones.
+     */
+    void EnableResourceSampling(bool value, std::chrono::milliseconds interval = std::chrono::seconds(1));
+
+    // writes the run report to GetRunReportPath() when GetResults finishes or fails (disabled by default)
+    void EnableRunReportFile(bool value);
+    // next to the working directory: <working directory>.report.json
+    boost::filesystem::path GetRunReportPath() const;
+
+    /**
+     * @brief Selects the file system of the working directory (tmpfs, fast disk or spill to disk).
+     * The directory is created when the inputs are staged, so the policy sees the estimated size
+     * of the inputs that are written (linked inputs do not count). Container pool and persistent
+     * worker runs always use the shared pool directory. Default: DockerScratchPolicy::FromEnvironment().
+     */
+    void SetScratchPolicy(const DockerScratchPolicy &policy);
+    const DockerScratchPolicy &GetScratchPolicy() const;
+    // location of the working directory; Disk for the shared pool directory
+    DockerScratchPolicy::Location GetScratchLocation() const;
+
+    // empty until the working directory is created (GetResults or GetFilePath)
     boost::filesystem::path GetWorkingDirectory() const;
+
+    /**
+     * @brief The working directory is deleted (see DockerWorkingDirectoryManager) when this helper
+     * and all result handles of its outputs are destroyed. Kept directories remain for debugging
+     * until they are evicted by the quota or swept as orphans. Timed out runs are always kept
+     * (on disk: a directory on the tmpfs is copied to diskRoot first).
+     */
+    void KeepWorkingDirectory(bool value);
+
+    /**
+     * @brief Number of threads that write the inputs to the working directory (0: hardware threads).
+     * All objects of all arguments are written in parallel; errors are reported together.
+     */
+    void SetStagingThreads(unsigned int threads);
+
+    /**
+     * @brief Images are written by DockerStagingWriter if it supports the file name (".nii", ".nii.gz", ".nrrd"),
+     * everything else with IOUtil::Save. The codec applies to NRRD files (default: uncompressed).
+     */
+    void SetStagingWriterOptions(const DockerStagingWriter::Options &options);
+    const DockerStagingWriter::Options &GetStagingWriterOptions() const;
+
+    /**
+     * @brief Staged inputs are moved into the host-wide DockerInputStore and linked from the working
+     * directory; the store is mounted read-only. Unchanged objects staged before are not written again.
+     * Not used for container pool and persistent worker runs. Default: MITK_DOCKER_INPUT_STORE=1.
+     */
+    void EnableInputStore(bool value);
+
+    /**
+     * @brief Inputs on disk are linked from the working directory; their directories are mounted read-only.
+     * If they are spread over more than maxMounts directories, common ancestors are mounted instead
+     * (see DockerMountPlanner); everything below an ancestor is visible in the container and a warning
+     * names it. Default: 0 (one mount per directory, no ancestors).
+     */
+    void SetMaxInputMounts(unsigned int maxMounts);
     
     
     void AddApplicationArgument(std::string targetParameter, std::string what = "");
@@ -170,9 +432,51 @@ namespace mitk
 
     std::string m_ImageName;
     boost::filesystem::path m_WorkingDirectory;
+    // working directory within the container (relative to the container root)
+    boost::filesystem::path m_ContainerWorkingDirectory;
     bool m_AutoRemoveImage = false;
     bool m_AutoRemoveContainer = false;
     bool m_UseGPUs = false;
+    bool m_UseContainerPool = false;
+    std::vector<std::string> m_ExecEntryPoint;
+    bool m_UsePersistentWorker = false;
+    std::vector<std::string> m_WorkerArguments;
+    bool m_UseJobScheduler = true;
+    bool m_UseResultCache = false;
+    bool m_ResultCacheHit = false;
+    // files written by the helper itself; hashed with normalized paths for the result cache key
+    std::set<std::string> m_GeneratedFiles;
+    Backend m_Backend = Backend::Auto;
+    DockerScratchPolicy m_ScratchPolicy = DockerScratchPolicy::FromEnvironment();
+    // the reservation in the RAM budget is held by DockerWorkingDirectoryManager with the directory
+    DockerScratchPolicy::Location m_ScratchLocation = DockerScratchPolicy::Location::Disk;
+    // the working directory is deleted when the last reference (helper, result handles) is gone
+    DockerWorkingDirectoryManager::Reference m_WorkingDirectoryReference;
+    bool m_KeepWorkingDirectory = false;
+
+    // inputs written to the working directory, reused by the next run if the data is unchanged
+    struct StagedFile
+    {
+      const mitk::BaseData *data = nullptr;
+      itk::ModifiedTimeType modifiedTime = 0;
+    };
+    std::map<boost::filesystem::path, StagedFile> m_StagedFiles;
+    std::set<boost::filesystem::path> m_StagedFilesOfRun;
+    // files to write by WriteStagedFiles
+    std::map<boost::filesystem::path, const mitk::BaseData *> m_PendingStagedFiles;
+    unsigned int m_StagingThreads = 0;
+    DockerStagingWriter::Options m_StagingWriterOptions;
+    bool m_UseInputStore = DockerInputStore::IsEnabledByEnvironment();
+    // stored inputs of the current run
+    std::vector<DockerInputStore::Reference> m_InputStoreReferences;
+    unsigned int m_MaxInputMounts = 0;
+    // input location -> canonical file if it can be linked instead of staged (empty otherwise), per run
+    std::map<std::string, boost::filesystem::path> m_LinkableFiles;
+    std::map<boost::filesystem::path, boost::filesystem::path> m_CanonicalDirectories;
+    bool m_HasRun = false;
+    DockerJobScheduler::Requirements m_ResourceRequirements;
+    bool m_ResourceRequirementsSet = false;
+    DockerResourceLimits m_ResourceLimits;
     
     
     mutable std::map<std::string, SaveDataInfo> m_SaveDataInfo;
@@ -186,6 +490,9 @@ namespace mitk
 
     std::vector<mitk::BaseData::Pointer> m_OutputData;
     std::vector<std::string> m_AutoLoadFilenamesFromWorkingDirectory;
+    DockerResultManifest m_ResultManifest;
+    // set by GetResultManifest: LoadData only collects the output handles
+    bool m_LoadResultsLazily = false;
 
     std::vector<std::string> m_DockerArguments;
     std::vector<std::string> m_ProgramArguments;
@@ -193,14 +500,165 @@ namespace mitk
     // Track mapped volumes: source path -> container path
     std::map<std::string, std::string> m_MappedVolumes;
 
+    ProgressCallback m_ProgressCallback;
+    std::thread m_AsyncThread;
+    // true until the run of m_AsyncThread has finished (the thread may still have to be joined)
+    std::atomic<bool> m_AsyncRunning{false};
+    std::atomic<bool> m_Cancelled{false};
+
+    // guards launching/killing of the docker process
+    mutable std::mutex m_ProcessMutex;
+    long m_ProcessId = 0;
+    std::string m_RunningContainerName;
+    // a container started through the Engine API is running (there is no client process)
+    bool m_EngineContainerRunning = false;
+
+    // watchdog of the run phase
+    std::chrono::milliseconds m_RunTimeout{0};
+    std::chrono::milliseconds m_StallTimeout{0};
+    std::chrono::seconds m_StopGracePeriod{10};
+    std::atomic<bool> m_TimedOut{false};
+    std::string m_TimeoutReason;
+    std::thread m_WatchdogThread;
+    std::mutex m_WatchdogMutex;
+    std::condition_variable m_WatchdogCondition;
+    bool m_WatchdogStop = false;
+    // set when the container has exited, guarded by m_WatchdogMutex
+    bool m_RunReturned = false;
+    std::atomic<std::chrono::steady_clock::rep> m_LastOutputTime{0};
+
+    // run report of the current GetResults call
+    DockerRunReport m_RunReport;
+    bool m_WriteRunReportFile = false;
+    Phase m_ReportPhase = Phase::Staging;
+    std::chrono::steady_clock::time_point m_ReportStartTime;
+    std::chrono::steady_clock::time_point m_ReportPhaseStartTime;
+    // launch of the run and first container output (steady clock ticks, 0: not yet)
+    std::atomic<std::chrono::steady_clock::rep> m_RunLaunchTime{0};
+    std::atomic<std::chrono::steady_clock::rep> m_FirstOutputTime{0};
+    bool m_SampleResources = false;
+    std::chrono::milliseconds m_SampleInterval{1000};
+    std::unique_ptr<DockerResourceSampler> m_ResourceSampler;
+
+    // guards the log file, the log callback and the recent output
+    std::mutex m_LogMutex;
+    // last lines of the container output, reported on timeouts
+    std::deque<std::string> m_RecentOutput;
+    DockerProcess::LineCallback m_LogCallback;
+    std::uintmax_t m_MaxLogFileSize = 10 * 1024 * 1024;
+    std::uintmax_t m_LogFileSize = 0;
+    bool m_LogFileTruncated = false;
+    std::ofstream m_LogFile;
+
     void ExecuteDockerCommand(std::string command, const std::vector<std::string> & args);
-    void GenerateRunData();
+    virtual void GenerateRunData();
+    // working directory mount, run arguments and application arguments
+    void GenerateDockerArguments();
     void Run(const std::vector<std::string> &cmdArgs, const std::vector<std::string> &entryPointArgs);
+    void RunInContainerPool(const std::vector<std::string> &entryPointArgs);
+    void RunInPersistentWorker(const std::vector<std::string> &entryPointArgs);
+    // returns false if the Engine API is not used for this run
+    bool RunWithEngineApi(const std::vector<std::string> &runArgs, const std::vector<std::string> &entryPointArgs);
+    bool UseEngineApi() const;
+    void RemoveContainer(const std::string &containerName);
+    void OnContainerOutput(DockerProcess::Stream stream, const std::string &line);
+    std::vector<std::string> GetContainerRunArguments() const;
+
+    // pool and worker runs need the shared pool directory: drops a (still empty) working directory
+    // that was created elsewhere, it is created again on staging
+    void UseSharedWorkingDirectory(bool value);
+    // creates the working directory if it does not exist yet: in the shared DockerContainerPool
+    // directory for pool and worker runs, otherwise where the scratch policy puts it
+    void CreateWorkingDirectory();
+    // drops the working directory and its staged inputs, the next run creates a new one
+    void ReleaseWorkingDirectory();
+    // replaces the working directory on the tmpfs by a copy on disk (kept directories must not hold RAM)
+    void MoveWorkingDirectoryToDisk();
+    // clears the arguments, outputs and flags of the previous run and removes everything but
+    // the staged inputs from the working directory (see RenewWorkingDirectory)
+    void ResetRunState();
+    // replaces a working directory that result handles still refer to, the staged inputs move along
+    void RenewWorkingDirectory();
+    // queues data to be written to path unless the same unchanged object was written there before
+    void SaveStagedFile(const mitk::BaseData *data, const boost::filesystem::path &path);
+    // writes the queued files in parallel; throws once with the errors of all failed files
+    void WriteStagedFiles();
+    bool UsesInputStore() const;
+    // replaces a staged file by a link to the stored file within the read-only store mount
+    void LinkToInputStore(const boost::filesystem::path &path, DockerInputStore::Reference reference);
+    // removes staged inputs of the previous run that were not used again
+    void RemoveUnusedStagedFiles();
+    // bytes written to the working directory when the inputs are staged (estimate)
+    virtual std::uint64_t EstimateStagingBytes() const;
+    static std::uint64_t EstimateSaveDataBytes(const std::map<std::string, SaveDataInfo> &saveDataInfo);
     void RemoveImage(std::vector<std::string> args = {});
     void GenerateSaveDataInfoAndSaveData();
+    // mounts the directories of all inputs on disk before they are linked by SaveData
+    void PlanInputMounts(const std::vector<const std::map<std::string, SaveDataInfo> *> &saveDataInfos);
+    // canonical file behind data if it is on disk with the requested extension, empty otherwise
+    boost::filesystem::path GetLinkableFile(const mitk::BaseData *data, const std::string &extension);
+    // container path of a file on the host; the directory is mounted if no mount covers it yet
+    boost::filesystem::path MapInputFile(const boost::filesystem::path &fileHost);
     void GenerateLoadDataInfo();
-    void LoadData();
+    virtual void LoadData();
+
+    // outputs relative to the working directory that are stored in the result cache
+    virtual std::vector<std::string> GetResultCacheOutputPaths() const;
+    // empty if the key cannot be computed (e.g. the image is not available locally)
+    std::string ComputeResultCacheKey();
+    std::string ResolveImageId() const;
+    // replaces the random working directory and mount names of a run
+    std::string NormalizeForResultCache(std::string value) const;
+    // host file behind a staged input (follows symlinks into mounted volumes); empty if unknown
+    boost::filesystem::path ResolveStagedFile(const boost::filesystem::path &file) const;
+
+    // saves/links the inputs into hostDirectory and appends the container paths to programArguments
+    void SaveData(std::map<std::string, SaveDataInfo> &saveDataInfo,
+                  const boost::filesystem::path &hostDirectory,
+                  const boost::filesystem::path &containerDirectory,
+                  std::vector<std::string> &programArguments);
+
+    // creates output directories in hostDirectory and appends the container paths to programArguments
+    void PrepareOutputs(const std::vector<LoadDataInfo> &loadDataInfo,
+                        const boost::filesystem::path &hostDirectory,
+                        const boost::filesystem::path &containerDirectory,
+                        std::vector<std::string> &programArguments);
+
+    // handles of all outputs found in hostDirectory
+    DockerResultManifest CollectOutputs(const boost::filesystem::path &hostDirectory) const;
+
+    // adds the outputs of hostDirectory to the result manifest and loads the auto-load outputs
+    // (unless the results are loaded lazily)
+    void LoadOutputs(const boost::filesystem::path &hostDirectory, std::vector<mitk::BaseData::Pointer> &outputData);
     std::string AddOrReuseVolumeMapping(const std::string& sourcePathHost, bool readOnly = false);
+    void WriteJobMetadata();
+    void ReportProgress(Phase phase, const std::string &message);
+
+    void BeginRunReport();
+    // adds the time since the last phase change to the run report; finishes it on terminal phases
+    void AccountPhase(Phase phase, const std::string &message);
+    // sizes of the files written to the working directory while staging
+    void AccountStagedFiles();
+    void MarkRunLaunched();
+    // called as soon as the container has exited, before its exit code is evaluated
+    void MarkRunReturned();
+    void StartResourceSampler(const std::string &containerName);
+    // stops the sampler and adds the usage to the run report
+    void StopResourceSampler();
+    void WriteLogLine(const std::string &line);
+    // flushes docker.log after the container has finished; the next line opens it again
+    void CloseLogFile();
+    void RecordOutput(const std::string &line);
+    void ThrowIfCancelled();
+    void CleanUpAfterCancel();
+
+    void StartWatchdog();
+    void StopWatchdog();
+    // stops (graceful) or kills the container of the run phase and its docker client
+    void StopRunningContainer(bool graceful);
+    // reason of the timeout, log file and the last lines of output
+    std::string GetTimeoutMessage();
+    void CleanUpAfterTimeout();
 
 
 
@@ -0,0 +1,114 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Host-wide content addressed store of staged inputs
+   *
+   * Staged input files are moved into the store once, named by the SHA-256 of their content
+   * and their format, and mounted read-only into every container that needs them (see
+   * DockerHelper::EnableInputStore). The same volume used by several tools or processes is
+   * kept on disk only once.
+   *
+   *   <directory>/files/<sha256><format>
+   *   <directory>/references/<sha256><format>/<host>_<pid>_<n>
+   *
+   * Every use holds a reference file; references of processes that are gone are removed.
+   * Evict() deletes unreferenced files, least recently used first, until the store fits its
+   * budget. The directory defaults to MITK_DOCKER_INPUT_STORE_DIR or <temp>/m2_docker_input_store,
+   * the budget to MITK_DOCKER_INPUT_STORE_BUDGET (bytes) or 10 GiB.
+   */
+  class MITKDOCKER_EXPORT DockerInputStore
+  {
+  public:
+    // a stored file is not evicted while a reference of any process exists
+    class MITKDOCKER_EXPORT Reference
+    {
+    public:
+      Reference() = default;
+      Reference(Reference &&other) noexcept;
+      Reference &operator=(Reference &&other) noexcept;
+      Reference(const Reference &) = delete;
+      Reference &operator=(const Reference &) = delete;
+      ~Reference();
+
+      bool IsValid() const { return !m_Marker.empty(); }
+      // the stored file
+      const boost::filesystem::path &GetPath() const { return m_File; }
+      void Release();
+
+    private:
+      friend class DockerInputStore;
+      Reference(boost::filesystem::path file, boost::filesystem::path marker)
+        : m_File(std::move(file)), m_Marker(std::move(marker))
+      {
+      }
+
+      boost::filesystem::path m_File;
+      boost::filesystem::path m_Marker;
+    };
+
+    static DockerInputStore &GetInstance();
+    // MITK_DOCKER_INPUT_STORE=1: helpers use the store unless disabled
+    static bool IsEnabledByEnvironment();
+    explicit DockerInputStore(const boost::filesystem::path &directory);
+
+    // relocates the store (e.g. in tests); not while helpers use it
+    void SetDirectory(const boost::filesystem::path &directory);
+    const boost::filesystem::path &GetDirectory() const;
+    // directory of the stored files, mounted into the containers
+    boost::filesystem::path GetFilesDirectory() const;
+
+    /**
+     * @brief Moves file into the store and returns a reference to the stored file.
+     * If the content is stored already, file is removed instead. Throws if file cannot be stored.
+     */
+    Reference Deposit(const boost::filesystem::path &file);
+
+    // reference to a stored file by name (<sha256><format>); invalid if it is not stored
+    Reference Acquire(const std::string &name);
+
+    void SetBudget(std::uintmax_t bytes);
+    std::uintmax_t GetBudget() const;
+    std::uintmax_t GetUsedBytes() const;
+
+    // removes unreferenced files, least recently used first, until the store fits its budget
+    void Evict();
+
+  private:
+    boost::filesystem::path GetReferenceDirectory(const std::string &name) const;
+    Reference CreateReference(const std::string &name);
+    // removes reference files of processes of this host that are gone; true if references remain
+    bool IsReferenced(const std::string &name) const;
+
+    boost::filesystem::path m_Directory;
+    std::uintmax_t m_Budget = 10ull * 1024 * 1024 * 1024;
+    mutable std::mutex m_Mutex;
+    std::atomic<std::uint64_t> m_Counter{0};
+  };
+
+} // namespace mitk
@@ -0,0 +1,53 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <mitkDockerJobSpec.h>
+
+#include <memory>
+
+namespace mitk
+{
+  /**
+   * @brief Executes job specs repeatedly in one working directory
+   *
+   * The first Execute creates a DockerHelper; later calls apply the new spec to the
+   * same helper, so inputs whose data objects did not change since the previous run
+   * are not written again. A manifest stays valid while it is held: the next run then
+   * moves to a new working directory. Execution settings (timeouts, callbacks, result
+   * cache, ...) are configured on GetHelper() and apply to all runs.
+   */
+  class MITKDOCKER_EXPORT DockerJobExecutor
+  {
+  public:
+    // loads the auto-load outputs
+    std::vector<mitk::BaseData::Pointer> Execute(const DockerJobSpec &spec);
+
+    // collects the outputs without loading them (see DockerHelper::GetResultManifest)
+    DockerResultManifest ExecuteLazily(const DockerJobSpec &spec);
+
+    // helper of the runs, created with spec on first use (e.g. to set timeouts before the first run)
+    DockerHelper &GetHelper(const DockerJobSpec &spec);
+    DockerHelper &GetHelper();
+
+    std::size_t GetNumberOfRuns() const;
+
+  private:
+    std::unique_ptr<DockerHelper> m_Helper;
+    std::size_t m_NumberOfRuns = 0;
+  };
+
+} // namespace mitk
@@ -0,0 +1,134 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace mitk
+{
+  /**
+   * @brief Admission control for concurrently running containers
+   *
+   * Jobs declare their CPU and memory requirements and are admitted in FIFO order
+   * as long as the sum of all admitted jobs fits into the host budget. A job that
+   * exceeds the whole budget is admitted only if no other job is running.
+   *
+   * The process-wide instance (GetInstance) is used by all DockerHelper instances;
+   * its budget defaults to the number of hardware threads and the physical memory.
+   */
+  class MITKDOCKER_EXPORT DockerJobScheduler
+  {
+  public:
+    struct Requirements
+    {
+      // number of CPUs (fractions allowed)
+      double cpus = 1.0;
+
+      // memory in bytes, 0 if unknown
+      std::uint64_t memoryBytes = 0;
+    };
+
+    struct Statistics
+    {
+      std::size_t queueDepth = 0;
+      std::size_t runningJobs = 0;
+      double usedCpus = 0.0;
+      std::uint64_t usedMemoryBytes = 0;
+      std::size_t admittedJobs = 0;
+      std::chrono::milliseconds lastWaitTime{0};
+      std::chrono::milliseconds maxWaitTime{0};
+      std::chrono::milliseconds averageWaitTime{0};
+    };
+
+    /**
+     * @brief Reservation of resources for an admitted job.
+     * The resources are released when the admission is destroyed or Release() is called.
+     */
+    class MITKDOCKER_EXPORT Admission
+    {
+    public:
+      Admission() = default;
+      Admission(Admission &&other) noexcept;
+      Admission &operator=(Admission &&other) noexcept;
+      Admission(const Admission &) = delete;
+      Admission &operator=(const Admission &) = delete;
+      ~Admission();
+
+      bool IsValid() const { return m_Scheduler != nullptr; }
+      void Release();
+
+    private:
+      friend class DockerJobScheduler;
+      Admission(DockerJobScheduler *scheduler, const Requirements &requirements)
+        : m_Scheduler(scheduler), m_Requirements(requirements)
+      {
+      }
+
+      DockerJobScheduler *m_Scheduler = nullptr;
+      Requirements m_Requirements;
+    };
+
+    static DockerJobScheduler &GetInstance();
+
+    DockerJobScheduler();
+
+    void SetBudget(double cpus, std::uint64_t memoryBytes);
+    double GetCpuBudget() const;
+    std::uint64_t GetMemoryBudget() const;
+
+    /**
+     * @brief Blocks until the job is admitted.
+     * @param isCancelled polled while waiting; if it returns true, the job leaves the
+     *        queue and an invalid admission is returned
+     */
+    Admission Acquire(const Requirements &requirements, std::function<bool()> isCancelled = nullptr);
+
+    std::size_t GetQueueDepth() const;
+    std::size_t GetNumberOfRunningJobs() const;
+    Statistics GetStatistics() const;
+
+  private:
+    void Release(const Requirements &requirements);
+
+    // requires m_Mutex to be locked
+    bool Fits(const Requirements &requirements) const;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Changed;
+    std::deque<std::uint64_t> m_Queue;
+    std::uint64_t m_NextTicket = 0;
+
+    double m_CpuBudget = 1.0;
+    std::uint64_t m_MemoryBudget = 0;
+    double m_UsedCpus = 0.0;
+    std::uint64_t m_UsedMemory = 0;
+    std::size_t m_RunningJobs = 0;
+
+    std::size_t m_AdmittedJobs = 0;
+    std::chrono::milliseconds m_LastWaitTime{0};
+    std::chrono::milliseconds m_MaxWaitTime{0};
+    std::chrono::milliseconds m_TotalWaitTime{0};
+  };
+
+} // namespace mitk
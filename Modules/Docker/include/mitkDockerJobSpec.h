@@ -0,0 +1,57 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <mitkDockerHelper.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mitk
+{
+  /**
+   * @brief What a container run does, independent of its execution state
+   *
+   * Image, run options, arguments, inputs and outputs of a DockerHelper run as a
+   * value type. A spec can be copied, compared and executed any number of times
+   * (see DockerJobExecutor); running it never modifies it.
+   */
+  struct MITKDOCKER_EXPORT DockerJobSpec
+  {
+    std::string image;
+
+    // extra arguments of "docker run" and of the application in the container
+    std::vector<std::string> runArguments;
+    std::vector<std::string> applicationArguments;
+
+    bool gpus = false;
+    bool autoRemoveContainer = false;
+    bool autoRemoveImage = false;
+    DockerResourceLimits resourceLimits;
+
+    // inputs by target argument
+    std::map<std::string, DockerHelper::SaveDataInfo> inputs;
+    std::vector<DockerHelper::LoadDataInfo> outputs;
+
+    // files of the working directory that are loaded after the run
+    std::vector<std::string> workingDirectoryOutputs;
+
+    // how in-memory images are written to the working directory
+    DockerStagingWriter::Options staging;
+  };
+
+} // namespace mitk
@@ -0,0 +1,51 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Computes the read-only bind mounts of inputs that are linked from disk
+   *
+   * Every directory that holds a linked input has to be visible in the container. Instead of one
+   * mount per directory, directories are replaced by common ancestors (deepest first) until at most
+   * maxMounts remain (0: no ancestors, only nested directories are removed). Ancestors with fewer than
+   * minDepth path elements below the root ("/", "/home") are never mounted, so unrelated locations stay
+   * separate mounts. An ancestor exposes everything below it (e.g. "/home/user" with "~/.ssh"), so
+   * merging is opt-in. All computations are lexical; the directories are expected to be canonical.
+   */
+  class MITKDOCKER_EXPORT DockerMountPlanner
+  {
+  public:
+    static std::vector<boost::filesystem::path> Plan(const std::vector<boost::filesystem::path> &directories,
+                                                     std::size_t maxMounts,
+                                                     std::size_t minDepth = 2);
+
+    // true if path is directory or lies below it
+    static bool IsWithin(const boost::filesystem::path &path, const boost::filesystem::path &directory);
+
+    // number of path elements below the root: 2 for "/data/study"
+    static std::size_t GetDepth(const boost::filesystem::path &path);
+  };
+
+} // namespace mitk
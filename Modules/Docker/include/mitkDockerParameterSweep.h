@@ -0,0 +1,91 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <mitkDockerHelper.h>
+
+namespace mitk
+{
+  /**
+   * @brief Runs one staged input set with many application-argument variants
+   *
+   * Inputs (AddAutoSaveData etc.) are staged once into the working directory of the
+   * sweep. Every variant runs in its own container with its own DockerHelper: the sweep
+   * directory and the input mounts are shared read-only, outputs are written to the
+   * (read-write) working directory of the variant.
+   *
+   *   <program> <application arguments> <inputs> <variant arguments> <outputs>
+   *
+   * Variants run in parallel (SetMaxParallelVariants), each one is still admitted by the
+   * DockerJobScheduler. Timeouts, backend, resource settings and the scratch policy of the
+   * sweep apply to every variant. Use RunSweep instead of GetResults.
+   */
+  class MITKDOCKER_EXPORT DockerParameterSweep : public DockerHelper
+  {
+  public:
+    struct Variant
+    {
+      std::string name;
+      std::vector<std::string> arguments;
+    };
+
+    struct VariantResult
+    {
+      Variant variant;
+      // auto-load outputs (empty if the variant failed)
+      std::vector<mitk::BaseData::Pointer> data;
+      DockerRunReport report;
+      // error message if the variant failed
+      std::string error;
+
+      bool Succeeded() const { return error.empty(); }
+    };
+
+    DockerParameterSweep(std::string image) : DockerHelper(image) {}
+
+    void AddVariant(const std::string &name, const std::vector<std::string> &arguments);
+
+    /**
+     * @brief Adds a variant for every combination of the parameter values.
+     * The variants are named "<argument>=<value>,<argument>=<value>,..." in parameter order.
+     */
+    void AddGrid(const std::vector<std::pair<std::string, std::vector<std::string>>> &parameters);
+
+    const std::vector<Variant> &GetVariants() const;
+
+    // 0: number of hardware threads (default)
+    void SetMaxParallelVariants(unsigned int value);
+
+    /**
+     * @brief Stages the inputs once and runs all variants.
+     * Failing variants do not stop the others; their error is stored in the result.
+     * @return results by variant name
+     */
+    std::map<std::string, VariantResult> RunSweep();
+
+  protected:
+    // program and mount arguments of the staged inputs
+    void StageSharedInputs();
+    VariantResult RunVariant(const Variant &variant);
+
+    std::vector<Variant> m_Variants;
+    unsigned int m_MaxParallelVariants = 0;
+
+    std::mutex m_VariantHelpersMutex;
+    std::set<DockerHelper *> m_VariantHelpers;
+  };
+
+} // namespace mitk
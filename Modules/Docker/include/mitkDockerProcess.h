@@ -0,0 +1,103 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Poco
+{
+  class Pipe;
+  class ProcessHandle;
+}
+
+namespace mitk
+{
+  /**
+   * @brief A running docker CLI process with captured output
+   *
+   * stdout and stderr are drained on two reader threads and delivered line by line
+   * to the line callback, so the pipes never block the process.
+   */
+  class MITKDOCKER_EXPORT DockerProcess
+  {
+  public:
+    enum class Stream
+    {
+      StdOut,
+      StdErr
+    };
+
+    // invoked on a reader thread
+    using LineCallback = std::function<void(Stream, const std::string &)>;
+
+    // args are passed to the docker executable
+    explicit DockerProcess(const std::vector<std::string> &args);
+    ~DockerProcess();
+
+    DockerProcess(const DockerProcess &) = delete;
+    DockerProcess &operator=(const DockerProcess &) = delete;
+
+    void SetLineCallback(LineCallback callback);
+
+    void Start();
+
+    // waits for the process and the reader threads, returns the exit code
+    int Wait();
+
+    long GetProcessId() const;
+    bool IsRunning() const;
+    void Kill();
+
+    /**
+     * @brief Runs docker with args and waits for it.
+     * @param output receives stdout if not null; stderr is discarded
+     * @return exit code
+     */
+    static int Execute(const std::vector<std::string> &args, std::string *output = nullptr);
+
+    /**
+     * @brief Executable used instead of "docker" (e.g. the MitkDockerFake test tool).
+     * Defaults to the environment variable MITK_DOCKER_EXECUTABLE or "docker". An empty
+     * value restores the default.
+     */
+    static void SetExecutable(const std::string &executable);
+    static std::string GetExecutable();
+
+    // true if another executable than "docker" is used; the Engine API is then not used automatically
+    static bool HasCustomExecutable();
+
+  private:
+    void ReadLines(Poco::Pipe &pipe, Stream stream);
+
+    std::vector<std::string> m_Args;
+    LineCallback m_LineCallback;
+    std::unique_ptr<Poco::Pipe> m_OutPipe;
+    std::unique_ptr<Poco::Pipe> m_ErrPipe;
+    std::unique_ptr<Poco::ProcessHandle> m_Handle;
+    std::thread m_OutReader;
+    std::thread m_ErrReader;
+    long m_ProcessId = 0;
+    bool m_Finished = false;
+    int m_ExitCode = -1;
+  };
+
+} // namespace mitk
@@ -0,0 +1,87 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Resource limits and placement of a container run
+   *
+   * Unset values (0 or empty) are not passed to docker. Validate() checks the
+   * limits against the host before a container is started, so invalid settings
+   * fail early instead of after the inputs were staged.
+   */
+  struct MITKDOCKER_EXPORT DockerResourceLimits
+  {
+    struct TmpfsMount
+    {
+      // absolute path within the container
+      std::string containerPath;
+
+      // 0: docker default (half of the host memory)
+      std::uint64_t sizeBytes = 0;
+    };
+
+    // CPU quota, "--cpus" (fractions allowed)
+    double cpus = 0.0;
+
+    // CPUs the container may run on, "--cpuset-cpus" (e.g. "0-3,6")
+    std::string cpusetCpus;
+
+    // hard memory limit, "--memory"
+    std::uint64_t memoryBytes = 0;
+
+    // memory plus swap, "--memory-swap"; -1 for unlimited swap, requires memoryBytes
+    std::int64_t memorySwapBytes = 0;
+
+    // size of /dev/shm, "--shm-size"
+    std::uint64_t shmSizeBytes = 0;
+
+    // share the IPC namespace (and /dev/shm) of the host, "--ipc=host"
+    bool hostIpc = false;
+
+    // maximum number of processes, "--pids-limit"; -1 for unlimited
+    std::int64_t pidsLimit = 0;
+
+    // "--tmpfs"
+    std::vector<TmpfsMount> tmpfs;
+
+    bool IsEmpty() const;
+
+    // throws a mitk::Exception describing the first invalid setting
+    void Validate() const;
+
+    // the docker run arguments of all set limits
+    std::vector<std::string> ToRunArguments() const;
+
+    nlohmann::json ToJson() const;
+
+    // number of CPUs the container can use (cpus or the size of the cpuset), 0 if unlimited
+    double GetEffectiveCpus() const;
+
+    // parses a cpuset list like "0-3,6"; throws on syntax errors
+    static std::vector<unsigned int> ParseCpuSet(const std::string &cpuset);
+  };
+
+} // namespace mitk
@@ -0,0 +1,110 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <nlohmann/json.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Resources used by a container, as far as they were observed by a DockerResourceSampler
+   *
+   * Counters are cumulative over the lifetime of the container up to the last sample.
+   */
+  struct MITKDOCKER_EXPORT DockerResourceUsage
+  {
+    // "cgroup-v2" or "engine-api"; empty if no sample was taken
+    std::string source;
+    std::size_t samples = 0;
+
+    // memory.peak if the kernel provides it, otherwise the highest sampled usage
+    std::uint64_t peakMemoryBytes = 0;
+    double cpuSeconds = 0.0;
+    std::uint64_t blockReadBytes = 0;
+    std::uint64_t blockWriteBytes = 0;
+
+    // CFS periods in which the container was throttled by its CPU quota
+    std::uint64_t throttledPeriods = 0;
+    double throttledSeconds = 0.0;
+
+    // keeps the maxima of both (all values are peaks or monotonic counters)
+    void Merge(const DockerResourceUsage &sample);
+
+    nlohmann::json ToJson() const;
+  };
+
+  /**
+   * @brief Polls the resource usage of a running container on a background thread
+   *
+   * The cgroup v2 files of the container (memory.peak/memory.current, cpu.stat, io.stat)
+   * are read directly if the cgroup is visible to this process. Otherwise the one-shot
+   * stats of the Docker Engine API are used. The container is looked up by name until
+   * it exists. Usage after the last sample (at most one interval) is not observed.
+   */
+  class MITKDOCKER_EXPORT DockerResourceSampler
+  {
+  public:
+    explicit DockerResourceSampler(const std::string &containerName,
+                                   std::chrono::milliseconds interval = std::chrono::seconds(1));
+    ~DockerResourceSampler();
+
+    DockerResourceSampler(const DockerResourceSampler &) = delete;
+    DockerResourceSampler &operator=(const DockerResourceSampler &) = delete;
+
+    void Start();
+    void Stop();
+
+    DockerResourceUsage GetUsage() const;
+
+    // cgroup v2 directory of a container (systemd and cgroupfs drivers); empty if not found
+    static boost::filesystem::path FindCgroupDirectory(const std::string &containerId,
+                                                       const boost::filesystem::path &cgroupRoot = "/sys/fs/cgroup");
+
+    // reads one sample from a cgroup v2 directory; false if the cgroup does not exist (anymore)
+    static bool ReadCgroup(const boost::filesystem::path &directory, DockerResourceUsage &sample);
+
+    // reads one sample from the response of GET /containers/{id}/stats
+    static void ParseEngineStats(const nlohmann::json &stats, DockerResourceUsage &sample);
+
+  private:
+    void Sample();
+    std::string ResolveContainerId() const;
+
+    std::string m_ContainerName;
+    std::chrono::milliseconds m_Interval;
+    std::string m_ContainerId;
+    boost::filesystem::path m_CgroupDirectory;
+    bool m_UseEngineApi = false;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stop = false;
+    std::thread m_Thread;
+    DockerResourceUsage m_Usage;
+  };
+
+} // namespace mitk
@@ -0,0 +1,171 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief On-disk cache of container outputs
+   *
+   * Entries are addressed by a key computed from everything that determines the
+   * outputs of a run (see DockerHelper::EnableResultCache): the staged input bytes,
+   * the image id and the normalized argument vectors. An entry stores the output
+   * files relative to the working directory:
+   *
+   *   <cache directory>/<key>/entry.json
+   *   <cache directory>/<key>/outputs/...
+   *
+   * Runs with the same key are coalesced within the process: ClaimKey blocks
+   * while another run holds the key, so the second run finds the stored entry.
+   *
+   * The directory defaults to MITK_DOCKER_CACHE_DIR or <temp>/m2_docker_result_cache.
+   * If the cache exceeds its maximum size, the least recently used entries are removed.
+   */
+  class MITKDOCKER_EXPORT DockerResultCache
+  {
+  public:
+    struct Statistics
+    {
+      std::size_t hits = 0;
+      std::size_t misses = 0;
+      std::size_t stores = 0;
+      std::size_t coalesced = 0;
+    };
+
+    /**
+     * @brief Exclusive right to compute the entry of a key.
+     * The key is released when the claim is destroyed or Release() is called.
+     */
+    class MITKDOCKER_EXPORT Claim
+    {
+    public:
+      Claim() = default;
+      Claim(Claim &&other) noexcept;
+      Claim &operator=(Claim &&other) noexcept;
+      Claim(const Claim &) = delete;
+      Claim &operator=(const Claim &) = delete;
+      ~Claim();
+
+      bool IsValid() const { return m_Cache != nullptr; }
+      void Release();
+
+    private:
+      friend class DockerResultCache;
+      Claim(DockerResultCache *cache, const std::string &key) : m_Cache(cache), m_Key(key) {}
+
+      DockerResultCache *m_Cache = nullptr;
+      std::string m_Key;
+    };
+
+    static DockerResultCache &GetInstance();
+
+    DockerResultCache();
+
+    void SetDirectory(const boost::filesystem::path &directory);
+    boost::filesystem::path GetDirectory() const;
+
+    // 0: unlimited (default: 10 GB)
+    void SetMaxSize(std::uintmax_t bytes);
+    std::uintmax_t GetMaxSize() const;
+
+    /**
+     * @brief Waits until no other run in this process holds the key and claims it.
+     * Returns an invalid claim if isCancelled returns true while waiting.
+     */
+    Claim ClaimKey(const std::string &key, std::function<bool()> isCancelled = nullptr);
+
+    bool Contains(const std::string &key) const;
+
+    /**
+     * @brief Hard links (or copies) the outputs of an entry into directory.
+     * @return false if there is no entry for key
+     */
+    bool Restore(const std::string &key, const boost::filesystem::path &directory);
+
+    /**
+     * @brief Stores the outputs (files or directories relative to directory) as entry of key.
+     * Missing outputs are skipped. Removes least recently used entries afterwards.
+     */
+    void Store(const std::string &key,
+               const boost::filesystem::path &directory,
+               const std::vector<std::string> &outputPaths);
+
+    // removes least recently used entries until the cache fits its maximum size
+    void Evict();
+    void Clear();
+
+    Statistics GetStatistics() const;
+
+    // hex encoded SHA-256 of the file content; memoized by path, device, inode, size and the
+    // modification and status change times in nanoseconds
+    std::string HashFile(const boost::filesystem::path &file);
+    // drops the memoized hash, e.g. before the file is written again
+    void ForgetFile(const boost::filesystem::path &file);
+    // hashes without the memo
+    static std::string HashFileContent(const boost::filesystem::path &file);
+    static std::string HashString(const std::string &value);
+
+    struct FileIdentity
+    {
+      std::uint64_t device = 0;
+      std::uint64_t inode = 0;
+      std::uint64_t size = 0;
+      std::int64_t modifiedNanoseconds = 0;
+      std::int64_t changedNanoseconds = 0;
+
+      bool operator==(const FileIdentity &other) const
+      {
+        return device == other.device && inode == other.inode && size == other.size &&
+               modifiedNanoseconds == other.modifiedNanoseconds && changedNanoseconds == other.changedNanoseconds;
+      }
+    };
+
+  private:
+    void ReleaseKey(const std::string &key);
+    boost::filesystem::path GetEntryDirectory(const std::string &key) const;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Released;
+    std::set<std::string> m_ClaimedKeys;
+    boost::filesystem::path m_Directory;
+    std::uintmax_t m_MaxSize = 10ull * 1024 * 1024 * 1024;
+    Statistics m_Statistics;
+
+    struct FileHash
+    {
+      FileIdentity identity;
+      std::string hash;
+    };
+    static constexpr std::size_t MaxFileHashes = 4096;
+    std::map<std::string, FileHash> m_FileHashes;
+    std::size_t m_Counter = 0;
+  };
+
+} // namespace mitk
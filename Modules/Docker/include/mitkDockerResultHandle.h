@@ -0,0 +1,96 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkDockerWorkingDirectoryManager.h>
+#include <mitkBaseData.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Output file of a container run that is loaded on first access
+   *
+   * Path, size, format and the image header (read with an ITK ImageIO, without
+   * pixel data) are available without loading the file. GetData loads it with
+   * mitk::IOUtil, Release drops the loaded objects again.
+   */
+  class MITKDOCKER_EXPORT DockerResultHandle
+  {
+  public:
+    struct ImageHeader
+    {
+      // false if the file is no image readable by ITK
+      bool valid = false;
+      unsigned int dimension = 0;
+      std::vector<std::size_t> size;
+      std::vector<double> spacing;
+      std::vector<double> origin;
+      unsigned int numberOfComponents = 0;
+      std::string pixelType;
+      std::string componentType;
+    };
+
+    DockerResultHandle(const std::string &argument, const boost::filesystem::path &path, bool autoLoad);
+
+    // the program argument the output was declared for (empty for files of the working directory)
+    const std::string &GetArgument() const;
+    const boost::filesystem::path &GetPath() const;
+
+    // declared as auto-load output (loaded by DockerHelper::GetResults)
+    bool IsAutoLoad() const;
+
+    bool Exists() const;
+    std::uintmax_t GetSize() const;
+
+    // file extension including compound extensions like ".nii.gz"
+    std::string GetFormat() const;
+
+    // read once and cached
+    ImageHeader GetImageHeader() const;
+
+    // loads the file on first access
+    std::vector<mitk::BaseData::Pointer> GetData();
+    bool IsLoaded() const;
+    void Release();
+
+    // keeps the working directory of the run (and so the file) until the handle is destroyed
+    void SetWorkingDirectoryReference(DockerWorkingDirectoryManager::Reference reference);
+
+  private:
+    std::string m_Argument;
+    boost::filesystem::path m_Path;
+    bool m_AutoLoad;
+    DockerWorkingDirectoryManager::Reference m_WorkingDirectoryReference;
+
+    mutable std::mutex m_Mutex;
+    bool m_Loaded = false;
+    std::vector<mitk::BaseData::Pointer> m_Data;
+    mutable bool m_HeaderRead = false;
+    mutable ImageHeader m_Header;
+  };
+
+  // all outputs of a run
+  using DockerResultManifest = std::vector<std::shared_ptr<DockerResultHandle>>;
+
+} // namespace mitk
@@ -0,0 +1,85 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkDockerResourceSampler.h>
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include <nlohmann/json.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Timing and I/O accounting of one DockerHelper::GetResults call
+   *
+   * Durations are wall-clock seconds of the phases reported to the progress
+   * callback. Values that were not measured (e.g. the exit code of a run that
+   * was answered from the result cache) are -1.
+   */
+  struct MITKDOCKER_EXPORT DockerRunReport
+  {
+    std::string image;
+    std::string containerName;
+    boost::filesystem::path workingDirectory;
+    // file system of the working directory: "ram", "fast" or "disk" (see DockerScratchPolicy)
+    std::string scratchLocation;
+
+    // "engine-api", "cli", "container-pool", "persistent-worker" or "result-cache"
+    std::string backend;
+
+    // "finished", "failed", "cancelled" or "timeout"
+    std::string status;
+    std::string message;
+
+    double stagingSeconds = 0.0;
+    double queuedSeconds = 0.0;
+    double runningSeconds = 0.0;
+    double loadingSeconds = 0.0;
+    double totalSeconds = 0.0;
+
+    // create and start of the container (Engine API only)
+    double containerStartSeconds = -1.0;
+    // from launching the run until the first line of container output
+    double firstOutputSeconds = -1.0;
+    int exitCode = -1;
+
+    // files written into the working directory while staging (inputs and job files)
+    std::uintmax_t stagingBytesWritten = 0;
+    std::size_t stagingFilesWritten = 0;
+    // inputs linked from disk instead of written
+    std::size_t stagingFilesLinked = 0;
+    // unchanged inputs hard linked or kept from an earlier staging instead of written (part of stagingFilesWritten)
+    std::size_t stagingFilesReused = 0;
+
+    // output files read while loading
+    std::uintmax_t loadingBytesRead = 0;
+    std::size_t loadingFilesRead = 0;
+
+    // sampled while the container ran (see DockerHelper::EnableResourceSampling)
+    DockerResourceUsage resources;
+
+    nlohmann::json ToJson() const;
+
+    // throws a mitk::Exception if the file cannot be written
+    void WriteJson(const boost::filesystem::path &path) const;
+  };
+
+} // namespace mitk
@@ -0,0 +1,120 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Selects the file system for the working directory of a run
+   *
+   * A RAM-backed tmpfs (ramRoot) is used if the estimated size of the run fits into
+   * the RAM budget of this process and into the free space of the tmpfs. Otherwise
+   * a fast local disk (fastRoot) is used if it is configured and has enough free
+   * space; everything else spills to diskRoot (the system temp directory if empty).
+   *
+   * The RAM budget is shared by all runs of the process: Reserve() accounts the
+   * estimated size until the returned reservation is released. DockerHelper hands it to
+   * DockerWorkingDirectoryManager, which releases it when the directory is removed.
+   */
+  struct MITKDOCKER_EXPORT DockerScratchPolicy
+  {
+    enum class Location
+    {
+      Ram,
+      Fast,
+      Disk
+    };
+
+    /**
+     * @brief Estimated bytes of a working directory held in the RAM budget.
+     * The bytes are returned to the budget when the reservation is destroyed or Release() is called.
+     */
+    class MITKDOCKER_EXPORT Reservation
+    {
+    public:
+      Reservation() = default;
+      Reservation(Reservation &&other) noexcept;
+      Reservation &operator=(Reservation &&other) noexcept;
+      Reservation(const Reservation &) = delete;
+      Reservation &operator=(const Reservation &) = delete;
+      ~Reservation();
+
+      Location GetLocation() const { return m_Location; }
+      const boost::filesystem::path &GetRoot() const { return m_Root; }
+      std::uint64_t GetBytes() const { return m_Bytes; }
+      void Release();
+
+    private:
+      friend struct DockerScratchPolicy;
+      Reservation(Location location, boost::filesystem::path root, std::uint64_t ramBytes)
+        : m_Location(location), m_Root(std::move(root)), m_Bytes(ramBytes)
+      {
+      }
+
+      Location m_Location = Location::Disk;
+      boost::filesystem::path m_Root;
+      // bytes accounted in the RAM budget (0 for the other locations)
+      std::uint64_t m_Bytes = 0;
+    };
+
+    // RAM-backed file system
+    boost::filesystem::path ramRoot = "/dev/shm";
+
+    // bytes all working directories of this process may use on ramRoot (0: ramRoot is not used)
+    std::uint64_t ramBudgetBytes = 0;
+
+    // fast local disk, e.g. an NVMe scratch volume (empty: not used)
+    boost::filesystem::path fastRoot;
+
+    // fallback (empty: system temp directory)
+    boost::filesystem::path diskRoot;
+
+    // outputs are expected to need outputFactor times the staged input size
+    double outputFactor = 1.0;
+
+    // first location that fits the estimated size of the staged inputs (without reserving it)
+    Location Select(std::uint64_t stagedBytes) const;
+
+    // selects a location and accounts the estimated size in the RAM budget if the tmpfs is used
+    Reservation Reserve(std::uint64_t stagedBytes) const;
+
+    boost::filesystem::path GetRoot(Location location) const;
+
+    // staged inputs plus the expected outputs
+    std::uint64_t GetRequiredBytes(std::uint64_t stagedBytes) const;
+
+    /**
+     * @brief Policy configured by the environment (used by DockerHelper by default).
+     * MITK_DOCKER_SCRATCH_RAM_BUDGET (bytes, optional suffix K/M/G), MITK_DOCKER_SCRATCH_RAM_ROOT,
+     * MITK_DOCKER_SCRATCH_FAST_ROOT and MITK_DOCKER_SCRATCH_DISK_ROOT. Without variables
+     * every working directory is created in the system temp directory as before.
+     */
+    static DockerScratchPolicy FromEnvironment();
+
+    // bytes of the RAM budget currently reserved by working directories of this process
+    static std::uint64_t GetReservedRamBytes();
+
+    static std::string ToString(Location location);
+  };
+
+} // namespace mitk
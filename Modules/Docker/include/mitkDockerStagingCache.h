@@ -0,0 +1,87 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkBaseData.h>
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Process-wide record of the files that in-memory inputs were staged to
+   *
+   * Entries are keyed by object identity, the file format (compound extension) and the
+   * modification time of the object (GetMTime). Modification times are unique within the
+   * process, so an object allocated at the address of a deleted one never matches. An
+   * unchanged object that was staged by any helper before is hard linked into the next
+   * working directory instead of being written again. Entries are dropped when the object is modified or when their file is gone or
+   * was changed after staging (e.g. by the container).
+   *
+   * Hard links only work within one file system; other targets are written as usual.
+   * Disabled by MITK_DOCKER_STAGING_CACHE=0.
+   */
+  class MITKDOCKER_EXPORT DockerStagingCache
+  {
+  public:
+    static DockerStagingCache &GetInstance();
+
+    // records that the current state of data was written to path
+    void Add(const mitk::BaseData *data, const boost::filesystem::path &path);
+
+    // hard links a staged file of the unchanged data with the format of target; false if there is none
+    bool LinkTo(const mitk::BaseData *data, const boost::filesystem::path &target);
+
+    // staged files of the unchanged data with the given format
+    std::vector<boost::filesystem::path> Find(const mitk::BaseData *data, const std::string &format) const;
+
+    void SetEnabled(bool value);
+    bool IsEnabled() const;
+
+    void Clear();
+    std::size_t GetNumberOfFiles() const;
+
+    // ".nii.gz" for "image.nii.gz"
+    static std::string GetFormat(const boost::filesystem::path &path);
+
+  private:
+    DockerStagingCache();
+
+    struct File
+    {
+      itk::ModifiedTimeType modifiedTime = 0;
+      boost::filesystem::path path;
+      std::uintmax_t size = 0;
+      std::time_t writeTime = 0;
+    };
+
+    static bool IsUnchanged(const File &file);
+    void RemoveStaleFiles();
+
+    mutable std::mutex m_Mutex;
+    bool m_Enabled = true;
+    std::map<std::pair<const mitk::BaseData *, std::string>, std::vector<File>> m_Files;
+  };
+
+} // namespace mitk
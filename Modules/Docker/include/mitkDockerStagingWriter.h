@@ -0,0 +1,69 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkBaseData.h>
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  class Image;
+
+  /**
+   * @brief Writes images that only exist in memory to the working directory of a run
+   *
+   * NIfTI-1 (".nii", ".nii.gz") and NRRD (".nrrd") files are written directly from the image
+   * buffer with one sequential write, instead of going through IOUtil::Save and the ITK writers.
+   * The files are read back by ITK, MITK, nibabel and pynrrd with the same geometry.
+   *
+   * ".nii" is always uncompressed and ".nii.gz" always gzip compressed; NRRD files use the codec
+   * of the options. Gzip uses the zlib library of ITK; level 1 is several times faster than the
+   * default level of the ITK writers and compresses CT/MR volumes almost as well.
+   */
+  class MITKDOCKER_EXPORT DockerStagingWriter
+  {
+  public:
+    enum class Codec
+    {
+      Raw,
+      Gzip
+    };
+
+    struct Options
+    {
+      // false: all inputs are written with IOUtil::Save
+      bool enabled = true;
+      Codec codec = Codec::Raw;
+      // zlib level, 1 (fast) to 9 (small)
+      int level = 1;
+    };
+
+    // images with one scalar component, 2 to 4 dimensions and a supported file name
+    static bool CanWrite(const mitk::BaseData *data, const boost::filesystem::path &path);
+
+    // returns the number of bytes written
+    static std::uint64_t Write(const mitk::Image *image, const boost::filesystem::path &path, const Options &options);
+
+    static std::string ToString(Codec codec);
+    static Codec CodecFromString(const std::string &value);
+  };
+
+} // namespace mitk
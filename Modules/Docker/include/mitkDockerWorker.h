@@ -0,0 +1,152 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Poco
+{
+  class Pipe;
+  class ProcessHandle;
+}
+
+namespace mitk
+{
+  /**
+   * @brief Long-lived worker container that keeps its application (e.g. a model) resident
+   *
+   * The worker is started once with "docker run -i" and the shared directory of the
+   * DockerContainerPool mounted. Jobs are sent as JSON lines to the stdin of the container:
+   *
+   *   {"id": 1, "workdir": "/m2_pool/m2_abc123", "args": ["-i", "/m2_pool/m2_abc123/input.nii", ...]}
+   *
+   * After the job has finished, the worker has to write a completion record as JSON line to stdout:
+   *
+   *   {"id": 1, "status": "ok"}
+   *   {"id": 1, "status": "error", "message": "..."}
+   *
+   * All other lines written to stdout are forwarded to the output callback. Jobs are processed one after
+   * another; the worker is shut down by closing its stdin.
+   *
+   * A running job is cancelled with a cancel request; the worker should stop the job and write its
+   * completion record (any status):
+   *
+   *   {"id": 1, "cancel": true}
+   *
+   * A worker that does not complete the job within the grace period is discarded (killed). Jobs of
+   * other callers that wait for a discarded worker are not sent and can be submitted to a new worker.
+   *
+   * Lines written to stderr are forwarded to the output callback of the running job (and logged as
+   * warnings between jobs); the last of them are reported if the worker terminates.
+   */
+  class MITKDOCKER_EXPORT DockerWorker
+  {
+  public:
+    using Pointer = std::shared_ptr<DockerWorker>;
+
+    /**
+     * @brief Returns the running worker for the given configuration or starts a new one.
+     * @param runArguments additional "docker run" arguments (e.g. "--gpus", "device=0")
+     * @param workerArguments command that starts the worker loop inside the container
+     */
+    static Pointer GetWorker(const std::string &image,
+                             const std::vector<std::string> &runArguments,
+                             const std::vector<std::string> &workerArguments);
+
+    // stops all workers started with GetWorker
+    static void ShutdownAll();
+
+    ~DockerWorker();
+
+    /**
+     * @brief Sends a job and blocks until its completion record is received.
+     * Throws if the worker reports an error or terminates. If cancelled returns true, a job that waits
+     * for the worker is not sent and a running job is cancelled (see class description); both throw.
+     * @return false if the worker was discarded or terminated before the job was sent
+     */
+    bool Submit(const std::string &containerWorkingDirectory,
+                const std::vector<std::string> &args,
+                std::function<void(const std::string &)> outputCallback = nullptr,
+                std::function<bool()> cancelled = nullptr,
+                std::chrono::milliseconds cancelGracePeriod = std::chrono::seconds(10));
+
+    bool IsRunning() const;
+    std::string GetContainerName() const;
+    long GetProcessId() const;
+
+    // stops the container by closing its stdin
+    void Shutdown();
+
+  private:
+    DockerWorker(const std::string &image,
+                 const std::vector<std::string> &runArguments,
+                 const std::vector<std::string> &workerArguments);
+
+    // returns false if the worker closed the pipe
+    static bool ReadLine(Poco::Pipe &pipe, std::string &buffer, std::string &line);
+    // reads the stdout of the worker into m_Lines
+    void ReadOutput();
+    // reads the stderr of the worker into m_ErrorLines
+    void ReadErrors();
+    // removes and returns the stderr lines read so far
+    std::vector<std::string> TakeErrorLines();
+    // returns false if the worker has exited (without raising SIGPIPE)
+    bool WriteLine(const std::string &line);
+    // kills the container; waiting jobs are not sent
+    void Discard();
+
+    std::string m_ContainerName;
+    std::unique_ptr<Poco::Pipe> m_InPipe;
+    std::unique_ptr<Poco::Pipe> m_OutPipe;
+    std::unique_ptr<Poco::Pipe> m_ErrPipe;
+    std::unique_ptr<Poco::ProcessHandle> m_Handle;
+    std::string m_ReadBuffer;
+    std::string m_ErrorBuffer;
+    std::atomic<bool> m_Running{false};
+    long m_ProcessId = 0;
+    unsigned long m_NextJobId = 1;
+
+    std::thread m_ReaderThread;
+    std::thread m_ErrorThread;
+    std::mutex m_LinesMutex;
+    std::condition_variable m_LinesCondition;
+    std::deque<std::string> m_Lines;
+    bool m_OutputClosed = false;
+    // last stderr lines, at most MaxErrorLines
+    std::deque<std::string> m_ErrorLines;
+    bool m_ErrorClosed = false;
+    static constexpr std::size_t MaxErrorLines = 100;
+
+    // serializes jobs, a worker processes one job at a time
+    std::timed_mutex m_Mutex;
+
+    static std::mutex s_RegistryMutex;
+    static std::map<std::string, Pointer> s_Workers;
+  };
+
+} // namespace mitk
@@ -0,0 +1,125 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#pragma once
+
+#include <MitkDockerExports.h>
+#include <mitkDockerScratchPolicy.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace mitk
+{
+  /**
+   * @brief Tracks the working directories of DockerHelper runs
+   *
+   * Every working directory is registered when it is created. The returned reference
+   * is held by the helper and by the result handles of its outputs; when the last copy
+   * is destroyed the directory is deleted, unless it was marked with Keep (debugging,
+   * timed out runs).
+   *
+   * Kept directories count against the quota; if the quota is exceeded, the least
+   * recently used kept directories that are no longer referenced are evicted.
+   *
+   * The directories of a process are listed in a session file, its kept directories
+   * in a kept file next to it. On startup the directories of sessions whose process
+   * no longer runs are removed, as well as their kept directories that are older than
+   * the orphan age. Directories that were not registered here (e.g. of
+   * HelperUtils::TempDirPath) and the result cache are never touched.
+   */
+  class MITKDOCKER_EXPORT DockerWorkingDirectoryManager
+  {
+  public:
+    // keeps a registered directory alive while copies exist
+    using Reference = std::shared_ptr<const boost::filesystem::path>;
+
+    static DockerWorkingDirectoryManager &GetInstance();
+
+    /**
+     * @param sessionDirectory location of the session files
+     * @param sweep sweep orphans of crashed sessions (GetInstance: unless MITK_DOCKER_SWEEP_ORPHANS=0)
+     */
+    DockerWorkingDirectoryManager(const boost::filesystem::path &sessionDirectory, bool sweep);
+    ~DockerWorkingDirectoryManager();
+
+    // the reservation of the directory in the RAM budget is held until the directory is removed
+    Reference Register(const boost::filesystem::path &directory,
+                       DockerScratchPolicy::Reservation reservation = DockerScratchPolicy::Reservation());
+
+    // kept directories survive their references and this process (until they are evicted or swept)
+    void Keep(const boost::filesystem::path &directory, bool keep = true);
+    bool IsKept(const boost::filesystem::path &directory) const;
+
+    // measures the size and marks the directory as recently used
+    void Touch(const boost::filesystem::path &directory);
+
+    // bytes of all tracked directories (0: unlimited, default: MITK_DOCKER_WORKDIR_QUOTA)
+    void SetQuota(std::uint64_t bytes);
+    std::uint64_t GetQuota() const;
+    std::uint64_t GetUsedBytes() const;
+    std::size_t GetNumberOfDirectories() const;
+
+    // removes the oldest unreferenced kept directories until the quota is met; returns the number removed
+    std::size_t EnforceQuota();
+
+    // age after which kept directories of exited sessions are considered orphans (default: 24 h)
+    void SetOrphanAge(std::chrono::seconds age);
+
+    /**
+     * @brief Removes the directories of sessions whose process has exited and their kept
+     * directories older than the orphan age.
+     * @return number of removed directories
+     */
+    std::size_t SweepOrphans();
+
+    boost::filesystem::path GetSessionFilePath() const;
+    boost::filesystem::path GetKeptFilePath() const;
+
+  private:
+    struct Entry
+    {
+      std::uint64_t bytes = 0;
+      std::chrono::system_clock::time_point lastUse;
+      bool referenced = true;
+      bool kept = false;
+      DockerScratchPolicy::Reservation reservation;
+    };
+
+    void Release(const boost::filesystem::path &directory);
+
+    // requires m_Mutex to be locked
+    std::size_t EnforceQuotaLocked();
+    void WriteSessionFileLocked() const;
+    std::size_t SweepKeptFile(const boost::filesystem::path &file, const std::set<boost::filesystem::path> &liveDirectories) const;
+
+    static std::uint64_t GetDirectorySize(const boost::filesystem::path &directory);
+    static void RemoveDirectory(const boost::filesystem::path &directory);
+
+    mutable std::mutex m_Mutex;
+    std::map<boost::filesystem::path, Entry> m_Entries;
+    boost::filesystem::path m_SessionDirectory;
+    std::uint64_t m_Quota = 0;
+    std::chrono::seconds m_OrphanAge{24 * 60 * 60};
+  };
+
+} // namespace mitk
@@ -0,0 +1,164 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerBatchHelper.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+std::size_t mitk::DockerBatchHelper::AddJob()
+{
+  m_JobSaveDataInfo.emplace_back();
+  return m_JobSaveDataInfo.size() - 1;
+}
+
+std::size_t mitk::DockerBatchHelper::GetNumberOfJobs() const
+{
+  return m_JobSaveDataInfo.size();
+}
+
+mitk::DockerHelper::SaveDataInfo *
+mitk::DockerBatchHelper::AddJobAutoSaveData(std::size_t job,
+                                            mitk::BaseData::Pointer data,
+                                            std::string targetArgument,
+                                            std::string name,
+                                            std::string extension)
+{
+  if (job >= m_JobSaveDataInfo.size())
+    mitkThrow() << "Job index [" << job << "] out of range";
+
+  auto res = m_JobSaveDataInfo[job].try_emplace(targetArgument, name, extension, std::vector<mitk::BaseData::Pointer>{data}, AUTOSAVE, SINGLE_FILE);
+  if (!res.second)
+    mitkThrow() << "Warning! Overriding an already inserted argument is not allowed!";
+  return &(res.first->second);
+}
+
+mitk::DockerHelper::SaveDataInfo *
+mitk::DockerBatchHelper::AddJobAutoSaveData(std::size_t job,
+                                            std::vector<mitk::BaseData::Pointer> data,
+                                            std::string targetArgument,
+                                            std::string name,
+                                            std::string extension)
+{
+  if (job >= m_JobSaveDataInfo.size())
+    mitkThrow() << "Job index [" << job << "] out of range";
+
+  auto res = m_JobSaveDataInfo[job].try_emplace(targetArgument, name, extension, data, AUTOSAVE, !SINGLE_FILE);
+  if (!res.second)
+    mitkThrow() << "Warning! Overriding an already inserted argument is not allowed!";
+  return &(res.first->second);
+}
+
+void mitk::DockerBatchHelper::SetManifestArgument(std::string argument)
+{
+  m_ManifestArgument = argument;
+}
+
+std::string mitk::DockerBatchHelper::GetJobName(std::size_t job)
+{
+  return (boost::format("job_%04d") % job).str();
+}
+
+boost::filesystem::path mitk::DockerBatchHelper::GetJobDirectory(std::size_t job) const
+{
+  return m_WorkingDirectory / GetJobName(job);
+}
+
+void mitk::DockerBatchHelper::GenerateRunData()
+{
+  if (m_JobSaveDataInfo.empty())
+    mitkThrow() << "No jobs added to the batch";
+
+  GenerateDockerArguments();
+
+  // inputs on disk of all jobs share the mounts
+  std::vector<const std::map<std::string, SaveDataInfo> *> saveDataInfos{&m_SaveDataInfo};
+  for (const auto &jobSaveDataInfo : m_JobSaveDataInfo)
+    saveDataInfos.push_back(&jobSaveDataInfo);
+  PlanInputMounts(saveDataInfos);
+
+  // shared inputs
+  GenerateSaveDataInfoAndSaveData();
+
+  json manifest;
+  manifest["jobs"] = json::array();
+  for (std::size_t i = 0; i < m_JobSaveDataInfo.size(); ++i)
+  {
+    const auto jobName = GetJobName(i);
+    const auto jobPathHost = m_WorkingDirectory / jobName;
+    const auto jobPathContainer = m_ContainerWorkingDirectory / jobName;
+    boost::filesystem::create_directories(jobPathHost);
+
+    std::vector<std::string> jobArguments;
+    SaveData(m_JobSaveDataInfo[i], jobPathHost, jobPathContainer, jobArguments);
+    PrepareOutputs(m_LoadDataInfo, jobPathHost, jobPathContainer, jobArguments);
+
+    json job;
+    job["id"] = jobName;
+    job["workdir"] = "/" + Replace(jobPathContainer.string(), '\\', '/');
+    job["args"] = jobArguments;
+    manifest["jobs"].push_back(job);
+  }
+  // the inputs of all jobs are written together
+  WriteStagedFiles();
+
+  const std::string manifestName = "batch_manifest.json";
+  boost::filesystem::ofstream manifestFile(m_WorkingDirectory / manifestName);
+  manifestFile << manifest.dump(2);
+  manifestFile.close();
+  if (!manifestFile)
+    mitkThrow() << "Could not write batch manifest to " << (m_WorkingDirectory / manifestName);
+
+  m_GeneratedFiles.insert(manifestName);
+  m_ProgramArguments.push_back(m_ManifestArgument);
+  m_ProgramArguments.push_back("/" + Replace((m_ContainerWorkingDirectory / manifestName).string(), '\\', '/'));
+}
+
+void mitk::DockerBatchHelper::LoadData()
+{
+  m_BatchOutputData.assign(m_JobSaveDataInfo.size(), {});
+  for (std::size_t i = 0; i < m_JobSaveDataInfo.size(); ++i)
+  {
+    LoadOutputs(GetJobDirectory(i), m_BatchOutputData[i]);
+    m_OutputData.insert(m_OutputData.end(), m_BatchOutputData[i].begin(), m_BatchOutputData[i].end());
+  }
+}
+
+std::vector<std::string> mitk::DockerBatchHelper::GetResultCacheOutputPaths() const
+{
+  std::vector<std::string> outputPaths = m_AutoLoadFilenamesFromWorkingDirectory;
+  for (std::size_t i = 0; i < m_JobSaveDataInfo.size(); ++i)
+    for (const auto &outputInfo : m_LoadDataInfo)
+      outputPaths.push_back(GetJobName(i) + "/" + outputInfo.path);
+  return outputPaths;
+}
+
+std::uint64_t mitk::DockerBatchHelper::EstimateStagingBytes() const
+{
+  auto bytes = DockerHelper::EstimateStagingBytes();
+  for (const auto &jobSaveDataInfo : m_JobSaveDataInfo)
+    bytes += EstimateSaveDataBytes(jobSaveDataInfo);
+  return bytes;
+}
+
+std::vector<std::vector<mitk::BaseData::Pointer>> mitk::DockerBatchHelper::GetBatchResults()
+{
+  GetResults();
+  return m_BatchOutputData;
+}
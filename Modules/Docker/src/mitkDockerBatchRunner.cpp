@@ -0,0 +1,327 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerBatchRunner.h>
+
+#include <mitkDockerHelper.h>
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <map>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+
+mitk::DockerBatchRunner::JobSpec mitk::DockerBatchRunner::ParseJobSpec(const nlohmann::json &document)
+{
+  using json = nlohmann::json;
+
+  JobSpec spec;
+  if (!document.contains("image"))
+    mitkThrow() << "Job spec: \"image\" is required";
+  spec.image = document.at("image").get<std::string>();
+  spec.arguments = document.value("arguments", std::vector<std::string>{});
+  spec.runArguments = document.value("runArguments", std::vector<std::string>{});
+  spec.gpus = document.value("gpus", false);
+  spec.timeoutSeconds = document.value("timeout", 0.0);
+  spec.stallTimeoutSeconds = document.value("stallTimeout", 0.0);
+
+  if (document.contains("limits"))
+  {
+    const auto &limits = document.at("limits");
+    spec.limits.cpus = limits.value("cpus", 0.0);
+    spec.limits.cpusetCpus = limits.value("cpusetCpus", std::string());
+    spec.limits.memoryBytes = limits.value("memoryBytes", std::uint64_t(0));
+    spec.limits.memorySwapBytes = limits.value("memorySwapBytes", std::int64_t(0));
+    spec.limits.shmSizeBytes = limits.value("shmSizeBytes", std::uint64_t(0));
+    spec.limits.pidsLimit = limits.value("pidsLimit", std::int64_t(0));
+    spec.limits.Validate();
+  }
+
+  for (const auto &entry : document.value("inputs", json::array()))
+  {
+    InputSpec input;
+    input.argument = entry.at("argument").get<std::string>();
+    input.name = entry.value("name", std::string("input"));
+    input.extension = entry.value("extension", std::string());
+    input.source = entry.value("source", input.source);
+    spec.inputs.push_back(input);
+  }
+  if (spec.inputs.empty())
+    mitkThrow() << "Job spec: at least one entry in \"inputs\" is required";
+
+  for (const auto &entry : document.value("outputs", json::array()))
+  {
+    OutputSpec output;
+    output.argument = entry.at("argument").get<std::string>();
+    output.path = entry.at("path").get<std::string>();
+    output.isDirectory = entry.value("directory", false);
+    output.isFlagOnly = entry.value("flagOnly", false);
+    output.files = entry.value("files", std::vector<std::string>{});
+    spec.outputs.push_back(output);
+  }
+  return spec;
+}
+
+std::string mitk::DockerBatchRunner::Stem(const boost::filesystem::path &path)
+{
+  auto stem = path.filename().string();
+  const auto pos = stem.find('.', 1);
+  return pos == std::string::npos ? stem : stem.substr(0, pos);
+}
+
+std::string mitk::DockerBatchRunner::Extension(const boost::filesystem::path &path)
+{
+  const auto name = path.filename().string();
+  const auto pos = name.find('.', 1);
+  return pos == std::string::npos ? std::string() : name.substr(pos);
+}
+
+std::string mitk::DockerBatchRunner::ExpandSource(std::string source, const Job &job)
+{
+  const std::map<std::string, std::string> variables = {
+    {"{input}", job.input.string()}, {"{stem}", Stem(job.input)}, {"{dir}", job.input.parent_path().string()}};
+  for (const auto &kv : variables)
+    for (auto pos = source.find(kv.first); pos != std::string::npos; pos = source.find(kv.first, pos + kv.second.size()))
+      source.replace(pos, kv.first.size(), kv.second);
+  return source;
+}
+
+std::vector<mitk::DockerBatchRunner::Job> mitk::DockerBatchRunner::CreateJobs(std::vector<boost::filesystem::path> inputs)
+{
+  std::sort(inputs.begin(), inputs.end());
+  inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+  std::vector<Job> jobs;
+  std::set<std::string> names;
+  for (const auto &input : inputs)
+  {
+    auto name = Stem(input);
+    for (int i = 1; !names.insert(name).second; ++i)
+      name = (boost::format("%1%_%2%") % Stem(input) % i).str();
+    jobs.push_back({name, boost::filesystem::absolute(input)});
+  }
+  return jobs;
+}
+
+void mitk::DockerBatchRunner::MoveOutput(const boost::filesystem::path &source, const boost::filesystem::path &target)
+{
+  boost::filesystem::create_directories(target.parent_path());
+  boost::filesystem::remove_all(target);
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(source, target, ec);
+  if (!ec)
+    return;
+
+  if (boost::filesystem::is_directory(source))
+  {
+    boost::filesystem::create_directories(target);
+    for (boost::filesystem::recursive_directory_iterator it(source), end; it != end; ++it)
+    {
+      const auto relative = boost::filesystem::relative(it->path(), source);
+      if (boost::filesystem::is_directory(it->path()))
+        boost::filesystem::create_directories(target / relative);
+      else
+        boost::filesystem::copy_file(it->path(), target / relative, boost::filesystem::copy_option::overwrite_if_exists);
+    }
+  }
+  else
+  {
+    boost::filesystem::copy_file(source, target, boost::filesystem::copy_option::overwrite_if_exists);
+  }
+}
+
+mitk::DockerBatchRunner::DockerBatchRunner(const nlohmann::json &specDocument, const boost::filesystem::path &outputDirectory)
+  : m_JobSpec(ParseJobSpec(specDocument)),
+    m_SpecDocument(specDocument),
+    m_OutputDirectory(boost::filesystem::absolute(outputDirectory)),
+    m_StatePath(m_OutputDirectory / "batch_state.json")
+{
+  if (!boost::filesystem::exists(m_StatePath))
+    return;
+
+  boost::filesystem::ifstream file(m_StatePath);
+  const auto document = nlohmann::json::parse(file, nullptr, false);
+  if (document.is_discarded())
+    MITK_WARN << "Ignoring unreadable state file " << m_StatePath;
+  else if (document.value("spec", nlohmann::json()) != m_SpecDocument)
+    MITK_WARN << "The job spec changed since the last invocation; all jobs are run again";
+  else
+    m_Jobs = document.value("jobs", nlohmann::json::object());
+}
+
+const mitk::DockerBatchRunner::JobSpec &mitk::DockerBatchRunner::GetJobSpec() const
+{
+  return m_JobSpec;
+}
+
+const boost::filesystem::path &mitk::DockerBatchRunner::GetOutputDirectory() const
+{
+  return m_OutputDirectory;
+}
+
+void mitk::DockerBatchRunner::KeepWorkingDirectories(bool value)
+{
+  m_KeepWorkingDirectories = value;
+}
+
+bool mitk::DockerBatchRunner::IsFinished(const Job &job) const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Jobs.contains(job.name))
+    return false;
+  const auto &entry = m_Jobs.at(job.name);
+  if (entry.value("status", std::string()) != "finished" || entry.value("input", std::string()) != job.input.string())
+    return false;
+  for (const auto &output : entry.value("outputs", std::vector<std::string>{}))
+    if (!boost::filesystem::exists(m_OutputDirectory / output))
+      return false;
+  return true;
+}
+
+nlohmann::json mitk::DockerBatchRunner::RunJob(const Job &job)
+{
+  const auto &spec = m_JobSpec;
+  nlohmann::json entry = {{"input", job.input.string()}, {"started", std::time(nullptr)}};
+
+  DockerHelper helper(spec.image);
+  helper.EnableAutoRemoveContainer(true);
+  helper.EnableGPUs(spec.gpus);
+  if (!spec.limits.IsEmpty())
+    helper.SetResourceLimits(spec.limits);
+  if (spec.timeoutSeconds > 0)
+    helper.SetRunTimeout(std::chrono::milliseconds(static_cast<long long>(spec.timeoutSeconds * 1000)));
+  if (spec.stallTimeoutSeconds > 0)
+    helper.SetStallTimeout(std::chrono::milliseconds(static_cast<long long>(spec.stallTimeoutSeconds * 1000)));
+  for (const auto &argument : spec.runArguments)
+    helper.AddRunArgument(argument);
+  for (const auto &argument : spec.arguments)
+    helper.AddApplicationArgument(argument);
+
+  const auto jobOutputDirectory = m_OutputDirectory / job.name;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_RunningHelpers.insert(&helper);
+  }
+  try
+  {
+    for (const auto &input : spec.inputs)
+    {
+      const boost::filesystem::path source = ExpandSource(input.source, job);
+      if (!boost::filesystem::exists(source))
+        mitkThrow() << "Input " << source << " does not exist";
+
+      // inputs with a matching extension are mounted from their location without being loaded
+      const auto extension = input.extension.empty() ? Extension(source) : input.extension;
+      helper.AddAutoSaveFile(source, input.argument, input.name, extension);
+    }
+
+    for (const auto &output : spec.outputs)
+    {
+      if (output.isDirectory)
+        helper.AddAutoLoadOutputFolder(output.argument, output.path, output.files);
+      else
+        helper.AddLoadLaterOutput(output.argument, output.path, output.isFlagOnly);
+    }
+
+    // outputs are moved, not loaded
+    helper.GetResultManifest();
+
+    std::vector<std::string> outputs;
+    for (const auto &output : spec.outputs)
+    {
+      const auto source = helper.GetWorkingDirectory() / output.path;
+      if (!boost::filesystem::exists(source))
+        mitkThrow() << "Output " << output.path << " was not written";
+      MoveOutput(source, jobOutputDirectory / output.path);
+      outputs.push_back(job.name + "/" + output.path);
+    }
+
+    entry["status"] = "finished";
+    entry["outputs"] = outputs;
+  }
+  catch (const mitk::DockerCancelledException &)
+  {
+    entry["status"] = "cancelled";
+  }
+  catch (const std::exception &e)
+  {
+    entry["status"] = helper.IsTimedOut() ? "timeout" : "failed";
+    entry["message"] = e.what();
+    MITK_ERROR << job.name << ": " << e.what();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_RunningHelpers.erase(&helper);
+  }
+
+  entry["report"] = helper.GetRunReport().ToJson();
+  entry["finished"] = std::time(nullptr);
+
+  // failed runs keep their working directory (and docker.log) for inspection, the others are
+  // deleted with the helper
+  if (m_KeepWorkingDirectories || entry["status"] == "failed" || entry["status"] == "timeout")
+  {
+    helper.KeepWorkingDirectory(true);
+    entry["workingDirectory"] = helper.GetWorkingDirectory().string();
+  }
+
+  try
+  {
+    SetJobState(job.name, entry);
+  }
+  catch (const std::exception &e)
+  {
+    MITK_ERROR << e.what();
+  }
+  return entry;
+}
+
+void mitk::DockerBatchRunner::CancelAll()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (auto *helper : m_RunningHelpers)
+    helper->Cancel();
+}
+
+nlohmann::json mitk::DockerBatchRunner::GetJobStates() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Jobs;
+}
+
+void mitk::DockerBatchRunner::SetJobState(const std::string &name, nlohmann::json entry)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Jobs[name] = std::move(entry);
+  WriteState();
+}
+
+void mitk::DockerBatchRunner::WriteState() const
+{
+  // rewritten atomically after each job
+  boost::filesystem::create_directories(m_OutputDirectory);
+  const auto temporaryPath = m_StatePath.string() + ".tmp";
+  {
+    boost::filesystem::ofstream file(temporaryPath);
+    file << nlohmann::json{{"spec", m_SpecDocument}, {"jobs", m_Jobs}}.dump(2) << "\n";
+    if (!file)
+      mitkThrow() << "Could not write state file " << temporaryPath;
+  }
+  boost::filesystem::rename(temporaryPath, m_StatePath);
+}
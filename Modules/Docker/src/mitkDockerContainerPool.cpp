@@ -0,0 +1,289 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerContainerPool.h>
+#include <mitkDockerProcess.h>
+
+#include <Poco/Process.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkIOUtil.h>
+#include <mitkLogMacros.h>
+
+mitk::DockerContainerPool &mitk::DockerContainerPool::GetInstance()
+{
+  static DockerContainerPool instance;
+  return instance;
+}
+
+mitk::DockerContainerPool::~DockerContainerPool()
+{
+  Shutdown();
+}
+
+void mitk::DockerContainerPool::SetOptions(const Options &options)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Options = options;
+}
+
+mitk::DockerContainerPool::Options mitk::DockerContainerPool::GetOptions() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Options;
+}
+
+boost::filesystem::path mitk::DockerContainerPool::GetSharedDirectory()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_SharedDirectory.empty())
+    m_SharedDirectory = boost::filesystem::path(mitk::IOUtil::CreateTemporaryDirectory("m2_pool_XXXXXX"));
+  return m_SharedDirectory;
+}
+
+std::string mitk::DockerContainerPool::GetSharedDirectoryContainerPath()
+{
+  return "m2_pool";
+}
+
+std::string mitk::DockerContainerPool::CreateKey(const std::string &image, const std::vector<std::string> &runArguments)
+{
+  std::string key = image;
+  for (const auto &a : runArguments)
+    key += " " + a;
+  return key;
+}
+
+bool mitk::DockerContainerPool::IsHealthy(const std::string &containerName)
+{
+  std::string output;
+  if (mitk::DockerProcess::Execute({"inspect", "-f", "{{.State.Running}}", containerName}, &output) != 0)
+    return false;
+  return output.find("true") != std::string::npos;
+}
+
+std::string mitk::DockerContainerPool::StartContainer(const std::string &image,
+                                                      const std::vector<std::string> &runArguments)
+{
+  const auto sharedDirectory = GetSharedDirectory();
+  std::vector<std::string> keepAliveCommand;
+  std::string name;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    keepAliveCommand = m_Options.keepAliveCommand;
+    name = "m2_pool_" + std::to_string(Poco::Process::id()) + "_" + std::to_string(m_Counter++);
+  }
+
+  if (keepAliveCommand.empty())
+    mitkThrow() << "The keep-alive command of the container pool must not be empty";
+
+  std::vector<std::string> args = {"run", "-d", "--name", name, "-v",
+                                   sharedDirectory.string() + ":/" + GetSharedDirectoryContainerPath()};
+  args.insert(args.end(), runArguments.begin(), runArguments.end());
+  args.push_back("--entrypoint");
+  args.push_back(keepAliveCommand.front());
+  args.push_back(image);
+  args.insert(args.end(), keepAliveCommand.begin() + 1, keepAliveCommand.end());
+
+  std::string output;
+  if (auto code = mitk::DockerProcess::Execute(args, &output))
+  {
+    RemoveContainer(name);
+    mitkThrow() << "Starting pool container for [" << image << "] failed with exit code [" << code << "]";
+  }
+
+  MITK_INFO << "Started pool container [" << name << "] for " << image;
+  return name;
+}
+
+void mitk::DockerContainerPool::RemoveContainer(const std::string &containerName)
+{
+  mitk::DockerProcess::Execute({"rm", "-f", containerName});
+}
+
+std::string mitk::DockerContainerPool::Acquire(const std::string &image, const std::vector<std::string> &runArguments)
+{
+  ReapIdle();
+
+  const auto key = CreateKey(image, runArguments);
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (true)
+  {
+    // reuse an idle container
+    std::string candidate;
+    for (auto &kv : m_Containers)
+    {
+      if (kv.second.key == key && !kv.second.busy)
+      {
+        kv.second.busy = true;
+        candidate = kv.first;
+        break;
+      }
+    }
+
+    if (!candidate.empty())
+    {
+      lock.unlock();
+      const bool healthy = IsHealthy(candidate);
+      lock.lock();
+
+      auto it = m_Containers.find(candidate);
+      if (healthy && it != m_Containers.end())
+      {
+        it->second.lastUsed = std::chrono::steady_clock::now();
+        return candidate;
+      }
+
+      MITK_WARN << "Pool container [" << candidate << "] is not healthy and will be removed";
+      if (it != m_Containers.end())
+        m_Containers.erase(it);
+      lock.unlock();
+      RemoveContainer(candidate);
+      lock.lock();
+      continue;
+    }
+
+    // start a new container if the limit allows it
+    unsigned int count = m_Starting[key];
+    for (const auto &kv : m_Containers)
+      if (kv.second.key == key)
+        ++count;
+
+    if (count < m_Options.maxContainersPerKey)
+    {
+      ++m_Starting[key];
+      lock.unlock();
+      std::string name;
+      try
+      {
+        name = StartContainer(image, runArguments);
+      }
+      catch (...)
+      {
+        lock.lock();
+        --m_Starting[key];
+        m_Released.notify_all();
+        throw;
+      }
+      lock.lock();
+      --m_Starting[key];
+
+      Container container;
+      container.name = name;
+      container.key = key;
+      container.busy = true;
+      container.lastUsed = std::chrono::steady_clock::now();
+      m_Containers[name] = container;
+      return name;
+    }
+
+    m_Released.wait(lock);
+  }
+}
+
+void mitk::DockerContainerPool::Release(const std::string &containerName, bool failed)
+{
+  bool remove = false;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Containers.find(containerName);
+    if (it == m_Containers.end())
+      return;
+
+    auto &container = it->second;
+    container.busy = false;
+    container.lastUsed = std::chrono::steady_clock::now();
+    ++container.jobs;
+
+    if (failed || container.jobs >= m_Options.maxJobsPerContainer)
+    {
+      m_Containers.erase(it);
+      remove = true;
+    }
+  }
+  m_Released.notify_all();
+
+  if (remove)
+  {
+    MITK_INFO << "Recycle pool container [" << containerName << "]";
+    RemoveContainer(containerName);
+  }
+
+  ReapIdle();
+}
+
+std::vector<std::string> mitk::DockerContainerPool::CollectIdleContainers()
+{
+  std::vector<std::string> expired;
+  const auto now = std::chrono::steady_clock::now();
+  for (auto it = m_Containers.begin(); it != m_Containers.end();)
+  {
+    if (!it->second.busy && now - it->second.lastUsed > m_Options.idleTimeout)
+    {
+      expired.push_back(it->first);
+      it = m_Containers.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  return expired;
+}
+
+void mitk::DockerContainerPool::ReapIdle()
+{
+  std::vector<std::string> expired;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    expired = CollectIdleContainers();
+  }
+
+  for (const auto &name : expired)
+  {
+    MITK_INFO << "Remove idle pool container [" << name << "]";
+    RemoveContainer(name);
+  }
+}
+
+void mitk::DockerContainerPool::Shutdown()
+{
+  std::vector<std::string> names;
+  boost::filesystem::path sharedDirectory;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const auto &kv : m_Containers)
+      names.push_back(kv.first);
+    m_Containers.clear();
+    sharedDirectory = m_SharedDirectory;
+    m_SharedDirectory.clear();
+  }
+  m_Released.notify_all();
+
+  for (const auto &name : names)
+    RemoveContainer(name);
+
+  if (!sharedDirectory.empty())
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(sharedDirectory, ec);
+  }
+}
+
+std::size_t mitk::DockerContainerPool::Count() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Containers.size();
+}
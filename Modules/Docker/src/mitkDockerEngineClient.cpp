@@ -0,0 +1,686 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerEngineClient.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkLogMacros.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+  // closes the socket when leaving the scope
+  struct SocketGuard
+  {
+    int fd;
+    ~SocketGuard()
+    {
+      if (fd >= 0)
+        ::close(fd);
+    }
+  };
+
+  std::string ToLower(std::string s)
+  {
+    for (auto &c : s)
+      c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+  }
+
+  // parses docker sizes like "512m" or "1073741824"; false if the value is not understood
+  bool ParseBytes(const std::string &value, std::int64_t &bytes)
+  {
+    try
+    {
+      std::size_t pos = 0;
+      const double number = std::stod(value, &pos);
+      const auto unit = ToLower(value.substr(pos));
+      double factor = 1;
+      if (unit == "k" || unit == "kb")
+        factor = 1024.0;
+      else if (unit == "m" || unit == "mb")
+        factor = 1024.0 * 1024.0;
+      else if (unit == "g" || unit == "gb")
+        factor = 1024.0 * 1024.0 * 1024.0;
+      else if (!unit.empty() && unit != "b")
+        return false;
+      bytes = static_cast<std::int64_t>(number * factor);
+      return true;
+    }
+    catch (const std::exception &)
+    {
+      return false;
+    }
+  }
+
+  /**
+   * Splits the multiplexed stream of the logs endpoint (8 byte frame header:
+   * stream type, 3 bytes padding, 4 bytes big endian payload size) into lines.
+   */
+  class LogDemultiplexer
+  {
+  public:
+    explicit LogDemultiplexer(mitk::DockerProcess::LineCallback callback) : m_Callback(callback) {}
+
+    void Add(const char *data, std::size_t size)
+    {
+      m_Buffer.append(data, size);
+      while (m_Buffer.size() >= 8)
+      {
+        const auto *header = reinterpret_cast<const unsigned char *>(m_Buffer.data());
+        const std::size_t frameSize = (std::size_t(header[4]) << 24) | (std::size_t(header[5]) << 16) |
+                                      (std::size_t(header[6]) << 8) | std::size_t(header[7]);
+        if (m_Buffer.size() < 8 + frameSize)
+          break;
+
+        auto &lineBuffer = header[0] == 2 ? m_ErrLine : m_OutLine;
+        const auto stream = header[0] == 2 ? mitk::DockerProcess::Stream::StdErr : mitk::DockerProcess::Stream::StdOut;
+        lineBuffer.append(m_Buffer, 8, frameSize);
+        m_Buffer.erase(0, 8 + frameSize);
+        EmitLines(lineBuffer, stream);
+      }
+    }
+
+    void Flush()
+    {
+      if (!m_OutLine.empty() && m_Callback)
+        m_Callback(mitk::DockerProcess::Stream::StdOut, m_OutLine);
+      if (!m_ErrLine.empty() && m_Callback)
+        m_Callback(mitk::DockerProcess::Stream::StdErr, m_ErrLine);
+      m_OutLine.clear();
+      m_ErrLine.clear();
+    }
+
+  private:
+    void EmitLines(std::string &lineBuffer, mitk::DockerProcess::Stream stream)
+    {
+      std::string::size_type pos;
+      while ((pos = lineBuffer.find_first_of("\r\n")) != std::string::npos)
+      {
+        const auto line = lineBuffer.substr(0, pos);
+        lineBuffer.erase(0, pos + 1);
+        if (!line.empty() && m_Callback)
+          m_Callback(stream, line);
+      }
+    }
+
+    mitk::DockerProcess::LineCallback m_Callback;
+    std::string m_Buffer;
+    std::string m_OutLine;
+    std::string m_ErrLine;
+  };
+} // namespace
+
+mitk::DockerEngineClient::DockerEngineClient(const std::string &socketPath) : m_SocketPath(socketPath)
+{
+}
+
+std::string mitk::DockerEngineClient::GetDefaultSocketPath()
+{
+  const char *dockerHost = std::getenv("DOCKER_HOST");
+  if (dockerHost)
+  {
+    const std::string host = dockerHost;
+    const std::string scheme = "unix://";
+    if (host.compare(0, scheme.size(), scheme) == 0)
+      return host.substr(scheme.size());
+  }
+  return "/var/run/docker.sock";
+}
+
+std::string mitk::DockerEngineClient::GetSocketPath() const
+{
+  return m_SocketPath;
+}
+
+bool mitk::DockerEngineClient::IsAvailable() const
+{
+  struct stat info;
+  if (::stat(m_SocketPath.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode))
+    return false;
+
+  try
+  {
+    return Ping();
+  }
+  catch (const std::exception &)
+  {
+    return false;
+  }
+}
+
+mitk::DockerEngineClient::Response mitk::DockerEngineClient::Request(const std::string &method,
+                                                                     const std::string &path,
+                                                                     const std::string &body,
+                                                                     DataCallback callback) const
+{
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (m_SocketPath.size() >= sizeof(address.sun_path))
+    mitkThrow() << "Docker socket path too long: " << m_SocketPath;
+  std::strncpy(address.sun_path, m_SocketPath.c_str(), sizeof(address.sun_path) - 1);
+
+  SocketGuard socketGuard{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (socketGuard.fd < 0 || ::connect(socketGuard.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    mitkThrow() << "Could not connect to docker socket " << m_SocketPath << ": " << std::strerror(errno);
+
+  std::ostringstream request;
+  request << method << " " << path << " HTTP/1.1\r\n"
+          << "Host: docker\r\n"
+          << "User-Agent: MitkDocker\r\n"
+          << "Connection: close\r\n";
+  if (!body.empty())
+    request << "Content-Type: application/json\r\n";
+  request << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+
+  const auto requestString = request.str();
+  std::size_t sent = 0;
+  while (sent < requestString.size())
+  {
+    const auto n = ::send(socketGuard.fd, requestString.data() + sent, requestString.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      mitkThrow() << "Could not send request to docker socket " << m_SocketPath;
+    sent += static_cast<std::size_t>(n);
+  }
+
+  Response response;
+  std::string buffer;
+  bool headerComplete = false;
+  bool chunked = false;
+  bool finished = false;
+  long long contentLength = -1;
+  long long received = 0;
+
+  auto emit = [&](const char *data, std::size_t size) {
+    if (size == 0)
+      return;
+    if (callback)
+      callback(data, size);
+    else
+      response.body.append(data, size);
+    received += static_cast<long long>(size);
+  };
+
+  char chunk[8192];
+  while (!finished)
+  {
+    const auto n = ::recv(socketGuard.fd, chunk, sizeof(chunk), 0);
+    if (n < 0)
+      mitkThrow() << "Could not read from docker socket " << m_SocketPath;
+    if (n == 0)
+      break;
+    buffer.append(chunk, static_cast<std::size_t>(n));
+
+    if (!headerComplete)
+    {
+      const auto headerEnd = buffer.find("\r\n\r\n");
+      if (headerEnd == std::string::npos)
+        continue;
+
+      std::istringstream header(buffer.substr(0, headerEnd));
+      std::string statusLine;
+      std::getline(header, statusLine);
+      std::istringstream statusStream(statusLine);
+      std::string httpVersion;
+      statusStream >> httpVersion >> response.status;
+
+      std::string line;
+      while (std::getline(header, line))
+      {
+        const auto colon = line.find(':');
+        if (colon == std::string::npos)
+          continue;
+        const auto key = ToLower(line.substr(0, colon));
+        auto value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        if (key == "transfer-encoding" && ToLower(value) == "chunked")
+          chunked = true;
+        else if (key == "content-length")
+          contentLength = std::stoll(value);
+      }
+
+      buffer.erase(0, headerEnd + 4);
+      headerComplete = true;
+    }
+
+    if (chunked)
+    {
+      while (true)
+      {
+        const auto lineEnd = buffer.find("\r\n");
+        if (lineEnd == std::string::npos)
+          break;
+        const auto size = std::stoul(buffer.substr(0, lineEnd), nullptr, 16);
+        if (size == 0)
+        {
+          finished = true;
+          break;
+        }
+        if (buffer.size() < lineEnd + 2 + size + 2)
+          break;
+        emit(buffer.data() + lineEnd + 2, size);
+        buffer.erase(0, lineEnd + 2 + size + 2);
+      }
+    }
+    else
+    {
+      emit(buffer.data(), buffer.size());
+      buffer.clear();
+      if (contentLength >= 0 && received >= contentLength)
+        finished = true;
+    }
+  }
+
+  if (!headerComplete)
+    mitkThrow() << "Incomplete response from docker socket " << m_SocketPath;
+
+  return response;
+}
+
+void mitk::DockerEngineClient::ThrowOnError(const Response &response, const std::string &what)
+{
+  if (response.status < 400)
+    return;
+
+  std::string message = response.body;
+  try
+  {
+    auto doc = json::parse(response.body);
+    if (doc.is_object() && doc.contains("message"))
+      message = doc["message"].get<std::string>();
+  }
+  catch (const json::exception &)
+  {
+  }
+  mitkThrow() << what << " failed with HTTP status [" << response.status << "]: " << message;
+}
+
+std::string mitk::DockerEngineClient::EncodeUrl(const std::string &value)
+{
+  static const char *hex = "0123456789ABCDEF";
+  std::string result;
+  for (unsigned char c : value)
+  {
+    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+    {
+      result += static_cast<char>(c);
+    }
+    else
+    {
+      result += '%';
+      result += hex[c >> 4];
+      result += hex[c & 15];
+    }
+  }
+  return result;
+}
+
+void mitk::DockerEngineClient::SplitImageName(const std::string &image, std::string &name, std::string &tag)
+{
+  // a digest reference ("name@sha256:...", optionally "name:tag@sha256:...") is pulled by its digest
+  const auto at = image.find('@');
+  const auto reference = image.substr(0, at);
+
+  // a colon after the last slash separates the tag (the registry may contain a port)
+  const auto slash = reference.rfind('/');
+  const auto colon = reference.rfind(':');
+  if (colon != std::string::npos && (slash == std::string::npos || colon > slash))
+  {
+    name = reference.substr(0, colon);
+    tag = reference.substr(colon + 1);
+  }
+  else
+  {
+    name = reference;
+    tag = "latest";
+  }
+
+  if (at != std::string::npos)
+    tag = image.substr(at + 1);
+}
+
+bool mitk::DockerEngineClient::Ping() const
+{
+  auto response = Request("GET", "/_ping");
+  return response.status == 200;
+}
+
+std::vector<std::string> mitk::DockerEngineClient::ListImages() const
+{
+  auto response = Request("GET", "/images/json");
+  ThrowOnError(response, "List images");
+
+  std::vector<std::string> images;
+  for (const auto &image : json::parse(response.body))
+  {
+    if (!image.contains("RepoTags") || !image["RepoTags"].is_array())
+      continue;
+    for (const auto &tag : image["RepoTags"])
+    {
+      if (tag.is_string() && tag.get<std::string>() != "<none>:<none>")
+        images.push_back(tag.get<std::string>());
+    }
+  }
+  return images;
+}
+
+bool mitk::DockerEngineClient::HasImage(const std::string &image) const
+{
+  auto response = Request("GET", "/images/" + EncodeUrl(image) + "/json");
+  return response.status == 200;
+}
+
+std::string mitk::DockerEngineClient::GetImageId(const std::string &image) const
+{
+  auto response = Request("GET", "/images/" + EncodeUrl(image) + "/json");
+  ThrowOnError(response, "Inspect image " + image);
+  return json::parse(response.body).at("Id").get<std::string>();
+}
+
+void mitk::DockerEngineClient::PullImage(const std::string &image) const
+{
+  std::string name, tag;
+  SplitImageName(image, name, tag);
+
+  MITK_INFO << "Pull image " << image;
+  auto response = Request("POST", "/images/create?fromImage=" + EncodeUrl(name) + "&tag=" + EncodeUrl(tag));
+  ThrowOnError(response, "Pull " + image);
+
+  // errors during the pull are reported within the progress stream
+  std::istringstream progress(response.body);
+  std::string line;
+  while (std::getline(progress, line))
+  {
+    try
+    {
+      auto message = json::parse(line);
+      if (message.is_object() && message.contains("error"))
+        mitkThrow() << "Pull " << image << " failed: " << message["error"].get<std::string>();
+    }
+    catch (const json::exception &)
+    {
+    }
+  }
+}
+
+void mitk::DockerEngineClient::RemoveImage(const std::string &image, bool force) const
+{
+  auto response = Request("DELETE", "/images/" + EncodeUrl(image) + (force ? "?force=1" : ""));
+  ThrowOnError(response, "Remove image " + image);
+}
+
+std::string mitk::DockerEngineClient::CreateContainer(const std::string &name, const json &config) const
+{
+  std::string path = "/containers/create";
+  if (!name.empty())
+    path += "?name=" + EncodeUrl(name);
+
+  auto response = Request("POST", path, config.dump());
+  ThrowOnError(response, "Create container");
+  return json::parse(response.body).at("Id").get<std::string>();
+}
+
+void mitk::DockerEngineClient::StartContainer(const std::string &id) const
+{
+  auto response = Request("POST", "/containers/" + EncodeUrl(id) + "/start");
+  ThrowOnError(response, "Start container " + id);
+}
+
+int mitk::DockerEngineClient::WaitContainer(const std::string &id) const
+{
+  auto response = Request("POST", "/containers/" + EncodeUrl(id) + "/wait");
+  ThrowOnError(response, "Wait for container " + id);
+  return json::parse(response.body).at("StatusCode").get<int>();
+}
+
+void mitk::DockerEngineClient::FollowLogs(const std::string &id, DockerProcess::LineCallback callback) const
+{
+  LogDemultiplexer demultiplexer(callback);
+  auto response = Request("GET",
+                          "/containers/" + EncodeUrl(id) + "/logs?follow=1&stdout=1&stderr=1",
+                          "",
+                          [&demultiplexer](const char *data, std::size_t size) { demultiplexer.Add(data, size); });
+  demultiplexer.Flush();
+  ThrowOnError(response, "Logs of container " + id);
+}
+
+std::string mitk::DockerEngineClient::GetLogs(const std::string &id) const
+{
+  std::string logs;
+  LogDemultiplexer demultiplexer([&logs](DockerProcess::Stream, const std::string &line) { logs += line + "\n"; });
+  auto response = Request("GET",
+                          "/containers/" + EncodeUrl(id) + "/logs?stdout=1&stderr=1",
+                          "",
+                          [&demultiplexer](const char *data, std::size_t size) { demultiplexer.Add(data, size); });
+  demultiplexer.Flush();
+  ThrowOnError(response, "Logs of container " + id);
+  return logs;
+}
+
+json mitk::DockerEngineClient::InspectContainer(const std::string &id) const
+{
+  auto response = Request("GET", "/containers/" + EncodeUrl(id) + "/json");
+  ThrowOnError(response, "Inspect container " + id);
+  return json::parse(response.body);
+}
+
+json mitk::DockerEngineClient::GetContainerStats(const std::string &id) const
+{
+  auto response = Request("GET", "/containers/" + EncodeUrl(id) + "/stats?stream=false&one-shot=true");
+  ThrowOnError(response, "Stats of container " + id);
+  return json::parse(response.body);
+}
+
+void mitk::DockerEngineClient::KillContainer(const std::string &id) const
+{
+  auto response = Request("POST", "/containers/" + EncodeUrl(id) + "/kill");
+  ThrowOnError(response, "Kill container " + id);
+}
+
+void mitk::DockerEngineClient::StopContainer(const std::string &id, int timeoutSeconds) const
+{
+  auto response = Request("POST", "/containers/" + EncodeUrl(id) + "/stop?t=" + std::to_string(timeoutSeconds));
+  ThrowOnError(response, "Stop container " + id);
+}
+
+void mitk::DockerEngineClient::RemoveContainer(const std::string &id, bool force) const
+{
+  auto response = Request("DELETE", "/containers/" + EncodeUrl(id) + (force ? "?force=1" : ""));
+  ThrowOnError(response, "Remove container " + id);
+}
+
+bool mitk::DockerEngineClient::TranslateRunArguments(const std::vector<std::string> &runArguments,
+                                                     const std::string &image,
+                                                     const std::vector<std::string> &command,
+                                                     json &config,
+                                                     std::string &name)
+{
+  config = json::object();
+  config["Image"] = image;
+  config["Cmd"] = command;
+  config["Tty"] = false;
+  config["AttachStdout"] = true;
+  config["AttachStderr"] = true;
+  json hostConfig = json::object();
+
+  for (std::size_t i = 0; i < runArguments.size(); ++i)
+  {
+    std::string option = runArguments[i];
+    std::string value;
+    bool hasValue = false;
+
+    // --option=value
+    const auto equals = option.find('=');
+    if (option.compare(0, 2, "--") == 0 && equals != std::string::npos)
+    {
+      value = option.substr(equals + 1);
+      option = option.substr(0, equals);
+      hasValue = true;
+    }
+
+    auto nextValue = [&]() -> bool {
+      if (hasValue)
+        return true;
+      if (i + 1 >= runArguments.size())
+        return false;
+      value = runArguments[++i];
+      return true;
+    };
+
+    if (option == "--rm")
+    {
+      hostConfig["AutoRemove"] = true;
+    }
+    else if (option == "-v" || option == "--volume")
+    {
+      if (!nextValue())
+        return false;
+      hostConfig["Binds"].push_back(value);
+    }
+    else if (option == "--name")
+    {
+      if (!nextValue())
+        return false;
+      name = value;
+    }
+    else if (option == "--ipc")
+    {
+      if (!nextValue())
+        return false;
+      hostConfig["IpcMode"] = value;
+    }
+    else if (option == "-e" || option == "--env")
+    {
+      if (!nextValue())
+        return false;
+      config["Env"].push_back(value);
+    }
+    else if (option == "--entrypoint")
+    {
+      if (!nextValue())
+        return false;
+      config["Entrypoint"] = json::array({value});
+    }
+    else if (option == "-w" || option == "--workdir")
+    {
+      if (!nextValue())
+        return false;
+      config["WorkingDir"] = value;
+    }
+    else if (option == "--cpus")
+    {
+      if (!nextValue())
+        return false;
+      try
+      {
+        hostConfig["NanoCpus"] = static_cast<std::int64_t>(std::stod(value) * 1e9);
+      }
+      catch (const std::exception &)
+      {
+        return false;
+      }
+    }
+    else if (option == "--cpuset-cpus")
+    {
+      if (!nextValue())
+        return false;
+      hostConfig["CpusetCpus"] = value;
+    }
+    else if (option == "--memory" || option == "-m" || option == "--memory-swap" || option == "--shm-size")
+    {
+      std::int64_t bytes = 0;
+      if (!nextValue() || !ParseBytes(value, bytes))
+        return false;
+      const auto key = option == "--memory-swap" ? "MemorySwap" : option == "--shm-size" ? "ShmSize" : "Memory";
+      hostConfig[key] = bytes;
+    }
+    else if (option == "--pids-limit")
+    {
+      if (!nextValue())
+        return false;
+      try
+      {
+        hostConfig["PidsLimit"] = std::stoll(value);
+      }
+      catch (const std::exception &)
+      {
+        return false;
+      }
+    }
+    else if (option == "--tmpfs")
+    {
+      if (!nextValue())
+        return false;
+      const auto colon = value.find(':');
+      hostConfig["Tmpfs"][value.substr(0, colon)] = colon == std::string::npos ? "" : value.substr(colon + 1);
+    }
+    else if (option == "--gpus")
+    {
+      if (!nextValue())
+        return false;
+      if (!value.empty() && value.front() == '"' && value.back() == '"')
+        value = value.substr(1, value.size() - 2);
+
+      json request;
+      request["Driver"] = "";
+      request["Capabilities"] = json::array({json::array({"gpu"})});
+      const std::string devicePrefix = "device=";
+      if (value == "all" || value == "device=all")
+      {
+        request["Count"] = -1;
+      }
+      else if (value.compare(0, devicePrefix.size(), devicePrefix) == 0)
+      {
+        json ids = json::array();
+        std::istringstream devices(value.substr(devicePrefix.size()));
+        std::string device;
+        while (std::getline(devices, device, ','))
+          ids.push_back(device);
+        request["DeviceIDs"] = ids;
+      }
+      else
+      {
+        try
+        {
+          request["Count"] = std::stoi(value);
+        }
+        catch (const std::exception &)
+        {
+          return false;
+        }
+      }
+      hostConfig["DeviceRequests"].push_back(request);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  config["HostConfig"] = hostConfig;
+  return true;
+}
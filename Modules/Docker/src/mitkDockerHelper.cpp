@@ -15,26 +15,87 @@ See LICENSE.txt for details.
 
 // Additional Attributions: Lorenz Schwab
 
-#include <Poco/Pipe.h>
 #include <Poco/Process.h>
 
+#include <mitkDockerContainerPool.h>
+#include <mitkDockerEngineClient.h>
 #include <mitkDockerHelper.h>
+#include <mitkDockerJobSpec.h>
+#include <mitkDockerMountPlanner.h>
+#include <mitkDockerProcess.h>
+#include <mitkDockerResultCache.h>
+#include <mitkDockerStagingCache.h>
+#include <mitkDockerWorker.h>
 #include <mitkHelperUtils.h>
 #include <mitkIOUtil.h>
+#include <mitkImage.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <sstream>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/format.hpp>
 
 
+mitk::DockerHelper::~DockerHelper()
+{
+  if (m_AsyncThread.joinable())
+  {
+    if (m_AsyncRunning)
+      Cancel();
+    m_AsyncThread.join();
+  }
+  StopWatchdog();
+}
+
+mitk::DockerHelper::DockerHelper(const DockerJobSpec &spec) : m_ImageName(spec.image)
+{
+  SetJobSpec(spec);
+}
+
+void mitk::DockerHelper::SetJobSpec(const DockerJobSpec &spec)
+{
+  m_ImageName = spec.image;
+  m_AdditionalRunArguments = spec.runArguments;
+  m_AdditionalApplicationArguments = spec.applicationArguments;
+  m_UseGPUs = spec.gpus;
+  m_AutoRemoveContainer = spec.autoRemoveContainer;
+  m_AutoRemoveImage = spec.autoRemoveImage;
+  SetResourceLimits(spec.resourceLimits);
+  m_SaveDataInfo = spec.inputs;
+  m_LoadDataInfo = spec.outputs;
+  m_AutoLoadFilenamesFromWorkingDirectory = spec.workingDirectoryOutputs;
+  m_StagingWriterOptions = spec.staging;
+}
+
+mitk::DockerJobSpec mitk::DockerHelper::GetJobSpec() const
+{
+  DockerJobSpec spec;
+  spec.image = m_ImageName;
+  spec.runArguments = m_AdditionalRunArguments;
+  spec.applicationArguments = m_AdditionalApplicationArguments;
+  spec.gpus = m_UseGPUs;
+  spec.autoRemoveContainer = m_AutoRemoveContainer;
+  spec.autoRemoveImage = m_AutoRemoveImage;
+  spec.resourceLimits = m_ResourceLimits;
+  spec.inputs = m_SaveDataInfo;
+  spec.outputs = m_LoadDataInfo;
+  spec.workingDirectoryOutputs = m_AutoLoadFilenamesFromWorkingDirectory;
+  spec.staging = m_StagingWriterOptions;
+  return spec;
+}
+
 bool mitk::DockerHelper::CanRunDocker()
 {
-  std::string command = "docker ps";
+  if (!mitk::DockerProcess::HasCustomExecutable() && mitk::DockerEngineClient().IsAvailable())
+    return true;
 
-  Poco::Process p;
-  Poco::Pipe pipe;
-  auto handle = p.launch("docker", {"ps"}, 0, &pipe, 0);
-  auto code = handle.wait();
+  std::string output;
+  auto code = mitk::DockerProcess::Execute({"ps"}, &output);
 
   if (code == 0)
     return true;
@@ -47,6 +108,7 @@ bool mitk::DockerHelper::CanRunDocker()
 
 std::string mitk::DockerHelper::GetFilePath(std::string path)
 {
+  CreateWorkingDirectory();
   return (m_WorkingDirectory / path).string();
 }
 
@@ -84,6 +146,25 @@ mitk::DockerHelper::AddAutoSaveData(mitk::BaseData::Pointer data,
   }
 }
 
+mitk::DockerHelper::SaveDataInfo *
+mitk::DockerHelper::AddAutoSaveFile(const boost::filesystem::path &file,
+                                    std::string targetArgument,
+                                    std::string name,
+                                    std::string extension)
+{
+  // staging only reads the location of a linked file, an empty image carries it
+  mitk::BaseData::Pointer data = mitk::Image::New().GetPointer();
+  data->GetPropertyList()->SetStringProperty("MITK.IO.reader.inputlocation", file.string().c_str());
+  if (GetLinkableFile(data, extension).empty())
+  {
+    const auto loaded = mitk::IOUtil::Load(file.string());
+    if (loaded.empty())
+      mitkThrow() << "Could not read " << file;
+    data = loaded.front();
+  }
+  return AddAutoSaveData(data, targetArgument, name, extension);
+}
+
 mitk::DockerHelper::SaveDataInfo *
 mitk::DockerHelper::AddAutoSaveData(std::vector<mitk::BaseData::Pointer> data,
                                     std::string targetArgument,
@@ -160,391 +241,2076 @@ void mitk::DockerHelper::EnableGPUs(bool value)
   m_UseGPUs = value;
 }
 
-void mitk::DockerHelper::EnableAutoRemoveImage(bool value)
+void mitk::DockerHelper::SetBackend(Backend backend)
 {
-  m_AutoRemoveImage = value;
+  m_Backend = backend;
 }
 
-void mitk::DockerHelper::EnableAutoRemoveContainer(bool value)
+mitk::DockerHelper::Backend mitk::DockerHelper::GetBackend() const
 {
-  m_AutoRemoveContainer = value;
+  return m_Backend;
 }
 
-void mitk::DockerHelper::ExecuteDockerCommand(
-    std::string command, const std::vector<std::string> &args)
+bool mitk::DockerHelper::UseEngineApi() const
 {
-  Poco::Process::Args processArgs;
-  processArgs.push_back(command);
-  std::stringstream ss;
-  ss << "docker run";
-  for (auto a : args)
+  switch (m_Backend)
   {
-     ss << " " << a;
-    processArgs.push_back(a);
+    case Backend::Cli:
+      return false;
+    case Backend::EngineApi:
+      return true;
+    default:
+      // a custom docker executable (e.g. a test double) replaces the daemon as well
+      return !mitk::DockerProcess::HasCustomExecutable() && mitk::DockerEngineClient().IsAvailable();
   }
-  MITK_INFO << ss.str();
+}
 
-  // launch the process
-  Poco::Process p;
-  int code;
-  auto handle = p.launch("docker", processArgs);
-  code = handle.wait();
+void mitk::DockerHelper::EnableAutoRemoveImage(bool value)
+{
+  m_AutoRemoveImage = value;
+}
 
-  if (code)
-  {
-    mitkThrow() << "docker " << command << " failed with exit code [" << code
-                << "]";
-  }
+void mitk::DockerHelper::EnableAutoRemoveContainer(bool value)
+{
+  m_AutoRemoveContainer = value;
 }
 
-void mitk::DockerHelper::Run(const std::vector<std::string> &cmdArgs,
-                             const std::vector<std::string> &entryPointArgs)
+void mitk::DockerHelper::EnableContainerPool(bool value, const std::vector<std::string> &entryPoint)
 {
+  m_ExecEntryPoint = entryPoint;
+  m_UseContainerPool = value;
+  UseSharedWorkingDirectory(m_UseContainerPool || m_UsePersistentWorker);
+}
 
-  std::vector<std::string> args;
-  args.insert(args.end(), cmdArgs.begin(), cmdArgs.end());
+void mitk::DockerHelper::EnablePersistentWorker(bool value, const std::vector<std::string> &workerArguments)
+{
+  m_WorkerArguments = workerArguments;
+  m_UsePersistentWorker = value;
+  UseSharedWorkingDirectory(m_UseContainerPool || m_UsePersistentWorker);
+}
 
-  if (m_AutoRemoveContainer &&
-      std::find(args.begin(), args.end(), "--rm") == args.end())
-    args.push_back("--rm");
+void mitk::DockerHelper::SetResourceRequirements(double cpus, std::uint64_t memoryBytes)
+{
+  if (cpus <= 0)
+    mitkThrow() << "The number of CPUs has to be positive";
 
-  if (m_UseGPUs &&
-      std::find(args.begin(), args.end(), "--gpus") == args.end())
-  {
-    args.push_back("--gpus");
-    args.push_back("device=all");
-  }
+  m_ResourceRequirements.cpus = cpus;
+  m_ResourceRequirements.memoryBytes = memoryBytes;
+  m_ResourceRequirementsSet = true;
+}
 
-  args.push_back(m_ImageName);
-  args.insert(args.end(), entryPointArgs.begin(), entryPointArgs.end());
+mitk::DockerJobScheduler::Requirements mitk::DockerHelper::GetResourceRequirements() const
+{
+  if (m_ResourceRequirementsSet)
+    return m_ResourceRequirements;
+
+  // a limited container can not use more than its limits
+  mitk::DockerJobScheduler::Requirements requirements;
+  const auto cpus = m_ResourceLimits.GetEffectiveCpus();
+  if (cpus > 0)
+    requirements.cpus = cpus;
+  requirements.memoryBytes = m_ResourceLimits.memoryBytes;
+  return requirements;
+}
 
-  ExecuteDockerCommand("run", args);
+void mitk::DockerHelper::SetResourceLimits(const DockerResourceLimits &limits)
+{
+  limits.Validate();
+  m_ResourceLimits = limits;
 }
 
-void mitk::DockerHelper::RemoveImage(std::vector<std::string> args)
+const mitk::DockerResourceLimits &mitk::DockerHelper::GetResourceLimits() const
 {
-  if (std::find(args.begin(), args.end(), "-f") == args.end())
-    args.insert(args.begin(), "-f");
-  ExecuteDockerCommand("rmi", args);
+  return m_ResourceLimits;
 }
 
-void mitk::DockerHelper::GenerateRunData()
+boost::filesystem::path mitk::DockerHelper::GetJobMetadataPath() const
 {
-  using namespace itksys;
-  using namespace std;
-  
-  // working directory name of the host system is used as mounting point name in
-  // the container this folder is used as persistent communication bridge
-  // between container and host and vice versa.
-  const auto dirPathContainer = m_WorkingDirectory.filename();
-  // add this as not "read only" mapping
-  m_DockerArguments.push_back("-v");
-  m_DockerArguments.push_back(m_WorkingDirectory.string() + ":/" + Replace(dirPathContainer.string(),'\\','/'));
+  return m_WorkingDirectory / "job.json";
+}
 
-  // add custom run arguments
-  m_DockerArguments.insert(end(m_DockerArguments), begin(m_AdditionalRunArguments),
-                   end(m_AdditionalRunArguments));
+nlohmann::json mitk::DockerHelper::GetJobMetadata() const
+{
+  const auto requirements = GetResourceRequirements();
+  nlohmann::json metadata;
+  metadata["image"] = m_ImageName;
+  metadata["containerName"] = GetContainerName();
+  metadata["runArguments"] = m_DockerArguments;
+  metadata["programArguments"] = m_ProgramArguments;
+  metadata["resourceLimits"] = m_ResourceLimits.ToJson();
+  metadata["resourceRequirements"] = {{"cpus", requirements.cpus}, {"memoryBytes", requirements.memoryBytes}};
+  return metadata;
+}
 
-  m_ProgramArguments.insert(end(m_ProgramArguments),
-                        begin(m_AdditionalApplicationArguments),
-                        end(m_AdditionalApplicationArguments));
+void mitk::DockerHelper::WriteJobMetadata()
+{
+  boost::filesystem::ofstream file(GetJobMetadataPath());
+  file << GetJobMetadata().dump(2) << "\n";
+}
 
-  GenerateSaveDataInfoAndSaveData();
-  GenerateLoadDataInfo();
+void mitk::DockerHelper::EnableJobScheduler(bool value)
+{
+  m_UseJobScheduler = value;
+}
 
-  
+void mitk::DockerHelper::EnableResultCache(bool value)
+{
+  m_UseResultCache = value;
 }
 
-std::string mitk::DockerHelper::AddOrReuseVolumeMapping(const std::string& sourcePathHost, bool readOnly)
+bool mitk::DockerHelper::IsResultCacheHit() const
 {
-  // Check if this source path is already mapped
-  auto it = m_MappedVolumes.find(sourcePathHost);
-  if (it != m_MappedVolumes.end())
-  {
-    // Reuse existing mapping
-    return it->second;
-  }
-  
-  // Create new mapping
-  const auto phantomDirPathHost = boost::filesystem::path(mitk::HelperUtils::TempDirPath());
-  const auto containerPath = phantomDirPathHost.filename().string();
-  boost::filesystem::remove(phantomDirPathHost);
-  
-  // Add to docker arguments
-  m_DockerArguments.push_back("-v");
-  std::string volumeArg = sourcePathHost + ":/" + Replace(containerPath, '\\', '/');
-  if (readOnly)
-    volumeArg += ":ro";
-  m_DockerArguments.push_back(volumeArg);
-  
-  // Store mapping
-  m_MappedVolumes[sourcePathHost] = containerPath;
-  
-  return containerPath;
+  return m_ResultCacheHit;
 }
 
-void mitk::DockerHelper::GenerateSaveDataInfoAndSaveData(){
-  using namespace itksys;
-  using namespace std;
-  const auto dirPathContainer = m_WorkingDirectory.filename();
-  // Add input data
-  for (auto &kv : m_SaveDataInfo)
-  {
-    std::string targetArgument = kv.first;
-    SaveDataInfo &dataInfo = kv.second;
-    const auto dataVector = dataInfo.data;
+std::vector<std::string> mitk::DockerHelper::GetResultCacheOutputPaths() const
+{
+  std::vector<std::string> outputPaths = m_AutoLoadFilenamesFromWorkingDirectory;
+  for (const auto &outputInfo : m_LoadDataInfo)
+    outputPaths.push_back(outputInfo.path);
+  return outputPaths;
+}
 
-    // save multiple objects to a folder given by dataInfo.nameWithExtension
-    if (!dataInfo.isSingleFile)
+std::string mitk::DockerHelper::ResolveImageId() const
+{
+  if (UseEngineApi())
+  {
+    try
     {
-      // create data folder
-      const auto splitPos = dataInfo.name.find("/");
-      const auto folderName = dataInfo.name.substr(0, splitPos);
-      const auto dirPathHost = m_WorkingDirectory / folderName;
-      boost::filesystem::create_directory(dirPathHost);
-      
-      int i = 0;
-      for(auto data: dataVector){
-        std::string filePath = "";
-        data->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation",
-                                                   filePath);
-        const bool hasSameExtension =
-            dataInfo.extension == SystemTools::GetFilenameExtension(filePath);
-
-        if (filePath.empty() || !hasSameExtension)
-        { // file not on disk or different extension
-          const auto fileRelativeFilePath = boost::filesystem::path((boost::format(dataInfo.name) % i).str() + dataInfo.extension);
-          const auto filePathHost = m_WorkingDirectory / fileRelativeFilePath;
-          mitk::IOUtil::Save(data, filePathHost.string());
-        }
-        else
-        {
-          auto fp = boost::filesystem::canonical(boost::filesystem::path(filePath));
-          MITK_INFO << fp;
-          // find the files location (parent dir) on the host system
-          auto parentDirPathHost = fp;
-          parentDirPathHost.remove_filename();  
-
-          // mount this parent dir as read only into the container (reuse if already mapped)
-          const auto phantomDirPathContainer = AddOrReuseVolumeMapping(parentDirPathHost.string(), true);
-
-          auto originalFileName = fp.filename();
-          auto baseName = originalFileName.stem();
-          auto originalExtension = originalFileName.extension();
-          
-          // Create symlink in working directory folder with target filename
-          const auto fileRelativeFilePath = boost::filesystem::path((boost::format(dataInfo.name) % i).str() + dataInfo.extension);
-          const auto symlinkPathHost = m_WorkingDirectory / fileRelativeFilePath;
-          
-          // If extension changed, we need to copy/save the file
-          if (originalExtension.string() != dataInfo.extension)
-          {
-            mitk::IOUtil::Save(data, symlinkPathHost.string());
-          }
-          else
-          {
-            // Create symlink to original file in mounted volume
-            // The symlink target should be the path within the container's mounted volume
-            const auto fileInContainerPath = boost::filesystem::path("/") / phantomDirPathContainer / originalFileName;
-            
-            // Create relative symlink from working directory to mounted volume
-            auto relativeTarget = boost::filesystem::relative(fileInContainerPath, symlinkPathHost.parent_path());
-            boost::filesystem::create_symlink(relativeTarget, symlinkPathHost);
-            
-            // For imzML files, also symlink companion .ibd file
-            if (dataInfo.extension == ".imzML")
-            {
-              auto ibdFileName = baseName.string() + ".ibd";
-              auto ibdFilePath = parentDirPathHost / ibdFileName;
-              if (boost::filesystem::exists(ibdFilePath))
-              {
-                auto ibdSymlinkPath = symlinkPathHost;
-                ibdSymlinkPath.replace_extension(".ibd");
-                
-                const auto ibdFileInContainerPath = boost::filesystem::path("/") / phantomDirPathContainer / ibdFileName;
-                auto ibdRelativeTarget = boost::filesystem::relative(ibdFileInContainerPath, ibdSymlinkPath.parent_path());
-                boost::filesystem::create_symlink(ibdRelativeTarget, ibdSymlinkPath);
-              }
-            }
-          }
-        }
-        ++i;
-      }
-
-      // the target folder is passed as command line argument instead of a file name
-      // this has to be handled of the target script
-      m_ProgramArguments.push_back(targetArgument);
-      m_ProgramArguments.push_back("/" + Replace((dirPathContainer / folderName).string(),'\\', '/'));
-
-
+      return mitk::DockerEngineClient().GetImageId(m_ImageName);
     }
-    // save/link a single data object
-    else 
+    catch (const mitk::Exception &)
     {
-      auto data = dataVector.front();
-
-      std::string filePath = "";
-      data->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation",
-                                                 filePath);
-      const bool hasSameExtension =
-          dataInfo.extension == SystemTools::GetFilenameExtension(filePath);
+      return "";
+    }
+  }
 
-      auto filePathHost = m_WorkingDirectory / (dataInfo.name + dataInfo.extension);
-      dataInfo.manualSavePath = filePathHost;
+  std::string output;
+  if (mitk::DockerProcess::Execute({"image", "inspect", "--format", "{{.Id}}", m_ImageName}, &output) != 0)
+    return "";
+  output.erase(output.find_last_not_of(" \r\n") + 1);
+  return output;
+}
 
-      if (filePath.empty() || !hasSameExtension)
-      { // file not on disk or different extension
-        // MITK_INFO << filePathHost.string() << " " << data;
-        mitk::IOUtil::Save(data, filePathHost.string());
-        const auto filePathContainer = dirPathContainer / (dataInfo.name + dataInfo.extension);
-        m_ProgramArguments.push_back(targetArgument);
-        m_ProgramArguments.push_back("/" + Replace(filePathContainer.string(),'\\','/'));
-      }
-      else
-      {
-        auto fp = boost::filesystem::canonical(boost::filesystem::path(filePath));
-        MITK_INFO << fp;
-        // find the files location (parent dir) on the host system
-        auto dirPathHost = fp;
-        dirPathHost.remove_filename();  
+std::string mitk::DockerHelper::NormalizeForResultCache(std::string value) const
+{
+  auto replaceAll = [&value](const std::string &from, const std::string &to) {
+    if (from.empty())
+      return;
+    for (auto pos = value.find(from); pos != std::string::npos; pos = value.find(from, pos + to.size()))
+      value.replace(pos, from.size(), to);
+  };
+
+  int volume = 0;
+  for (const auto &kv : m_MappedVolumes)
+  {
+    const auto name = "<volume" + std::to_string(volume++) + ">";
+    replaceAll(kv.first, name + "/host");
+    replaceAll(kv.second, name + "/container");
+  }
+  replaceAll(m_WorkingDirectory.string(), "<workdir>/host");
+  replaceAll(Replace(m_ContainerWorkingDirectory.string(), '\\', '/'), "<workdir>/container");
+  replaceAll(m_WorkingDirectory.filename().string(), "<workdir>/name");
+  return value;
+}
 
-        // mount this parent dir as read only into the container (reuse if already mapped)
-        const auto dirPathContainer = AddOrReuseVolumeMapping(dirPathHost.string(), true);
+boost::filesystem::path mitk::DockerHelper::ResolveStagedFile(const boost::filesystem::path &file) const
+{
+  if (!boost::filesystem::is_symlink(file))
+    return file;
 
-        auto fileName = fp.filename();
+  // staged inputs link to their location within a read-only mount of the container
+  const auto relativeDirectory = boost::filesystem::relative(file.parent_path(), m_WorkingDirectory);
+  const auto containerFile =
+    (boost::filesystem::path("/") / m_ContainerWorkingDirectory / relativeDirectory / boost::filesystem::read_symlink(file))
+      .lexically_normal();
 
-        const auto filePathContainer = boost::filesystem::path(dirPathContainer) / fileName.replace_extension(dataInfo.extension);
-        m_ProgramArguments.push_back(targetArgument);
-        m_ProgramArguments.push_back("/" + Replace(filePathContainer.string(),'\\','/'));
-      }
-    }
+  for (const auto &kv : m_MappedVolumes)
+  {
+    const auto relativePath = containerFile.lexically_relative(boost::filesystem::path("/") / kv.second);
+    if (!relativePath.empty() && *relativePath.begin() != "..")
+      return boost::filesystem::path(kv.first) / relativePath;
   }
+  return boost::filesystem::path();
 }
 
+std::string mitk::DockerHelper::ComputeResultCacheKey()
+{
+  const auto imageId = ResolveImageId();
+  if (imageId.empty())
+  {
+    MITK_INFO << "Image [" << m_ImageName << "] is not available locally, the result cache is not used";
+    return "";
+  }
 
-void mitk::DockerHelper::GenerateLoadDataInfo(){
-  using namespace itksys;
-  using namespace std;
-  const auto dirPathContainer = m_WorkingDirectory.filename();
-  for (const auto &outputInfo : m_LoadDataInfo)
+  auto &cache = mitk::DockerResultCache::GetInstance();
+  nlohmann::json key;
+  key["image"] = imageId;
+  for (const auto &a : m_DockerArguments)
+    key["runArguments"].push_back(NormalizeForResultCache(a));
+  for (const auto &a : m_ProgramArguments)
+    key["programArguments"].push_back(NormalizeForResultCache(a));
+  key["outputs"] = GetResultCacheOutputPaths();
+
+  // staged inputs, sorted by their path within the working directory
+  std::vector<std::string> relativePaths;
+  for (boost::filesystem::recursive_directory_iterator it(m_WorkingDirectory), end; it != end; ++it)
   {
-    const auto argumentName = outputInfo.arg;
+    if (boost::filesystem::is_directory(boost::filesystem::symlink_status(it->path())))
+      continue;
+    relativePaths.push_back(boost::filesystem::relative(it->path(), m_WorkingDirectory).generic_string());
+  }
+  std::sort(relativePaths.begin(), relativePaths.end());
 
-    // no directory
-    if (!outputInfo.isDirectory)
-    {
-      const auto filePathContainer = dirPathContainer / outputInfo.path;
+  key["inputs"] = nlohmann::json::array();
+  for (const auto &relativePath : relativePaths)
+  {
+    if (relativePath == GetLogFilePath().filename() || relativePath == GetJobMetadataPath().filename())
+      continue;
 
-      m_ProgramArguments.push_back(argumentName);
-      if (!outputInfo.isFlagOnly)
-        m_ProgramArguments.push_back("/" + Replace(filePathContainer.string(),'\\','/'));
+    const auto path = m_WorkingDirectory / relativePath;
+    std::string hash;
+    if (m_GeneratedFiles.count(relativePath))
+    {
+      boost::filesystem::ifstream file(path);
+      std::stringstream content;
+      content << file.rdbuf();
+      hash = mitk::DockerResultCache::HashString(NormalizeForResultCache(content.str()));
     }
     else
-    { // directory
-
-      // find within container
-      const auto folderPathContainer = dirPathContainer / outputInfo.path;
-
-      m_ProgramArguments.push_back(argumentName);
-      if (!outputInfo.isFlagOnly)
-        m_ProgramArguments.push_back("/" + Replace(folderPathContainer.string(),'\\','/'));
-
-      if (SystemTools::GetFilenameExtension(outputInfo.path) != "")
+    {
+      const auto hostFile = ResolveStagedFile(path);
+      if (hostFile.empty() || !boost::filesystem::exists(hostFile))
       {
-        MITK_WARN << "Directory path [" << outputInfo.path
-                  << "] contains a dot";
+        MITK_INFO << "Input " << relativePath << " can not be resolved, the result cache is not used";
+        return "";
       }
-
-      // create directory on host
-      const auto folderPathHost = m_WorkingDirectory / outputInfo.path;
-      boost::filesystem::create_directories(folderPathHost);
+      hash = cache.HashFile(hostFile);
     }
+    key["inputs"].push_back({relativePath, hash});
   }
+
+  return mitk::DockerResultCache::HashString(key.dump());
 }
 
-void mitk::DockerHelper::LoadData()
+void mitk::DockerHelper::UseSharedWorkingDirectory(bool value)
 {
+  if (m_WorkingDirectory.empty())
+    return;
 
-  using namespace itksys;
+  const auto sharedDirectory = mitk::DockerContainerPool::GetInstance().GetSharedDirectory();
+  const bool isShared = m_WorkingDirectory.parent_path() == sharedDirectory;
+  if (isShared == value)
+    return;
 
-  // load files from working directory
-  for (auto filename : m_AutoLoadFilenamesFromWorkingDirectory)
-  {
-    const auto fileInFolderPathHost = m_WorkingDirectory / filename;
-    if (boost::filesystem::exists(fileInFolderPathHost))
-    {
-      auto data = mitk::IOUtil::Load(fileInFolderPathHost.string());
-      m_OutputData.insert(m_OutputData.end(), data.begin(), data.end());
-      MITK_INFO << "Loaded [Working Directory]: " << fileInFolderPathHost;
-    }
-  }
+  // pool and worker containers only see the shared pool directory
+  ReleaseWorkingDirectory();
+}
 
-  for (const auto &outputInfo : m_LoadDataInfo)
+void mitk::DockerHelper::ReleaseWorkingDirectory()
+{
+  // the directory is deleted by the manager once no result handle refers to it
+  m_WorkingDirectoryReference.reset();
+  m_WorkingDirectory.clear();
+  m_ContainerWorkingDirectory.clear();
+  m_StagedFiles.clear();
+  m_ScratchLocation = DockerScratchPolicy::Location::Disk;
+}
+
+void mitk::DockerHelper::MoveWorkingDirectoryToDisk()
+{
+  auto &manager = mitk::DockerWorkingDirectoryManager::GetInstance();
+  const auto previousDirectory = m_WorkingDirectory;
+  boost::filesystem::path directory;
+  try
   {
-    const auto argumentName = outputInfo.arg;
-    if (outputInfo.useAutoLoad)
+    const auto root = m_ScratchPolicy.GetRoot(DockerScratchPolicy::Location::Disk);
+    boost::filesystem::create_directories(root);
+    directory = mitk::IOUtil::CreateTemporaryDirectory("m2_XXXXXX", root.string());
+    for (boost::filesystem::recursive_directory_iterator it(previousDirectory), end; it != end; ++it)
     {
-
-      // load a file
-      if (!outputInfo.isDirectory)
-      {
-        const auto filePathHost = m_WorkingDirectory / outputInfo.path;
-        if (boost::filesystem::exists(filePathHost))
-        {
-          auto data = mitk::IOUtil::Load(filePathHost.string());
-          m_OutputData.insert(m_OutputData.end(), data.begin(), data.end());
-          MITK_INFO << "Loaded [File]: " << filePathHost << " for argument "
-                    << argumentName;
-        }
-        else
-        {
-          MITK_WARN << "FAILD: Loaded [File]: " << filePathHost
-                    << " for argument " << argumentName;
-        }
-      }
+      const auto target = directory / boost::filesystem::relative(it->path(), previousDirectory);
+      const auto status = it->symlink_status();
+      if (boost::filesystem::is_symlink(status))
+        boost::filesystem::copy_symlink(it->path(), target);
+      else if (boost::filesystem::is_directory(status))
+        boost::filesystem::create_directories(target);
       else
-      { // load all files in directory
-
-        for (auto filename : outputInfo.directoryFileNames)
-        {
-          const auto fileInFolderPathHost = m_WorkingDirectory / outputInfo.path / filename;
-          if (boost::filesystem::exists(fileInFolderPathHost))
-          {
-            auto data = mitk::IOUtil::Load(fileInFolderPathHost.string());
-            m_OutputData.insert(m_OutputData.end(), data.begin(), data.end());
-            MITK_INFO << "Loaded [Directory]: " << fileInFolderPathHost
-                      << " for argument " << argumentName;
-          }
-        }
-      }
+        boost::filesystem::copy_file(it->path(), target);
     }
   }
-}
+  catch (const std::exception &e)
+  {
+    MITK_WARN << "Could not move the working directory " << previousDirectory << " to disk, it is not kept: " << e.what();
+    boost::system::error_code ec;
+    if (!directory.empty())
+      boost::filesystem::remove_all(directory, ec);
+    manager.Keep(previousDirectory, false);
+    ReleaseWorkingDirectory();
+    return;
+  }
 
-boost::filesystem::path mitk::DockerHelper::GetWorkingDirectory() const
-{
-  return m_WorkingDirectory;
+  MITK_INFO << "Moved the working directory " << previousDirectory << " to " << directory;
+  manager.Keep(previousDirectory, false);
+  ReleaseWorkingDirectory();
+  m_WorkingDirectory = directory;
+  m_ContainerWorkingDirectory = m_WorkingDirectory.filename();
+  m_WorkingDirectoryReference = manager.Register(m_WorkingDirectory);
+  m_RunReport.workingDirectory = m_WorkingDirectory;
+  m_RunReport.scratchLocation = DockerScratchPolicy::ToString(GetScratchLocation());
 }
 
-std::vector<mitk::BaseData::Pointer> mitk::DockerHelper::GetResults()
+void mitk::DockerHelper::CreateWorkingDirectory()
 {
-  if (!CanRunDocker())
+  if (!m_WorkingDirectory.empty())
+    return;
+
+  DockerScratchPolicy::Reservation reservation;
+  if (m_UseContainerPool || m_UsePersistentWorker)
   {
-    mitkThrow() << "No Docker instance found!";
+    const auto sharedDirectory = mitk::DockerContainerPool::GetInstance().GetSharedDirectory();
+    m_WorkingDirectory = boost::filesystem::path(mitk::IOUtil::CreateTemporaryDirectory("m2_XXXXXX", sharedDirectory.string()));
+    m_ContainerWorkingDirectory = boost::filesystem::path(mitk::DockerContainerPool::GetSharedDirectoryContainerPath()) / m_WorkingDirectory.filename();
   }
+  else
+  {
+    const auto stagingBytes = EstimateStagingBytes();
+    reservation = m_ScratchPolicy.Reserve(stagingBytes);
+    try
+    {
+      const auto root = reservation.GetRoot();
+      boost::filesystem::create_directories(root);
+      m_WorkingDirectory = boost::filesystem::path(mitk::IOUtil::CreateTemporaryDirectory("m2_XXXXXX", root.string()));
+    }
+    catch (const std::exception &e)
+    {
+      // a missing or read-only scratch root must not fail the run
+      MITK_WARN << "Could not create the working directory in " << reservation.GetRoot() << ": " << e.what();
+      reservation = DockerScratchPolicy::Reservation();
+      m_WorkingDirectory = boost::filesystem::path(mitk::IOUtil::CreateTemporaryDirectory("m2_XXXXXX", m_ScratchPolicy.GetRoot(DockerScratchPolicy::Location::Disk).string()));
+    }
+    m_ScratchLocation = reservation.GetLocation();
+    m_ContainerWorkingDirectory = m_WorkingDirectory.filename();
+    MITK_DEBUG << "Working directory " << m_WorkingDirectory << " (" << DockerScratchPolicy::ToString(GetScratchLocation())
+               << ", estimated " << stagingBytes << " bytes of inputs)";
+  }
+
+  // the RAM reservation ends when the directory is removed, not with this helper or run
+  auto &manager = mitk::DockerWorkingDirectoryManager::GetInstance();
+  m_WorkingDirectoryReference = manager.Register(m_WorkingDirectory, std::move(reservation));
+  if (m_KeepWorkingDirectory)
+    manager.Keep(m_WorkingDirectory);
+
+  m_RunReport.workingDirectory = m_WorkingDirectory;
+  m_RunReport.containerName = GetContainerName();
+  m_RunReport.scratchLocation = DockerScratchPolicy::ToString(GetScratchLocation());
+}
+
+void mitk::DockerHelper::ResetRunState()
+{
+  // a container left by the previous run (no "--rm") would block the container name
+  if (m_HasRun && !m_AutoRemoveContainer && !m_UseContainerPool && !m_UsePersistentWorker)
+    RemoveContainer(GetContainerName());
+
+  m_TimedOut = false;
+  m_TimeoutReason.clear();
+  m_ResultCacheHit = false;
+  m_DockerArguments.clear();
+  m_ProgramArguments.clear();
+  m_MappedVolumes.clear();
+  m_GeneratedFiles.clear();
+  m_OutputData.clear();
+  m_ResultManifest.clear();
+  m_StagedFilesOfRun.clear();
+  m_PendingStagedFiles.clear();
+  m_InputStoreReferences.clear();
+  m_LinkableFiles.clear();
+  m_CanonicalDirectories.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    m_RunningContainerName.clear();
+    m_EngineContainerRunning = false;
+    m_ProcessId = 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_LogMutex);
+    if (m_LogFile.is_open())
+      m_LogFile.close();
+    m_RecentOutput.clear();
+    m_LogFileSize = 0;
+    m_LogFileTruncated = false;
+  }
+
+  if (!m_HasRun || m_WorkingDirectory.empty())
+    return;
+
+  // result handles of the previous run still refer to its outputs
+  if (m_WorkingDirectoryReference.use_count() > 1)
+  {
+    RenewWorkingDirectory();
+    return;
+  }
+
+  // outputs, links, the log and generated files of the previous run; staged inputs stay
+  std::set<boost::filesystem::path> stagedDirectories;
+  for (const auto &kv : m_StagedFiles)
+    for (auto directory = kv.first.parent_path(); directory != m_WorkingDirectory && !directory.empty(); directory = directory.parent_path())
+      stagedDirectories.insert(directory);
+
+  std::vector<boost::filesystem::path> stale;
+  boost::system::error_code ec;
+  for (boost::filesystem::recursive_directory_iterator it(m_WorkingDirectory, ec), end; !ec && it != end; it.increment(ec))
+  {
+    // directories holding staged inputs are kept and scanned
+    if (m_StagedFiles.count(it->path()) || stagedDirectories.count(it->path()))
+      continue;
+    if (boost::filesystem::is_directory(it->symlink_status()))
+      it.disable_recursion_pending();
+    stale.push_back(it->path());
+  }
+  for (const auto &path : stale)
+    boost::filesystem::remove_all(path, ec);
+}
+
+void mitk::DockerHelper::RenewWorkingDirectory()
+{
+  const auto previousDirectory = m_WorkingDirectory;
+  auto stagedFiles = std::move(m_StagedFiles);
+  ReleaseWorkingDirectory();
+  CreateWorkingDirectory();
+
+  // written inputs move along; links are created again, their targets contain the directory name
+  std::size_t moved = 0;
+  for (const auto &kv : stagedFiles)
+  {
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_regular_file(boost::filesystem::symlink_status(kv.first, ec)))
+      continue;
+
+    const auto path = m_WorkingDirectory / kv.first.lexically_relative(previousDirectory);
+    boost::filesystem::create_directories(path.parent_path(), ec);
+    boost::filesystem::rename(kv.first, path, ec);
+    // e.g. another file system: written again
+    if (ec)
+      continue;
+    m_StagedFiles.emplace(path, kv.second);
+    ++moved;
+  }
+  MITK_DEBUG << "Result handles refer to " << previousDirectory << ", moved " << moved << " staged input(s) to "
+             << m_WorkingDirectory;
+}
+
+void mitk::DockerHelper::SaveStagedFile(const mitk::BaseData *data, const boost::filesystem::path &path)
+{
+  m_StagedFilesOfRun.insert(path);
+  const auto it = m_StagedFiles.find(path);
+  if (it != m_StagedFiles.end() && it->second.data == data && it->second.modifiedTime == data->GetMTime() &&
+      boost::filesystem::exists(path))
+  {
+    MITK_DEBUG << "Reuse staged input " << path;
+    ++m_RunReport.stagingFilesReused;
+    return;
+  }
+
+  m_PendingStagedFiles[path] = data;
+}
+
+void mitk::DockerHelper::WriteStagedFiles()
+{
+  if (m_PendingStagedFiles.empty())
+    return;
+
+  // sorted by path, so the order of the errors does not depend on the threads
+  const auto pending = std::move(m_PendingStagedFiles);
+  m_PendingStagedFiles.clear();
+
+  // the first file of an object and format is written or linked from an earlier run,
+  // further files of the same object and format are hard links to it
+  auto &cache = DockerStagingCache::GetInstance();
+  auto &store = DockerInputStore::GetInstance();
+  auto &resultCache = DockerResultCache::GetInstance();
+  const bool useInputStore = UsesInputStore();
+  std::vector<std::pair<boost::filesystem::path, const mitk::BaseData *>> files;
+  std::vector<boost::filesystem::path> linked;
+  std::vector<std::pair<boost::filesystem::path, boost::filesystem::path>> duplicates;
+  std::map<std::pair<const mitk::BaseData *, std::string>, boost::filesystem::path> firstFiles;
+  // first files that link to the input store already
+  std::map<boost::filesystem::path, std::string> storedFiles;
+  for (const auto &kv : pending)
+  {
+    // never write through a hard link shared with another working directory
+    boost::system::error_code ec;
+    boost::filesystem::remove(kv.first, ec);
+    // the content at this path changes; a rewrite may keep size and time stamp
+    resultCache.ForgetFile(kv.first);
+
+    const auto format = DockerStagingCache::GetFormat(kv.first);
+    const auto inserted = firstFiles.emplace(std::make_pair(kv.second, format), kv.first);
+    if (!inserted.second)
+    {
+      duplicates.emplace_back(kv.first, inserted.first->second);
+      continue;
+    }
+
+    if (useInputStore)
+    {
+      DockerInputStore::Reference reference;
+      for (const auto &path : cache.Find(kv.second, format))
+        if (path.parent_path() == store.GetFilesDirectory() && (reference = store.Acquire(path.filename().string())).IsValid())
+          break;
+      if (reference.IsValid())
+      {
+        storedFiles[kv.first] = reference.GetPath().filename().string();
+        LinkToInputStore(kv.first, std::move(reference));
+        m_StagedFiles[kv.first] = {kv.second, kv.second->GetMTime()};
+        ++m_RunReport.stagingFilesReused;
+        continue;
+      }
+    }
+
+    if (cache.LinkTo(kv.second, kv.first))
+      linked.push_back(kv.first);
+    else
+      files.push_back(kv);
+  }
+
+  std::vector<std::string> errors(files.size());
+  std::atomic<std::size_t> next{0};
+  auto write = [&]() {
+    for (auto i = next++; i < files.size(); i = next++)
+    {
+      try
+      {
+        if (m_StagingWriterOptions.enabled && DockerStagingWriter::CanWrite(files[i].second, files[i].first))
+          DockerStagingWriter::Write(static_cast<const mitk::Image *>(files[i].second), files[i].first, m_StagingWriterOptions);
+        else
+          mitk::IOUtil::Save(files[i].second, files[i].first.string());
+      }
+      catch (const std::exception &e)
+      {
+        errors[i] = e.what();
+        // no partial file is reused by the next run
+        boost::system::error_code ec;
+        boost::filesystem::remove(files[i].first, ec);
+      }
+    }
+  };
+
+  const auto threads = std::min<std::size_t>(
+    m_StagingThreads ? m_StagingThreads : std::max(1u, std::thread::hardware_concurrency()), files.size());
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < threads; ++i)
+    workers.emplace_back(write);
+  write();
+  for (auto &worker : workers)
+    worker.join();
+
+  std::ostringstream message;
+  std::size_t failed = 0;
+  std::set<boost::filesystem::path> failedFiles;
+  for (std::size_t i = 0; i < files.size(); ++i)
+  {
+    if (errors[i].empty())
+    {
+      m_StagedFiles[files[i].first] = {files[i].second, files[i].second->GetMTime()};
+      cache.Add(files[i].second, files[i].first);
+      continue;
+    }
+    m_StagedFiles.erase(files[i].first);
+    failedFiles.insert(files[i].first);
+    message << "\n  " << files[i].first.string() << ": " << errors[i];
+    ++failed;
+  }
+
+  for (const auto &path : linked)
+  {
+    const auto *data = pending.at(path);
+    m_StagedFiles[path] = {data, data->GetMTime()};
+    ++m_RunReport.stagingFilesReused;
+  }
+
+  // the written and linked first files are moved into the input store
+  if (useInputStore)
+  {
+    std::vector<boost::filesystem::path> depositFiles = linked;
+    for (const auto &file : files)
+      if (!failedFiles.count(file.first))
+        depositFiles.push_back(file.first);
+    for (const auto &path : depositFiles)
+    {
+      try
+      {
+        auto reference = store.Deposit(path);
+        cache.Add(pending.at(path), reference.GetPath());
+        storedFiles[path] = reference.GetPath().filename().string();
+        LinkToInputStore(path, std::move(reference));
+      }
+      catch (const std::exception &e)
+      {
+        // the file stays in the working directory
+        MITK_WARN << "Could not move " << path << " into the input store: " << e.what();
+      }
+    }
+  }
+
+  for (const auto &duplicate : duplicates)
+  {
+    const auto &path = duplicate.first;
+    const auto &source = duplicate.second;
+    boost::system::error_code ec;
+    if (failedFiles.count(source))
+    {
+      message << "\n  " << path.string() << ": same data as " << source.string();
+      ++failed;
+      continue;
+    }
+    const auto stored = storedFiles.find(source);
+    if (stored != storedFiles.end())
+    {
+      auto reference = store.Acquire(stored->second);
+      if (reference.IsValid())
+      {
+        LinkToInputStore(path, std::move(reference));
+        const auto *data = pending.at(path);
+        m_StagedFiles[path] = {data, data->GetMTime()};
+        ++m_RunReport.stagingFilesReused;
+        continue;
+      }
+    }
+    boost::filesystem::create_hard_link(source, path, ec);
+    if (ec)
+      boost::filesystem::copy_file(source, path, ec);
+    if (ec)
+    {
+      message << "\n  " << path.string() << ": " << ec.message();
+      ++failed;
+      continue;
+    }
+    const auto *data = pending.at(path);
+    m_StagedFiles[path] = {data, data->GetMTime()};
+    ++m_RunReport.stagingFilesReused;
+  }
+
+  if (failed)
+    mitkThrow() << "Staging failed for " << failed << " of " << pending.size() << " inputs:" << message.str();
+}
+
+bool mitk::DockerHelper::UsesInputStore() const
+{
+  // the mounts of pool and worker containers are fixed when they are started
+  return m_UseInputStore && !m_UseContainerPool && !m_UsePersistentWorker;
+}
+
+void mitk::DockerHelper::LinkToInputStore(const boost::filesystem::path &path, DockerInputStore::Reference reference)
+{
+  const auto storeContainer =
+    boost::filesystem::path("/") / AddOrReuseVolumeMapping(DockerInputStore::GetInstance().GetFilesDirectory().string(), true);
+  const auto directoryContainer =
+    (boost::filesystem::path("/") / m_ContainerWorkingDirectory / path.parent_path().lexically_relative(m_WorkingDirectory))
+      .lexically_normal();
+
+  // relative within the container, like the links of inputs on disk (see ResolveStagedFile)
+  boost::system::error_code ec;
+  boost::filesystem::remove(path, ec);
+  boost::filesystem::create_symlink((storeContainer / reference.GetPath().filename()).lexically_relative(directoryContainer), path);
+  m_InputStoreReferences.push_back(std::move(reference));
+}
+
+void mitk::DockerHelper::EnableInputStore(bool value)
+{
+  m_UseInputStore = value;
+}
+
+void mitk::DockerHelper::SetStagingThreads(unsigned int threads)
+{
+  m_StagingThreads = threads;
+}
+
+void mitk::DockerHelper::SetStagingWriterOptions(const DockerStagingWriter::Options &options)
+{
+  m_StagingWriterOptions = options;
+}
+
+const mitk::DockerStagingWriter::Options &mitk::DockerHelper::GetStagingWriterOptions() const
+{
+  return m_StagingWriterOptions;
+}
+
+void mitk::DockerHelper::RemoveUnusedStagedFiles()
+{
+  for (auto it = m_StagedFiles.begin(); it != m_StagedFiles.end();)
+  {
+    if (m_StagedFilesOfRun.count(it->first))
+    {
+      ++it;
+      continue;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove(it->first, ec);
+    it = m_StagedFiles.erase(it);
+  }
+}
+
+std::uint64_t mitk::DockerHelper::EstimateStagingBytes() const
+{
+  return EstimateSaveDataBytes(m_SaveDataInfo);
+}
+
+std::uint64_t mitk::DockerHelper::EstimateSaveDataBytes(const std::map<std::string, SaveDataInfo> &saveDataInfo)
+{
+  std::uint64_t bytes = 0;
+  for (const auto &kv : saveDataInfo)
+  {
+    for (const auto &data : kv.second.data)
+    {
+      // files on disk with the requested extension are linked, not written
+      std::string filePath;
+      data->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation", filePath);
+      if (!filePath.empty() && kv.second.extension == itksys::SystemTools::GetFilenameExtension(filePath) &&
+          boost::filesystem::exists(filePath))
+        continue;
+
+      // uncompressed pixel data; other data types are small compared to images
+      const auto *image = dynamic_cast<const mitk::Image *>(data.GetPointer());
+      if (!image)
+        continue;
+      std::uint64_t imageBytes = image->GetPixelType().GetSize();
+      for (unsigned int i = 0; i < image->GetDimension(); ++i)
+        imageBytes *= image->GetDimension(i);
+      bytes += imageBytes;
+    }
+  }
+  return bytes;
+}
+
+void mitk::DockerHelper::SetScratchPolicy(const DockerScratchPolicy &policy)
+{
+  m_ScratchPolicy = policy;
+}
+
+const mitk::DockerScratchPolicy &mitk::DockerHelper::GetScratchPolicy() const
+{
+  return m_ScratchPolicy;
+}
+
+mitk::DockerScratchPolicy::Location mitk::DockerHelper::GetScratchLocation() const
+{
+  return m_ScratchLocation;
+}
+
+void mitk::DockerHelper::KeepWorkingDirectory(bool value)
+{
+  m_KeepWorkingDirectory = value;
+  if (!m_WorkingDirectory.empty())
+    mitk::DockerWorkingDirectoryManager::GetInstance().Keep(m_WorkingDirectory, value);
+}
+
+void mitk::DockerHelper::ExecuteDockerCommand(
+    std::string command, const std::vector<std::string> &args)
+{
+  std::vector<std::string> processArgs;
+  processArgs.push_back(command);
+  std::stringstream ss;
+  ss << "docker " << command;
+  for (auto a : args)
+  {
+     ss << " " << a;
+    processArgs.push_back(a);
+  }
+  MITK_INFO << ss.str();
+  WriteLogLine("$ " + ss.str());
+
+  mitk::DockerProcess process(processArgs);
+  process.SetLineCallback([this](mitk::DockerProcess::Stream stream, const std::string &line) { OnContainerOutput(stream, line); });
+
+  // launch the process; the pid is kept so that Cancel() can terminate it
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    ThrowIfCancelled();
+    process.Start();
+    m_ProcessId = process.GetProcessId();
+  }
+
+  int code = process.Wait();
+  if (command == "run" || command == "exec")
+    MarkRunReturned();
+
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    m_ProcessId = 0;
+  }
+
+  if (command == "run" || command == "exec")
+    m_RunReport.exitCode = code;
+
+  ThrowIfCancelled();
+
+  if (code)
+  {
+    mitkThrow() << "docker " << command << " failed with exit code [" << code
+                << "] (see " << GetLogFilePath().string() << ")";
+  }
+}
+
+void mitk::DockerHelper::OnContainerOutput(mitk::DockerProcess::Stream stream, const std::string &line)
+{
+  // the complete output is in docker.log
+  MITK_DEBUG << "[" << m_ImageName << "] " << line;
+  RecordOutput(line);
+  WriteLogLine(stream == mitk::DockerProcess::Stream::StdErr ? "[stderr] " + line : line);
+
+  // called unlocked, the callback may use the helper
+  DockerProcess::LineCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(m_LogMutex);
+    callback = m_LogCallback;
+  }
+  if (callback)
+    callback(stream, line);
+}
+
+void mitk::DockerHelper::SetLogCallback(mitk::DockerProcess::LineCallback callback)
+{
+  std::lock_guard<std::mutex> lock(m_LogMutex);
+  m_LogCallback = callback;
+}
+
+void mitk::DockerHelper::SetMaxLogFileSize(std::uintmax_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_LogMutex);
+  m_MaxLogFileSize = bytes;
+}
+
+boost::filesystem::path mitk::DockerHelper::GetLogFilePath() const
+{
+  return m_WorkingDirectory / "docker.log";
+}
+
+void mitk::DockerHelper::WriteLogLine(const std::string &line)
+{
+  std::lock_guard<std::mutex> lock(m_LogMutex);
+  if (m_LogFileTruncated)
+    return;
+
+  // open once per run, see CloseLogFile
+  if (!m_LogFile.is_open())
+    m_LogFile.open(GetLogFilePath().string(), std::ios::app);
+
+  if (m_LogFileSize + line.size() + 1 > m_MaxLogFileSize)
+  {
+    m_LogFileTruncated = true;
+    m_LogFile << "[log truncated after " << m_LogFileSize << " bytes]\n";
+    m_LogFile.close();
+    return;
+  }
+
+  m_LogFile << line << "\n";
+  m_LogFileSize += line.size() + 1;
+}
+
+void mitk::DockerHelper::CloseLogFile()
+{
+  std::lock_guard<std::mutex> lock(m_LogMutex);
+  if (m_LogFile.is_open())
+    m_LogFile.close();
+}
+
+void mitk::DockerHelper::Run(const std::vector<std::string> &cmdArgs,
+                             const std::vector<std::string> &entryPointArgs)
+{
+  MarkRunLaunched();
+  if (m_UsePersistentWorker)
+  {
+    RunInPersistentWorker(entryPointArgs);
+    return;
+  }
+
+  if (m_UseContainerPool)
+  {
+    if (m_MappedVolumes.empty())
+    {
+      RunInContainerPool(entryPointArgs);
+      return;
+    }
+    MITK_INFO << "Additional volume mappings required, fall back to docker run";
+  }
+
+  std::vector<std::string> args;
+  args.insert(args.end(), cmdArgs.begin(), cmdArgs.end());
+  if (m_AutoRemoveContainer &&
+      std::find(args.begin(), args.end(), "--rm") == args.end())
+    args.push_back("--rm");
+
+  if (m_UseGPUs &&
+      std::find(args.begin(), args.end(), "--gpus") == args.end())
+  {
+    args.push_back("--gpus");
+    args.push_back("device=all");
+  }
+
+  // a known container name is required to kill the container on Cancel()
+  auto nameIt = std::find(args.begin(), args.end(), "--name");
+  if (nameIt == args.end())
+  {
+    args.push_back("--name");
+    args.push_back(GetContainerName());
+    nameIt = args.end() - 2;
+  }
+  const auto containerName = (nameIt + 1 != args.end()) ? *(nameIt + 1) : GetContainerName();
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    m_RunningContainerName = containerName;
+  }
+  StartResourceSampler(containerName);
+
+  if (RunWithEngineApi(args, entryPointArgs))
+    return;
+
+  args.push_back(m_ImageName);
+  args.insert(args.end(), entryPointArgs.begin(), entryPointArgs.end());
+
+  m_RunReport.backend = "cli";
+  ExecuteDockerCommand("run", args);
+}
+
+bool mitk::DockerHelper::RunWithEngineApi(const std::vector<std::string> &runArgs,
+                                          const std::vector<std::string> &entryPointArgs)
+{
+  if (!UseEngineApi())
+    return false;
+
+  nlohmann::json config;
+  std::string containerName;
+  if (!mitk::DockerEngineClient::TranslateRunArguments(runArgs, m_ImageName, entryPointArgs, config, containerName))
+  {
+    if (m_Backend == Backend::EngineApi)
+      mitkThrow() << "The run arguments of [" << m_ImageName << "] are not supported by the Engine API backend";
+    MITK_INFO << "Run arguments not supported by the Engine API, fall back to the docker CLI";
+    return false;
+  }
+
+  // the container is removed after its exit code was read ("AutoRemove" could remove it before)
+  const bool autoRemove = config["HostConfig"].value("AutoRemove", false);
+  config["HostConfig"].erase("AutoRemove");
+
+  std::stringstream ss;
+  ss << "docker run";
+  for (const auto &a : runArgs)
+    ss << " " << a;
+  ss << " " << m_ImageName;
+  for (const auto &a : entryPointArgs)
+    ss << " " << a;
+  MITK_INFO << ss.str() << " (Engine API)";
+  WriteLogLine("$ " + ss.str());
+  m_RunReport.backend = "engine-api";
+
+  mitk::DockerEngineClient client;
+  if (!client.HasImage(m_ImageName))
+    client.PullImage(m_ImageName);
+
+  std::string id;
+  const auto createTime = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    ThrowIfCancelled();
+    id = client.CreateContainer(containerName, config);
+  }
+
+  int code = -1;
+  try
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_ProcessMutex);
+      ThrowIfCancelled();
+      client.StartContainer(id);
+      m_EngineContainerRunning = true;
+    }
+    m_RunReport.containerStartSeconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - createTime).count();
+
+    client.FollowLogs(id, [this](mitk::DockerProcess::Stream stream, const std::string &line) { OnContainerOutput(stream, line); });
+    code = client.WaitContainer(id);
+    MarkRunReturned();
+    m_RunReport.exitCode = code;
+  }
+  catch (...)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_ProcessMutex);
+      m_EngineContainerRunning = false;
+    }
+    try
+    {
+      client.RemoveContainer(id);
+    }
+    catch (const mitk::Exception &)
+    {
+    }
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    m_EngineContainerRunning = false;
+  }
+
+  if (autoRemove)
+    client.RemoveContainer(id);
+
+  ThrowIfCancelled();
+
+  if (code)
+  {
+    mitkThrow() << "docker run failed with exit code [" << code << "] (see " << GetLogFilePath().string() << ")";
+  }
+  return true;
+}
+
+std::vector<std::string> mitk::DockerHelper::GetContainerRunArguments() const
+{
+  auto runArgs = m_ResourceLimits.ToRunArguments();
+  runArgs.insert(runArgs.end(), m_AdditionalRunArguments.begin(), m_AdditionalRunArguments.end());
+  if (m_UseGPUs &&
+      std::find(runArgs.begin(), runArgs.end(), "--gpus") == runArgs.end())
+  {
+    runArgs.push_back("--gpus");
+    runArgs.push_back("device=all");
+  }
+  return runArgs;
+}
+
+void mitk::DockerHelper::RunInContainerPool(const std::vector<std::string> &entryPointArgs)
+{
+  m_RunReport.backend = "container-pool";
+  auto &pool = mitk::DockerContainerPool::GetInstance();
+  const auto containerName = pool.Acquire(m_ImageName, GetContainerRunArguments());
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    m_RunningContainerName = containerName;
+  }
+
+  std::vector<std::string> args = {containerName};
+  args.insert(args.end(), m_ExecEntryPoint.begin(), m_ExecEntryPoint.end());
+  args.insert(args.end(), entryPointArgs.begin(), entryPointArgs.end());
+
+  try
+  {
+    ExecuteDockerCommand("exec", args);
+  }
+  catch (...)
+  {
+    // the state of the container is unknown, do not reuse it
+    pool.Release(containerName, true);
+    throw;
+  }
+  pool.Release(containerName);
+}
+
+void mitk::DockerHelper::RunInPersistentWorker(const std::vector<std::string> &entryPointArgs)
+{
+  if (!m_MappedVolumes.empty())
+    mitkThrow() << "Inputs that require additional volume mappings are not supported by persistent workers";
+
+  m_RunReport.backend = "persistent-worker";
+
+  // the worker is shared with other helpers: it is not stopped by Cancel() or the watchdog,
+  // the job is cancelled through the worker protocol instead
+  auto cancelled = [this]() { return IsCancelled() || m_TimedOut; };
+  auto outputCallback = [this](const std::string &line) { OnContainerOutput(mitk::DockerProcess::Stream::StdOut, line); };
+
+  // a worker discarded by the cancelled job of another helper is replaced
+  for (int attempt = 0; attempt < 3; ++attempt)
+  {
+    ThrowIfCancelled();
+    auto worker = mitk::DockerWorker::GetWorker(m_ImageName, GetContainerRunArguments(), m_WorkerArguments);
+    MITK_INFO << "Submit job to worker [" << worker->GetContainerName() << "]";
+    if (worker->Submit("/" + Replace(m_ContainerWorkingDirectory.string(), '\\', '/'), entryPointArgs, outputCallback,
+                       cancelled, m_StopGracePeriod))
+    {
+      MarkRunReturned();
+      m_RunReport.exitCode = 0;
+      return;
+    }
+  }
+  mitkThrow() << "Worker container for [" << m_ImageName << "] terminated before the job was sent";
+}
+
+void mitk::DockerHelper::RemoveImage(std::vector<std::string> args)
+{
+  if (UseEngineApi())
+  {
+    mitk::DockerEngineClient client;
+    for (const auto &image : args)
+      if (image != "-f")
+        client.RemoveImage(image);
+    return;
+  }
+
+  if (std::find(args.begin(), args.end(), "-f") == args.end())
+    args.insert(args.begin(), "-f");
+  ExecuteDockerCommand("rmi", args);
+}
+
+void mitk::DockerHelper::GenerateRunData()
+{
+  GenerateDockerArguments();
+  GenerateSaveDataInfoAndSaveData();
+  GenerateLoadDataInfo();
+}
+
+void mitk::DockerHelper::GenerateDockerArguments()
+{
+  using namespace itksys;
+  using namespace std;
+  
+  // working directory name of the host system is used as mounting point name in
+  // the container this folder is used as persistent communication bridge
+  // between container and host and vice versa.
+  const auto dirPathContainer = m_ContainerWorkingDirectory;
+  // add this as not "read only" mapping
+  m_DockerArguments.push_back("-v");
+  m_DockerArguments.push_back(m_WorkingDirectory.string() + ":/" + Replace(dirPathContainer.string(),'\\','/'));
+
+  // add resource limits and custom run arguments
+  const auto limitArguments = m_ResourceLimits.ToRunArguments();
+  m_DockerArguments.insert(end(m_DockerArguments), begin(limitArguments), end(limitArguments));
+  m_DockerArguments.insert(end(m_DockerArguments), begin(m_AdditionalRunArguments),
+                   end(m_AdditionalRunArguments));
+
+  m_ProgramArguments.insert(end(m_ProgramArguments),
+                        begin(m_AdditionalApplicationArguments),
+                        end(m_AdditionalApplicationArguments));
+}
+
+std::string mitk::DockerHelper::AddOrReuseVolumeMapping(const std::string& sourcePathHost, bool readOnly)
+{
+  // Check if this source path is already mapped
+  auto it = m_MappedVolumes.find(sourcePathHost);
+  if (it != m_MappedVolumes.end())
+  {
+    // Reuse existing mapping
+    return it->second;
+  }
+  
+  // Create new mapping; the name is unique within the container because the working directory name is
+  const auto containerPath = m_WorkingDirectory.filename().string() + "_volume" + std::to_string(m_MappedVolumes.size());
+  
+  // Add to docker arguments
+  m_DockerArguments.push_back("-v");
+  std::string volumeArg = sourcePathHost + ":/" + containerPath;
+  if (readOnly)
+    volumeArg += ":ro";
+  m_DockerArguments.push_back(volumeArg);
+  
+  // Store mapping
+  m_MappedVolumes[sourcePathHost] = containerPath;
+  
+  return containerPath;
+}
+
+void mitk::DockerHelper::SetMaxInputMounts(unsigned int maxMounts)
+{
+  m_MaxInputMounts = maxMounts;
+}
+
+boost::filesystem::path mitk::DockerHelper::GetLinkableFile(const mitk::BaseData *data, const std::string &extension)
+{
+  std::string filePath;
+  data->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation", filePath);
+  if (filePath.empty() || extension != itksys::SystemTools::GetFilenameExtension(filePath))
+    return boost::filesystem::path();
+
+  const auto it = m_LinkableFiles.find(filePath);
+  if (it != m_LinkableFiles.end())
+    return it->second;
+
+  // the file may be gone, e.g. the output of an earlier run whose working directory was released
+  boost::filesystem::path linkable;
+  boost::system::error_code ec;
+  const auto status = boost::filesystem::symlink_status(filePath, ec);
+  if (boost::filesystem::is_symlink(status))
+  {
+    linkable = boost::filesystem::canonical(filePath, ec);
+  }
+  else if (boost::filesystem::exists(status))
+  {
+    // one lookup per directory instead of per file
+    const auto directory = boost::filesystem::absolute(filePath).parent_path();
+    auto directoryIt = m_CanonicalDirectories.find(directory);
+    if (directoryIt == m_CanonicalDirectories.end())
+      directoryIt = m_CanonicalDirectories.emplace(directory, boost::filesystem::canonical(directory, ec)).first;
+    if (!directoryIt->second.empty())
+      linkable = directoryIt->second / boost::filesystem::path(filePath).filename();
+  }
+
+  // a link to a file of another type is staged
+  if (ec || !boost::algorithm::ends_with(linkable.filename().string(), extension))
+    linkable.clear();
+  m_LinkableFiles[filePath] = linkable;
+  return linkable;
+}
+
+void mitk::DockerHelper::PlanInputMounts(const std::vector<const std::map<std::string, SaveDataInfo> *> &saveDataInfos)
+{
+  std::vector<boost::filesystem::path> directories;
+  std::set<boost::filesystem::path> seen;
+  for (const auto *saveDataInfo : saveDataInfos)
+  {
+    for (const auto &kv : *saveDataInfo)
+    {
+      for (const auto &data : kv.second.data)
+      {
+        const auto file = GetLinkableFile(data, kv.second.extension);
+        // companion files (".ibd") are in the same directory
+        if (file.empty() || !seen.insert(file.parent_path()).second)
+          continue;
+        const auto covered = std::any_of(m_MappedVolumes.begin(), m_MappedVolumes.end(), [&file](const auto &volume) {
+          return DockerMountPlanner::IsWithin(file.parent_path(), volume.first);
+        });
+        if (!covered)
+          directories.push_back(file.parent_path());
+      }
+    }
+  }
+  if (directories.empty())
+    return;
+
+  const auto mounts = DockerMountPlanner::Plan(directories, m_MaxInputMounts);
+  MITK_INFO << "Mount " << mounts.size() << " directories for inputs in " << directories.size() << " directories";
+  for (const auto &mount : mounts)
+  {
+    // an ancestor exposes unrelated files next to the inputs
+    if (!seen.count(mount))
+      MITK_WARN << "Mount " << mount << " read-only for inputs in its subdirectories; all files below it are visible in the container";
+    AddOrReuseVolumeMapping(mount.string(), true);
+  }
+}
+
+boost::filesystem::path mitk::DockerHelper::MapInputFile(const boost::filesystem::path &fileHost)
+{
+  // the deepest mount that covers the file
+  const std::pair<const std::string, std::string> *best = nullptr;
+  for (const auto &kv : m_MappedVolumes)
+  {
+    if (DockerMountPlanner::IsWithin(fileHost.parent_path(), kv.first) && (!best || kv.first.size() > best->first.size()))
+      best = &kv;
+  }
+  if (!best)
+    return boost::filesystem::path("/") / AddOrReuseVolumeMapping(fileHost.parent_path().string(), true) / fileHost.filename();
+  return boost::filesystem::path("/") / best->second / fileHost.lexically_relative(best->first);
+}
+
+void mitk::DockerHelper::GenerateSaveDataInfoAndSaveData(){
+  PlanInputMounts({&m_SaveDataInfo});
+  SaveData(m_SaveDataInfo, m_WorkingDirectory, m_ContainerWorkingDirectory, m_ProgramArguments);
+  WriteStagedFiles();
+}
+
+void mitk::DockerHelper::SaveData(std::map<std::string, SaveDataInfo> &saveDataInfo,
+                                  const boost::filesystem::path &hostDirectory,
+                                  const boost::filesystem::path &containerDirectory,
+                                  std::vector<std::string> &programArguments){
+  using namespace std;
+  const auto &dirPathContainer = containerDirectory;
+  // symlink in hostDirectory -> file in a mounted volume (container path); created together below
+  vector<pair<boost::filesystem::path, boost::filesystem::path>> links;
+
+  // Add input data
+  for (auto &kv : saveDataInfo)
+  {
+    std::string targetArgument = kv.first;
+    SaveDataInfo &dataInfo = kv.second;
+    const auto dataVector = dataInfo.data;
+
+    // save multiple objects to a folder given by dataInfo.nameWithExtension
+    if (!dataInfo.isSingleFile)
+    {
+      // create data folder
+      const auto splitPos = dataInfo.name.find("/");
+      const auto folderName = dataInfo.name.substr(0, splitPos);
+      const auto dirPathHost = hostDirectory / folderName;
+      boost::filesystem::create_directory(dirPathHost);
+      
+      int i = 0;
+      for(auto data: dataVector){
+        const auto fileRelativeFilePath = boost::filesystem::path((boost::format(dataInfo.name) % i).str() + dataInfo.extension);
+        const auto filePathHost = hostDirectory / fileRelativeFilePath;
+        const auto fileHost = GetLinkableFile(data, dataInfo.extension);
+
+        if (fileHost.empty())
+        { // file not on disk or different extension
+          SaveStagedFile(data, filePathHost);
+        }
+        else
+        {
+          // link to the original file in its mounted volume
+          links.emplace_back(filePathHost, MapInputFile(fileHost));
+
+          // For imzML files, also link the companion .ibd file
+          if (dataInfo.extension == ".imzML")
+          {
+            auto ibdFileHost = fileHost;
+            ibdFileHost.replace_extension(".ibd");
+            if (boost::filesystem::exists(ibdFileHost))
+            {
+              auto ibdSymlinkPath = filePathHost;
+              ibdSymlinkPath.replace_extension(".ibd");
+              links.emplace_back(ibdSymlinkPath, MapInputFile(ibdFileHost));
+            }
+          }
+        }
+        ++i;
+      }
+
+      // the target folder is passed as command line argument instead of a file name
+      // this has to be handled of the target script
+      programArguments.push_back(targetArgument);
+      programArguments.push_back("/" + Replace((dirPathContainer / folderName).string(),'\\', '/'));
+
+
+    }
+    // save/link a single data object
+    else 
+    {
+      auto data = dataVector.front();
+
+      auto filePathHost = hostDirectory / (dataInfo.name + dataInfo.extension);
+      dataInfo.manualSavePath = filePathHost;
+      const auto fileHost = GetLinkableFile(data, dataInfo.extension);
+
+      if (fileHost.empty())
+      { // file not on disk or different extension
+        SaveStagedFile(data, filePathHost);
+        const auto filePathContainer = dirPathContainer / (dataInfo.name + dataInfo.extension);
+        programArguments.push_back(targetArgument);
+        programArguments.push_back("/" + Replace(filePathContainer.string(),'\\','/'));
+      }
+      else
+      {
+        // the file is passed directly from its mounted volume
+        programArguments.push_back(targetArgument);
+        programArguments.push_back(MapInputFile(fileHost).generic_string());
+      }
+    }
+  }
+
+  // links are relative within the container (see ResolveStagedFile)
+  const auto rootContainer = boost::filesystem::path("/") / containerDirectory;
+  std::set<boost::filesystem::path> linkDirectories;
+  for (const auto &link : links)
+  {
+    const auto linkDirectory = link.first.parent_path();
+    if (linkDirectories.insert(linkDirectory).second)
+      boost::filesystem::create_directories(linkDirectory);
+    const auto linkDirectoryContainer = (rootContainer / linkDirectory.lexically_relative(hostDirectory)).lexically_normal();
+    boost::filesystem::create_symlink(link.second.lexically_relative(linkDirectoryContainer), link.first);
+  }
+  if (!links.empty())
+    MITK_INFO << "Linked " << links.size() << " input files from " << m_MappedVolumes.size() << " mounted volumes";
+}
+
+
+void mitk::DockerHelper::GenerateLoadDataInfo(){
+  PrepareOutputs(m_LoadDataInfo, m_WorkingDirectory, m_ContainerWorkingDirectory, m_ProgramArguments);
+}
+
+void mitk::DockerHelper::PrepareOutputs(const std::vector<LoadDataInfo> &loadDataInfo,
+                                        const boost::filesystem::path &hostDirectory,
+                                        const boost::filesystem::path &containerDirectory,
+                                        std::vector<std::string> &programArguments){
+  using namespace itksys;
+  using namespace std;
+  const auto &dirPathContainer = containerDirectory;
+  for (const auto &outputInfo : loadDataInfo)
+  {
+    const auto argumentName = outputInfo.arg;
+
+    // no directory
+    if (!outputInfo.isDirectory)
+    {
+      const auto filePathContainer = dirPathContainer / outputInfo.path;
+
+      programArguments.push_back(argumentName);
+      if (!outputInfo.isFlagOnly)
+        programArguments.push_back("/" + Replace(filePathContainer.string(),'\\','/'));
+    }
+    else
+    { // directory
+
+      // find within container
+      const auto folderPathContainer = dirPathContainer / outputInfo.path;
+
+      programArguments.push_back(argumentName);
+      if (!outputInfo.isFlagOnly)
+        programArguments.push_back("/" + Replace(folderPathContainer.string(),'\\','/'));
+
+      if (SystemTools::GetFilenameExtension(outputInfo.path) != "")
+      {
+        MITK_WARN << "Directory path [" << outputInfo.path
+                  << "] contains a dot";
+      }
 
-  GenerateRunData();
-
-  Run(m_DockerArguments, m_ProgramArguments);
-  LoadData();
-
-  MITK_INFO << "Size of the results vector " << m_OutputData.size();
-
-  // autoremove image
-  if (m_AutoRemoveImage)
+      // create directory on host
+      const auto folderPathHost = hostDirectory / outputInfo.path;
+      boost::filesystem::create_directories(folderPathHost);
+    }
+  }
+}
+
+void mitk::DockerHelper::LoadData()
+{
+  LoadOutputs(m_WorkingDirectory, m_OutputData);
+}
+
+mitk::DockerResultManifest mitk::DockerHelper::CollectOutputs(const boost::filesystem::path &hostDirectory) const
+{
+  DockerResultManifest manifest;
+
+  // files from working directory
+  for (const auto &filename : m_AutoLoadFilenamesFromWorkingDirectory)
+  {
+    const auto fileInFolderPathHost = hostDirectory / filename;
+    if (boost::filesystem::exists(fileInFolderPathHost))
+      manifest.push_back(std::make_shared<DockerResultHandle>("", fileInFolderPathHost, true));
+  }
+
+  for (const auto &outputInfo : m_LoadDataInfo)
+  {
+    const auto pathHost = hostDirectory / outputInfo.path;
+    if (!outputInfo.isDirectory)
+    {
+      // missing files are listed as well, see DockerResultHandle::Exists
+      manifest.push_back(std::make_shared<DockerResultHandle>(outputInfo.arg, pathHost, outputInfo.useAutoLoad));
+    }
+    else if (!outputInfo.directoryFileNames.empty())
+    {
+      for (const auto &filename : outputInfo.directoryFileNames)
+      {
+        const auto fileInFolderPathHost = pathHost / filename;
+        if (boost::filesystem::exists(fileInFolderPathHost))
+          manifest.push_back(
+            std::make_shared<DockerResultHandle>(outputInfo.arg, fileInFolderPathHost, outputInfo.useAutoLoad));
+      }
+    }
+    else if (boost::filesystem::is_directory(pathHost))
+    {
+      // unknown content: listed, but never loaded automatically
+      std::vector<boost::filesystem::path> files;
+      for (boost::filesystem::recursive_directory_iterator it(pathHost), end; it != end; ++it)
+        if (boost::filesystem::is_regular_file(it->path()))
+          files.push_back(it->path());
+      std::sort(files.begin(), files.end());
+      for (const auto &file : files)
+        manifest.push_back(std::make_shared<DockerResultHandle>(outputInfo.arg, file, false));
+    }
+  }
+  return manifest;
+}
+
+void mitk::DockerHelper::LoadOutputs(const boost::filesystem::path &hostDirectory,
+                                     std::vector<mitk::BaseData::Pointer> &outputData)
+{
+  const auto manifest = CollectOutputs(hostDirectory);
+  for (const auto &handle : manifest)
+    handle->SetWorkingDirectoryReference(m_WorkingDirectoryReference);
+  m_ResultManifest.insert(m_ResultManifest.end(), manifest.begin(), manifest.end());
+  if (m_LoadResultsLazily)
+    return;
+
+  for (const auto &handle : manifest)
+  {
+    if (!handle->IsAutoLoad())
+      continue;
+
+    if (!handle->Exists())
+    {
+      MITK_WARN << "FAILD: Loaded [File]: " << handle->GetPath() << " for argument " << handle->GetArgument();
+      continue;
+    }
+
+    auto data = handle->GetData();
+    outputData.insert(outputData.end(), data.begin(), data.end());
+    m_RunReport.loadingBytesRead += handle->GetSize();
+    ++m_RunReport.loadingFilesRead;
+    MITK_INFO << "Loaded: " << handle->GetPath() << " for argument " << handle->GetArgument();
+  }
+}
+
+const mitk::DockerResultManifest &mitk::DockerHelper::GetResultHandles() const
+{
+  return m_ResultManifest;
+}
+
+mitk::DockerResultManifest mitk::DockerHelper::GetResultManifest()
+{
+  m_LoadResultsLazily = true;
+  try
+  {
+    GetResults();
+  }
+  catch (...)
+  {
+    m_LoadResultsLazily = false;
+    throw;
+  }
+  m_LoadResultsLazily = false;
+  return m_ResultManifest;
+}
+
+boost::filesystem::path mitk::DockerHelper::GetWorkingDirectory() const
+{
+  return m_WorkingDirectory;
+}
+
+std::string mitk::DockerHelper::GetContainerName() const
+{
+  return m_WorkingDirectory.filename().string();
+}
+
+void mitk::DockerHelper::SetProgressCallback(ProgressCallback callback)
+{
+  m_ProgressCallback = callback;
+}
+
+void mitk::DockerHelper::ReportProgress(Phase phase, const std::string &message)
+{
+  AccountPhase(phase, message);
+  if (m_ProgressCallback)
+    m_ProgressCallback(phase, message);
+}
+
+const mitk::DockerRunReport &mitk::DockerHelper::GetRunReport() const
+{
+  return m_RunReport;
+}
+
+void mitk::DockerHelper::EnableRunReportFile(bool value)
+{
+  m_WriteRunReportFile = value;
+}
+
+boost::filesystem::path mitk::DockerHelper::GetRunReportPath() const
+{
+  return m_WorkingDirectory.parent_path() / (m_WorkingDirectory.filename().string() + ".report.json");
+}
+
+void mitk::DockerHelper::BeginRunReport()
+{
+  m_RunReport = DockerRunReport();
+  m_RunReport.image = m_ImageName;
+  m_RunReport.containerName = GetContainerName();
+  m_RunReport.workingDirectory = m_WorkingDirectory;
+  m_ReportPhase = Phase::Staging;
+  m_ReportStartTime = std::chrono::steady_clock::now();
+  m_ReportPhaseStartTime = m_ReportStartTime;
+  m_RunLaunchTime = 0;
+  m_FirstOutputTime = 0;
+}
+
+void mitk::DockerHelper::AccountPhase(Phase phase, const std::string &message)
+{
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed = std::chrono::duration<double>(now - m_ReportPhaseStartTime).count();
+  switch (m_ReportPhase)
+  {
+    case Phase::Staging:
+      m_RunReport.stagingSeconds += elapsed;
+      break;
+    case Phase::Queued:
+      m_RunReport.queuedSeconds += elapsed;
+      break;
+    case Phase::Running:
+      m_RunReport.runningSeconds += elapsed;
+      break;
+    case Phase::Loading:
+      m_RunReport.loadingSeconds += elapsed;
+      break;
+    default:
+      break;
+  }
+  m_ReportPhase = phase;
+  m_ReportPhaseStartTime = now;
+
+  if (phase != Phase::Finished && phase != Phase::Failed && phase != Phase::Cancelled)
+    return;
+
+  if (phase == Phase::Finished)
+    m_RunReport.status = "finished";
+  else if (phase == Phase::Cancelled)
+    m_RunReport.status = "cancelled";
+  else
+    m_RunReport.status = m_TimedOut ? "timeout" : "failed";
+  m_RunReport.message = message;
+  m_RunReport.totalSeconds = std::chrono::duration<double>(now - m_ReportStartTime).count();
+
+  using clock = std::chrono::steady_clock;
+  if (m_RunLaunchTime != 0 && m_FirstOutputTime != 0)
+    m_RunReport.firstOutputSeconds = std::chrono::duration<double>(clock::duration(m_FirstOutputTime.load()) -
+                                                                   clock::duration(m_RunLaunchTime.load()))
+                                       .count();
+
+  if (m_WriteRunReportFile && !m_WorkingDirectory.empty())
+  {
+    try
+    {
+      m_RunReport.WriteJson(GetRunReportPath());
+    }
+    catch (const std::exception &e)
+    {
+      MITK_WARN << e.what();
+    }
+  }
+}
+
+void mitk::DockerHelper::AccountStagedFiles()
+{
+  boost::system::error_code ec;
+  for (boost::filesystem::recursive_directory_iterator it(m_WorkingDirectory, ec), end; !ec && it != end; it.increment(ec))
+  {
+    const auto status = boost::filesystem::symlink_status(it->path(), ec);
+    if (boost::filesystem::is_symlink(status))
+    {
+      ++m_RunReport.stagingFilesLinked;
+    }
+    else if (boost::filesystem::is_regular_file(status))
+    {
+      m_RunReport.stagingBytesWritten += boost::filesystem::file_size(it->path(), ec);
+      ++m_RunReport.stagingFilesWritten;
+    }
+  }
+}
+
+void mitk::DockerHelper::EnableResourceSampling(bool value, std::chrono::milliseconds interval)
+{
+  m_SampleResources = value;
+  m_SampleInterval = interval;
+}
+
+void mitk::DockerHelper::StartResourceSampler(const std::string &containerName)
+{
+  if (!m_SampleResources)
+    return;
+  m_ResourceSampler = std::make_unique<mitk::DockerResourceSampler>(containerName, m_SampleInterval);
+  m_ResourceSampler->Start();
+}
+
+void mitk::DockerHelper::StopResourceSampler()
+{
+  if (!m_ResourceSampler)
+    return;
+  m_ResourceSampler->Stop();
+  m_RunReport.resources = m_ResourceSampler->GetUsage();
+  m_ResourceSampler.reset();
+  if (m_RunReport.resources.samples == 0)
+    MITK_INFO << "No resource usage sampled for [" << m_ImageName << "] (container too short-lived or cgroup not accessible)";
+}
+
+void mitk::DockerHelper::MarkRunLaunched()
+{
+  m_FirstOutputTime = 0;
+  m_RunLaunchTime = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void mitk::DockerHelper::MarkRunReturned()
+{
+  // a container that has exited is not reported as timed out by the watchdog
+  std::lock_guard<std::mutex> lock(m_WatchdogMutex);
+  m_RunReturned = true;
+}
+
+bool mitk::DockerHelper::IsCancelled() const
+{
+  return m_Cancelled;
+}
+
+void mitk::DockerHelper::ThrowIfCancelled()
+{
+  // a timed out run is stopped like a cancelled one
+  if (m_TimedOut)
+    mitkThrowException(mitk::DockerTimeoutException) << GetTimeoutMessage();
+  if (m_Cancelled)
+    mitkThrowException(mitk::DockerCancelledException) << "Docker run of [" << m_ImageName << "] was cancelled";
+}
+
+void mitk::DockerHelper::Cancel()
+{
+  {
+    // a process started after this point sees the flag and does not launch
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    if (m_Cancelled.exchange(true))
+      return;
+  }
+
+  MITK_INFO << "Cancel docker run of [" << m_ImageName << "]";
+  StopRunningContainer(false);
+}
+
+void mitk::DockerHelper::StopRunningContainer(bool graceful)
+{
+  std::string containerName;
+  long processId;
+  bool engineContainerRunning;
   {
-    RemoveImage({m_ImageName});
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    containerName = m_RunningContainerName;
+    processId = m_ProcessId;
+    engineContainerRunning = m_EngineContainerRunning;
   }
 
+  if (processId != 0)
+  {
+    // a running docker client is only interrupted after the container is gone
+    if (graceful)
+      mitk::DockerProcess::Execute({"stop", "-t", std::to_string(m_StopGracePeriod.count()), containerName});
+    else
+      mitk::DockerProcess::Execute({"kill", containerName});
+    if (Poco::Process::isRunning(processId))
+      Poco::Process::kill(processId);
+  }
+  else if (engineContainerRunning)
+  {
+    // the log stream and the wait request return once the container is stopped
+    try
+    {
+      mitk::DockerEngineClient client;
+      if (graceful)
+        client.StopContainer(containerName, static_cast<int>(m_StopGracePeriod.count()));
+      else
+        client.KillContainer(containerName);
+    }
+    catch (const mitk::Exception &e)
+    {
+      MITK_WARN << e.GetDescription();
+    }
+  }
+}
+
+void mitk::DockerHelper::SetRunTimeout(std::chrono::milliseconds timeout)
+{
+  m_RunTimeout = timeout;
+}
+
+void mitk::DockerHelper::SetStallTimeout(std::chrono::milliseconds timeout)
+{
+  m_StallTimeout = timeout;
+}
+
+void mitk::DockerHelper::SetStopGracePeriod(std::chrono::seconds gracePeriod)
+{
+  m_StopGracePeriod = gracePeriod;
+}
+
+bool mitk::DockerHelper::IsTimedOut() const
+{
+  return m_TimedOut;
+}
+
+void mitk::DockerHelper::RecordOutput(const std::string &line)
+{
+  m_LastOutputTime = std::chrono::steady_clock::now().time_since_epoch().count();
+  std::chrono::steady_clock::rep noOutput = 0;
+  m_FirstOutputTime.compare_exchange_strong(noOutput, m_LastOutputTime.load());
+
+  std::lock_guard<std::mutex> lock(m_LogMutex);
+  m_RecentOutput.push_back(line);
+  if (m_RecentOutput.size() > 20)
+    m_RecentOutput.pop_front();
+}
+
+void mitk::DockerHelper::StartWatchdog()
+{
+  if (m_RunTimeout.count() == 0 && m_StallTimeout.count() == 0)
+    return;
+
+  StopWatchdog();
+  m_WatchdogStop = false;
+  m_RunReturned = false;
+  m_LastOutputTime = std::chrono::steady_clock::now().time_since_epoch().count();
+
+  m_WatchdogThread = std::thread([this]() {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    std::unique_lock<std::mutex> lock(m_WatchdogMutex);
+    while (!m_WatchdogStop)
+    {
+      m_WatchdogCondition.wait_for(lock, std::chrono::milliseconds(100));
+      if (m_WatchdogStop || m_RunReturned)
+        return;
+
+      const auto now = clock::now();
+      const auto lastOutput = clock::time_point(clock::duration(m_LastOutputTime.load()));
+      std::ostringstream reason;
+      if (m_RunTimeout.count() > 0 && now - start > m_RunTimeout)
+        reason << "Docker run of [" << m_ImageName << "] exceeded the run timeout of " << m_RunTimeout.count() << " ms";
+      else if (m_StallTimeout.count() > 0 && now - lastOutput > m_StallTimeout)
+        reason << "Docker run of [" << m_ImageName << "] wrote no output for " << m_StallTimeout.count() << " ms";
+      else
+        continue;
+
+      m_TimeoutReason = reason.str();
+      m_TimedOut = true;
+      lock.unlock();
+
+      MITK_WARN << m_TimeoutReason << ", stopping the container";
+      WriteLogLine("[timeout] " + m_TimeoutReason);
+      StopRunningContainer(true);
+      return;
+    }
+  });
+}
+
+void mitk::DockerHelper::StopWatchdog()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_WatchdogMutex);
+    m_WatchdogStop = true;
+  }
+  m_WatchdogCondition.notify_all();
+  if (m_WatchdogThread.joinable())
+    m_WatchdogThread.join();
+}
+
+std::string mitk::DockerHelper::GetTimeoutMessage()
+{
+  std::string reason;
+  {
+    std::lock_guard<std::mutex> lock(m_WatchdogMutex);
+    reason = m_TimeoutReason;
+  }
+
+  std::ostringstream recentOutput;
+  {
+    std::lock_guard<std::mutex> lock(m_LogMutex);
+    for (const auto &line : m_RecentOutput)
+      recentOutput << "\n  " << line;
+  }
+
+  std::ostringstream message;
+  message << reason << " (see " << GetLogFilePath().string() << ")";
+  if (!recentOutput.str().empty())
+    message << "; last output:" << recentOutput.str();
+  return message.str();
+}
+
+void mitk::DockerHelper::RemoveContainer(const std::string &containerName)
+{
+  if (UseEngineApi())
+  {
+    try
+    {
+      mitk::DockerEngineClient().RemoveContainer(containerName);
+    }
+    catch (const mitk::Exception &)
+    {
+      // the container may not exist anymore
+    }
+    return;
+  }
+  mitk::DockerProcess::Execute({"rm", "-f", containerName});
+}
+
+void mitk::DockerHelper::CleanUpAfterCancel()
+{
+  // the container may still exist if it was killed before "--rm" could take effect
+  std::string containerName;
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    containerName = m_RunningContainerName;
+  }
+  if (!containerName.empty())
+  {
+    RemoveContainer(containerName);
+  }
+
+  // also a kept directory; the next run stages its inputs in a new one
+  if (!m_WorkingDirectory.empty())
+  {
+    mitk::DockerWorkingDirectoryManager::GetInstance().Keep(m_WorkingDirectory, false);
+    ReleaseWorkingDirectory();
+  }
+
+  // the cancel request ends with this run, the helper can be run again
+  std::lock_guard<std::mutex> lock(m_ProcessMutex);
+  m_Cancelled = false;
+}
+
+void mitk::DockerHelper::CleanUpAfterTimeout()
+{
+  // without "--rm" the stopped container would be left behind; the working directory is kept for debugging
+  std::string containerName;
+  {
+    std::lock_guard<std::mutex> lock(m_ProcessMutex);
+    containerName = m_RunningContainerName;
+  }
+  if (!containerName.empty())
+    RemoveContainer(containerName);
+
+  if (m_WorkingDirectory.empty())
+    return;
+
+  // a kept directory on the tmpfs would hold RAM until it is evicted
+  if (m_ScratchLocation == DockerScratchPolicy::Location::Ram)
+    MoveWorkingDirectoryToDisk();
+  if (!m_WorkingDirectory.empty())
+    mitk::DockerWorkingDirectoryManager::GetInstance().Keep(m_WorkingDirectory);
+}
+
+std::vector<mitk::BaseData::Pointer> mitk::DockerHelper::GetResults()
+{
+  ResetRunState();
+  m_HasRun = true;
+  BeginRunReport();
+  try
+  {
+    if (!CanRunDocker())
+    {
+      mitkThrow() << "No Docker instance found!";
+    }
+
+    m_ResourceLimits.Validate();
+
+    ReportProgress(Phase::Staging, "Save input data");
+    ThrowIfCancelled();
+    CreateWorkingDirectory();
+    GenerateRunData();
+    RemoveUnusedStagedFiles();
+    WriteJobMetadata();
+    AccountStagedFiles();
+
+    // identical jobs of this process wait for each other and then share the cache entry
+    auto &resultCache = mitk::DockerResultCache::GetInstance();
+    mitk::DockerResultCache::Claim resultCacheClaim;
+    std::string resultCacheKey;
+    m_ResultCacheHit = false;
+    if (m_UseResultCache)
+    {
+      resultCacheKey = ComputeResultCacheKey();
+      if (!resultCacheKey.empty())
+      {
+        resultCacheClaim = resultCache.ClaimKey(resultCacheKey, [this]() { return IsCancelled(); });
+        ThrowIfCancelled();
+        m_ResultCacheHit = resultCache.Restore(resultCacheKey, m_WorkingDirectory);
+        if (m_ResultCacheHit)
+          m_RunReport.backend = "result-cache";
+      }
+    }
+
+    if (!m_ResultCacheHit)
+    {
+      mitk::DockerJobScheduler::Admission admission;
+      if (m_UseJobScheduler)
+      {
+        auto &scheduler = mitk::DockerJobScheduler::GetInstance();
+        ReportProgress(Phase::Queued, "Waiting for resources (" + std::to_string(scheduler.GetQueueDepth()) + " job(s) queued)");
+        admission = scheduler.Acquire(GetResourceRequirements(), [this]() { return IsCancelled(); });
+      }
+
+      ReportProgress(Phase::Running, "Run " + m_ImageName);
+      ThrowIfCancelled();
+      StartWatchdog();
+      try
+      {
+        Run(m_DockerArguments, m_ProgramArguments);
+      }
+      catch (...)
+      {
+        StopWatchdog();
+        StopResourceSampler();
+        CloseLogFile();
+        throw;
+      }
+      StopWatchdog();
+      StopResourceSampler();
+      CloseLogFile();
+      admission.Release();
+      ThrowIfCancelled();
+
+      if (!resultCacheKey.empty())
+      {
+        try
+        {
+          resultCache.Store(resultCacheKey, m_WorkingDirectory, GetResultCacheOutputPaths());
+        }
+        catch (const std::exception &e)
+        {
+          MITK_WARN << "Could not store the results in the result cache: " << e.what();
+        }
+      }
+    }
+    resultCacheClaim.Release();
+
+    ReportProgress(Phase::Loading, m_LoadResultsLazily ? "Collect results" : "Load results");
+    ThrowIfCancelled();
+    m_ResultManifest.clear();
+    LoadData();
+
+    // autoremove image; a failure is reported like any other error of the run
+    if (m_AutoRemoveImage)
+    {
+      RemoveImage({m_ImageName});
+    }
+  }
+  catch (const mitk::DockerTimeoutException &)
+  {
+    // the message names the log file, which may have moved to disk
+    CleanUpAfterTimeout();
+    const auto message = GetTimeoutMessage();
+    ReportProgress(Phase::Failed, message);
+    mitkThrowException(mitk::DockerTimeoutException) << message;
+  }
+  catch (const mitk::DockerCancelledException &)
+  {
+    CleanUpAfterCancel();
+    ReportProgress(Phase::Cancelled, "Cancelled");
+    throw;
+  }
+  catch (const std::exception &e)
+  {
+    // a stopped container lets "docker run" fail with a generic error
+    if (m_TimedOut)
+    {
+      CleanUpAfterTimeout();
+      const auto message = GetTimeoutMessage();
+      ReportProgress(Phase::Failed, message);
+      mitkThrowException(mitk::DockerTimeoutException) << message;
+    }
+    if (m_Cancelled)
+    {
+      CleanUpAfterCancel();
+      ReportProgress(Phase::Cancelled, "Cancelled");
+      mitkThrowException(mitk::DockerCancelledException) << "Docker run of [" << m_ImageName << "] was cancelled";
+    }
+    ReportProgress(Phase::Failed, e.what());
+    throw;
+  }
+
+  MITK_INFO << "Size of the results vector " << m_OutputData.size();
+
+  mitk::DockerWorkingDirectoryManager::GetInstance().Touch(m_WorkingDirectory);
+  ReportProgress(Phase::Finished, "Finished");
   return m_OutputData;
+}
+
+std::future<std::vector<mitk::BaseData::Pointer>> mitk::DockerHelper::GetResultsAsync()
+{
+  if (m_AsyncRunning)
+    mitkThrow() << "GetResultsAsync is still running for this helper";
+  // the previous run has finished, its thread ends without waiting
+  if (m_AsyncThread.joinable())
+    m_AsyncThread.join();
+
+  m_AsyncRunning = true;
+  std::packaged_task<std::vector<mitk::BaseData::Pointer>()> task([this]() {
+    // also reset if the run throws
+    struct Finished
+    {
+      std::atomic<bool> &running;
+      ~Finished() { running = false; }
+    } finished{m_AsyncRunning};
+    return GetResults();
+  });
+  auto future = task.get_future();
+  m_AsyncThread = std::thread(std::move(task));
+  return future;
 }
\ No newline at end of file
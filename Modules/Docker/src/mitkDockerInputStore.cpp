@@ -0,0 +1,304 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerInputStore.h>
+
+#include <mitkDockerResultCache.h>
+#include <mitkExceptionMacro.h>
+#include <mitkIOUtil.h>
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace
+{
+  std::string GetHostName()
+  {
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    return hostname;
+  }
+
+  bool IsProcessRunning(long pid)
+  {
+    return pid > 0 && (kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM);
+  }
+
+  // ".nii.gz" for "image.nii.gz"
+  std::string GetFormat(const boost::filesystem::path &path)
+  {
+    const auto name = path.filename().string();
+    const auto position = name.find('.', 1);
+    return position == std::string::npos ? std::string() : name.substr(position);
+  }
+} // namespace
+
+mitk::DockerInputStore::Reference::Reference(Reference &&other) noexcept
+  : m_File(std::move(other.m_File)), m_Marker(std::move(other.m_Marker))
+{
+  other.m_Marker.clear();
+}
+
+mitk::DockerInputStore::Reference &mitk::DockerInputStore::Reference::operator=(Reference &&other) noexcept
+{
+  if (this != &other)
+  {
+    Release();
+    m_File = std::move(other.m_File);
+    m_Marker = std::move(other.m_Marker);
+    other.m_Marker.clear();
+  }
+  return *this;
+}
+
+mitk::DockerInputStore::Reference::~Reference()
+{
+  Release();
+}
+
+void mitk::DockerInputStore::Reference::Release()
+{
+  if (m_Marker.empty())
+    return;
+
+  boost::system::error_code ec;
+  boost::filesystem::remove(m_Marker, ec);
+  m_Marker.clear();
+}
+
+mitk::DockerInputStore &mitk::DockerInputStore::GetInstance()
+{
+  static DockerInputStore instance([] {
+    const char *directory = std::getenv("MITK_DOCKER_INPUT_STORE_DIR");
+    return directory && *directory ? boost::filesystem::path(directory)
+                                   : boost::filesystem::path(mitk::IOUtil::GetTempPath()) / "m2_docker_input_store";
+  }());
+  return instance;
+}
+
+bool mitk::DockerInputStore::IsEnabledByEnvironment()
+{
+  const char *enabled = std::getenv("MITK_DOCKER_INPUT_STORE");
+  return enabled && std::string(enabled) == "1";
+}
+
+mitk::DockerInputStore::DockerInputStore(const boost::filesystem::path &directory) : m_Directory(directory)
+{
+  const char *budget = std::getenv("MITK_DOCKER_INPUT_STORE_BUDGET");
+  if (budget && *budget)
+    m_Budget = std::strtoull(budget, nullptr, 10);
+}
+
+void mitk::DockerInputStore::SetDirectory(const boost::filesystem::path &directory)
+{
+  m_Directory = directory;
+}
+
+const boost::filesystem::path &mitk::DockerInputStore::GetDirectory() const
+{
+  return m_Directory;
+}
+
+boost::filesystem::path mitk::DockerInputStore::GetFilesDirectory() const
+{
+  return m_Directory / "files";
+}
+
+boost::filesystem::path mitk::DockerInputStore::GetReferenceDirectory(const std::string &name) const
+{
+  return m_Directory / "references" / name;
+}
+
+mitk::DockerInputStore::Reference mitk::DockerInputStore::CreateReference(const std::string &name)
+{
+  const auto directory = GetReferenceDirectory(name);
+  const auto marker =
+    directory / (GetHostName() + "_" + std::to_string(getpid()) + "_" + std::to_string(m_Counter++));
+  // Evict may remove the empty directory of an evicted file in between
+  for (int attempt = 0; attempt < 3 && !boost::filesystem::exists(marker); ++attempt)
+  {
+    boost::filesystem::create_directories(directory);
+    boost::filesystem::ofstream(marker).close();
+  }
+  if (!boost::filesystem::exists(marker))
+    mitkThrow() << "Could not create the input store reference " << marker;
+  // the modification time of the reference directory is the last use of the file
+  boost::system::error_code ec;
+  boost::filesystem::last_write_time(directory, std::time(nullptr), ec);
+  return Reference(GetFilesDirectory() / name, marker);
+}
+
+mitk::DockerInputStore::Reference mitk::DockerInputStore::Acquire(const std::string &name)
+{
+  // the reference exists before the file is checked, so Evict either sees it or the file is gone
+  auto reference = CreateReference(name);
+  if (!boost::filesystem::exists(reference.GetPath()))
+    reference.Release();
+  return reference;
+}
+
+mitk::DockerInputStore::Reference mitk::DockerInputStore::Deposit(const boost::filesystem::path &file)
+{
+  // a freshly written file: a memoized hash of an earlier file at this path must not be used
+  const auto name = mitk::DockerResultCache::HashFileContent(file) + GetFormat(file);
+  auto reference = Acquire(name);
+  if (reference.IsValid())
+  {
+    boost::filesystem::remove(file);
+    return reference;
+  }
+
+  reference = CreateReference(name);
+  const auto target = reference.GetPath();
+  const auto temporary =
+    GetFilesDirectory() / ("." + name + "." + GetHostName() + "_" + std::to_string(getpid()) + "_" + std::to_string(m_Counter++));
+  boost::filesystem::create_directories(GetFilesDirectory());
+
+  // rename within the file system, copy otherwise; stored files are read-only
+  boost::system::error_code ec;
+  boost::filesystem::rename(file, temporary, ec);
+  if (ec)
+  {
+    boost::filesystem::copy_file(file, temporary);
+    boost::filesystem::remove(file);
+  }
+  boost::filesystem::permissions(temporary,
+                                 boost::filesystem::owner_read | boost::filesystem::group_read | boost::filesystem::others_read,
+                                 ec);
+  // another process may have stored the same content meanwhile, the content is the same
+  boost::filesystem::rename(temporary, target);
+
+  Evict();
+  return reference;
+}
+
+bool mitk::DockerInputStore::IsReferenced(const std::string &name) const
+{
+  const auto host = GetHostName() + "_";
+  bool referenced = false;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(GetReferenceDirectory(name), ec), end; !ec && it != end; it.increment(ec))
+  {
+    const auto marker = it->path().filename().string();
+    // <host>_<pid>_<n>; references of other hosts sharing the directory are kept
+    if (marker.compare(0, host.size(), host) == 0)
+    {
+      const auto pid = std::strtol(marker.c_str() + host.size(), nullptr, 10);
+      if (!IsProcessRunning(pid))
+      {
+        boost::system::error_code removeError;
+        boost::filesystem::remove(it->path(), removeError);
+        continue;
+      }
+    }
+    referenced = true;
+  }
+  return referenced;
+}
+
+void mitk::DockerInputStore::SetBudget(std::uintmax_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Budget = bytes;
+}
+
+std::uintmax_t mitk::DockerInputStore::GetBudget() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Budget;
+}
+
+std::uintmax_t mitk::DockerInputStore::GetUsedBytes() const
+{
+  std::uintmax_t bytes = 0;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(GetFilesDirectory(), ec), end; !ec && it != end; it.increment(ec))
+  {
+    boost::system::error_code sizeError;
+    const auto size = boost::filesystem::file_size(it->path(), sizeError);
+    if (!sizeError)
+      bytes += size;
+  }
+  return bytes;
+}
+
+void mitk::DockerInputStore::Evict()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  struct File
+  {
+    std::string name;
+    std::uintmax_t size;
+    std::time_t lastUse;
+  };
+  std::vector<File> files;
+  std::uintmax_t used = 0;
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(GetFilesDirectory(), ec), end; !ec && it != end; it.increment(ec))
+  {
+    const auto name = it->path().filename().string();
+    boost::system::error_code fileError;
+    const auto size = boost::filesystem::file_size(it->path(), fileError);
+    if (fileError)
+      continue;
+    used += size;
+    // files being stored
+    if (name.front() == '.')
+      continue;
+    auto lastUse = boost::filesystem::last_write_time(GetReferenceDirectory(name), fileError);
+    if (fileError)
+      lastUse = boost::filesystem::last_write_time(it->path(), fileError);
+    files.push_back({name, size, lastUse});
+  }
+  if (used <= m_Budget)
+    return;
+
+  std::sort(files.begin(), files.end(), [](const File &a, const File &b) { return a.lastUse < b.lastUse; });
+  for (const auto &file : files)
+  {
+    if (used <= m_Budget)
+      break;
+    if (IsReferenced(file.name))
+      continue;
+
+    // the file is moved away before the references are checked again, so a reference
+    // created meanwhile either is seen here or finds the file gone (see Acquire)
+    const auto path = GetFilesDirectory() / file.name;
+    const auto evicted = GetFilesDirectory() / ("." + file.name + ".evicted");
+    boost::filesystem::rename(path, evicted, ec);
+    if (ec)
+      continue;
+    if (IsReferenced(file.name))
+    {
+      boost::filesystem::rename(evicted, path, ec);
+      continue;
+    }
+    boost::filesystem::remove(evicted, ec);
+    // only if empty
+    boost::filesystem::remove(GetReferenceDirectory(file.name), ec);
+    used -= std::min(used, file.size);
+    MITK_DEBUG << "Evicted " << file.name << " from the input store";
+  }
+}
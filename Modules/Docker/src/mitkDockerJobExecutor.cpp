@@ -0,0 +1,51 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerJobExecutor.h>
+
+mitk::DockerHelper &mitk::DockerJobExecutor::GetHelper(const DockerJobSpec &spec)
+{
+  if (!m_Helper)
+    m_Helper = std::make_unique<DockerHelper>(spec);
+  return *m_Helper;
+}
+
+mitk::DockerHelper &mitk::DockerJobExecutor::GetHelper()
+{
+  if (!m_Helper)
+    mitkThrow() << "No job was executed yet";
+  return *m_Helper;
+}
+
+std::vector<mitk::BaseData::Pointer> mitk::DockerJobExecutor::Execute(const DockerJobSpec &spec)
+{
+  auto &helper = GetHelper(spec);
+  helper.SetJobSpec(spec);
+  ++m_NumberOfRuns;
+  return helper.GetResults();
+}
+
+mitk::DockerResultManifest mitk::DockerJobExecutor::ExecuteLazily(const DockerJobSpec &spec)
+{
+  auto &helper = GetHelper(spec);
+  helper.SetJobSpec(spec);
+  ++m_NumberOfRuns;
+  return helper.GetResultManifest();
+}
+
+std::size_t mitk::DockerJobExecutor::GetNumberOfRuns() const
+{
+  return m_NumberOfRuns;
+}
@@ -0,0 +1,190 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerJobScheduler.h>
+
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <unistd.h>
+
+mitk::DockerJobScheduler::Admission::Admission(Admission &&other) noexcept
+  : m_Scheduler(other.m_Scheduler), m_Requirements(other.m_Requirements)
+{
+  other.m_Scheduler = nullptr;
+}
+
+mitk::DockerJobScheduler::Admission &mitk::DockerJobScheduler::Admission::operator=(Admission &&other) noexcept
+{
+  if (this != &other)
+  {
+    Release();
+    m_Scheduler = other.m_Scheduler;
+    m_Requirements = other.m_Requirements;
+    other.m_Scheduler = nullptr;
+  }
+  return *this;
+}
+
+mitk::DockerJobScheduler::Admission::~Admission()
+{
+  Release();
+}
+
+void mitk::DockerJobScheduler::Admission::Release()
+{
+  if (m_Scheduler)
+  {
+    m_Scheduler->Release(m_Requirements);
+    m_Scheduler = nullptr;
+  }
+}
+
+mitk::DockerJobScheduler &mitk::DockerJobScheduler::GetInstance()
+{
+  static DockerJobScheduler instance;
+  return instance;
+}
+
+mitk::DockerJobScheduler::DockerJobScheduler()
+{
+  m_CpuBudget = std::max(1u, std::thread::hardware_concurrency());
+
+  const auto pages = sysconf(_SC_PHYS_PAGES);
+  const auto pageSize = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && pageSize > 0)
+    m_MemoryBudget = static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize);
+}
+
+void mitk::DockerJobScheduler::SetBudget(double cpus, std::uint64_t memoryBytes)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_CpuBudget = cpus;
+    m_MemoryBudget = memoryBytes;
+  }
+  m_Changed.notify_all();
+}
+
+double mitk::DockerJobScheduler::GetCpuBudget() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_CpuBudget;
+}
+
+std::uint64_t mitk::DockerJobScheduler::GetMemoryBudget() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MemoryBudget;
+}
+
+bool mitk::DockerJobScheduler::Fits(const Requirements &requirements) const
+{
+  // oversized jobs run alone instead of waiting forever
+  if (m_RunningJobs == 0)
+    return true;
+
+  const bool cpuFits = m_UsedCpus + requirements.cpus <= m_CpuBudget;
+  const bool memoryFits = m_MemoryBudget == 0 || m_UsedMemory + requirements.memoryBytes <= m_MemoryBudget;
+  return cpuFits && memoryFits;
+}
+
+mitk::DockerJobScheduler::Admission mitk::DockerJobScheduler::Acquire(const Requirements &requirements,
+                                                                      std::function<bool()> isCancelled)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  const auto ticket = m_NextTicket++;
+  m_Queue.push_back(ticket);
+
+  if (requirements.cpus > m_CpuBudget || (m_MemoryBudget != 0 && requirements.memoryBytes > m_MemoryBudget))
+    MITK_WARN << "Job requirements exceed the host budget, the job will run exclusively";
+
+  // strict FIFO: only the head of the queue may be admitted
+  while (m_Queue.front() != ticket || !Fits(requirements))
+  {
+    if (isCancelled && isCancelled())
+    {
+      m_Queue.erase(std::find(m_Queue.begin(), m_Queue.end(), ticket));
+      lock.unlock();
+      m_Changed.notify_all();
+      return Admission();
+    }
+    m_Changed.wait_for(lock, std::chrono::milliseconds(100));
+  }
+
+  m_Queue.pop_front();
+  m_UsedCpus += requirements.cpus;
+  m_UsedMemory += requirements.memoryBytes;
+  ++m_RunningJobs;
+
+  const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  ++m_AdmittedJobs;
+  m_LastWaitTime = waited;
+  m_MaxWaitTime = std::max(m_MaxWaitTime, waited);
+  m_TotalWaitTime += waited;
+
+  if (waited.count() > 0)
+    MITK_INFO << "Job admitted after waiting " << waited.count() << " ms";
+
+  lock.unlock();
+
+  // the next job in the queue may fit as well
+  m_Changed.notify_all();
+  return Admission(this, requirements);
+}
+
+void mitk::DockerJobScheduler::Release(const Requirements &requirements)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_UsedCpus = std::max(0.0, m_UsedCpus - requirements.cpus);
+    m_UsedMemory -= std::min(m_UsedMemory, requirements.memoryBytes);
+    if (m_RunningJobs > 0)
+      --m_RunningJobs;
+  }
+  m_Changed.notify_all();
+}
+
+std::size_t mitk::DockerJobScheduler::GetQueueDepth() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Queue.size();
+}
+
+std::size_t mitk::DockerJobScheduler::GetNumberOfRunningJobs() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_RunningJobs;
+}
+
+mitk::DockerJobScheduler::Statistics mitk::DockerJobScheduler::GetStatistics() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Statistics statistics;
+  statistics.queueDepth = m_Queue.size();
+  statistics.runningJobs = m_RunningJobs;
+  statistics.usedCpus = m_UsedCpus;
+  statistics.usedMemoryBytes = m_UsedMemory;
+  statistics.admittedJobs = m_AdmittedJobs;
+  statistics.lastWaitTime = m_LastWaitTime;
+  statistics.maxWaitTime = m_MaxWaitTime;
+  if (m_AdmittedJobs > 0)
+    statistics.averageWaitTime = m_TotalWaitTime / static_cast<long>(m_AdmittedJobs);
+  return statistics;
+}
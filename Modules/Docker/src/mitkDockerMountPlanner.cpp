@@ -0,0 +1,101 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerMountPlanner.h>
+
+#include <algorithm>
+
+namespace
+{
+  boost::filesystem::path CommonAncestor(const boost::filesystem::path &a, const boost::filesystem::path &b)
+  {
+    boost::filesystem::path ancestor;
+    for (auto i = a.begin(), j = b.begin(); i != a.end() && j != b.end() && *i == *j; ++i, ++j)
+      ancestor /= *i;
+    return ancestor;
+  }
+} // namespace
+
+bool mitk::DockerMountPlanner::IsWithin(const boost::filesystem::path &path, const boost::filesystem::path &directory)
+{
+  auto i = path.begin();
+  for (auto j = directory.begin(); j != directory.end(); ++i, ++j)
+  {
+    if (i == path.end() || *i != *j)
+      return false;
+  }
+  return true;
+}
+
+std::size_t mitk::DockerMountPlanner::GetDepth(const boost::filesystem::path &path)
+{
+  std::size_t depth = 0;
+  for (const auto &element : path.relative_path())
+    if (!element.empty() && element != ".")
+      ++depth;
+  return depth;
+}
+
+std::vector<boost::filesystem::path> mitk::DockerMountPlanner::Plan(const std::vector<boost::filesystem::path> &directories,
+                                                                    std::size_t maxMounts,
+                                                                    std::size_t minDepth)
+{
+  std::vector<boost::filesystem::path> sorted;
+  sorted.reserve(directories.size());
+  for (const auto &directory : directories)
+  {
+    auto normal = directory.lexically_normal();
+    // "/data/x/" is normalized to "/data/x/."
+    if (normal.filename() == ".")
+      normal.remove_filename();
+    sorted.push_back(normal);
+  }
+  // element-wise order: every directory is directly followed by the directories below it
+  std::sort(sorted.begin(), sorted.end());
+
+  auto collapse = [](const std::vector<boost::filesystem::path> &input) {
+    std::vector<boost::filesystem::path> output;
+    for (const auto &directory : input)
+      if (output.empty() || !IsWithin(directory, output.back()))
+        output.push_back(directory);
+    return output;
+  };
+
+  auto mounts = collapse(sorted);
+  while (maxMounts > 0 && mounts.size() > maxMounts)
+  {
+    // the deepest common ancestor is found among neighbors
+    boost::filesystem::path best;
+    std::size_t bestDepth = 0;
+    for (std::size_t i = 1; i < mounts.size(); ++i)
+    {
+      const auto ancestor = CommonAncestor(mounts[i - 1], mounts[i]);
+      const auto depth = GetDepth(ancestor);
+      if (depth >= minDepth && depth > bestDepth)
+      {
+        best = ancestor;
+        bestDepth = depth;
+      }
+    }
+    if (best.empty())
+      break;
+
+    std::vector<boost::filesystem::path> merged;
+    for (const auto &mount : mounts)
+      merged.push_back(IsWithin(mount, best) ? best : mount);
+    mounts = collapse(merged);
+  }
+  return mounts;
+}
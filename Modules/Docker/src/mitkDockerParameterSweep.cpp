@@ -0,0 +1,212 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerParameterSweep.h>
+#include <mitkDockerJobSpec.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+void mitk::DockerParameterSweep::AddVariant(const std::string &name, const std::vector<std::string> &arguments)
+{
+  const auto it = std::find_if(m_Variants.begin(), m_Variants.end(), [&name](const Variant &v) { return v.name == name; });
+  if (it != m_Variants.end())
+    mitkThrow() << "Variant [" << name << "] was already added";
+  m_Variants.push_back({name, arguments});
+}
+
+void mitk::DockerParameterSweep::AddGrid(const std::vector<std::pair<std::string, std::vector<std::string>>> &parameters)
+{
+  if (parameters.empty())
+    return;
+  for (const auto &parameter : parameters)
+    if (parameter.second.empty())
+      mitkThrow() << "No values given for parameter [" << parameter.first << "]";
+
+  // odometer over the value indices, the last parameter changes fastest
+  std::vector<std::size_t> index(parameters.size(), 0);
+  while (true)
+  {
+    std::string name;
+    std::vector<std::string> arguments;
+    for (std::size_t i = 0; i < parameters.size(); ++i)
+    {
+      const auto &value = parameters[i].second[index[i]];
+      name += (i ? "," : "") + parameters[i].first + "=" + value;
+      arguments.push_back(parameters[i].first);
+      arguments.push_back(value);
+    }
+    AddVariant(name, arguments);
+
+    auto i = parameters.size();
+    while (i > 0 && ++index[i - 1] == parameters[i - 1].second.size())
+      index[--i] = 0;
+    if (i == 0)
+      break;
+  }
+}
+
+const std::vector<mitk::DockerParameterSweep::Variant> &mitk::DockerParameterSweep::GetVariants() const
+{
+  return m_Variants;
+}
+
+void mitk::DockerParameterSweep::SetMaxParallelVariants(unsigned int value)
+{
+  m_MaxParallelVariants = value;
+}
+
+void mitk::DockerParameterSweep::StageSharedInputs()
+{
+  CreateWorkingDirectory();
+  GenerateSaveDataInfoAndSaveData();
+  RemoveUnusedStagedFiles();
+
+  // the variants only read the staged inputs
+  m_DockerArguments.push_back("-v");
+  m_DockerArguments.push_back(m_WorkingDirectory.string() + ":/" + Replace(m_ContainerWorkingDirectory.string(), '\\', '/') + ":ro");
+}
+
+mitk::DockerParameterSweep::VariantResult mitk::DockerParameterSweep::RunVariant(const Variant &variant)
+{
+  VariantResult result;
+  result.variant = variant;
+
+  auto spec = GetJobSpec();
+  spec.inputs.clear();
+  spec.runArguments.insert(spec.runArguments.end(), m_DockerArguments.begin(), m_DockerArguments.end());
+  spec.applicationArguments.insert(spec.applicationArguments.end(), m_ProgramArguments.begin(), m_ProgramArguments.end());
+  spec.applicationArguments.insert(spec.applicationArguments.end(), variant.arguments.begin(), variant.arguments.end());
+  // removed once after all variants
+  spec.autoRemoveImage = false;
+
+  DockerHelper helper(spec);
+  helper.SetRunTimeout(m_RunTimeout);
+  helper.SetStallTimeout(m_StallTimeout);
+  helper.SetStopGracePeriod(m_StopGracePeriod);
+  helper.SetBackend(m_Backend);
+  helper.EnableJobScheduler(m_UseJobScheduler);
+  if (m_ResourceRequirementsSet)
+    helper.SetResourceRequirements(m_ResourceRequirements.cpus, m_ResourceRequirements.memoryBytes);
+  helper.SetScratchPolicy(m_ScratchPolicy);
+  helper.EnableResourceSampling(m_SampleResources, m_SampleInterval);
+  helper.EnableRunReportFile(m_WriteRunReportFile);
+  helper.KeepWorkingDirectory(m_KeepWorkingDirectory);
+
+  {
+    std::lock_guard<std::mutex> lock(m_VariantHelpersMutex);
+    m_VariantHelpers.insert(&helper);
+  }
+  try
+  {
+    result.data = helper.GetResults();
+  }
+  catch (const std::exception &e)
+  {
+    result.error = e.what();
+    MITK_ERROR << "Variant [" << variant.name << "] failed: " << e.what();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_VariantHelpersMutex);
+    m_VariantHelpers.erase(&helper);
+  }
+  result.report = helper.GetRunReport();
+  return result;
+}
+
+std::map<std::string, mitk::DockerParameterSweep::VariantResult> mitk::DockerParameterSweep::RunSweep()
+{
+  if (m_Variants.empty())
+    mitkThrow() << "No variants added to the sweep";
+
+  ResetRunState();
+  m_HasRun = true;
+  BeginRunReport();
+
+  std::map<std::string, VariantResult> results;
+  try
+  {
+    if (!CanRunDocker())
+      mitkThrow() << "No Docker instance found!";
+
+    ReportProgress(Phase::Staging, "Save input data");
+    ThrowIfCancelled();
+    StageSharedInputs();
+    AccountStagedFiles();
+
+    const auto parallel = std::min<std::size_t>(
+      m_MaxParallelVariants ? m_MaxParallelVariants : std::max(1u, std::thread::hardware_concurrency()), m_Variants.size());
+    ReportProgress(Phase::Running, "Run " + std::to_string(m_Variants.size()) + " variants of " + m_ImageName);
+
+    std::mutex resultsMutex;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < parallel; ++i)
+    {
+      workers.emplace_back([&]() {
+        for (auto index = next++; index < m_Variants.size() && !IsCancelled(); index = next++)
+        {
+          auto result = RunVariant(m_Variants[index]);
+          std::lock_guard<std::mutex> lock(resultsMutex);
+          results[m_Variants[index].name] = std::move(result);
+        }
+        ++done;
+      });
+    }
+
+    // Cancel() of the sweep stops the running variants
+    while (done < workers.size())
+    {
+      if (IsCancelled())
+      {
+        std::lock_guard<std::mutex> lock(m_VariantHelpersMutex);
+        for (auto *helper : m_VariantHelpers)
+          helper->Cancel();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    for (auto &worker : workers)
+      worker.join();
+    ThrowIfCancelled();
+
+    ReportProgress(Phase::Loading, "Collect results");
+    for (const auto &kv : results)
+    {
+      m_OutputData.insert(m_OutputData.end(), kv.second.data.begin(), kv.second.data.end());
+      m_RunReport.loadingBytesRead += kv.second.report.loadingBytesRead;
+      m_RunReport.loadingFilesRead += kv.second.report.loadingFilesRead;
+    }
+
+    if (m_AutoRemoveImage)
+      RemoveImage({m_ImageName});
+  }
+  catch (const mitk::DockerCancelledException &)
+  {
+    CleanUpAfterCancel();
+    ReportProgress(Phase::Cancelled, "Cancelled");
+    throw;
+  }
+  catch (const std::exception &e)
+  {
+    ReportProgress(Phase::Failed, e.what());
+    throw;
+  }
+
+  const auto failed = std::count_if(results.begin(), results.end(), [](const auto &kv) { return !kv.second.Succeeded(); });
+  ReportProgress(Phase::Finished, std::to_string(results.size() - failed) + " of " + std::to_string(results.size()) + " variants finished");
+  return results;
+}
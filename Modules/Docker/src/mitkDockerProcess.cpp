@@ -0,0 +1,157 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerProcess.h>
+
+#include <Poco/Pipe.h>
+#include <Poco/Process.h>
+
+#include <mitkExceptionMacro.h>
+
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+  std::mutex s_ExecutableMutex;
+  std::string s_Executable;
+
+  std::string GetDefaultExecutable()
+  {
+    const char *executable = std::getenv("MITK_DOCKER_EXECUTABLE");
+    return executable && *executable ? executable : "docker";
+  }
+} // namespace
+
+mitk::DockerProcess::DockerProcess(const std::vector<std::string> &args) : m_Args(args)
+{
+}
+
+mitk::DockerProcess::~DockerProcess()
+{
+  if (m_Handle)
+  {
+    if (IsRunning())
+      Kill();
+    Wait();
+  }
+}
+
+void mitk::DockerProcess::SetLineCallback(LineCallback callback)
+{
+  m_LineCallback = callback;
+}
+
+void mitk::DockerProcess::Start()
+{
+  if (m_Handle)
+    mitkThrow() << "Docker process was already started";
+
+  m_OutPipe.reset(new Poco::Pipe);
+  m_ErrPipe.reset(new Poco::Pipe);
+  m_Handle.reset(new Poco::ProcessHandle(Poco::Process::launch(GetExecutable(), m_Args, nullptr, m_OutPipe.get(), m_ErrPipe.get())));
+  m_ProcessId = m_Handle->id();
+
+  m_OutReader = std::thread([this]() { ReadLines(*m_OutPipe, Stream::StdOut); });
+  m_ErrReader = std::thread([this]() { ReadLines(*m_ErrPipe, Stream::StdErr); });
+}
+
+void mitk::DockerProcess::ReadLines(Poco::Pipe &pipe, Stream stream)
+{
+  std::string buffer;
+  char chunk[4096];
+  int n;
+  while ((n = pipe.readBytes(chunk, sizeof(chunk))) > 0)
+  {
+    buffer.append(chunk, n);
+    std::string::size_type pos;
+    while ((pos = buffer.find_first_of("\r\n")) != std::string::npos)
+    {
+      // progress bars use carriage returns to redraw a line
+      const auto line = buffer.substr(0, pos);
+      buffer.erase(0, pos + 1);
+      if (!line.empty() && m_LineCallback)
+        m_LineCallback(stream, line);
+    }
+  }
+
+  if (!buffer.empty() && m_LineCallback)
+    m_LineCallback(stream, buffer);
+}
+
+int mitk::DockerProcess::Wait()
+{
+  if (!m_Handle)
+    mitkThrow() << "Docker process was not started";
+
+  if (m_OutReader.joinable() || m_ErrReader.joinable())
+  {
+    m_ExitCode = m_Handle->wait();
+    m_Finished = true;
+    if (m_OutReader.joinable())
+      m_OutReader.join();
+    if (m_ErrReader.joinable())
+      m_ErrReader.join();
+  }
+  return m_ExitCode;
+}
+
+long mitk::DockerProcess::GetProcessId() const
+{
+  return m_ProcessId;
+}
+
+bool mitk::DockerProcess::IsRunning() const
+{
+  return m_ProcessId != 0 && !m_Finished && Poco::Process::isRunning(m_ProcessId);
+}
+
+void mitk::DockerProcess::Kill()
+{
+  if (IsRunning())
+    Poco::Process::kill(m_ProcessId);
+}
+
+int mitk::DockerProcess::Execute(const std::vector<std::string> &args, std::string *output)
+{
+  DockerProcess process(args);
+  if (output)
+  {
+    output->clear();
+    process.SetLineCallback([output](Stream stream, const std::string &line) {
+      if (stream == Stream::StdOut)
+        *output += line + "\n";
+    });
+  }
+  process.Start();
+  return process.Wait();
+}
+
+void mitk::DockerProcess::SetExecutable(const std::string &executable)
+{
+  std::lock_guard<std::mutex> lock(s_ExecutableMutex);
+  s_Executable = executable;
+}
+
+std::string mitk::DockerProcess::GetExecutable()
+{
+  std::lock_guard<std::mutex> lock(s_ExecutableMutex);
+  return s_Executable.empty() ? GetDefaultExecutable() : s_Executable;
+}
+
+bool mitk::DockerProcess::HasCustomExecutable()
+{
+  return GetExecutable() != "docker";
+}
@@ -0,0 +1,229 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResourceLimits.h>
+
+#include <mitkExceptionMacro.h>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace
+{
+  // smallest memory limit accepted by docker
+  const std::uint64_t MinimumMemoryBytes = 6 * 1024 * 1024;
+
+  unsigned int GetNumberOfHostCpus()
+  {
+    const auto n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned int>(n) : std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::uint64_t GetHostMemory()
+  {
+    const auto pages = sysconf(_SC_PHYS_PAGES);
+    const auto pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0)
+      return static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize);
+    return 0;
+  }
+} // namespace
+
+bool mitk::DockerResourceLimits::IsEmpty() const
+{
+  return cpus == 0.0 && cpusetCpus.empty() && memoryBytes == 0 && memorySwapBytes == 0 && shmSizeBytes == 0 &&
+         !hostIpc && pidsLimit == 0 && tmpfs.empty();
+}
+
+std::vector<unsigned int> mitk::DockerResourceLimits::ParseCpuSet(const std::string &cpuset)
+{
+  std::set<unsigned int> cpuIds;
+  std::istringstream list(cpuset);
+  std::string item;
+  while (std::getline(list, item, ','))
+  {
+    const auto dash = item.find('-');
+    try
+    {
+      std::size_t pos = 0;
+      if (dash == std::string::npos)
+      {
+        const auto id = std::stoul(item, &pos);
+        if (pos != item.size())
+          throw std::invalid_argument(item);
+        cpuIds.insert(static_cast<unsigned int>(id));
+      }
+      else
+      {
+        const auto first = std::stoul(item.substr(0, dash), &pos);
+        if (pos != dash)
+          throw std::invalid_argument(item);
+        const auto lastString = item.substr(dash + 1);
+        const auto last = std::stoul(lastString, &pos);
+        if (pos != lastString.size() || last < first)
+          throw std::invalid_argument(item);
+        for (auto id = first; id <= last; ++id)
+          cpuIds.insert(static_cast<unsigned int>(id));
+      }
+    }
+    catch (const std::logic_error &)
+    {
+      mitkThrow() << "Invalid cpuset [" << cpuset << "]: expected a list like \"0-3,6\"";
+    }
+  }
+
+  if (cpuIds.empty())
+    mitkThrow() << "Invalid cpuset [" << cpuset << "]: no CPU given";
+
+  return std::vector<unsigned int>(cpuIds.begin(), cpuIds.end());
+}
+
+double mitk::DockerResourceLimits::GetEffectiveCpus() const
+{
+  double result = cpus;
+  if (!cpusetCpus.empty())
+  {
+    const double setSize = static_cast<double>(ParseCpuSet(cpusetCpus).size());
+    result = result > 0 ? std::min(result, setSize) : setSize;
+  }
+  return result;
+}
+
+void mitk::DockerResourceLimits::Validate() const
+{
+  const auto hostCpus = GetNumberOfHostCpus();
+  if (cpus < 0)
+    mitkThrow() << "The CPU quota must not be negative";
+  if (cpus > hostCpus)
+    mitkThrow() << "The CPU quota " << cpus << " exceeds the " << hostCpus << " CPUs of the host";
+
+  if (!cpusetCpus.empty())
+  {
+    const auto cpuIds = ParseCpuSet(cpusetCpus);
+    if (cpuIds.back() >= hostCpus)
+      mitkThrow() << "The cpuset [" << cpusetCpus << "] refers to CPU " << cpuIds.back() << " but the host has "
+                  << hostCpus << " CPUs";
+  }
+
+  if (memoryBytes != 0 && memoryBytes < MinimumMemoryBytes)
+    mitkThrow() << "The memory limit must be at least " << MinimumMemoryBytes << " bytes";
+
+  const auto hostMemory = GetHostMemory();
+  if (memoryBytes != 0 && hostMemory != 0 && memoryBytes > hostMemory)
+    mitkThrow() << "The memory limit of " << memoryBytes << " bytes exceeds the physical memory of the host ("
+                << hostMemory << " bytes)";
+
+  if (memorySwapBytes != 0)
+  {
+    if (memoryBytes == 0)
+      mitkThrow() << "A memory-swap limit requires a memory limit";
+    if (memorySwapBytes < -1)
+      mitkThrow() << "The memory-swap limit must be -1 (unlimited) or a number of bytes";
+    if (memorySwapBytes > 0 && static_cast<std::uint64_t>(memorySwapBytes) < memoryBytes)
+      mitkThrow() << "The memory-swap limit includes the memory limit and must not be smaller than it";
+  }
+
+  if (hostIpc && shmSizeBytes != 0)
+    mitkThrow() << "A shm size cannot be set if the IPC namespace of the host is shared";
+
+  if (pidsLimit < -1)
+    mitkThrow() << "The pids limit must be -1 (unlimited) or positive";
+
+  std::set<std::string> tmpfsPaths;
+  for (const auto &mount : tmpfs)
+  {
+    if (mount.containerPath.empty() || mount.containerPath.front() != '/')
+      mitkThrow() << "The tmpfs path [" << mount.containerPath << "] has to be absolute";
+    if (mount.containerPath.find_first_of(":,") != std::string::npos)
+      mitkThrow() << "The tmpfs path [" << mount.containerPath << "] must not contain ':' or ','";
+    if (!tmpfsPaths.insert(mount.containerPath).second)
+      mitkThrow() << "The tmpfs path [" << mount.containerPath << "] is mounted twice";
+  }
+}
+
+std::vector<std::string> mitk::DockerResourceLimits::ToRunArguments() const
+{
+  std::vector<std::string> args;
+  if (cpus > 0)
+  {
+    std::ostringstream value;
+    value << cpus;
+    args.push_back("--cpus");
+    args.push_back(value.str());
+  }
+  if (!cpusetCpus.empty())
+  {
+    args.push_back("--cpuset-cpus");
+    args.push_back(cpusetCpus);
+  }
+  if (memoryBytes != 0)
+  {
+    args.push_back("--memory");
+    args.push_back(std::to_string(memoryBytes));
+  }
+  if (memorySwapBytes != 0)
+  {
+    args.push_back("--memory-swap");
+    args.push_back(std::to_string(memorySwapBytes));
+  }
+  if (shmSizeBytes != 0)
+  {
+    args.push_back("--shm-size");
+    args.push_back(std::to_string(shmSizeBytes));
+  }
+  if (hostIpc)
+  {
+    args.push_back("--ipc");
+    args.push_back("host");
+  }
+  if (pidsLimit != 0)
+  {
+    args.push_back("--pids-limit");
+    args.push_back(std::to_string(pidsLimit));
+  }
+  for (const auto &mount : tmpfs)
+  {
+    args.push_back("--tmpfs");
+    args.push_back(mount.sizeBytes ? mount.containerPath + ":size=" + std::to_string(mount.sizeBytes)
+                                   : mount.containerPath);
+  }
+  return args;
+}
+
+nlohmann::json mitk::DockerResourceLimits::ToJson() const
+{
+  nlohmann::json limits = nlohmann::json::object();
+  if (cpus > 0)
+    limits["cpus"] = cpus;
+  if (!cpusetCpus.empty())
+    limits["cpusetCpus"] = cpusetCpus;
+  if (memoryBytes != 0)
+    limits["memoryBytes"] = memoryBytes;
+  if (memorySwapBytes != 0)
+    limits["memorySwapBytes"] = memorySwapBytes;
+  if (shmSizeBytes != 0)
+    limits["shmSizeBytes"] = shmSizeBytes;
+  if (hostIpc)
+    limits["hostIpc"] = true;
+  if (pidsLimit != 0)
+    limits["pidsLimit"] = pidsLimit;
+  for (const auto &mount : tmpfs)
+    limits["tmpfs"].push_back({{"containerPath", mount.containerPath}, {"sizeBytes", mount.sizeBytes}});
+  return limits;
+}
@@ -0,0 +1,285 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResourceSampler.h>
+
+#include <mitkDockerEngineClient.h>
+#include <mitkDockerProcess.h>
+#include <mitkExceptionMacro.h>
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace
+{
+  bool ReadNumber(const boost::filesystem::path &file, std::uint64_t &value)
+  {
+    boost::filesystem::ifstream stream(file);
+    return static_cast<bool>(stream >> value);
+  }
+
+  // "key value" lines of cpu.stat
+  std::uint64_t ReadKey(const boost::filesystem::path &file, const std::string &key)
+  {
+    boost::filesystem::ifstream stream(file);
+    std::string name;
+    std::uint64_t value = 0;
+    while (stream >> name >> value)
+      if (name == key)
+        return value;
+    return 0;
+  }
+} // namespace
+
+void mitk::DockerResourceUsage::Merge(const DockerResourceUsage &sample)
+{
+  if (source.empty())
+    source = sample.source;
+  ++samples;
+  peakMemoryBytes = std::max(peakMemoryBytes, sample.peakMemoryBytes);
+  cpuSeconds = std::max(cpuSeconds, sample.cpuSeconds);
+  blockReadBytes = std::max(blockReadBytes, sample.blockReadBytes);
+  blockWriteBytes = std::max(blockWriteBytes, sample.blockWriteBytes);
+  throttledPeriods = std::max(throttledPeriods, sample.throttledPeriods);
+  throttledSeconds = std::max(throttledSeconds, sample.throttledSeconds);
+}
+
+nlohmann::json mitk::DockerResourceUsage::ToJson() const
+{
+  return {{"source", source},
+          {"samples", samples},
+          {"peakMemoryBytes", peakMemoryBytes},
+          {"cpuSeconds", cpuSeconds},
+          {"blockReadBytes", blockReadBytes},
+          {"blockWriteBytes", blockWriteBytes},
+          {"throttledPeriods", throttledPeriods},
+          {"throttledSeconds", throttledSeconds}};
+}
+
+mitk::DockerResourceSampler::DockerResourceSampler(const std::string &containerName,
+                                                   std::chrono::milliseconds interval)
+  : m_ContainerName(containerName), m_Interval(interval)
+{
+}
+
+mitk::DockerResourceSampler::~DockerResourceSampler()
+{
+  Stop();
+}
+
+void mitk::DockerResourceSampler::Start()
+{
+  Stop();
+  m_Stop = false;
+  m_Thread = std::thread([this]() {
+    m_UseEngineApi = !mitk::DockerProcess::HasCustomExecutable() && mitk::DockerEngineClient().IsAvailable();
+
+    // the container is looked up more often than sampled, it may not exist yet
+    const auto lookupInterval = std::min(m_Interval, std::chrono::milliseconds(250));
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (!m_Stop)
+    {
+      lock.unlock();
+      if (m_ContainerId.empty())
+      {
+        m_ContainerId = ResolveContainerId();
+        if (!m_ContainerId.empty())
+          m_CgroupDirectory = FindCgroupDirectory(m_ContainerId);
+      }
+      if (!m_ContainerId.empty())
+        Sample();
+      lock.lock();
+
+      m_Condition.wait_for(lock, m_ContainerId.empty() ? lookupInterval : m_Interval);
+    }
+  });
+}
+
+void mitk::DockerResourceSampler::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Condition.notify_all();
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+mitk::DockerResourceUsage mitk::DockerResourceSampler::GetUsage() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Usage;
+}
+
+void mitk::DockerResourceSampler::Sample()
+{
+  DockerResourceUsage sample;
+  if (!m_CgroupDirectory.empty() && ReadCgroup(m_CgroupDirectory, sample))
+  {
+    sample.source = "cgroup-v2";
+  }
+  else if (m_UseEngineApi)
+  {
+    try
+    {
+      ParseEngineStats(mitk::DockerEngineClient().GetContainerStats(m_ContainerId), sample);
+      sample.source = "engine-api";
+    }
+    catch (const std::exception &e)
+    {
+      MITK_DEBUG << "Could not sample container " << m_ContainerName << ": " << e.what();
+      return;
+    }
+  }
+  else
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Usage.Merge(sample);
+}
+
+std::string mitk::DockerResourceSampler::ResolveContainerId() const
+{
+  if (m_UseEngineApi)
+  {
+    try
+    {
+      return mitk::DockerEngineClient().InspectContainer(m_ContainerName).value("Id", "");
+    }
+    catch (const std::exception &)
+    {
+      return "";
+    }
+  }
+
+  std::string output;
+  if (mitk::DockerProcess::Execute({"inspect", "--format", "{{.Id}}", m_ContainerName}, &output) != 0)
+    return "";
+  boost::algorithm::trim(output);
+  return output;
+}
+
+boost::filesystem::path mitk::DockerResourceSampler::FindCgroupDirectory(const std::string &containerId,
+                                                                        const boost::filesystem::path &cgroupRoot)
+{
+  // cgroup v1 hierarchies are not supported
+  if (containerId.empty() || !boost::filesystem::exists(cgroupRoot / "cgroup.controllers"))
+    return {};
+
+  for (const auto &candidate : {cgroupRoot / "system.slice" / ("docker-" + containerId + ".scope"),
+                                cgroupRoot / "docker" / containerId})
+  {
+    if (boost::filesystem::is_directory(candidate))
+      return candidate;
+  }
+
+  // rootless daemons and custom parents place the scope deeper in the hierarchy
+  const std::string scopeName = "docker-" + containerId + ".scope";
+  std::vector<boost::filesystem::path> level = {cgroupRoot};
+  for (int depth = 0; depth < 6 && !level.empty(); ++depth)
+  {
+    std::vector<boost::filesystem::path> nextLevel;
+    for (const auto &directory : level)
+    {
+      boost::system::error_code ec;
+      for (boost::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+      {
+        if (!boost::filesystem::is_directory(it->path()))
+          continue;
+        const auto name = it->path().filename().string();
+        if (name == scopeName || name == containerId)
+          return it->path();
+        nextLevel.push_back(it->path());
+      }
+    }
+    level.swap(nextLevel);
+  }
+  return {};
+}
+
+bool mitk::DockerResourceSampler::ReadCgroup(const boost::filesystem::path &directory, DockerResourceUsage &sample)
+{
+  std::uint64_t memory = 0;
+  if (!ReadNumber(directory / "memory.peak", memory) && !ReadNumber(directory / "memory.current", memory))
+    return false;
+  sample.peakMemoryBytes = memory;
+
+  const auto cpuStat = directory / "cpu.stat";
+  sample.cpuSeconds = ReadKey(cpuStat, "usage_usec") / 1e6;
+  sample.throttledPeriods = ReadKey(cpuStat, "nr_throttled");
+  sample.throttledSeconds = ReadKey(cpuStat, "throttled_usec") / 1e6;
+
+  // "<major>:<minor> rbytes=... wbytes=... rios=... ..." per device
+  boost::filesystem::ifstream ioStat(directory / "io.stat");
+  std::string line;
+  while (std::getline(ioStat, line))
+  {
+    std::istringstream fields(line);
+    std::string field;
+    while (fields >> field)
+    {
+      const auto separator = field.find('=');
+      if (separator == std::string::npos)
+        continue;
+      const auto key = field.substr(0, separator);
+      const auto value = std::strtoull(field.c_str() + separator + 1, nullptr, 10);
+      if (key == "rbytes")
+        sample.blockReadBytes += value;
+      else if (key == "wbytes")
+        sample.blockWriteBytes += value;
+    }
+  }
+  return true;
+}
+
+void mitk::DockerResourceSampler::ParseEngineStats(const nlohmann::json &stats, DockerResourceUsage &sample)
+{
+  const auto memoryStats = stats.value("memory_stats", nlohmann::json::object());
+  // max_usage is only reported on cgroup v1 hosts
+  sample.peakMemoryBytes = std::max(memoryStats.value("max_usage", std::uint64_t(0)),
+                                    memoryStats.value("usage", std::uint64_t(0)));
+
+  const auto cpuStats = stats.value("cpu_stats", nlohmann::json::object());
+  if (cpuStats.contains("cpu_usage"))
+    sample.cpuSeconds = cpuStats["cpu_usage"].value("total_usage", std::uint64_t(0)) / 1e9;
+  if (cpuStats.contains("throttling_data"))
+  {
+    sample.throttledPeriods = cpuStats["throttling_data"].value("throttled_periods", std::uint64_t(0));
+    sample.throttledSeconds = cpuStats["throttling_data"].value("throttled_time", std::uint64_t(0)) / 1e9;
+  }
+
+  const auto blkioStats = stats.value("blkio_stats", nlohmann::json::object());
+  const auto ioBytes = blkioStats.find("io_service_bytes_recursive");
+  if (ioBytes != blkioStats.end() && ioBytes->is_array())
+  {
+    for (const auto &entry : *ioBytes)
+    {
+      auto op = entry.value("op", "");
+      std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+      if (op == "read")
+        sample.blockReadBytes += entry.value("value", std::uint64_t(0));
+      else if (op == "write")
+        sample.blockWriteBytes += entry.value("value", std::uint64_t(0));
+    }
+  }
+}
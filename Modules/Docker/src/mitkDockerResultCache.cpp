@@ -0,0 +1,395 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResultCache.h>
+
+#include <Poco/SHA2Engine.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // a rewrite changes the modification or status change time (nanoseconds) or, if the file
+  // was replaced, the inode
+  mitk::DockerResultCache::FileIdentity GetFileIdentity(const struct stat &status)
+  {
+#ifdef __APPLE__
+    const auto &modified = status.st_mtimespec;
+    const auto &changed = status.st_ctimespec;
+#else
+    const auto &modified = status.st_mtim;
+    const auto &changed = status.st_ctim;
+#endif
+    return {static_cast<std::uint64_t>(status.st_dev),
+            static_cast<std::uint64_t>(status.st_ino),
+            static_cast<std::uint64_t>(status.st_size),
+            static_cast<std::int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec,
+            static_cast<std::int64_t>(changed.tv_sec) * 1000000000 + changed.tv_nsec};
+  }
+
+  // hard links the file (the cache and the working directories are usually on one file system) or copies it
+  void LinkOrCopy(const boost::filesystem::path &source, const boost::filesystem::path &target)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(target, ec);
+    boost::filesystem::create_hard_link(source, target, ec);
+    if (ec)
+      boost::filesystem::copy_file(source, target);
+  }
+
+  // mirrors the files of source (file or directory) to target
+  void LinkOrCopyTree(const boost::filesystem::path &source, const boost::filesystem::path &target)
+  {
+    if (!boost::filesystem::is_directory(source))
+    {
+      boost::filesystem::create_directories(target.parent_path());
+      LinkOrCopy(source, target);
+      return;
+    }
+
+    boost::filesystem::create_directories(target);
+    for (boost::filesystem::recursive_directory_iterator it(source), end; it != end; ++it)
+    {
+      const auto relativePath = boost::filesystem::relative(it->path(), source);
+      if (boost::filesystem::is_directory(it->path()))
+        boost::filesystem::create_directories(target / relativePath);
+      else if (boost::filesystem::is_regular_file(it->path()))
+        LinkOrCopy(it->path(), target / relativePath);
+    }
+  }
+
+  std::uintmax_t GetTreeSize(const boost::filesystem::path &directory)
+  {
+    std::uintmax_t size = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+      if (boost::filesystem::is_regular_file(it->path()))
+        size += boost::filesystem::file_size(it->path(), ec);
+    }
+    return size;
+  }
+} // namespace
+
+mitk::DockerResultCache::Claim::Claim(Claim &&other) noexcept : m_Cache(other.m_Cache), m_Key(std::move(other.m_Key))
+{
+  other.m_Cache = nullptr;
+}
+
+mitk::DockerResultCache::Claim &mitk::DockerResultCache::Claim::operator=(Claim &&other) noexcept
+{
+  if (this != &other)
+  {
+    Release();
+    m_Cache = other.m_Cache;
+    m_Key = std::move(other.m_Key);
+    other.m_Cache = nullptr;
+  }
+  return *this;
+}
+
+mitk::DockerResultCache::Claim::~Claim()
+{
+  Release();
+}
+
+void mitk::DockerResultCache::Claim::Release()
+{
+  if (m_Cache)
+  {
+    m_Cache->ReleaseKey(m_Key);
+    m_Cache = nullptr;
+  }
+}
+
+mitk::DockerResultCache &mitk::DockerResultCache::GetInstance()
+{
+  static DockerResultCache instance;
+  return instance;
+}
+
+mitk::DockerResultCache::DockerResultCache()
+{
+  const char *directory = std::getenv("MITK_DOCKER_CACHE_DIR");
+  if (directory && *directory)
+    m_Directory = directory;
+  else
+    m_Directory = boost::filesystem::temp_directory_path() / "m2_docker_result_cache";
+}
+
+void mitk::DockerResultCache::SetDirectory(const boost::filesystem::path &directory)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Directory = directory;
+}
+
+boost::filesystem::path mitk::DockerResultCache::GetDirectory() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Directory;
+}
+
+void mitk::DockerResultCache::SetMaxSize(std::uintmax_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MaxSize = bytes;
+}
+
+std::uintmax_t mitk::DockerResultCache::GetMaxSize() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MaxSize;
+}
+
+boost::filesystem::path mitk::DockerResultCache::GetEntryDirectory(const std::string &key) const
+{
+  return GetDirectory() / key;
+}
+
+mitk::DockerResultCache::Claim mitk::DockerResultCache::ClaimKey(const std::string &key,
+                                                                 std::function<bool()> isCancelled)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  if (m_ClaimedKeys.count(key))
+  {
+    ++m_Statistics.coalesced;
+    MITK_INFO << "Waiting for a running job with the same inputs";
+  }
+
+  while (m_ClaimedKeys.count(key))
+  {
+    if (isCancelled && isCancelled())
+      return Claim();
+    m_Released.wait_for(lock, std::chrono::milliseconds(100));
+  }
+
+  m_ClaimedKeys.insert(key);
+  return Claim(this, key);
+}
+
+void mitk::DockerResultCache::ReleaseKey(const std::string &key)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_ClaimedKeys.erase(key);
+  }
+  m_Released.notify_all();
+}
+
+bool mitk::DockerResultCache::Contains(const std::string &key) const
+{
+  return boost::filesystem::exists(GetEntryDirectory(key) / "entry.json");
+}
+
+bool mitk::DockerResultCache::Restore(const std::string &key, const boost::filesystem::path &directory)
+{
+  const auto entryDirectory = GetEntryDirectory(key);
+  if (!Contains(key))
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_Statistics.misses;
+    return false;
+  }
+
+  try
+  {
+    const auto outputDirectory = entryDirectory / "outputs";
+    if (boost::filesystem::exists(outputDirectory))
+      LinkOrCopyTree(outputDirectory, directory);
+
+    // the modification time of entry.json orders the entries for eviction
+    boost::filesystem::last_write_time(entryDirectory / "entry.json", std::time(nullptr));
+  }
+  catch (const boost::filesystem::filesystem_error &e)
+  {
+    MITK_WARN << "Could not restore result cache entry " << key << ": " << e.what();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_Statistics.misses;
+    return false;
+  }
+
+  MITK_INFO << "Restored results from cache entry " << key;
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  ++m_Statistics.hits;
+  return true;
+}
+
+void mitk::DockerResultCache::Store(const std::string &key,
+                                    const boost::filesystem::path &directory,
+                                    const std::vector<std::string> &outputPaths)
+{
+  const auto entryDirectory = GetEntryDirectory(key);
+  if (Contains(key))
+    return;
+
+  std::string temporaryName;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    temporaryName = ".tmp_" + key + "_" + std::to_string(::getpid()) + "_" + std::to_string(m_Counter++);
+  }
+  const auto temporaryDirectory = GetDirectory() / temporaryName;
+
+  // the entry is assembled in a temporary directory and renamed, readers never see partial entries
+  boost::filesystem::create_directories(temporaryDirectory / "outputs");
+  nlohmann::json entry;
+  entry["created"] = std::time(nullptr);
+  entry["outputs"] = nlohmann::json::array();
+  for (const auto &outputPath : outputPaths)
+  {
+    const auto source = directory / outputPath;
+    if (!boost::filesystem::exists(source))
+      continue;
+    LinkOrCopyTree(source, temporaryDirectory / "outputs" / outputPath);
+    entry["outputs"].push_back(outputPath);
+  }
+
+  {
+    boost::filesystem::ofstream file(temporaryDirectory / "entry.json");
+    file << entry.dump(2) << "\n";
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::rename(temporaryDirectory, entryDirectory, ec);
+  if (ec)
+  {
+    // stored concurrently by another process
+    boost::filesystem::remove_all(temporaryDirectory, ec);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_Statistics.stores;
+  }
+  MITK_INFO << "Stored results as cache entry " << key;
+  Evict();
+}
+
+void mitk::DockerResultCache::Evict()
+{
+  const auto directory = GetDirectory();
+  const auto maxSize = GetMaxSize();
+  if (maxSize == 0 || !boost::filesystem::exists(directory))
+    return;
+
+  struct Entry
+  {
+    boost::filesystem::path path;
+    std::time_t lastUsed;
+    std::uintmax_t size;
+  };
+
+  std::vector<Entry> entries;
+  std::uintmax_t totalSize = 0;
+  for (boost::filesystem::directory_iterator it(directory), end; it != end; ++it)
+  {
+    const auto entryFile = it->path() / "entry.json";
+    if (!boost::filesystem::exists(entryFile))
+      continue;
+    Entry entry{it->path(), boost::filesystem::last_write_time(entryFile), GetTreeSize(it->path())};
+    totalSize += entry.size;
+    entries.push_back(entry);
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.lastUsed < b.lastUsed; });
+  for (const auto &entry : entries)
+  {
+    if (totalSize <= maxSize)
+      break;
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(entry.path, ec);
+    totalSize -= entry.size;
+    MITK_INFO << "Evicted result cache entry " << entry.path.filename();
+  }
+}
+
+void mitk::DockerResultCache::Clear()
+{
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(GetDirectory(), ec);
+}
+
+mitk::DockerResultCache::Statistics mitk::DockerResultCache::GetStatistics() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Statistics;
+}
+
+std::string mitk::DockerResultCache::HashFile(const boost::filesystem::path &file)
+{
+  struct stat status;
+  if (stat(file.c_str(), &status) != 0)
+    mitkThrow() << "Could not read " << file << " for hashing";
+  const auto identity = GetFileIdentity(status);
+  const auto pathKey = boost::filesystem::absolute(file).string();
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_FileHashes.find(pathKey);
+    if (it != m_FileHashes.end() && it->second.identity == identity)
+      return it->second.hash;
+  }
+
+  const auto hash = HashFileContent(file);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  // paths of earlier working directories are not hashed again
+  if (m_FileHashes.size() >= MaxFileHashes)
+    m_FileHashes.clear();
+  m_FileHashes[pathKey] = FileHash{identity, hash};
+  return hash;
+}
+
+void mitk::DockerResultCache::ForgetFile(const boost::filesystem::path &file)
+{
+  const auto pathKey = boost::filesystem::absolute(file).string();
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_FileHashes.erase(pathKey);
+}
+
+std::string mitk::DockerResultCache::HashFileContent(const boost::filesystem::path &file)
+{
+  boost::filesystem::ifstream stream(file, std::ios::binary);
+  if (!stream)
+    mitkThrow() << "Could not read " << file << " for hashing";
+
+  Poco::SHA2Engine engine(Poco::SHA2Engine::SHA_256);
+  std::vector<char> buffer(1 << 20);
+  while (stream)
+  {
+    stream.read(buffer.data(), buffer.size());
+    if (stream.gcount() > 0)
+      engine.update(buffer.data(), static_cast<unsigned>(stream.gcount()));
+  }
+  return Poco::DigestEngine::digestToHex(engine.digest());
+}
+
+std::string mitk::DockerResultCache::HashString(const std::string &value)
+{
+  Poco::SHA2Engine engine(Poco::SHA2Engine::SHA_256);
+  engine.update(value.data(), static_cast<unsigned>(value.size()));
+  return Poco::DigestEngine::digestToHex(engine.digest());
+}
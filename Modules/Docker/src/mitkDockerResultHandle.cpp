@@ -0,0 +1,137 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResultHandle.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkIOUtil.h>
+#include <mitkLogMacros.h>
+
+#include <itkImageIOFactory.h>
+#include <itkMacro.h>
+
+mitk::DockerResultHandle::DockerResultHandle(const std::string &argument,
+                                             const boost::filesystem::path &path,
+                                             bool autoLoad)
+  : m_Argument(argument), m_Path(path), m_AutoLoad(autoLoad)
+{
+}
+
+const std::string &mitk::DockerResultHandle::GetArgument() const
+{
+  return m_Argument;
+}
+
+const boost::filesystem::path &mitk::DockerResultHandle::GetPath() const
+{
+  return m_Path;
+}
+
+bool mitk::DockerResultHandle::IsAutoLoad() const
+{
+  return m_AutoLoad;
+}
+
+bool mitk::DockerResultHandle::Exists() const
+{
+  return boost::filesystem::exists(m_Path);
+}
+
+std::uintmax_t mitk::DockerResultHandle::GetSize() const
+{
+  boost::system::error_code ec;
+  const auto size = boost::filesystem::file_size(m_Path, ec);
+  return ec ? 0 : size;
+}
+
+std::string mitk::DockerResultHandle::GetFormat() const
+{
+  const auto filename = m_Path.filename().string();
+  for (const std::string compound : {".nii.gz", ".tar.gz"})
+  {
+    if (filename.size() > compound.size() &&
+        filename.compare(filename.size() - compound.size(), compound.size(), compound) == 0)
+      return compound;
+  }
+  return m_Path.extension().string();
+}
+
+mitk::DockerResultHandle::ImageHeader mitk::DockerResultHandle::GetImageHeader() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_HeaderRead)
+    return m_Header;
+  m_HeaderRead = true;
+
+  auto io = itk::ImageIOFactory::CreateImageIO(m_Path.string().c_str(), itk::IOFileModeEnum::ReadMode);
+  if (io.IsNull())
+    return m_Header;
+
+  try
+  {
+    io->SetFileName(m_Path.string());
+    io->ReadImageInformation();
+  }
+  catch (const itk::ExceptionObject &)
+  {
+    return m_Header;
+  }
+
+  m_Header.dimension = io->GetNumberOfDimensions();
+  for (unsigned int i = 0; i < m_Header.dimension; ++i)
+  {
+    m_Header.size.push_back(io->GetDimensions(i));
+    m_Header.spacing.push_back(io->GetSpacing(i));
+    m_Header.origin.push_back(io->GetOrigin(i));
+  }
+  m_Header.numberOfComponents = io->GetNumberOfComponents();
+  m_Header.pixelType = io->GetPixelTypeAsString(io->GetPixelType());
+  m_Header.componentType = io->GetComponentTypeAsString(io->GetComponentType());
+  m_Header.valid = true;
+  return m_Header;
+}
+
+std::vector<mitk::BaseData::Pointer> mitk::DockerResultHandle::GetData()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Loaded)
+  {
+    if (!boost::filesystem::exists(m_Path))
+      mitkThrow() << "Output " << m_Path << " of argument [" << m_Argument << "] does not exist";
+
+    m_Data = mitk::IOUtil::Load(m_Path.string());
+    m_Loaded = true;
+    MITK_INFO << "Loaded " << m_Path;
+  }
+  return m_Data;
+}
+
+bool mitk::DockerResultHandle::IsLoaded() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Loaded;
+}
+
+void mitk::DockerResultHandle::Release()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Data.clear();
+  m_Loaded = false;
+}
+
+void mitk::DockerResultHandle::SetWorkingDirectoryReference(DockerWorkingDirectoryManager::Reference reference)
+{
+  m_WorkingDirectoryReference = std::move(reference);
+}
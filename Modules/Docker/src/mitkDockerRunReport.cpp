@@ -0,0 +1,56 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerRunReport.h>
+
+#include <mitkExceptionMacro.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+nlohmann::json mitk::DockerRunReport::ToJson() const
+{
+  nlohmann::json report;
+  report["image"] = image;
+  report["containerName"] = containerName;
+  report["workingDirectory"] = workingDirectory.string();
+  report["scratchLocation"] = scratchLocation;
+  report["backend"] = backend;
+  report["status"] = status;
+  report["message"] = message;
+  report["phases"] = {{"staging", stagingSeconds},
+                      {"queued", queuedSeconds},
+                      {"running", runningSeconds},
+                      {"loading", loadingSeconds},
+                      {"total", totalSeconds}};
+  report["container"] = {
+    {"startSeconds", containerStartSeconds}, {"firstOutputSeconds", firstOutputSeconds}, {"exitCode", exitCode}};
+  report["staging"] = {{"bytesWritten", stagingBytesWritten},
+                       {"filesWritten", stagingFilesWritten},
+                       {"filesLinked", stagingFilesLinked},
+                       {"filesReused", stagingFilesReused}};
+  report["loading"] = {{"bytesRead", loadingBytesRead}, {"filesRead", loadingFilesRead}};
+  if (!resources.source.empty())
+    report["resources"] = resources.ToJson();
+  return report;
+}
+
+void mitk::DockerRunReport::WriteJson(const boost::filesystem::path &path) const
+{
+  boost::filesystem::ofstream file(path);
+  file << ToJson().dump(2) << "\n";
+  file.close();
+  if (!file)
+    mitkThrow() << "Could not write run report to " << path;
+}
@@ -0,0 +1,179 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerScratchPolicy.h>
+
+#include <mitkIOUtil.h>
+#include <mitkLogMacros.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+  std::mutex s_RamMutex;
+  std::uint64_t s_ReservedRamBytes = 0;
+
+  // free bytes of the file system of path, 0 if it does not exist
+  std::uint64_t GetAvailableBytes(const boost::filesystem::path &path)
+  {
+    boost::system::error_code ec;
+    const auto info = boost::filesystem::space(path, ec);
+    return ec ? 0 : static_cast<std::uint64_t>(info.available);
+  }
+
+  // "1073741824", "512M" or "2g"; 0 if the value is not understood
+  std::uint64_t ParseBytes(const std::string &value)
+  {
+    try
+    {
+      std::size_t pos = 0;
+      const double number = std::stod(value, &pos);
+      const char unit = pos < value.size() ? static_cast<char>(std::tolower(static_cast<unsigned char>(value[pos]))) : 'b';
+      const double factor = unit == 'k' ? 1024.0 : unit == 'm' ? 1024.0 * 1024.0 : unit == 'g' ? 1024.0 * 1024.0 * 1024.0 : 1.0;
+      return number > 0 ? static_cast<std::uint64_t>(number * factor) : 0;
+    }
+    catch (const std::exception &)
+    {
+      MITK_WARN << "Could not parse the size \"" << value << "\"";
+      return 0;
+    }
+  }
+
+  std::string GetEnvironment(const char *name)
+  {
+    const char *value = std::getenv(name);
+    return value ? value : "";
+  }
+} // namespace
+
+mitk::DockerScratchPolicy::Reservation::Reservation(Reservation &&other) noexcept
+  : m_Location(other.m_Location), m_Root(std::move(other.m_Root)), m_Bytes(other.m_Bytes)
+{
+  other.m_Bytes = 0;
+}
+
+mitk::DockerScratchPolicy::Reservation &mitk::DockerScratchPolicy::Reservation::operator=(Reservation &&other) noexcept
+{
+  if (this != &other)
+  {
+    Release();
+    m_Location = other.m_Location;
+    m_Root = std::move(other.m_Root);
+    m_Bytes = other.m_Bytes;
+    other.m_Bytes = 0;
+  }
+  return *this;
+}
+
+mitk::DockerScratchPolicy::Reservation::~Reservation()
+{
+  Release();
+}
+
+void mitk::DockerScratchPolicy::Reservation::Release()
+{
+  if (m_Bytes == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(s_RamMutex);
+  s_ReservedRamBytes -= std::min(s_ReservedRamBytes, m_Bytes);
+  m_Bytes = 0;
+}
+
+std::uint64_t mitk::DockerScratchPolicy::GetRequiredBytes(std::uint64_t stagedBytes) const
+{
+  return stagedBytes + static_cast<std::uint64_t>(stagedBytes * std::max(0.0, outputFactor));
+}
+
+mitk::DockerScratchPolicy::Location mitk::DockerScratchPolicy::Select(std::uint64_t stagedBytes) const
+{
+  const auto requiredBytes = GetRequiredBytes(stagedBytes);
+  if (ramBudgetBytes > 0 && requiredBytes <= ramBudgetBytes - std::min(ramBudgetBytes, GetReservedRamBytes()) &&
+      requiredBytes < GetAvailableBytes(ramRoot))
+    return Location::Ram;
+
+  if (!fastRoot.empty() && requiredBytes < GetAvailableBytes(fastRoot))
+    return Location::Fast;
+
+  return Location::Disk;
+}
+
+mitk::DockerScratchPolicy::Reservation mitk::DockerScratchPolicy::Reserve(std::uint64_t stagedBytes) const
+{
+  const auto requiredBytes = GetRequiredBytes(stagedBytes);
+  if (ramBudgetBytes > 0 && requiredBytes < GetAvailableBytes(ramRoot))
+  {
+    // check and account under one lock, concurrent runs must not overcommit the budget
+    std::lock_guard<std::mutex> lock(s_RamMutex);
+    if (s_ReservedRamBytes + requiredBytes <= ramBudgetBytes)
+    {
+      s_ReservedRamBytes += requiredBytes;
+      return Reservation(Location::Ram, ramRoot, requiredBytes);
+    }
+  }
+
+  if (!fastRoot.empty() && requiredBytes < GetAvailableBytes(fastRoot))
+    return Reservation(Location::Fast, fastRoot, 0);
+
+  return Reservation(Location::Disk, GetRoot(Location::Disk), 0);
+}
+
+boost::filesystem::path mitk::DockerScratchPolicy::GetRoot(Location location) const
+{
+  switch (location)
+  {
+    case Location::Ram:
+      return ramRoot;
+    case Location::Fast:
+      return fastRoot;
+    default:
+      return diskRoot.empty() ? boost::filesystem::path(mitk::IOUtil::GetTempPath()) : diskRoot;
+  }
+}
+
+mitk::DockerScratchPolicy mitk::DockerScratchPolicy::FromEnvironment()
+{
+  DockerScratchPolicy policy;
+  const auto ramBudget = GetEnvironment("MITK_DOCKER_SCRATCH_RAM_BUDGET");
+  if (!ramBudget.empty())
+    policy.ramBudgetBytes = ParseBytes(ramBudget);
+  const auto ramRoot = GetEnvironment("MITK_DOCKER_SCRATCH_RAM_ROOT");
+  if (!ramRoot.empty())
+    policy.ramRoot = ramRoot;
+  policy.fastRoot = GetEnvironment("MITK_DOCKER_SCRATCH_FAST_ROOT");
+  policy.diskRoot = GetEnvironment("MITK_DOCKER_SCRATCH_DISK_ROOT");
+  return policy;
+}
+
+std::uint64_t mitk::DockerScratchPolicy::GetReservedRamBytes()
+{
+  std::lock_guard<std::mutex> lock(s_RamMutex);
+  return s_ReservedRamBytes;
+}
+
+std::string mitk::DockerScratchPolicy::ToString(Location location)
+{
+  switch (location)
+  {
+    case Location::Ram:
+      return "ram";
+    case Location::Fast:
+      return "fast";
+    default:
+      return "disk";
+  }
+}
@@ -0,0 +1,169 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerStagingCache.h>
+
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+mitk::DockerStagingCache &mitk::DockerStagingCache::GetInstance()
+{
+  static DockerStagingCache instance;
+  return instance;
+}
+
+mitk::DockerStagingCache::DockerStagingCache()
+{
+  const char *enabled = std::getenv("MITK_DOCKER_STAGING_CACHE");
+  m_Enabled = !enabled || std::string(enabled) != "0";
+}
+
+std::string mitk::DockerStagingCache::GetFormat(const boost::filesystem::path &path)
+{
+  const auto name = path.filename().string();
+  const auto position = name.find('.', 1);
+  return position == std::string::npos ? std::string() : name.substr(position);
+}
+
+bool mitk::DockerStagingCache::IsUnchanged(const File &file)
+{
+  boost::system::error_code ec;
+  const auto status = boost::filesystem::symlink_status(file.path, ec);
+  if (ec || !boost::filesystem::is_regular_file(status))
+    return false;
+  const auto size = boost::filesystem::file_size(file.path, ec);
+  if (ec || size != file.size)
+    return false;
+  const auto writeTime = boost::filesystem::last_write_time(file.path, ec);
+  return !ec && writeTime == file.writeTime;
+}
+
+void mitk::DockerStagingCache::Add(const mitk::BaseData *data, const boost::filesystem::path &path)
+{
+  if (!data)
+    return;
+
+  File file;
+  file.modifiedTime = data->GetMTime();
+  file.path = path;
+  boost::system::error_code ec;
+  file.size = boost::filesystem::file_size(path, ec);
+  if (ec)
+    return;
+  file.writeTime = boost::filesystem::last_write_time(path, ec);
+  if (ec)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Enabled)
+    return;
+  RemoveStaleFiles();
+  auto &files = m_Files[{data, GetFormat(path)}];
+  // files of an earlier state of the object are never used again
+  files.erase(std::remove_if(files.begin(),
+                             files.end(),
+                             [&file](const File &other) {
+                               return other.modifiedTime != file.modifiedTime || other.path == file.path;
+                             }),
+              files.end());
+  files.push_back(file);
+}
+
+bool mitk::DockerStagingCache::LinkTo(const mitk::BaseData *data, const boost::filesystem::path &target)
+{
+  if (!data)
+    return false;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Enabled)
+    return false;
+  const auto it = m_Files.find({data, GetFormat(target)});
+  if (it == m_Files.end())
+    return false;
+
+  const auto modifiedTime = data->GetMTime();
+  for (const auto &file : it->second)
+  {
+    if (file.modifiedTime != modifiedTime || file.path == target || !IsUnchanged(file))
+      continue;
+    // fails across file systems, another copy may be on the same one
+    boost::system::error_code ec;
+    boost::filesystem::create_hard_link(file.path, target, ec);
+    if (!ec)
+    {
+      MITK_DEBUG << "Link staged input " << file.path << " to " << target;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<boost::filesystem::path> mitk::DockerStagingCache::Find(const mitk::BaseData *data,
+                                                                   const std::string &format) const
+{
+  std::vector<boost::filesystem::path> paths;
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  const auto it = m_Files.find({data, format});
+  if (!data || !m_Enabled || it == m_Files.end())
+    return paths;
+
+  const auto modifiedTime = data->GetMTime();
+  for (const auto &file : it->second)
+    if (file.modifiedTime == modifiedTime && IsUnchanged(file))
+      paths.push_back(file.path);
+  return paths;
+}
+
+void mitk::DockerStagingCache::RemoveStaleFiles()
+{
+  for (auto it = m_Files.begin(); it != m_Files.end();)
+  {
+    auto &files = it->second;
+    files.erase(std::remove_if(files.begin(), files.end(), [](const File &file) { return !IsUnchanged(file); }),
+                files.end());
+    it = files.empty() ? m_Files.erase(it) : std::next(it);
+  }
+}
+
+void mitk::DockerStagingCache::SetEnabled(bool value)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Enabled = value;
+  if (!m_Enabled)
+    m_Files.clear();
+}
+
+bool mitk::DockerStagingCache::IsEnabled() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Enabled;
+}
+
+void mitk::DockerStagingCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Files.clear();
+}
+
+std::size_t mitk::DockerStagingCache::GetNumberOfFiles() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::size_t count = 0;
+  for (const auto &kv : m_Files)
+    count += kv.second.size();
+  return count;
+}
@@ -0,0 +1,391 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerStagingWriter.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkImage.h>
+#include <mitkImageReadAccessor.h>
+
+#include <itk_zlib.h>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+
+namespace
+{
+  enum class Format
+  {
+    None,
+    Nifti,
+    NiftiGz,
+    Nrrd
+  };
+
+  Format GetFormat(const boost::filesystem::path &path)
+  {
+    const auto name = path.filename().string();
+    auto endsWith = [&name](const std::string &suffix) {
+      return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".nii.gz"))
+      return Format::NiftiGz;
+    if (endsWith(".nii"))
+      return Format::Nifti;
+    if (endsWith(".nrrd"))
+      return Format::Nrrd;
+    return Format::None;
+  }
+
+  struct ScalarType
+  {
+    std::string nrrd;
+    std::int16_t nifti = 0;
+    unsigned int bytes = 0;
+  };
+
+  // empty nrrd name if the pixel type is not supported
+  ScalarType GetScalarType(const mitk::Image *image)
+  {
+    const auto &pixelType = image->GetPixelType();
+    if (pixelType.GetNumberOfComponents() != 1)
+      return {};
+
+    const auto component = pixelType.GetComponentTypeAsString();
+    const unsigned int bytes = pixelType.GetBpe() / 8;
+    if (component == "float" && bytes == 4)
+      return {"float", 16, 4};
+    if (component == "double" && bytes == 8)
+      return {"double", 64, 8};
+
+    const bool isUnsigned = component.compare(0, 8, "unsigned") == 0;
+    switch (bytes)
+    {
+      case 1:
+        return isUnsigned ? ScalarType{"uint8", 2, 1} : ScalarType{"int8", 256, 1};
+      case 2:
+        return isUnsigned ? ScalarType{"uint16", 512, 2} : ScalarType{"int16", 4, 2};
+      case 4:
+        return isUnsigned ? ScalarType{"uint32", 768, 4} : ScalarType{"int32", 8, 4};
+      case 8:
+        return isUnsigned ? ScalarType{"uint64", 1280, 8} : ScalarType{"int64", 1024, 8};
+      default:
+        return {};
+    }
+  }
+
+  bool IsLittleEndian()
+  {
+    const std::uint16_t value = 1;
+    return *reinterpret_cast<const std::uint8_t *>(&value) == 1;
+  }
+
+  // index to world matrix (LPS, with spacing) and origin of the first time step
+  struct Geometry
+  {
+    std::array<std::array<double, 3>, 3> matrix;
+    std::array<double, 3> spacing;
+    std::array<double, 3> origin;
+  };
+
+  Geometry GetGeometry(const mitk::Image *image)
+  {
+    const auto *geometry = image->GetGeometry();
+    const auto &matrix = geometry->GetIndexToWorldTransform()->GetMatrix();
+    const auto spacing = geometry->GetSpacing();
+    const auto origin = geometry->GetOrigin();
+
+    Geometry result;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+      for (unsigned int j = 0; j < 3; ++j)
+        result.matrix[i][j] = matrix[i][j];
+      result.spacing[i] = spacing[i];
+      result.origin[i] = origin[i];
+    }
+    return result;
+  }
+
+  template <class T>
+  void Put(std::vector<char> &buffer, std::size_t offset, T value)
+  {
+    std::memcpy(buffer.data() + offset, &value, sizeof(T));
+  }
+
+  // NIfTI-1 header with an empty extension block; qform and sform describe the same RAS transform
+  std::vector<char> NiftiHeader(const mitk::Image *image, const ScalarType &type)
+  {
+    std::vector<char> header(352, 0);
+    const auto dimension = image->GetDimension();
+    const auto geometry = GetGeometry(image);
+
+    Put<std::int32_t>(header, 0, 348);
+    Put<std::int16_t>(header, 40, static_cast<std::int16_t>(dimension));
+    for (unsigned int i = 0; i < 7; ++i)
+      Put<std::int16_t>(header, 42 + 2 * i, static_cast<std::int16_t>(i < dimension ? image->GetDimension(i) : 1));
+    Put<std::int16_t>(header, 70, type.nifti);
+    Put<std::int16_t>(header, 72, static_cast<std::int16_t>(8 * type.bytes));
+    for (unsigned int i = 0; i < 7; ++i)
+      Put<float>(header, 80 + 4 * i, static_cast<float>(i < 3 ? geometry.spacing[i] : 1.0));
+    Put<float>(header, 108, 352.0f);
+    Put<float>(header, 112, 1.0f);
+    // millimeters
+    header[123] = 2;
+
+    // LPS to RAS: the first two world axes change their sign
+    std::array<std::array<double, 3>, 3> rotation;
+    std::array<double, 3> offset;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+      const double sign = i < 2 ? -1.0 : 1.0;
+      for (unsigned int j = 0; j < 3; ++j)
+        rotation[i][j] = sign * geometry.matrix[i][j] / geometry.spacing[j];
+      offset[i] = sign * geometry.origin[i];
+    }
+
+    // quaternion of the rotation (nifti_mat44_to_quatern); a left-handed frame flips the third axis
+    const double determinant = rotation[0][0] * (rotation[1][1] * rotation[2][2] - rotation[1][2] * rotation[2][1]) -
+                               rotation[0][1] * (rotation[1][0] * rotation[2][2] - rotation[1][2] * rotation[2][0]) +
+                               rotation[0][2] * (rotation[1][0] * rotation[2][1] - rotation[1][1] * rotation[2][0]);
+    const double qfac = determinant < 0 ? -1.0 : 1.0;
+    for (unsigned int i = 0; i < 3; ++i)
+      rotation[i][2] *= qfac;
+
+    double a = rotation[0][0] + rotation[1][1] + rotation[2][2] + 1.0, b, c, d;
+    if (a > 0.5)
+    {
+      a = 0.5 * std::sqrt(a);
+      b = 0.25 * (rotation[2][1] - rotation[1][2]) / a;
+      c = 0.25 * (rotation[0][2] - rotation[2][0]) / a;
+      d = 0.25 * (rotation[1][0] - rotation[0][1]) / a;
+    }
+    else
+    {
+      const double xd = 1.0 + rotation[0][0] - (rotation[1][1] + rotation[2][2]);
+      const double yd = 1.0 + rotation[1][1] - (rotation[0][0] + rotation[2][2]);
+      const double zd = 1.0 + rotation[2][2] - (rotation[0][0] + rotation[1][1]);
+      if (xd > 1.0)
+      {
+        b = 0.5 * std::sqrt(xd);
+        c = 0.25 * (rotation[0][1] + rotation[1][0]) / b;
+        d = 0.25 * (rotation[0][2] + rotation[2][0]) / b;
+        a = 0.25 * (rotation[2][1] - rotation[1][2]) / b;
+      }
+      else if (yd > 1.0)
+      {
+        c = 0.5 * std::sqrt(yd);
+        b = 0.25 * (rotation[0][1] + rotation[1][0]) / c;
+        d = 0.25 * (rotation[1][2] + rotation[2][1]) / c;
+        a = 0.25 * (rotation[0][2] - rotation[2][0]) / c;
+      }
+      else
+      {
+        d = 0.5 * std::sqrt(zd);
+        b = 0.25 * (rotation[0][2] + rotation[2][0]) / d;
+        c = 0.25 * (rotation[1][2] + rotation[2][1]) / d;
+        a = 0.25 * (rotation[1][0] - rotation[0][1]) / d;
+      }
+      if (a < 0.0)
+      {
+        b = -b;
+        c = -c;
+        d = -d;
+      }
+    }
+
+    Put<float>(header, 76, static_cast<float>(qfac));
+    // qform_code and sform_code: scanner anatomical
+    Put<std::int16_t>(header, 252, 1);
+    Put<std::int16_t>(header, 254, 1);
+    Put<float>(header, 256, static_cast<float>(b));
+    Put<float>(header, 260, static_cast<float>(c));
+    Put<float>(header, 264, static_cast<float>(d));
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+      Put<float>(header, 268 + 4 * i, static_cast<float>(offset[i]));
+      const double sign = i < 2 ? -1.0 : 1.0;
+      for (unsigned int j = 0; j < 3; ++j)
+        Put<float>(header, 280 + 16 * i + 4 * j, static_cast<float>(sign * geometry.matrix[i][j]));
+      Put<float>(header, 280 + 16 * i + 12, static_cast<float>(offset[i]));
+    }
+    std::memcpy(header.data() + 344, "n+1", 4);
+    return header;
+  }
+
+  std::vector<char> NrrdHeader(const mitk::Image *image, const ScalarType &type, mitk::DockerStagingWriter::Codec codec)
+  {
+    const auto dimension = image->GetDimension();
+    const auto geometry = GetGeometry(image);
+
+    std::ostringstream header;
+    header << std::setprecision(17);
+    header << "NRRD0004\n";
+    header << "type: " << type.nrrd << "\n";
+    header << "dimension: " << dimension << "\n";
+    header << "space: left-posterior-superior\n";
+    header << "sizes:";
+    for (unsigned int i = 0; i < dimension; ++i)
+      header << " " << image->GetDimension(i);
+    header << "\nspace directions:";
+    for (unsigned int j = 0; j < dimension; ++j)
+    {
+      if (j < 3)
+        header << " (" << geometry.matrix[0][j] << "," << geometry.matrix[1][j] << "," << geometry.matrix[2][j] << ")";
+      else
+        header << " none";
+    }
+    header << "\nkinds:";
+    for (unsigned int j = 0; j < dimension; ++j)
+      header << (j < 3 ? " domain" : " list");
+    header << "\n";
+    if (type.bytes > 1)
+      header << "endian: " << (IsLittleEndian() ? "little" : "big") << "\n";
+    header << "encoding: " << (codec == mitk::DockerStagingWriter::Codec::Gzip ? "gzip" : "raw") << "\n";
+    header << "space origin: (" << geometry.origin[0] << "," << geometry.origin[1] << "," << geometry.origin[2] << ")\n";
+    header << "\n";
+
+    const auto text = header.str();
+    return std::vector<char>(text.begin(), text.end());
+  }
+
+  // gzip stream of the given blocks
+  void WriteGzip(std::ostream &stream, const std::vector<std::pair<const char *, std::size_t>> &blocks, int level)
+  {
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    // 16 + MAX_WBITS: gzip wrapper instead of zlib
+    if (deflateInit2(&z, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      mitkThrow() << "Could not initialize the gzip stream";
+
+    std::vector<char> output(1 << 20);
+    try
+    {
+      for (std::size_t i = 0; i < blocks.size(); ++i)
+      {
+        auto *data = blocks[i].first;
+        auto remaining = blocks[i].second;
+        const bool last = i + 1 == blocks.size();
+        do
+        {
+          // avail_in is 32 bit
+          const auto chunk = std::min<std::size_t>(remaining, 1u << 30);
+          z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+          z.avail_in = static_cast<uInt>(chunk);
+          data += chunk;
+          remaining -= chunk;
+          const int flush = last && remaining == 0 ? Z_FINISH : Z_NO_FLUSH;
+          int result;
+          do
+          {
+            z.next_out = reinterpret_cast<Bytef *>(output.data());
+            z.avail_out = static_cast<uInt>(output.size());
+            result = deflate(&z, flush);
+            if (result == Z_STREAM_ERROR)
+              mitkThrow() << "Gzip compression failed";
+            stream.write(output.data(), output.size() - z.avail_out);
+          } while (z.avail_out == 0);
+        } while (remaining > 0);
+      }
+    }
+    catch (...)
+    {
+      deflateEnd(&z);
+      throw;
+    }
+    deflateEnd(&z);
+  }
+} // namespace
+
+bool mitk::DockerStagingWriter::CanWrite(const mitk::BaseData *data, const boost::filesystem::path &path)
+{
+  const auto *image = dynamic_cast<const mitk::Image *>(data);
+  if (!image || GetFormat(path) == Format::None)
+    return false;
+  const auto dimension = image->GetDimension();
+  return dimension >= 2 && dimension <= 4 && !GetScalarType(image).nrrd.empty();
+}
+
+std::uint64_t mitk::DockerStagingWriter::Write(const mitk::Image *image,
+                                               const boost::filesystem::path &path,
+                                               const Options &options)
+{
+  if (!CanWrite(image, path))
+    mitkThrow() << "The staging writer does not support " << path;
+
+  const auto format = GetFormat(path);
+  const auto type = GetScalarType(image);
+  auto codec = options.codec;
+  if (format == Format::Nifti)
+    codec = Codec::Raw;
+  else if (format == Format::NiftiGz)
+    codec = Codec::Gzip;
+
+  const auto header = format == Format::Nrrd ? NrrdHeader(image, type, codec) : NiftiHeader(image, type);
+
+  std::size_t bytes = type.bytes;
+  for (unsigned int i = 0; i < image->GetDimension(); ++i)
+    bytes *= image->GetDimension(i);
+  mitk::ImageReadAccessor accessor(const_cast<mitk::Image *>(image));
+  const auto *data = static_cast<const char *>(accessor.GetData());
+
+  boost::filesystem::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  if (!stream)
+    mitkThrow() << "Could not open " << path << " for writing";
+
+  if (codec == Codec::Gzip)
+  {
+    // NRRD compresses the data only, ".nii.gz" the whole file
+    if (format == Format::Nrrd)
+    {
+      stream.write(header.data(), header.size());
+      WriteGzip(stream, {{data, bytes}}, options.level);
+    }
+    else
+    {
+      WriteGzip(stream, {{header.data(), header.size()}, {data, bytes}}, options.level);
+    }
+  }
+  else
+  {
+    stream.write(header.data(), header.size());
+    stream.write(data, bytes);
+  }
+
+  const auto written = static_cast<std::uint64_t>(stream.tellp());
+  stream.close();
+  if (!stream)
+    mitkThrow() << "Could not write " << path;
+  return written;
+}
+
+std::string mitk::DockerStagingWriter::ToString(Codec codec)
+{
+  return codec == Codec::Gzip ? "gzip" : "raw";
+}
+
+mitk::DockerStagingWriter::Codec mitk::DockerStagingWriter::CodecFromString(const std::string &value)
+{
+  if (value == "raw")
+    return Codec::Raw;
+  if (value == "gzip")
+    return Codec::Gzip;
+  mitkThrow() << "Unknown staging codec [" << value << "] (raw, gzip)";
+}
@@ -0,0 +1,381 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerContainerPool.h>
+#include <mitkDockerProcess.h>
+#include <mitkDockerWorker.h>
+
+#include <Poco/Exception.h>
+#include <Poco/Pipe.h>
+#include <Poco/Process.h>
+
+#include <mitkExceptionMacro.h>
+#include <mitkLogMacros.h>
+
+#include <nlohmann/json.hpp>
+
+#include <pthread.h>
+#include <signal.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+  // "; last worker output: ..." for error messages, empty without lines
+  std::string FormatErrorLines(const std::vector<std::string> &lines)
+  {
+    std::string text;
+    for (const auto &line : lines)
+      text += "\n  " + line;
+    return text.empty() ? text : "; last worker output:" + text;
+  }
+}
+
+std::mutex mitk::DockerWorker::s_RegistryMutex;
+std::map<std::string, mitk::DockerWorker::Pointer> mitk::DockerWorker::s_Workers;
+
+mitk::DockerWorker::Pointer mitk::DockerWorker::GetWorker(const std::string &image,
+                                                          const std::vector<std::string> &runArguments,
+                                                          const std::vector<std::string> &workerArguments)
+{
+  std::string key = image;
+  for (const auto &a : runArguments)
+    key += " " + a;
+  key += " --";
+  for (const auto &a : workerArguments)
+    key += " " + a;
+
+  std::lock_guard<std::mutex> lock(s_RegistryMutex);
+  auto it = s_Workers.find(key);
+  if (it != s_Workers.end() && it->second->IsRunning())
+    return it->second;
+
+  Pointer worker(new DockerWorker(image, runArguments, workerArguments));
+  s_Workers[key] = worker;
+  return worker;
+}
+
+void mitk::DockerWorker::ShutdownAll()
+{
+  std::map<std::string, Pointer> workers;
+  {
+    std::lock_guard<std::mutex> lock(s_RegistryMutex);
+    workers.swap(s_Workers);
+  }
+  for (auto &kv : workers)
+    kv.second->Shutdown();
+}
+
+mitk::DockerWorker::DockerWorker(const std::string &image,
+                                 const std::vector<std::string> &runArguments,
+                                 const std::vector<std::string> &workerArguments)
+{
+  static std::atomic<unsigned int> counter{0};
+  m_ContainerName = "m2_worker_" + std::to_string(Poco::Process::id()) + "_" + std::to_string(counter++);
+
+  const auto sharedDirectory = mitk::DockerContainerPool::GetInstance().GetSharedDirectory();
+  std::vector<std::string> args = {"run", "-i", "--rm", "--name", m_ContainerName, "-v",
+                                   sharedDirectory.string() + ":/" + mitk::DockerContainerPool::GetSharedDirectoryContainerPath()};
+  args.insert(args.end(), runArguments.begin(), runArguments.end());
+  args.push_back(image);
+  args.insert(args.end(), workerArguments.begin(), workerArguments.end());
+
+  m_InPipe.reset(new Poco::Pipe);
+  m_OutPipe.reset(new Poco::Pipe);
+  m_ErrPipe.reset(new Poco::Pipe);
+  m_Handle.reset(new Poco::ProcessHandle(Poco::Process::launch(mitk::DockerProcess::GetExecutable(), args, m_InPipe.get(), m_OutPipe.get(), m_ErrPipe.get())));
+  m_ProcessId = m_Handle->id();
+  m_Running = true;
+  m_ReaderThread = std::thread(&DockerWorker::ReadOutput, this);
+  m_ErrorThread = std::thread(&DockerWorker::ReadErrors, this);
+
+  MITK_INFO << "Started worker container [" << m_ContainerName << "] for " << image;
+}
+
+mitk::DockerWorker::~DockerWorker()
+{
+  Shutdown();
+}
+
+bool mitk::DockerWorker::IsRunning() const
+{
+  return m_Running && Poco::Process::isRunning(m_ProcessId);
+}
+
+std::string mitk::DockerWorker::GetContainerName() const
+{
+  return m_ContainerName;
+}
+
+long mitk::DockerWorker::GetProcessId() const
+{
+  return m_ProcessId;
+}
+
+bool mitk::DockerWorker::ReadLine(Poco::Pipe &pipe, std::string &buffer, std::string &line)
+{
+  while (true)
+  {
+    const auto pos = buffer.find('\n');
+    if (pos != std::string::npos)
+    {
+      line = buffer.substr(0, pos);
+      buffer.erase(0, pos + 1);
+      return true;
+    }
+
+    char chunk[4096];
+    const int n = pipe.readBytes(chunk, sizeof(chunk));
+    if (n <= 0)
+      return false;
+    buffer.append(chunk, n);
+  }
+}
+
+void mitk::DockerWorker::ReadOutput()
+{
+  std::string line;
+  while (ReadLine(*m_OutPipe, m_ReadBuffer, line))
+  {
+    std::lock_guard<std::mutex> lock(m_LinesMutex);
+    m_Lines.push_back(line);
+    m_LinesCondition.notify_all();
+  }
+  std::lock_guard<std::mutex> lock(m_LinesMutex);
+  m_OutputClosed = true;
+  m_LinesCondition.notify_all();
+}
+
+void mitk::DockerWorker::ReadErrors()
+{
+  std::string line;
+  while (ReadLine(*m_ErrPipe, m_ErrorBuffer, line))
+  {
+    std::lock_guard<std::mutex> lock(m_LinesMutex);
+    m_ErrorLines.push_back(line);
+    if (m_ErrorLines.size() > MaxErrorLines)
+      m_ErrorLines.pop_front();
+    m_LinesCondition.notify_all();
+  }
+  std::lock_guard<std::mutex> lock(m_LinesMutex);
+  m_ErrorClosed = true;
+  m_LinesCondition.notify_all();
+}
+
+std::vector<std::string> mitk::DockerWorker::TakeErrorLines()
+{
+  std::lock_guard<std::mutex> lock(m_LinesMutex);
+  std::vector<std::string> lines(m_ErrorLines.begin(), m_ErrorLines.end());
+  m_ErrorLines.clear();
+  return lines;
+}
+
+bool mitk::DockerWorker::WriteLine(const std::string &line)
+{
+  // writing to a worker that has exited raises SIGPIPE, which would terminate the application;
+  // the signal is blocked for this thread and a pending one is consumed before it is unblocked
+  sigset_t pipeSignal, previousMask;
+  sigemptyset(&pipeSignal);
+  sigaddset(&pipeSignal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+
+  bool written = true;
+  const auto text = line + "\n";
+  const char *data = text.data();
+  int remaining = static_cast<int>(text.size());
+  try
+  {
+    while (remaining > 0)
+    {
+      const int n = m_InPipe->writeBytes(data, remaining);
+      if (n <= 0)
+      {
+        written = false;
+        break;
+      }
+      data += n;
+      remaining -= n;
+    }
+  }
+  catch (const Poco::Exception &e)
+  {
+    MITK_DEBUG << "Could not write to worker container [" << m_ContainerName << "]: " << e.displayText();
+    written = false;
+  }
+
+  sigset_t pending;
+  sigpending(&pending);
+  if (!written && sigismember(&pending, SIGPIPE) && !sigismember(&previousMask, SIGPIPE))
+  {
+    int received = 0;
+    sigwait(&pipeSignal, &received);
+  }
+  pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+  return written;
+}
+
+bool mitk::DockerWorker::Submit(const std::string &containerWorkingDirectory,
+                                const std::vector<std::string> &args,
+                                std::function<void(const std::string &)> outputCallback,
+                                std::function<bool()> cancelled,
+                                std::chrono::milliseconds cancelGracePeriod)
+{
+  // a job that waits for the worker can be cancelled without affecting the running job
+  std::unique_lock<std::timed_mutex> jobLock(m_Mutex, std::defer_lock);
+  while (!jobLock.try_lock_for(std::chrono::milliseconds(100)))
+  {
+    if (cancelled && cancelled())
+      mitkThrow() << "Job for worker container [" << m_ContainerName << "] was cancelled before it was sent";
+  }
+  if (!IsRunning())
+    return false;
+
+  // stderr lines written between jobs do not belong to this job
+  for (const auto &line : TakeErrorLines())
+    MITK_WARN << "[" << m_ContainerName << "] " << line;
+
+  const auto id = m_NextJobId++;
+  json request;
+  request["id"] = id;
+  request["workdir"] = containerWorkingDirectory;
+  request["args"] = args;
+  if (!WriteLine(request.dump()))
+  {
+    m_Running = false;
+    {
+      // the reason of the exit is usually the last output of the worker
+      std::unique_lock<std::mutex> lock(m_LinesMutex);
+      m_LinesCondition.wait_for(lock, std::chrono::seconds(1), [this]() { return m_ErrorClosed; });
+    }
+    mitkThrow() << "Could not send job to worker container [" << m_ContainerName << "]" << FormatErrorLines(TakeErrorLines());
+  }
+
+  bool cancelSent = false;
+  std::chrono::steady_clock::time_point cancelDeadline;
+  std::vector<std::string> recentErrors;
+  while (true)
+  {
+    std::string line;
+    bool hasLine = false;
+    bool closed = false;
+    {
+      std::unique_lock<std::mutex> lock(m_LinesMutex);
+      m_LinesCondition.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+        return !m_Lines.empty() || !m_ErrorLines.empty() || (m_OutputClosed && m_ErrorClosed);
+      });
+      if (!m_Lines.empty())
+      {
+        line = m_Lines.front();
+        m_Lines.pop_front();
+        hasLine = true;
+      }
+      closed = m_OutputClosed && m_ErrorClosed && m_Lines.empty();
+    }
+
+    for (const auto &errorLine : TakeErrorLines())
+    {
+      MITK_DEBUG << "[" << m_ContainerName << "] " << errorLine;
+      if (outputCallback)
+        outputCallback(errorLine);
+      recentErrors.push_back(errorLine);
+      if (recentErrors.size() > 10)
+        recentErrors.erase(recentErrors.begin());
+    }
+
+    if (hasLine)
+    {
+      json record;
+      try
+      {
+        record = json::parse(line);
+      }
+      catch (const json::exception &)
+      {
+        record = json();
+      }
+
+      if (!record.is_object() || !record.contains("id") || record["id"] != id)
+      {
+        MITK_DEBUG << "[" << m_ContainerName << "] " << line;
+        if (outputCallback)
+          outputCallback(line);
+        continue;
+      }
+
+      if (cancelSent)
+        mitkThrow() << "Worker job " << id << " was cancelled";
+      const auto status = record.value("status", std::string("error"));
+      if (status != "ok")
+        mitkThrow() << "Worker job failed: " << record.value("message", std::string("no message"));
+      return true;
+    }
+    if (closed)
+      break;
+
+    if (!cancelSent && cancelled && cancelled())
+    {
+      // only this job is stopped, the worker keeps running for other jobs
+      MITK_INFO << "Cancel job " << id << " of worker [" << m_ContainerName << "]";
+      json cancel;
+      cancel["id"] = id;
+      cancel["cancel"] = true;
+      cancelSent = true;
+      cancelDeadline = std::chrono::steady_clock::now() + cancelGracePeriod;
+      if (!WriteLine(cancel.dump()))
+        cancelDeadline = std::chrono::steady_clock::now();
+    }
+    else if (cancelSent && std::chrono::steady_clock::now() >= cancelDeadline)
+    {
+      Discard();
+      mitkThrow() << "Worker container [" << m_ContainerName << "] did not stop cancelled job " << id << " and was discarded";
+    }
+  }
+
+  m_Running = false;
+  mitkThrow() << "Worker container [" << m_ContainerName << "] terminated before the job was completed" << FormatErrorLines(recentErrors);
+}
+
+void mitk::DockerWorker::Discard()
+{
+  MITK_WARN << "Discard worker container [" << m_ContainerName << "]";
+  m_Running = false;
+  mitk::DockerProcess::Execute({"kill", m_ContainerName});
+  if (Poco::Process::isRunning(m_ProcessId))
+    Poco::Process::kill(m_ProcessId);
+}
+
+void mitk::DockerWorker::Shutdown()
+{
+  if (!m_Handle)
+    return;
+
+  m_Running = false;
+  m_InPipe->close(Poco::Pipe::CLOSE_WRITE);
+
+  // the worker should exit when its stdin is closed, stop it otherwise
+  bool exited;
+  {
+    std::unique_lock<std::mutex> lock(m_LinesMutex);
+    exited = m_LinesCondition.wait_for(lock, std::chrono::seconds(5), [this]() { return m_OutputClosed; });
+  }
+  if (!exited)
+    mitk::DockerProcess::Execute({"stop", "-t", "10", m_ContainerName});
+  m_Handle->wait();
+  m_Handle.reset();
+  if (m_ReaderThread.joinable())
+    m_ReaderThread.join();
+  if (m_ErrorThread.joinable())
+    m_ErrorThread.join();
+}
@@ -0,0 +1,417 @@
+/*===================================================================
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerWorkingDirectoryManager.h>
+
+#include <mitkIOUtil.h>
+#include <mitkLogMacros.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <set>
+#include <string>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace
+{
+  std::string GetHostName()
+  {
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    return hostname;
+  }
+
+  bool IsProcessRunning(long pid)
+  {
+    return pid > 0 && (kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM);
+  }
+
+  std::vector<boost::filesystem::path> ReadSessionFile(const boost::filesystem::path &file)
+  {
+    std::vector<boost::filesystem::path> directories;
+    boost::filesystem::ifstream stream(file);
+    std::string line;
+    while (std::getline(stream, line))
+      if (!line.empty())
+        directories.emplace_back(line);
+    return directories;
+  }
+
+  void WriteListFile(const boost::filesystem::path &file, const std::vector<boost::filesystem::path> &directories)
+  {
+    if (directories.empty())
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(file, ec);
+      return;
+    }
+
+    const auto temporaryPath = file.string() + ".tmp";
+    {
+      boost::filesystem::ofstream stream(temporaryPath);
+      for (const auto &directory : directories)
+        stream << directory.string() << "\n";
+    }
+    boost::filesystem::rename(temporaryPath, file);
+  }
+} // namespace
+
+mitk::DockerWorkingDirectoryManager &mitk::DockerWorkingDirectoryManager::GetInstance()
+{
+  static DockerWorkingDirectoryManager instance(boost::filesystem::path(mitk::IOUtil::GetTempPath()) / "m2_docker_sessions",
+                                                [] {
+                                                  const char *sweep = std::getenv("MITK_DOCKER_SWEEP_ORPHANS");
+                                                  return !sweep || std::string(sweep) != "0";
+                                                }());
+  return instance;
+}
+
+mitk::DockerWorkingDirectoryManager::DockerWorkingDirectoryManager(const boost::filesystem::path &sessionDirectory, bool sweep)
+  : m_SessionDirectory(sessionDirectory)
+{
+  const char *quota = std::getenv("MITK_DOCKER_WORKDIR_QUOTA");
+  if (quota && *quota)
+    m_Quota = std::strtoull(quota, nullptr, 10);
+
+  if (sweep)
+  {
+    try
+    {
+      SweepOrphans();
+    }
+    catch (const std::exception &e)
+    {
+      MITK_WARN << "Could not sweep orphaned working directories: " << e.what();
+    }
+  }
+}
+
+mitk::DockerWorkingDirectoryManager::~DockerWorkingDirectoryManager()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (const auto &kv : m_Entries)
+    if (!kv.second.kept)
+      RemoveDirectory(kv.first);
+
+  boost::system::error_code ec;
+  boost::filesystem::remove(GetSessionFilePath(), ec);
+}
+
+mitk::DockerWorkingDirectoryManager::Reference mitk::DockerWorkingDirectoryManager::Register(const boost::filesystem::path &directory,
+                                                                                             DockerScratchPolicy::Reservation reservation)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto &entry = m_Entries[directory];
+    if (reservation.GetBytes() > 0)
+      entry.reservation = std::move(reservation);
+    entry.referenced = true;
+    entry.lastUse = std::chrono::system_clock::now();
+    EnforceQuotaLocked();
+    WriteSessionFileLocked();
+  }
+  return Reference(new boost::filesystem::path(directory), [this](const boost::filesystem::path *path) {
+    Release(*path);
+    delete path;
+  });
+}
+
+void mitk::DockerWorkingDirectoryManager::Release(const boost::filesystem::path &directory)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto it = m_Entries.find(directory);
+  if (it == m_Entries.end())
+    return;
+
+  if (it->second.kept)
+  {
+    it->second.referenced = false;
+    it->second.bytes = GetDirectorySize(directory);
+    it->second.lastUse = std::chrono::system_clock::now();
+    EnforceQuotaLocked();
+    return;
+  }
+
+  RemoveDirectory(directory);
+  m_Entries.erase(it);
+  WriteSessionFileLocked();
+}
+
+void mitk::DockerWorkingDirectoryManager::Keep(const boost::filesystem::path &directory, bool keep)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto it = m_Entries.find(directory);
+  if (it == m_Entries.end())
+    return;
+
+  it->second.kept = keep;
+  if (!keep && !it->second.referenced)
+  {
+    RemoveDirectory(directory);
+    m_Entries.erase(it);
+  }
+  // kept directories are listed in the kept file, they outlive this process
+  WriteSessionFileLocked();
+}
+
+bool mitk::DockerWorkingDirectoryManager::IsKept(const boost::filesystem::path &directory) const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  const auto it = m_Entries.find(directory);
+  return it != m_Entries.end() && it->second.kept;
+}
+
+void mitk::DockerWorkingDirectoryManager::Touch(const boost::filesystem::path &directory)
+{
+  const auto bytes = GetDirectorySize(directory);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto it = m_Entries.find(directory);
+  if (it == m_Entries.end())
+    return;
+
+  it->second.bytes = bytes;
+  it->second.lastUse = std::chrono::system_clock::now();
+  EnforceQuotaLocked();
+}
+
+void mitk::DockerWorkingDirectoryManager::SetQuota(std::uint64_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Quota = bytes;
+  EnforceQuotaLocked();
+}
+
+std::uint64_t mitk::DockerWorkingDirectoryManager::GetQuota() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Quota;
+}
+
+std::uint64_t mitk::DockerWorkingDirectoryManager::GetUsedBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::uint64_t bytes = 0;
+  for (const auto &kv : m_Entries)
+    bytes += kv.second.bytes;
+  return bytes;
+}
+
+std::size_t mitk::DockerWorkingDirectoryManager::GetNumberOfDirectories() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Entries.size();
+}
+
+std::size_t mitk::DockerWorkingDirectoryManager::EnforceQuota()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return EnforceQuotaLocked();
+}
+
+std::size_t mitk::DockerWorkingDirectoryManager::EnforceQuotaLocked()
+{
+  if (m_Quota == 0)
+    return 0;
+
+  std::uint64_t usedBytes = 0;
+  std::vector<std::map<boost::filesystem::path, Entry>::iterator> candidates;
+  for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it)
+  {
+    usedBytes += it->second.bytes;
+    // referenced directories are in use by a helper or by result handles
+    if (!it->second.referenced)
+      candidates.push_back(it);
+  }
+
+  std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) { return a->second.lastUse < b->second.lastUse; });
+
+  std::size_t removed = 0;
+  for (auto it : candidates)
+  {
+    if (usedBytes <= m_Quota)
+      break;
+    MITK_INFO << "Evicting kept working directory " << it->first << " (quota " << m_Quota << " bytes)";
+    usedBytes -= std::min(usedBytes, it->second.bytes);
+    RemoveDirectory(it->first);
+    m_Entries.erase(it);
+    ++removed;
+  }
+
+  if (usedBytes > m_Quota)
+    MITK_WARN << "Working directories in use exceed the quota (" << usedBytes << " of " << m_Quota << " bytes)";
+  if (removed > 0)
+    WriteSessionFileLocked();
+  return removed;
+}
+
+void mitk::DockerWorkingDirectoryManager::SetOrphanAge(std::chrono::seconds age)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_OrphanAge = age;
+}
+
+std::size_t mitk::DockerWorkingDirectoryManager::SweepOrphans()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::size_t removed = 0;
+  std::set<boost::filesystem::path> liveDirectories;
+  for (const auto &kv : m_Entries)
+    liveDirectories.insert(kv.first);
+
+  // sessions of this host; other hosts may share the temp directory
+  boost::system::error_code ec;
+  const auto hostPrefix = GetHostName() + "_";
+  std::vector<boost::filesystem::path> keptFiles;
+  for (boost::filesystem::directory_iterator it(m_SessionDirectory, ec), end; !ec && it != end; it.increment(ec))
+  {
+    const auto name = it->path().filename().string();
+    const auto extension = it->path().extension().string();
+    if (name.compare(0, hostPrefix.size(), hostPrefix) != 0 || extension == ".tmp" || it->path() == GetSessionFilePath() ||
+        it->path() == GetKeptFilePath())
+      continue;
+
+    const auto directories = ReadSessionFile(it->path());
+    if (IsProcessRunning(std::strtol(name.c_str() + hostPrefix.size(), nullptr, 10)))
+    {
+      liveDirectories.insert(directories.begin(), directories.end());
+      continue;
+    }
+
+    if (extension == ".kept")
+    {
+      keptFiles.push_back(it->path());
+      continue;
+    }
+
+    for (const auto &directory : directories)
+    {
+      if (!boost::filesystem::exists(directory))
+        continue;
+      MITK_INFO << "Removing working directory of a crashed session: " << directory;
+      RemoveDirectory(directory);
+      ++removed;
+    }
+    boost::system::error_code removeError;
+    boost::filesystem::remove(it->path(), removeError);
+  }
+
+  for (const auto &file : keptFiles)
+    removed += SweepKeptFile(file, liveDirectories);
+  return removed;
+}
+
+std::size_t mitk::DockerWorkingDirectoryManager::SweepKeptFile(const boost::filesystem::path &file,
+                                                               const std::set<boost::filesystem::path> &liveDirectories) const
+{
+  // kept directories of exited sessions past the orphan age; the younger ones stay listed
+  std::size_t removed = 0;
+  std::vector<boost::filesystem::path> remaining;
+  const auto now = std::time(nullptr);
+  for (const auto &directory : ReadSessionFile(file))
+  {
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_directory(directory, ec))
+      continue;
+
+    const auto lastWrite = boost::filesystem::last_write_time(directory, ec);
+    if (liveDirectories.count(directory) || ec || now - lastWrite < m_OrphanAge.count())
+    {
+      remaining.push_back(directory);
+      continue;
+    }
+
+    MITK_INFO << "Removing orphaned working directory " << directory;
+    RemoveDirectory(directory);
+    ++removed;
+  }
+
+  try
+  {
+    WriteListFile(file, remaining);
+  }
+  catch (const std::exception &e)
+  {
+    MITK_WARN << "Could not update the kept working directory file " << file << ": " << e.what();
+  }
+  return removed;
+}
+
+boost::filesystem::path mitk::DockerWorkingDirectoryManager::GetSessionFilePath() const
+{
+  return m_SessionDirectory / (GetHostName() + "_" + std::to_string(getpid()));
+}
+
+boost::filesystem::path mitk::DockerWorkingDirectoryManager::GetKeptFilePath() const
+{
+  return GetSessionFilePath().string() + ".kept";
+}
+
+void mitk::DockerWorkingDirectoryManager::WriteSessionFileLocked() const
+{
+  try
+  {
+    boost::filesystem::create_directories(m_SessionDirectory);
+    std::vector<boost::filesystem::path> directories, keptDirectories;
+    for (const auto &kv : m_Entries)
+      (kv.second.kept ? keptDirectories : directories).push_back(kv.first);
+
+    // the session file is also written when empty, it marks the session as alive
+    const auto path = GetSessionFilePath();
+    const auto temporaryPath = path.string() + ".tmp";
+    {
+      boost::filesystem::ofstream file(temporaryPath);
+      for (const auto &directory : directories)
+        file << directory.string() << "\n";
+    }
+    boost::filesystem::rename(temporaryPath, path);
+    WriteListFile(GetKeptFilePath(), keptDirectories);
+  }
+  catch (const std::exception &e)
+  {
+    MITK_WARN << "Could not write the working directory session file: " << e.what();
+  }
+}
+
+std::uint64_t mitk::DockerWorkingDirectoryManager::GetDirectorySize(const boost::filesystem::path &directory)
+{
+  std::uint64_t bytes = 0;
+  boost::system::error_code ec;
+  for (boost::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+  {
+    boost::system::error_code sizeError;
+    // symlinks point to mounted inputs, they take no space here
+    if (boost::filesystem::is_regular_file(it->symlink_status(sizeError)))
+    {
+      const auto size = boost::filesystem::file_size(it->path(), sizeError);
+      if (!sizeError)
+        bytes += size;
+    }
+  }
+  return bytes;
+}
+
+void mitk::DockerWorkingDirectoryManager::RemoveDirectory(const boost::filesystem::path &directory)
+{
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(directory, ec);
+  if (ec)
+    MITK_WARN << "Could not remove working directory " << directory << ": " << ec.message();
+}
@@ -14,13 +14,17 @@ See LICENSE.txt for details.
 
 ===================================================================*/
 
+#include <mitkDockerContainerPool.h>
 #include <mitkDockerHelper.h>
 #include <cppunit/TestFixture.h>
 #include <mitkImageCast.h>
+#include <mitkIOUtil.h>
 #include <mitkImagePixelWriteAccessor.h>
 #include <mitkTestFixture.h>
 #include <mitkTestingMacros.h>
 
+#include <set>
+
 //#include <boost/algorithm/string.hpp>
 
 class DockerTestSuite : public mitk::TestFixture
@@ -28,9 +32,26 @@ class DockerTestSuite : public mitk::TestFixture
   CPPUNIT_TEST_SUITE(DockerTestSuite);
   MITK_TEST(FindDocker);
   MITK_TEST(RunHelloWorldContainer_NoThrow);
+  MITK_TEST(RunHelloWorldContainerAsync_NoThrow);
+  MITK_TEST(CancelBeforeRun_ThrowsCancelled);
+  MITK_TEST(RunInContainerPool_ReusesContainer);
+  MITK_TEST(StallTimeout_ThrowsTimeout);
   MITK_TEST(RunSparsePCA_NoThrow);
   CPPUNIT_TEST_SUITE_END();
 
+  static std::set<std::string> ListWorkingDirectories()
+  {
+    std::set<std::string> names;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(mitk::IOUtil::GetTempPath(), ec), end; !ec && it != end; it.increment(ec))
+    {
+      const auto name = it->path().filename().string();
+      if (name.size() == 9 && name.compare(0, 3, "m2_") == 0)
+        names.insert(name);
+    }
+    return names;
+  }
+
 public:
   void FindDocker(){
     CPPUNIT_ASSERT(mitk::DockerHelper::CanRunDocker());
@@ -42,6 +63,52 @@ public:
     CPPUNIT_ASSERT_NO_THROW(helper.GetResults());
   }
 
+  void RunHelloWorldContainerAsync_NoThrow(){
+    mitk::DockerHelper helper("hello-world");
+    helper.EnableAutoRemoveContainer(true);
+    std::vector<mitk::DockerHelper::Phase> phases;
+    helper.SetProgressCallback([&phases](mitk::DockerHelper::Phase phase, const std::string &) { phases.push_back(phase); });
+    auto future = helper.GetResultsAsync();
+    CPPUNIT_ASSERT_NO_THROW(future.get());
+    CPPUNIT_ASSERT(!phases.empty());
+    CPPUNIT_ASSERT(phases.back() == mitk::DockerHelper::Phase::Finished);
+  }
+
+  void CancelBeforeRun_ThrowsCancelled(){
+    // the working directory is created lazily: a cancelled run must not stage anything
+    const auto before = ListWorkingDirectories();
+    mitk::DockerHelper helper("hello-world");
+    helper.Cancel();
+    auto future = helper.GetResultsAsync();
+    CPPUNIT_ASSERT_THROW(future.get(), mitk::DockerCancelledException);
+    CPPUNIT_ASSERT(helper.GetWorkingDirectory().empty());
+    CPPUNIT_ASSERT(ListWorkingDirectories() == before);
+  }
+
+  void StallTimeout_ThrowsTimeout(){
+    mitk::DockerHelper helper("alpine");
+    helper.AddApplicationArgument("sleep", "60");
+    helper.SetStallTimeout(std::chrono::seconds(2));
+    helper.SetStopGracePeriod(std::chrono::seconds(1));
+    CPPUNIT_ASSERT_THROW(helper.GetResults(), mitk::DockerTimeoutException);
+    CPPUNIT_ASSERT(helper.IsTimedOut());
+    CPPUNIT_ASSERT(boost::filesystem::exists(helper.GetLogFilePath()));
+  }
+
+  void RunInContainerPool_ReusesContainer(){
+    auto &pool = mitk::DockerContainerPool::GetInstance();
+    for (int i = 0; i < 2; ++i)
+    {
+      mitk::DockerHelper helper("alpine");
+      helper.EnableContainerPool(true);
+      helper.AddApplicationArgument("echo", "pooled job");
+      CPPUNIT_ASSERT_NO_THROW(helper.GetResults());
+    }
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), pool.Count());
+    pool.Shutdown();
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), pool.Count());
+  }
+
   void RunSparsePCA_NoThrow(){
 
     
@@ -0,0 +1,1026 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+/**
+ * Deterministic stand-in for the docker CLI, used by tests and benchmarks on
+ * machines without a daemon (select it with MITK_DOCKER_EXECUTABLE or
+ * mitk::DockerProcess::SetExecutable).
+ *
+ * Supported: run, exec, ps, images, pull, rmi, inspect, image inspect/ls/pull/rm,
+ * kill, stop, rm, stats, version and info. Containers do not run an image; the
+ * command is emulated on the mounted volumes instead:
+ *  - "sleep <seconds>" sleeps (stall and timeout tests)
+ *  - "m2-worker" runs the JSON lines job loop of mitk::DockerWorker on stdin/stdout; the
+ *    jobs are emulated like commands, "sleep" jobs stop on a cancel request
+ *  - arguments that are files or non-empty directories within a volume are read
+ *  - "--manifest <file>" emulates the "args" of every job of a batch manifest
+ *  - arguments that are empty directories within a volume receive the output files,
+ *    missing files whose parent directory exists are written
+ *
+ * Behavior is configured through the environment:
+ *  MITK_FAKE_DOCKER_STATE_DIR     images and containers (default: <tmp>/mitk_fake_docker_<uid>)
+ *  MITK_FAKE_DOCKER_IMAGES        images present initially (default: hello-world:latest,alpine:latest)
+ *  MITK_FAKE_DOCKER_LATENCY_MS    delay of every command (default: 0)
+ *  MITK_FAKE_DOCKER_START_MS      additional delay of run before the command starts (default: 0)
+ *  MITK_FAKE_DOCKER_RUN_MS        duration of the emulated command (default: 0)
+ *  MITK_FAKE_DOCKER_PULL_MS       duration of a pull (default: 0)
+ *  MITK_FAKE_DOCKER_NO_PULL       if set, run fails for missing images instead of pulling
+ *  MITK_FAKE_DOCKER_EXIT_CODE     exit code of run and exec (default: 0)
+ *  MITK_FAKE_DOCKER_STDOUT_LINES  lines printed by run and exec (default: 1)
+ *  MITK_FAKE_DOCKER_OUTPUT_FILES  files written into output directories (default: output.nrrd)
+ *  MITK_FAKE_DOCKER_OUTPUT_BYTES  size of written outputs (default: 1024)
+ *  MITK_FAKE_DOCKER_OUTPUT_SOURCE file copied as content of written outputs (overrides the size)
+ *  MITK_FAKE_DOCKER_WORKER_EXIT_AFTER   the worker terminates when it receives this job (default: never)
+ *  MITK_FAKE_DOCKER_WORKER_IGNORE_CANCEL if set, the worker ignores cancel requests
+ *
+ * Only the C++ standard library and POSIX are used, so the tool builds without MITK.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+  std::string GetEnv(const char *name, const std::string &defaultValue = "")
+  {
+    const char *value = std::getenv(name);
+    return value && *value ? value : defaultValue;
+  }
+
+  long GetEnvNumber(const char *name, long defaultValue)
+  {
+    const auto value = GetEnv(name);
+    return value.empty() ? defaultValue : std::strtol(value.c_str(), nullptr, 10);
+  }
+
+  void SleepMilliseconds(long milliseconds)
+  {
+    if (milliseconds > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+  }
+
+  std::vector<std::string> Split(const std::string &value, char separator)
+  {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, separator))
+      if (!item.empty())
+        items.push_back(item);
+    return items;
+  }
+
+  std::string ReplaceAll(std::string value, const std::string &pattern, const std::string &replacement)
+  {
+    for (auto pos = value.find(pattern); pos != std::string::npos; pos = value.find(pattern, pos + replacement.size()))
+      value.replace(pos, pattern.size(), replacement);
+    return value;
+  }
+
+  // deterministic 64 hex digit id
+  std::string MakeId(const std::string &value)
+  {
+    std::string id;
+    for (std::uint64_t salt = 0; salt < 4; ++salt)
+    {
+      std::uint64_t hash = 1469598103934665603ull ^ salt;
+      for (unsigned char c : value)
+        hash = (hash ^ c) * 1099511628211ull;
+      char buffer[17];
+      std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+      id += buffer;
+    }
+    return id;
+  }
+
+  std::string NormalizeImage(const std::string &image)
+  {
+    const auto slash = image.rfind('/');
+    const auto colon = image.rfind(':');
+    if (colon == std::string::npos || (slash != std::string::npos && colon < slash))
+      return image + ":latest";
+    return image;
+  }
+
+  struct Volume
+  {
+    fs::path host;
+    fs::path container;
+  };
+
+  struct Container
+  {
+    std::string name;
+    std::string id;
+    std::string image;
+    long pid = 0;
+    bool running = false;
+    std::vector<Volume> volumes;
+  };
+
+  // images and containers of the fake daemon; all changes happen under an exclusive file lock
+  class State
+  {
+  public:
+    State()
+    {
+      m_Directory = GetEnv("MITK_FAKE_DOCKER_STATE_DIR",
+                           (fs::temp_directory_path() / ("mitk_fake_docker_" + std::to_string(getuid()))).string());
+      fs::create_directories(m_Directory / "containers");
+      m_LockFile = open((m_Directory / "lock").c_str(), O_CREAT | O_RDWR, 0644);
+    }
+
+    ~State()
+    {
+      if (m_LockFile >= 0)
+        close(m_LockFile);
+    }
+
+    void Lock() { flock(m_LockFile, LOCK_EX); }
+    void Unlock() { flock(m_LockFile, LOCK_UN); }
+
+    std::vector<std::string> GetImages() const
+    {
+      const auto file = m_Directory / "images";
+      if (!fs::exists(file))
+        return Split(GetEnv("MITK_FAKE_DOCKER_IMAGES", "hello-world:latest,alpine:latest"), ',');
+
+      std::vector<std::string> images;
+      std::ifstream stream(file);
+      std::string line;
+      while (std::getline(stream, line))
+        if (!line.empty())
+          images.push_back(line);
+      return images;
+    }
+
+    void SetImages(const std::vector<std::string> &images) const
+    {
+      std::ofstream stream(m_Directory / "images");
+      for (const auto &image : images)
+        stream << image << "\n";
+    }
+
+    bool HasImage(const std::string &image) const
+    {
+      const auto images = GetImages();
+      return std::find(images.begin(), images.end(), NormalizeImage(image)) != images.end();
+    }
+
+    fs::path GetContainerFile(const std::string &name) const { return m_Directory / "containers" / name; }
+
+    bool GetContainer(const std::string &nameOrId, Container &container) const
+    {
+      for (const auto &entry : fs::directory_iterator(m_Directory / "containers"))
+      {
+        if (!ReadContainer(entry.path(), container))
+          continue;
+        if (container.name == nameOrId || (nameOrId.size() >= 12 && container.id.rfind(nameOrId, 0) == 0))
+          return true;
+      }
+      return false;
+    }
+
+    std::vector<Container> GetContainers() const
+    {
+      std::vector<Container> containers;
+      for (const auto &entry : fs::directory_iterator(m_Directory / "containers"))
+      {
+        Container container;
+        if (ReadContainer(entry.path(), container))
+          containers.push_back(container);
+      }
+      std::sort(containers.begin(), containers.end(), [](const Container &a, const Container &b) { return a.name < b.name; });
+      return containers;
+    }
+
+    void WriteContainer(const Container &container) const
+    {
+      std::ofstream stream(GetContainerFile(container.name));
+      stream << "id " << container.id << "\n"
+             << "image " << container.image << "\n"
+             << "pid " << container.pid << "\n"
+             << "running " << container.running << "\n";
+      for (const auto &volume : container.volumes)
+        stream << "volume " << volume.host.string() << "\t" << volume.container.string() << "\n";
+    }
+
+    void RemoveContainer(const std::string &name) const
+    {
+      std::error_code ec;
+      fs::remove(GetContainerFile(name), ec);
+    }
+
+  private:
+    static bool ReadContainer(const fs::path &file, Container &container)
+    {
+      std::ifstream stream(file);
+      if (!stream)
+        return false;
+      container = Container();
+      container.name = file.filename().string();
+      std::string line;
+      while (std::getline(stream, line))
+      {
+        const auto space = line.find(' ');
+        if (space == std::string::npos)
+          continue;
+        const auto key = line.substr(0, space);
+        const auto value = line.substr(space + 1);
+        if (key == "id")
+          container.id = value;
+        else if (key == "image")
+          container.image = value;
+        else if (key == "pid")
+          container.pid = std::strtol(value.c_str(), nullptr, 10);
+        else if (key == "running")
+          container.running = value == "1";
+        else if (key == "volume")
+        {
+          const auto tab = value.find('\t');
+          container.volumes.push_back({value.substr(0, tab), value.substr(tab + 1)});
+        }
+      }
+      return !container.id.empty();
+    }
+
+    fs::path m_Directory;
+    int m_LockFile = -1;
+  };
+
+  class Locked
+  {
+  public:
+    explicit Locked(State &state) : m_State(state) { m_State.Lock(); }
+    ~Locked() { m_State.Unlock(); }
+
+  private:
+    State &m_State;
+  };
+
+  // maps a container path to the host through the volumes; empty if not mounted
+  fs::path ToHost(const fs::path &containerPath, const std::vector<Volume> &volumes)
+  {
+    fs::path best;
+    std::size_t bestLength = 0;
+    const auto value = containerPath.lexically_normal().string();
+    for (const auto &volume : volumes)
+    {
+      const auto mountPoint = volume.container.lexically_normal().string();
+      if (value == mountPoint || value.rfind(mountPoint + "/", 0) == 0)
+      {
+        if (mountPoint.size() >= bestLength)
+        {
+          best = volume.host / value.substr(std::min(value.size(), mountPoint.size() + 1));
+          bestLength = mountPoint.size();
+        }
+      }
+    }
+    return best;
+  }
+
+  // follows symlinks the way the container sees them (relative targets point into other volumes)
+  fs::path ResolveHost(const fs::path &containerPath, const std::vector<Volume> &volumes, int depth = 0)
+  {
+    const auto hostPath = ToHost(containerPath, volumes);
+    std::error_code ec;
+    if (hostPath.empty() || depth > 8 || !fs::is_symlink(fs::symlink_status(hostPath, ec)))
+      return hostPath;
+
+    const auto target = fs::read_symlink(hostPath, ec);
+    const auto containerTarget = target.is_absolute() ? target : containerPath.parent_path() / target;
+    return ResolveHost(containerTarget.lexically_normal(), volumes, depth + 1);
+  }
+
+  struct IoCounters
+  {
+    std::uintmax_t bytesRead = 0;
+    std::uintmax_t bytesWritten = 0;
+    std::size_t filesRead = 0;
+    std::size_t filesWritten = 0;
+  };
+
+  void ReadFile(const fs::path &file, IoCounters &counters)
+  {
+    std::ifstream stream(file, std::ios::binary);
+    char buffer[1 << 16];
+    while (stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0)
+      counters.bytesRead += static_cast<std::uintmax_t>(stream.gcount());
+    ++counters.filesRead;
+  }
+
+  void WriteOutput(const fs::path &file, IoCounters &counters)
+  {
+    const auto source = GetEnv("MITK_FAKE_DOCKER_OUTPUT_SOURCE");
+    if (!source.empty())
+    {
+      fs::copy_file(source, file, fs::copy_options::overwrite_existing);
+      counters.bytesWritten += fs::file_size(file);
+    }
+    else
+    {
+      const auto size = static_cast<std::uintmax_t>(GetEnvNumber("MITK_FAKE_DOCKER_OUTPUT_BYTES", 1024));
+      std::ofstream stream(file, std::ios::binary);
+      std::string block(1 << 16, '\0');
+      for (std::size_t i = 0; i < block.size(); ++i)
+        block[i] = static_cast<char>(i * 31 + 7);
+      for (std::uintmax_t written = 0; written < size;)
+      {
+        const auto n = std::min<std::uintmax_t>(block.size(), size - written);
+        stream.write(block.data(), static_cast<std::streamsize>(n));
+        written += n;
+      }
+      counters.bytesWritten += size;
+    }
+    ++counters.filesWritten;
+  }
+
+  // JSON string value behind the opening quote at pos; pos is moved behind the closing quote
+  std::string ParseJsonString(const std::string &text, std::size_t &pos)
+  {
+    std::string value;
+    while (pos < text.size() && text[pos] != '"')
+    {
+      char c = text[pos++];
+      if (c == '\\' && pos < text.size())
+      {
+        c = text[pos++];
+        if (c == 'n')
+          c = '\n';
+        else if (c == 't')
+          c = '\t';
+        else if (c == 'u')
+        {
+          c = static_cast<char>(std::strtol(text.substr(pos, 4).c_str(), nullptr, 16));
+          pos += 4;
+        }
+      }
+      value += c;
+    }
+    ++pos;
+    return value;
+  }
+
+  // members of the flat JSON requests of mitk::DockerWorker ({"args":[...],"id":1,"workdir":"..."})
+  long GetJsonNumber(const std::string &line, const std::string &key)
+  {
+    const auto pos = line.find("\"" + key + "\":");
+    return pos == std::string::npos ? -1 : std::strtol(line.c_str() + pos + key.size() + 3, nullptr, 10);
+  }
+
+  // all string arrays of the member key, e.g. the "args" of every job of a batch manifest
+  std::vector<std::vector<std::string>> GetJsonStringArrays(const std::string &text, const std::string &key)
+  {
+    std::vector<std::vector<std::string>> arrays;
+    for (auto pos = text.find("\"" + key + "\""); pos != std::string::npos; pos = text.find("\"" + key + "\"", pos))
+    {
+      pos = text.find_first_not_of(" \t\r\n:", pos + key.size() + 2);
+      if (pos == std::string::npos || text[pos] != '[')
+        continue;
+      std::vector<std::string> values;
+      for (++pos; pos < text.size() && text[pos] != ']';)
+      {
+        if (text[pos++] == '"')
+          values.push_back(ParseJsonString(text, pos));
+      }
+      arrays.push_back(values);
+    }
+    return arrays;
+  }
+
+  std::vector<std::string> GetJsonStrings(const std::string &line, const std::string &key)
+  {
+    const auto arrays = GetJsonStringArrays(line, key);
+    return arrays.empty() ? std::vector<std::string>() : arrays.front();
+  }
+
+  // emulates the container command on the mounted volumes and returns its exit code
+  int Emulate(const std::vector<std::string> &command, const std::vector<Volume> &volumes)
+  {
+    const auto lines = GetEnvNumber("MITK_FAKE_DOCKER_STDOUT_LINES", 1);
+    for (long i = 0; i < lines; ++i)
+      std::cout << "fake container output " << i + 1 << "/" << lines << std::endl;
+
+    if (command.size() >= 2 && command[0] == "sleep")
+      SleepMilliseconds(static_cast<long>(std::strtod(command[1].c_str(), nullptr) * 1000));
+
+    IoCounters counters;
+    std::set<fs::path> visited;
+    for (std::size_t i = 0; i < command.size(); ++i)
+    {
+      const auto &argument = command[i];
+      // batch manifest of mitk::DockerBatchHelper: every job is emulated with its arguments
+      if (argument == "--manifest" && i + 1 < command.size())
+      {
+        std::ifstream stream(ResolveHost(command[i + 1], volumes));
+        const std::string manifest((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        for (auto jobCommand : GetJsonStringArrays(manifest, "args"))
+        {
+          jobCommand.insert(jobCommand.begin(), "job");
+          Emulate(jobCommand, volumes);
+        }
+      }
+
+      if (argument.empty() || argument[0] != '/')
+        continue;
+      const auto hostPath = ResolveHost(argument, volumes);
+      if (hostPath.empty() || !visited.insert(hostPath).second)
+        continue;
+
+      std::error_code ec;
+      if (fs::is_regular_file(hostPath, ec))
+      {
+        ReadFile(hostPath, counters);
+      }
+      else if (fs::is_directory(hostPath, ec))
+      {
+        if (fs::is_empty(hostPath, ec))
+        {
+          for (const auto &name : Split(GetEnv("MITK_FAKE_DOCKER_OUTPUT_FILES", "output.nrrd"), ','))
+            WriteOutput(hostPath / name, counters);
+        }
+        else
+        {
+          for (const auto &entry : fs::recursive_directory_iterator(hostPath))
+          {
+            const auto file = entry.is_symlink() ? ResolveHost(fs::path(argument) / fs::relative(entry.path(), hostPath), volumes)
+                                                 : entry.path();
+            if (fs::is_regular_file(file, ec))
+              ReadFile(file, counters);
+          }
+        }
+      }
+      else if (!hostPath.parent_path().empty() && fs::is_directory(hostPath.parent_path(), ec))
+      {
+        WriteOutput(hostPath, counters);
+      }
+    }
+
+    SleepMilliseconds(GetEnvNumber("MITK_FAKE_DOCKER_RUN_MS", 0));
+    std::cerr << "fake docker: read " << counters.bytesRead << " bytes from " << counters.filesRead << " file(s), wrote "
+              << counters.bytesWritten << " bytes to " << counters.filesWritten << " file(s)" << std::endl;
+    return static_cast<int>(GetEnvNumber("MITK_FAKE_DOCKER_EXIT_CODE", 0));
+  }
+
+  // job loop of mitk::DockerWorker: one request per stdin line, a completion record per job on stdout
+  int Worker(const std::vector<Volume> &volumes)
+  {
+    const auto exitAfter = GetEnvNumber("MITK_FAKE_DOCKER_WORKER_EXIT_AFTER", 0);
+    const bool ignoreCancel = !GetEnv("MITK_FAKE_DOCKER_WORKER_IGNORE_CANCEL").empty();
+    std::atomic<long> cancelledJob{-1};
+    std::thread job;
+    long jobs = 0;
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+      const auto id = GetJsonNumber(line, "id");
+      if (line.find("\"cancel\":true") != std::string::npos)
+      {
+        if (!ignoreCancel)
+          cancelledJob = id;
+        continue;
+      }
+
+      if (job.joinable())
+        job.join();
+      if (exitAfter > 0 && ++jobs >= exitAfter)
+      {
+        std::cerr << "fake docker: worker terminated" << std::endl;
+        return 1;
+      }
+
+      // the job runs next to the loop, so that cancel requests are read
+      job = std::thread([&volumes, &cancelledJob, id, command = GetJsonStrings(line, "args")]() {
+        int code = 0;
+        if (command.size() >= 2 && command[0] == "sleep")
+        {
+          const auto deadline = std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(static_cast<long>(std::strtod(command[1].c_str(), nullptr) * 1000));
+          while (cancelledJob != id && std::chrono::steady_clock::now() < deadline)
+            SleepMilliseconds(20);
+        }
+        else
+        {
+          code = Emulate(command, volumes);
+        }
+
+        if (cancelledJob == id)
+          std::cout << "{\"id\": " << id << ", \"status\": \"cancelled\"}" << std::endl;
+        else if (code != 0)
+          std::cout << "{\"id\": " << id << ", \"status\": \"error\", \"message\": \"exit code " << code << "\"}" << std::endl;
+        else
+          std::cout << "{\"id\": " << id << ", \"status\": \"ok\"}" << std::endl;
+      });
+    }
+    if (job.joinable())
+      job.join();
+    return 0;
+  }
+
+  std::string FormatContainer(std::string format, const Container &container)
+  {
+    format = ReplaceAll(format, "{{.Names}}", container.name);
+    format = ReplaceAll(format, "{{.Name}}", "/" + container.name);
+    format = ReplaceAll(format, "{{.ID}}", container.id.substr(0, 12));
+    format = ReplaceAll(format, "{{.Id}}", container.id);
+    format = ReplaceAll(format, "{{.Image}}", container.image);
+    format = ReplaceAll(format, "{{.State.Running}}", container.running ? "true" : "false");
+    format = ReplaceAll(format, "{{.Status}}", container.running ? "Up" : "Exited");
+    return format;
+  }
+
+  std::string FormatImage(std::string format, const std::string &image)
+  {
+    const auto colon = image.rfind(':');
+    format = ReplaceAll(format, "{{.Repository}}", image.substr(0, colon));
+    format = ReplaceAll(format, "{{.Tag}}", image.substr(colon + 1));
+    format = ReplaceAll(format, "{{.ID}}", MakeId(image).substr(0, 12));
+    format = ReplaceAll(format, "{{.Id}}", "sha256:" + MakeId(image));
+    return format;
+  }
+
+  // options of run/exec that take a value
+  const std::set<std::string> ValueOptions = {
+    "-v", "--volume", "--name", "-e", "--env", "--entrypoint", "-w", "--workdir", "--gpus", "--cpus", "--cpuset-cpus",
+    "-m", "--memory", "--memory-swap", "--shm-size", "--pids-limit", "--tmpfs", "--ipc", "--network", "-u", "--user",
+    "--label", "-l", "--mount", "--platform"};
+
+  int Run(State &state, const std::vector<std::string> &args)
+  {
+    Container container;
+    bool detach = false;
+    bool autoRemove = false;
+    std::string entryPoint;
+    std::size_t i = 0;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i)
+    {
+      auto option = args[i];
+      std::string value;
+      const auto equals = option.find('=');
+      if (equals != std::string::npos)
+      {
+        value = option.substr(equals + 1);
+        option = option.substr(0, equals);
+      }
+      else if (ValueOptions.count(option) && i + 1 < args.size())
+      {
+        value = args[++i];
+      }
+
+      if (option == "-d" || option == "--detach")
+        detach = true;
+      else if (option == "--rm")
+        autoRemove = true;
+      else if (option == "--name")
+        container.name = value;
+      else if (option == "--entrypoint")
+        entryPoint = value;
+      else if (option == "-v" || option == "--volume")
+      {
+        const auto parts = Split(value, ':');
+        if (parts.size() >= 2)
+          container.volumes.push_back({parts[0], parts[1]});
+      }
+    }
+
+    if (i >= args.size())
+    {
+      std::cerr << "\"docker run\" requires at least 1 argument." << std::endl;
+      return 125;
+    }
+    container.image = NormalizeImage(args[i]);
+    std::vector<std::string> command(args.begin() + i + 1, args.end());
+    if (!entryPoint.empty())
+      command.insert(command.begin(), entryPoint);
+
+    if (container.name.empty())
+      container.name = "fake_" + std::to_string(getpid());
+    container.id = MakeId(container.name + std::to_string(getpid()));
+
+    {
+      Locked lock(state);
+      if (!state.HasImage(container.image))
+      {
+        if (!GetEnv("MITK_FAKE_DOCKER_NO_PULL").empty())
+        {
+          std::cerr << "Unable to find image '" << container.image << "' locally" << std::endl;
+          return 125;
+        }
+        std::cerr << "Unable to find image '" << container.image << "' locally" << std::endl;
+        SleepMilliseconds(GetEnvNumber("MITK_FAKE_DOCKER_PULL_MS", 0));
+        auto images = state.GetImages();
+        images.push_back(container.image);
+        state.SetImages(images);
+      }
+
+      Container existing;
+      if (state.GetContainer(container.name, existing))
+      {
+        std::cerr << "docker: Error response from daemon: Conflict. The container name \"/" << container.name
+                  << "\" is already in use." << std::endl;
+        return 125;
+      }
+
+      container.running = true;
+      container.pid = detach ? 0 : getpid();
+      state.WriteContainer(container);
+    }
+
+    if (detach)
+    {
+      std::cout << container.id << std::endl;
+      return 0;
+    }
+
+    SleepMilliseconds(GetEnvNumber("MITK_FAKE_DOCKER_START_MS", 0));
+    const int code = !command.empty() && command.front() == "m2-worker" ? Worker(container.volumes)
+                                                                         : Emulate(command, container.volumes);
+
+    Locked lock(state);
+    if (autoRemove)
+    {
+      state.RemoveContainer(container.name);
+    }
+    else
+    {
+      container.running = false;
+      container.pid = 0;
+      state.WriteContainer(container);
+    }
+    return code;
+  }
+
+  int Exec(State &state, const std::vector<std::string> &args)
+  {
+    std::size_t i = 0;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i)
+      if (ValueOptions.count(args[i]) && args[i].find('=') == std::string::npos)
+        ++i;
+
+    if (i >= args.size())
+    {
+      std::cerr << "\"docker exec\" requires at least 2 arguments." << std::endl;
+      return 1;
+    }
+
+    Container container;
+    {
+      Locked lock(state);
+      if (!state.GetContainer(args[i], container) || !container.running)
+      {
+        std::cerr << "Error response from daemon: container " << args[i] << " is not running" << std::endl;
+        return 1;
+      }
+    }
+    return Emulate(std::vector<std::string>(args.begin() + i + 1, args.end()), container.volumes);
+  }
+
+  std::string GetFormat(const std::vector<std::string> &args)
+  {
+    for (std::size_t i = 0; i + 1 < args.size(); ++i)
+      if (args[i] == "--format" || args[i] == "-f")
+        return args[i + 1];
+    return "";
+  }
+
+  // positional arguments; valueOptions are skipped with their value
+  std::vector<std::string> GetOperands(const std::vector<std::string> &args, const std::set<std::string> &valueOptions)
+  {
+    std::vector<std::string> operands;
+    for (std::size_t i = 0; i < args.size(); ++i)
+    {
+      if (valueOptions.count(args[i]))
+        ++i;
+      else if (args[i].empty() || args[i][0] != '-')
+        operands.push_back(args[i]);
+    }
+    return operands;
+  }
+
+  bool HasFlag(const std::vector<std::string> &args, const std::string &shortFlag, const std::string &longFlag)
+  {
+    return std::find(args.begin(), args.end(), shortFlag) != args.end() ||
+           std::find(args.begin(), args.end(), longFlag) != args.end();
+  }
+
+  int Ps(State &state, const std::vector<std::string> &args)
+  {
+    const bool all = HasFlag(args, "-a", "--all");
+    const bool quiet = HasFlag(args, "-q", "--quiet");
+    std::string nameFilter;
+    for (std::size_t i = 0; i + 1 < args.size(); ++i)
+      if (args[i] == "--filter" && args[i + 1].rfind("name=", 0) == 0)
+        nameFilter = args[i + 1].substr(5);
+
+    const auto format = GetFormat(args);
+    if (format.empty() && !quiet)
+      std::cout << "CONTAINER ID   IMAGE   COMMAND   STATUS   NAMES" << std::endl;
+
+    Locked lock(state);
+    for (const auto &container : state.GetContainers())
+    {
+      if (!all && !container.running)
+        continue;
+      if (!nameFilter.empty() && container.name.find(nameFilter) == std::string::npos)
+        continue;
+      if (quiet)
+        std::cout << container.id.substr(0, 12) << std::endl;
+      else if (!format.empty())
+        std::cout << FormatContainer(format, container) << std::endl;
+      else
+        std::cout << FormatContainer("{{.ID}}   {{.Image}}   \"fake\"   {{.Status}}   {{.Names}}", container) << std::endl;
+    }
+    return 0;
+  }
+
+  int Images(State &state, const std::vector<std::string> &args)
+  {
+    const bool quiet = HasFlag(args, "-q", "--quiet");
+    const auto format = GetFormat(args);
+    if (format.empty() && !quiet)
+      std::cout << "REPOSITORY   TAG   IMAGE ID" << std::endl;
+
+    Locked lock(state);
+    for (const auto &image : state.GetImages())
+    {
+      if (quiet)
+        std::cout << MakeId(image).substr(0, 12) << std::endl;
+      else if (!format.empty())
+        std::cout << FormatImage(format, image) << std::endl;
+      else
+        std::cout << FormatImage("{{.Repository}}   {{.Tag}}   {{.ID}}", image) << std::endl;
+    }
+    return 0;
+  }
+
+  int Pull(State &state, const std::vector<std::string> &args)
+  {
+    const auto operands = GetOperands(args, {"--platform"});
+    if (operands.empty())
+    {
+      std::cerr << "\"docker pull\" requires exactly 1 argument." << std::endl;
+      return 1;
+    }
+    const auto image = NormalizeImage(operands.front());
+    std::cout << "Pulling " << image << std::endl;
+    SleepMilliseconds(GetEnvNumber("MITK_FAKE_DOCKER_PULL_MS", 0));
+
+    Locked lock(state);
+    auto images = state.GetImages();
+    if (std::find(images.begin(), images.end(), image) == images.end())
+      images.push_back(image);
+    state.SetImages(images);
+    std::cout << "Status: Downloaded newer image for " << image << std::endl;
+    return 0;
+  }
+
+  int Rmi(State &state, const std::vector<std::string> &args)
+  {
+    const bool force = HasFlag(args, "-f", "--force");
+    int code = 0;
+    Locked lock(state);
+    auto images = state.GetImages();
+    for (const auto &operand : GetOperands(args, {}))
+    {
+      const auto image = NormalizeImage(operand);
+      auto it = std::find(images.begin(), images.end(), image);
+      if (it == images.end())
+      {
+        if (!force)
+        {
+          std::cerr << "Error response from daemon: No such image: " << image << std::endl;
+          code = 1;
+        }
+        continue;
+      }
+      images.erase(it);
+      std::cout << "Untagged: " << image << std::endl;
+    }
+    state.SetImages(images);
+    return code;
+  }
+
+  int Inspect(State &state, const std::vector<std::string> &args, bool imagesOnly)
+  {
+    const auto format = GetFormat(args);
+    int code = 0;
+    Locked lock(state);
+    for (const auto &operand : GetOperands(args, {"-f", "--format", "--type"}))
+    {
+      Container container;
+      if (!imagesOnly && state.GetContainer(operand, container))
+      {
+        if (!format.empty())
+          std::cout << FormatContainer(format, container) << std::endl;
+        else
+          std::cout << FormatContainer("[{\"Id\": \"{{.Id}}\", \"Name\": \"{{.Name}}\", \"Image\": \"{{.Image}}\", "
+                                       "\"State\": {\"Running\": {{.State.Running}}}}]",
+                                       container)
+                    << std::endl;
+      }
+      else if (state.HasImage(operand))
+      {
+        const auto image = NormalizeImage(operand);
+        if (!format.empty())
+          std::cout << FormatImage(format, image) << std::endl;
+        else
+          std::cout << FormatImage("[{\"Id\": \"{{.Id}}\", \"RepoTags\": [\"" + image + "\"]}]", image) << std::endl;
+      }
+      else
+      {
+        std::cerr << "Error: No such object: " << operand << std::endl;
+        code = 1;
+      }
+    }
+    return code;
+  }
+
+  // kill, stop and rm
+  int StopContainers(State &state, const std::string &command, const std::vector<std::string> &args)
+  {
+    long gracePeriod = 10;
+    for (std::size_t i = 0; i + 1 < args.size(); ++i)
+      if (args[i] == "-t" || args[i] == "--time")
+        gracePeriod = std::strtol(args[i + 1].c_str(), nullptr, 10);
+    const bool force = HasFlag(args, "-f", "--force");
+
+    int code = 0;
+    for (const auto &name : GetOperands(args, {"-t", "--time", "-s", "--signal"}))
+    {
+      Container container;
+      {
+        Locked lock(state);
+        if (!state.GetContainer(name, container))
+        {
+          std::cerr << "Error response from daemon: No such container: " << name << std::endl;
+          code = 1;
+          continue;
+        }
+        if (command == "rm" && container.running && !force)
+        {
+          std::cerr << "Error response from daemon: You cannot remove a running container " << container.id << std::endl;
+          code = 1;
+          continue;
+        }
+      }
+
+      if (container.running && container.pid > 0)
+      {
+        if (command == "stop")
+        {
+          kill(container.pid, SIGTERM);
+          const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(gracePeriod);
+          while (kill(container.pid, 0) == 0 && std::chrono::steady_clock::now() < deadline)
+            SleepMilliseconds(20);
+        }
+        kill(container.pid, SIGKILL);
+      }
+
+      Locked lock(state);
+      if (command == "rm")
+      {
+        state.RemoveContainer(container.name);
+      }
+      else
+      {
+        container.running = false;
+        container.pid = 0;
+        state.WriteContainer(container);
+      }
+      std::cout << name << std::endl;
+    }
+    return code;
+  }
+
+  int Stats(State &state, const std::vector<std::string> &args)
+  {
+    const auto format = GetFormat(args);
+    const auto operands = GetOperands(args, {"--format"});
+    if (format.empty())
+      std::cout << "CONTAINER ID   NAME   CPU %   MEM USAGE / LIMIT   BLOCK I/O" << std::endl;
+
+    Locked lock(state);
+    for (const auto &container : state.GetContainers())
+    {
+      if (!container.running)
+        continue;
+      if (!operands.empty() && std::find(operands.begin(), operands.end(), container.name) == operands.end())
+        continue;
+      auto line = format.empty() ? "{{.ID}}   {{.Name}}   {{.CPUPerc}}   {{.MemUsage}}   {{.BlockIO}}" : format;
+      line = ReplaceAll(line, "{{.Name}}", container.name);
+      line = ReplaceAll(line, "{{.CPUPerc}}", "0.00%");
+      line = ReplaceAll(line, "{{.MemUsage}}", "0B / 0B");
+      line = ReplaceAll(line, "{{.MemPerc}}", "0.00%");
+      line = ReplaceAll(line, "{{.BlockIO}}", "0B / 0B");
+      line = ReplaceAll(line, "{{.NetIO}}", "0B / 0B");
+      line = ReplaceAll(line, "{{.PIDs}}", "0");
+      std::cout << FormatContainer(line, container) << std::endl;
+    }
+    return 0;
+  }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty())
+  {
+    std::cerr << "Usage: docker COMMAND (fake docker for tests)" << std::endl;
+    return 1;
+  }
+
+  SleepMilliseconds(GetEnvNumber("MITK_FAKE_DOCKER_LATENCY_MS", 0));
+
+  auto command = args.front();
+  args.erase(args.begin());
+
+  // "docker image inspect|ls|pull|rm" and "docker container ..."
+  if ((command == "image" || command == "container") && !args.empty())
+  {
+    const auto subcommand = args.front();
+    args.erase(args.begin());
+    if (command == "image")
+    {
+      if (subcommand == "inspect")
+      {
+        State state;
+        return Inspect(state, args, true);
+      }
+      command = subcommand == "ls" ? "images" : subcommand == "rm" ? "rmi" : subcommand;
+    }
+    else
+    {
+      command = subcommand == "ls" ? "ps" : subcommand;
+    }
+  }
+
+  try
+  {
+    State state;
+    if (command == "run")
+      return Run(state, args);
+    if (command == "exec")
+      return Exec(state, args);
+    if (command == "ps")
+      return Ps(state, args);
+    if (command == "images")
+      return Images(state, args);
+    if (command == "pull")
+      return Pull(state, args);
+    if (command == "rmi")
+      return Rmi(state, args);
+    if (command == "inspect")
+      return Inspect(state, args, false);
+    if (command == "kill" || command == "stop" || command == "rm")
+      return StopContainers(state, command, args);
+    if (command == "stats")
+      return Stats(state, args);
+    if (command == "version" || command == "info")
+    {
+      std::cout << "Server Version: fake" << std::endl;
+      return 0;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "fake docker: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::cerr << "fake docker: unsupported command \"" << command << "\"" << std::endl;
+  return 1;
+}
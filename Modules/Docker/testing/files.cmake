@@ -1,4 +1,20 @@
 set(MODULE_TESTS
   DockerTest
+  mitkDockerBatchRunnerTest
   mitkDockerImageManagerTest
+  mitkDockerEngineClientTest
+  mitkDockerFakeTest
+  mitkDockerInputStoreTest
+  mitkDockerJobSchedulerTest
+  mitkDockerMountPlannerTest
+  mitkDockerResourceLimitsTest
+  mitkDockerResourceSamplerTest
+  mitkDockerResultCacheTest
+  mitkDockerResultHandleTest
+  mitkDockerRunReportTest
+  mitkDockerScratchPolicyTest
+  mitkDockerStagingCacheTest
+  mitkDockerStagingWriterTest
+  mitkDockerWorkerTest
+  mitkDockerWorkingDirectoryManagerTest
 )
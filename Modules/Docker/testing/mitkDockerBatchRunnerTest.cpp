@@ -0,0 +1,196 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerBatchRunner.h>
+#include <mitkDockerProcess.h>
+#include <mitkIOUtil.h>
+#include <mitkImage.h>
+#include <mitkImageWriteAccessor.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerBatchRunnerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerBatchRunnerTestSuite);
+
+  MITK_TEST(ParseJobSpec_RequiresImageAndInputs);
+  MITK_TEST(ExpandSource_ReplacesVariables);
+  MITK_TEST(CreateJobs_MakesNamesUnique);
+  MITK_TEST(MoveOutput_ReplacesTarget);
+  MITK_TEST(RunJob_ResumeSkipsFinishedJobs);
+  MITK_TEST(RunJob_ChangedSpecRunsAllJobs);
+  MITK_TEST(RunJob_LinksInputsWithoutLoading);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+
+  static nlohmann::json CreateSpec()
+  {
+    return {{"image", "alpine"},
+            {"inputs", {{{"argument", "--input"}, {"name", "input"}, {"extension", ".nrrd"}}}},
+            {"outputs", {{{"argument", "--output"}, {"path", "result.txt"}}}}};
+  }
+
+  std::vector<boost::filesystem::path> CreateInputs()
+  {
+    auto image = mitk::Image::New();
+    unsigned int dimensions[3] = {8, 8, 8};
+    image->Initialize(mitk::MakeScalarPixelType<float>(), 3, dimensions);
+    {
+      mitk::ImageWriteAccessor accessor(image);
+      std::fill_n(static_cast<float *>(accessor.GetData()), 8 * 8 * 8, 1.0f);
+    }
+
+    std::vector<boost::filesystem::path> inputs;
+    for (const auto *name : {"case_01.nrrd", "case_02.nrrd"})
+    {
+      inputs.push_back(m_Root / "data" / name);
+      boost::filesystem::create_directories(inputs.back().parent_path());
+      mitk::IOUtil::Save(image, inputs.back().string());
+    }
+    return inputs;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_batch_runner_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+    setenv("MITK_FAKE_DOCKER_STATE_DIR", (m_Root / "state").string().c_str(), 1);
+    mitk::DockerProcess::SetExecutable(MITK_DOCKER_FAKE_EXECUTABLE);
+  }
+
+  void tearDown() override
+  {
+    mitk::DockerProcess::SetExecutable("");
+    unsetenv("MITK_FAKE_DOCKER_STATE_DIR");
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void ParseJobSpec_RequiresImageAndInputs()
+  {
+    auto spec = CreateSpec();
+    const auto parsed = mitk::DockerBatchRunner::ParseJobSpec(spec);
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine"), parsed.image);
+    CPPUNIT_ASSERT_EQUAL(std::string("{input}"), parsed.inputs.front().source);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), parsed.outputs.size());
+
+    spec.erase("inputs");
+    CPPUNIT_ASSERT_THROW(mitk::DockerBatchRunner::ParseJobSpec(spec), mitk::Exception);
+    CPPUNIT_ASSERT_THROW(mitk::DockerBatchRunner::ParseJobSpec({{"inputs", CreateSpec()["inputs"]}}), mitk::Exception);
+  }
+
+  void ExpandSource_ReplacesVariables()
+  {
+    const mitk::DockerBatchRunner::Job job = {"case_01", "/data/images/case_01.nii.gz"};
+    CPPUNIT_ASSERT_EQUAL(std::string("/data/images/case_01.nii.gz"), mitk::DockerBatchRunner::ExpandSource("{input}", job));
+    CPPUNIT_ASSERT_EQUAL(std::string("/data/images/masks/case_01_mask.nrrd"),
+                         mitk::DockerBatchRunner::ExpandSource("{dir}/masks/{stem}_mask.nrrd", job));
+    CPPUNIT_ASSERT_EQUAL(std::string("case_01-case_01"), mitk::DockerBatchRunner::ExpandSource("{stem}-{stem}", job));
+    CPPUNIT_ASSERT_EQUAL(std::string(".nii.gz"), mitk::DockerBatchRunner::Extension(job.input));
+  }
+
+  void CreateJobs_MakesNamesUnique()
+  {
+    const auto jobs = mitk::DockerBatchRunner::CreateJobs({"b/case.nrrd", "a/case.nrrd", "c/other.nii.gz", "a/case.nrrd"});
+    CPPUNIT_ASSERT_EQUAL(std::size_t(3), jobs.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("case"), jobs[0].name);
+    CPPUNIT_ASSERT_EQUAL(std::string("a"), jobs[0].input.parent_path().filename().string());
+    CPPUNIT_ASSERT_EQUAL(std::string("case_1"), jobs[1].name);
+    CPPUNIT_ASSERT_EQUAL(std::string("other"), jobs[2].name);
+    CPPUNIT_ASSERT(jobs[2].input.is_absolute());
+  }
+
+  void MoveOutput_ReplacesTarget()
+  {
+    const auto source = m_Root / "workdir" / "segmentations";
+    boost::filesystem::create_directories(source / "organs");
+    boost::filesystem::ofstream(source / "organs" / "liver.nrrd") << "liver";
+    const auto target = m_Root / "output" / "case" / "segmentations";
+    boost::filesystem::create_directories(target);
+    boost::filesystem::ofstream(target / "stale.nrrd") << "stale";
+
+    mitk::DockerBatchRunner::MoveOutput(source, target);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(source));
+    CPPUNIT_ASSERT(boost::filesystem::exists(target / "organs" / "liver.nrrd"));
+    CPPUNIT_ASSERT(!boost::filesystem::exists(target / "stale.nrrd"));
+  }
+
+  void RunJob_ResumeSkipsFinishedJobs()
+  {
+    const auto jobs = mitk::DockerBatchRunner::CreateJobs(CreateInputs());
+    const auto outputDirectory = m_Root / "output";
+    {
+      mitk::DockerBatchRunner runner(CreateSpec(), outputDirectory);
+      for (const auto &job : jobs)
+      {
+        CPPUNIT_ASSERT(!runner.IsFinished(job));
+        const auto entry = runner.RunJob(job);
+        CPPUNIT_ASSERT_EQUAL(std::string("finished"), entry["status"].get<std::string>());
+        CPPUNIT_ASSERT(boost::filesystem::exists(outputDirectory / job.name / "result.txt"));
+      }
+    }
+    CPPUNIT_ASSERT(boost::filesystem::exists(outputDirectory / "batch_state.json"));
+
+    // a second invocation skips the finished jobs unless their outputs are gone
+    boost::filesystem::remove(outputDirectory / jobs[1].name / "result.txt");
+    mitk::DockerBatchRunner runner(CreateSpec(), outputDirectory);
+    CPPUNIT_ASSERT(runner.IsFinished(jobs[0]));
+    CPPUNIT_ASSERT(!runner.IsFinished(jobs[1]));
+    runner.RunJob(jobs[1]);
+    CPPUNIT_ASSERT(runner.IsFinished(jobs[1]));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), runner.GetJobStates().size());
+  }
+
+  void RunJob_ChangedSpecRunsAllJobs()
+  {
+    const auto jobs = mitk::DockerBatchRunner::CreateJobs(CreateInputs());
+    const auto outputDirectory = m_Root / "output";
+    {
+      mitk::DockerBatchRunner runner(CreateSpec(), outputDirectory);
+      runner.RunJob(jobs[0]);
+      CPPUNIT_ASSERT(runner.IsFinished(jobs[0]));
+    }
+
+    auto spec = CreateSpec();
+    spec["arguments"] = {"--fast"};
+    mitk::DockerBatchRunner runner(spec, outputDirectory);
+    CPPUNIT_ASSERT(!runner.IsFinished(jobs[0]));
+    CPPUNIT_ASSERT(runner.GetJobStates().empty());
+  }
+
+  void RunJob_LinksInputsWithoutLoading()
+  {
+    // not a readable image: the input has to be passed on without loading it
+    const auto input = m_Root / "data" / "case_01.nrrd";
+    boost::filesystem::create_directories(input.parent_path());
+    boost::filesystem::ofstream(input) << "not an image";
+
+    mitk::DockerBatchRunner runner(CreateSpec(), m_Root / "output");
+    const auto entry = runner.RunJob(mitk::DockerBatchRunner::CreateJobs({input}).front());
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), entry["status"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(0, entry["report"]["staging"]["filesWritten"].get<int>());
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerBatchRunner)
@@ -0,0 +1,314 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerEngineClient.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  /**
+   * Serves HTTP responses on a UNIX domain socket. The handler receives the request
+   * line and the body and returns the raw response.
+   */
+  class MockDockerSocket
+  {
+  public:
+    using Handler = std::function<std::string(const std::string &requestLine, const std::string &body)>;
+
+    explicit MockDockerSocket(Handler handler) : m_Handler(handler)
+    {
+      char directory[] = "/tmp/m2_mock_docker_XXXXXX";
+      m_Directory = mkdtemp(directory);
+      m_Path = m_Directory + "/docker.sock";
+
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strncpy(address.sun_path, m_Path.c_str(), sizeof(address.sun_path) - 1);
+
+      m_Socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      ::bind(m_Socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+      ::listen(m_Socket, 8);
+      m_Thread = std::thread([this]() { Serve(); });
+    }
+
+    ~MockDockerSocket()
+    {
+      ::shutdown(m_Socket, SHUT_RDWR);
+      ::close(m_Socket);
+      m_Thread.join();
+      ::unlink(m_Path.c_str());
+      ::rmdir(m_Directory.c_str());
+    }
+
+    std::string GetPath() const { return m_Path; }
+
+    std::vector<std::string> GetRequests()
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      return m_Requests;
+    }
+
+    std::string GetLastBody()
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      return m_LastBody;
+    }
+
+  private:
+    void Serve()
+    {
+      while (true)
+      {
+        int client = ::accept(m_Socket, nullptr, nullptr);
+        if (client < 0)
+          return;
+
+        std::string request;
+        char chunk[4096];
+        std::size_t headerEnd = std::string::npos;
+        std::size_t contentLength = 0;
+        while (true)
+        {
+          auto n = ::recv(client, chunk, sizeof(chunk), 0);
+          if (n <= 0)
+            break;
+          request.append(chunk, n);
+          if (headerEnd == std::string::npos && (headerEnd = request.find("\r\n\r\n")) != std::string::npos)
+          {
+            const auto pos = request.find("Content-Length: ");
+            if (pos != std::string::npos && pos < headerEnd)
+              contentLength = std::stoul(request.substr(pos + 16));
+          }
+          if (headerEnd != std::string::npos && request.size() >= headerEnd + 4 + contentLength)
+            break;
+        }
+
+        const auto requestLine = request.substr(0, request.find(" HTTP/1.1"));
+        const auto body = headerEnd == std::string::npos ? std::string() : request.substr(headerEnd + 4);
+        {
+          std::lock_guard<std::mutex> lock(m_Mutex);
+          m_Requests.push_back(requestLine);
+          m_LastBody = body;
+        }
+
+        const auto response = m_Handler(requestLine, body);
+        ::send(client, response.data(), response.size(), MSG_NOSIGNAL);
+        ::close(client);
+      }
+    }
+
+    Handler m_Handler;
+    std::string m_Directory;
+    std::string m_Path;
+    int m_Socket = -1;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::vector<std::string> m_Requests;
+    std::string m_LastBody;
+  };
+
+  std::string JsonResponse(int status, const std::string &body)
+  {
+    return "HTTP/1.1 " + std::to_string(status) + " X\r\nContent-Type: application/json\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+  }
+
+  std::string LogFrame(char stream, const std::string &payload)
+  {
+    std::string frame(8, '\0');
+    frame[0] = stream;
+    frame[7] = static_cast<char>(payload.size());
+    return frame + payload;
+  }
+} // namespace
+
+class mitkDockerEngineClientTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerEngineClientTestSuite);
+
+  MITK_TEST(TestUnavailableSocket);
+  MITK_TEST(TestPing);
+  MITK_TEST(TestListImages);
+  MITK_TEST(TestChunkedStreaming);
+  MITK_TEST(TestFollowLogsDemultiplexes);
+  MITK_TEST(TestErrorStatusThrows);
+  MITK_TEST(TestCreateContainer);
+  MITK_TEST(TestTranslateRunArguments);
+  MITK_TEST(TestTranslateUnsupportedArgument);
+  MITK_TEST(TestSplitImageName);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void TestUnavailableSocket()
+  {
+    mitk::DockerEngineClient client("/tmp/m2_no_such_docker.sock");
+    CPPUNIT_ASSERT(!client.IsAvailable());
+    CPPUNIT_ASSERT_THROW(client.Ping(), mitk::Exception);
+  }
+
+  void TestPing()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) { return JsonResponse(200, "OK"); });
+    mitk::DockerEngineClient client(server.GetPath());
+    CPPUNIT_ASSERT(client.IsAvailable());
+    CPPUNIT_ASSERT_EQUAL(std::string("GET /_ping"), server.GetRequests().back());
+  }
+
+  void TestListImages()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) {
+      return JsonResponse(200,
+                          R"([{"RepoTags":["alpine:latest","alpine:3"]},{"RepoTags":null},{"RepoTags":["<none>:<none>"]}])");
+    });
+    mitk::DockerEngineClient client(server.GetPath());
+    const auto images = client.ListImages();
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), images.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine:latest"), images[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("GET /images/json"), server.GetRequests().back());
+  }
+
+  void TestChunkedStreaming()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) {
+      return std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "5\r\nhello\r\n"
+                         "6\r\n world\r\n"
+                         "0\r\n\r\n");
+    });
+    mitk::DockerEngineClient client(server.GetPath());
+
+    std::string streamed;
+    int calls = 0;
+    auto response = client.Request("GET", "/stream", "", [&](const char *data, std::size_t size) {
+      streamed.append(data, size);
+      ++calls;
+    });
+    CPPUNIT_ASSERT_EQUAL(200, response.status);
+    CPPUNIT_ASSERT_EQUAL(std::string("hello world"), streamed);
+    CPPUNIT_ASSERT_EQUAL(2, calls);
+    CPPUNIT_ASSERT(response.body.empty());
+  }
+
+  void TestFollowLogsDemultiplexes()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) {
+      const auto body = LogFrame(1, "first li") + LogFrame(1, "ne\nsecond\n") + LogFrame(2, "an error\n");
+      return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    });
+    mitk::DockerEngineClient client(server.GetPath());
+
+    std::vector<std::string> out, err;
+    client.FollowLogs("abc", [&](mitk::DockerProcess::Stream stream, const std::string &line) {
+      (stream == mitk::DockerProcess::Stream::StdErr ? err : out).push_back(line);
+    });
+
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), out.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("first line"), out[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("second"), out[1]);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), err.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("an error"), err[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("GET /containers/abc/logs?follow=1&stdout=1&stderr=1"), server.GetRequests().back());
+  }
+
+  void TestErrorStatusThrows()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) {
+      return JsonResponse(404, R"({"message":"No such image: foo:latest"})");
+    });
+    mitk::DockerEngineClient client(server.GetPath());
+    CPPUNIT_ASSERT(!client.HasImage("foo:latest"));
+    CPPUNIT_ASSERT_THROW(client.RemoveImage("foo:latest"), mitk::Exception);
+    CPPUNIT_ASSERT_EQUAL(std::string("DELETE /images/foo%3Alatest?force=1"), server.GetRequests().back());
+  }
+
+  void TestCreateContainer()
+  {
+    MockDockerSocket server([](const std::string &, const std::string &) { return JsonResponse(201, R"({"Id":"1234"})"); });
+    mitk::DockerEngineClient client(server.GetPath());
+
+    nlohmann::json config;
+    config["Image"] = "alpine";
+    CPPUNIT_ASSERT_EQUAL(std::string("1234"), client.CreateContainer("m2_test", config));
+    CPPUNIT_ASSERT_EQUAL(std::string("POST /containers/create?name=m2_test"), server.GetRequests().back());
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine"), nlohmann::json::parse(server.GetLastBody())["Image"].get<std::string>());
+  }
+
+  void TestTranslateRunArguments()
+  {
+    nlohmann::json config;
+    std::string name;
+    const bool ok = mitk::DockerEngineClient::TranslateRunArguments(
+      {"-v", "/host:/m2_abc", "--rm", "--gpus", "device=all", "--ipc=host", "--name", "m2_abc", "-e", "A=1"},
+      "alpine:3",
+      {"echo", "hello"},
+      config,
+      name);
+
+    CPPUNIT_ASSERT(ok);
+    CPPUNIT_ASSERT_EQUAL(std::string("m2_abc"), name);
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine:3"), config["Image"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(std::string("hello"), config["Cmd"][1].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(std::string("A=1"), config["Env"][0].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(std::string("/host:/m2_abc"), config["HostConfig"]["Binds"][0].get<std::string>());
+    CPPUNIT_ASSERT(config["HostConfig"]["AutoRemove"].get<bool>());
+    CPPUNIT_ASSERT_EQUAL(std::string("host"), config["HostConfig"]["IpcMode"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(-1, config["HostConfig"]["DeviceRequests"][0]["Count"].get<int>());
+  }
+
+  void TestTranslateUnsupportedArgument()
+  {
+    nlohmann::json config;
+    std::string name;
+    CPPUNIT_ASSERT(!mitk::DockerEngineClient::TranslateRunArguments({"--privileged"}, "alpine", {}, config, name));
+    CPPUNIT_ASSERT(!mitk::DockerEngineClient::TranslateRunArguments({"-v"}, "alpine", {}, config, name));
+  }
+
+  void TestSplitImageName()
+  {
+    std::string name, tag;
+    mitk::DockerEngineClient::SplitImageName("localhost:5000/seg/model", name, tag);
+    CPPUNIT_ASSERT_EQUAL(std::string("localhost:5000/seg/model"), name);
+    CPPUNIT_ASSERT_EQUAL(std::string("latest"), tag);
+
+    mitk::DockerEngineClient::SplitImageName("wasserth/totalsegmentator:2.2.1", name, tag);
+    CPPUNIT_ASSERT_EQUAL(std::string("wasserth/totalsegmentator"), name);
+    CPPUNIT_ASSERT_EQUAL(std::string("2.2.1"), tag);
+
+    // digest references are pulled by digest
+    mitk::DockerEngineClient::SplitImageName("localhost:5000/seg/model@sha256:0123abcd", name, tag);
+    CPPUNIT_ASSERT_EQUAL(std::string("localhost:5000/seg/model"), name);
+    CPPUNIT_ASSERT_EQUAL(std::string("sha256:0123abcd"), tag);
+
+    mitk::DockerEngineClient::SplitImageName("wasserth/totalsegmentator:2.2.1@sha256:0123abcd", name, tag);
+    CPPUNIT_ASSERT_EQUAL(std::string("wasserth/totalsegmentator"), name);
+    CPPUNIT_ASSERT_EQUAL(std::string("sha256:0123abcd"), tag);
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerEngineClient)
@@ -0,0 +1,585 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerBatchHelper.h>
+#include <mitkDockerHelper.h>
+#include <mitkDockerInputStore.h>
+#include <mitkDockerJobExecutor.h>
+#include <mitkDockerParameterSweep.h>
+#include <mitkDockerProcess.h>
+#include <mitkDockerResultCache.h>
+#include <mitkIOUtil.h>
+#include <mitkImage.h>
+#include <mitkImageWriteAccessor.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <nlohmann/json.hpp>
+
+// runs DockerHelper against the MitkDockerFake executable, no daemon required
+class mitkDockerFakeTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerFakeTestSuite);
+
+  MITK_TEST(CanRunDocker_WithFake);
+  MITK_TEST(Run_WritesOutputs);
+  MITK_TEST(Run_StagesInputs);
+  MITK_TEST(Run_StagesObjectsInParallel);
+  MITK_TEST(Run_StagingErrorsAreAggregated);
+  MITK_TEST(Run_LogFileIsTruncated);
+  MITK_TEST(Run_ExitCodeThrows);
+  MITK_TEST(Run_StallTimeoutThrows);
+  MITK_TEST(Run_RunTimeoutThrows);
+  MITK_TEST(Run_CompletedRunIsNotTimedOut);
+  MITK_TEST(Run_CancelledHelperRunsAgain);
+  MITK_TEST(Run_AsyncHelperRunsAgain);
+  MITK_TEST(Run_ResultCacheHit);
+  MITK_TEST(Run_ResultCacheMissesRewrittenInput);
+  MITK_TEST(Rerun_ReusesUnchangedInputs);
+  MITK_TEST(Staging_LinksObjectBoundTwice);
+  MITK_TEST(Staging_LinksFileOfOtherHelper);
+  MITK_TEST(Staging_InputStoreIsShared);
+  MITK_TEST(Staging_LinksFilesOnDiskWithFewMounts);
+  MITK_TEST(Executor_RunsSpecRepeatedly);
+  MITK_TEST(Batch_RunsJobsFromManifest);
+  MITK_TEST(Sweep_RunsGridOnSharedInputs);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+
+  static mitk::Image::Pointer CreateImage()
+  {
+    auto image = mitk::Image::New();
+    unsigned int dimensions[3] = {16, 16, 16};
+    image->Initialize(mitk::MakeScalarPixelType<float>(), 3, dimensions);
+    mitk::ImageWriteAccessor accessor(image);
+    std::fill_n(static_cast<float *>(accessor.GetData()), 16 * 16 * 16, 1.0f);
+    return image;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_fake_docker_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+    setenv("MITK_FAKE_DOCKER_STATE_DIR", (m_Root / "state").string().c_str(), 1);
+    mitk::DockerProcess::SetExecutable(MITK_DOCKER_FAKE_EXECUTABLE);
+  }
+
+  void tearDown() override
+  {
+    mitk::DockerProcess::SetExecutable("");
+    for (const auto *name :
+         {"MITK_FAKE_DOCKER_STATE_DIR", "MITK_FAKE_DOCKER_EXIT_CODE", "MITK_FAKE_DOCKER_STDOUT_LINES", "MITK_FAKE_DOCKER_OUTPUT_SOURCE",
+          "MITK_FAKE_DOCKER_RUN_MS"})
+      unsetenv(name);
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void CanRunDocker_WithFake()
+  {
+    CPPUNIT_ASSERT(mitk::DockerProcess::HasCustomExecutable());
+    CPPUNIT_ASSERT(mitk::DockerHelper::CanRunDocker());
+  }
+
+  void Run_WritesOutputs()
+  {
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddApplicationArgument("true");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+    const auto manifest = helper.GetResultManifest();
+
+    const auto it = std::find_if(manifest.begin(), manifest.end(), [](const auto &handle) { return handle->GetArgument() == "--output"; });
+    CPPUNIT_ASSERT(it != manifest.end());
+    CPPUNIT_ASSERT((*it)->Exists());
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(1024), (*it)->GetSize());
+
+    const auto &report = helper.GetRunReport();
+    CPPUNIT_ASSERT_EQUAL(std::string("cli"), report.backend);
+    CPPUNIT_ASSERT_EQUAL(0, report.exitCode);
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), report.status);
+  }
+
+  void Run_StagesInputs()
+  {
+    auto image = CreateImage();
+
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    helper.GetResults();
+
+    const auto &report = helper.GetRunReport();
+    CPPUNIT_ASSERT(report.stagingBytesWritten > 16 * 16 * 16 * sizeof(float) / 2);
+    CPPUNIT_ASSERT(report.stagingFilesWritten >= 1);
+  }
+
+  void Run_StagesObjectsInParallel()
+  {
+    std::vector<mitk::BaseData::Pointer> images;
+    for (int i = 0; i < 12; ++i)
+      images.push_back(CreateImage().GetPointer());
+
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.SetStagingThreads(4);
+    helper.AddAutoSaveData(images, "--inputs", "inputs/image_%1%", ".nrrd");
+    helper.AddAutoSaveData(images.front(), "--mask", "mask", ".nrrd");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+    helper.GetResultManifest();
+
+    for (int i = 0; i < 12; ++i)
+      CPPUNIT_ASSERT(boost::filesystem::exists(helper.GetWorkingDirectory() / "inputs" / ("image_" + std::to_string(i) + ".nrrd")));
+    CPPUNIT_ASSERT(boost::filesystem::exists(helper.GetWorkingDirectory() / "mask.nrrd"));
+    CPPUNIT_ASSERT(helper.GetRunReport().stagingFilesWritten >= 13);
+  }
+
+  void Run_StagingErrorsAreAggregated()
+  {
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddAutoSaveData(CreateImage().GetPointer(), "--first", "first", ".no_writer");
+    helper.AddAutoSaveData(CreateImage().GetPointer(), "--second", "second", ".no_writer");
+    helper.AddAutoSaveData(CreateImage().GetPointer(), "--third", "third", ".nrrd");
+    try
+    {
+      helper.GetResults();
+      CPPUNIT_FAIL("staging did not throw");
+    }
+    catch (const mitk::Exception &e)
+    {
+      const std::string message = e.what();
+      CPPUNIT_ASSERT(message.find("2 of 3") != std::string::npos);
+      CPPUNIT_ASSERT(message.find("first.no_writer") != std::string::npos);
+      CPPUNIT_ASSERT(message.find("second.no_writer") != std::string::npos);
+    }
+  }
+
+  void Run_LogFileIsTruncated()
+  {
+    setenv("MITK_FAKE_DOCKER_STDOUT_LINES", "200", 1);
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.SetMaxLogFileSize(1000);
+
+    // the callback may use the helper, it is not called under the log lock
+    std::size_t lines = 0;
+    helper.SetLogCallback([&](mitk::DockerProcess::Stream, const std::string &) {
+      helper.SetLogCallback([&lines](mitk::DockerProcess::Stream, const std::string &) { ++lines; });
+      helper.SetMaxLogFileSize(1000);
+    });
+    helper.AddApplicationArgument("true");
+    helper.GetResults();
+    CPPUNIT_ASSERT(lines >= 199);
+
+    const auto logFile = helper.GetLogFilePath();
+    CPPUNIT_ASSERT(boost::filesystem::file_size(logFile) < 1100);
+    boost::filesystem::ifstream stream(logFile);
+    const std::string log((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    CPPUNIT_ASSERT(log.find("fake container output 1/200") != std::string::npos);
+    CPPUNIT_ASSERT(log.find("fake container output 200/200") == std::string::npos);
+    CPPUNIT_ASSERT(log.find("[log truncated after ") != std::string::npos);
+  }
+
+  void Run_ExitCodeThrows()
+  {
+    setenv("MITK_FAKE_DOCKER_EXIT_CODE", "3", 1);
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddApplicationArgument("false");
+    CPPUNIT_ASSERT_THROW(helper.GetResults(), mitk::Exception);
+    CPPUNIT_ASSERT_EQUAL(3, helper.GetRunReport().exitCode);
+    CPPUNIT_ASSERT_EQUAL(std::string("failed"), helper.GetRunReport().status);
+  }
+
+  void Run_StallTimeoutThrows()
+  {
+    setenv("MITK_FAKE_DOCKER_STDOUT_LINES", "0", 1);
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddApplicationArgument("sleep", "30");
+    helper.SetStallTimeout(std::chrono::milliseconds(500));
+    helper.SetStopGracePeriod(std::chrono::seconds(1));
+    CPPUNIT_ASSERT_THROW(helper.GetResults(), mitk::DockerTimeoutException);
+    CPPUNIT_ASSERT(helper.IsTimedOut());
+    CPPUNIT_ASSERT(helper.GetRunReport().totalSeconds < 10);
+  }
+
+  void Run_RunTimeoutThrows()
+  {
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddApplicationArgument("sleep", "30");
+    helper.SetRunTimeout(std::chrono::milliseconds(500));
+    helper.SetStopGracePeriod(std::chrono::seconds(1));
+    CPPUNIT_ASSERT_THROW(helper.GetResults(), mitk::DockerTimeoutException);
+    CPPUNIT_ASSERT(helper.IsTimedOut());
+    CPPUNIT_ASSERT(helper.GetRunReport().exitCode != 0);
+    CPPUNIT_ASSERT(helper.GetRunReport().totalSeconds < 10);
+  }
+
+  void Run_CompletedRunIsNotTimedOut()
+  {
+    // the timeouts are close to the run time: a run either completes or is stopped, a completed
+    // run is never reported as timed out
+    setenv("MITK_FAKE_DOCKER_RUN_MS", "300", 1);
+    for (int timeout = 250; timeout <= 450; timeout += 20)
+    {
+      mitk::DockerHelper helper("alpine");
+      helper.EnableAutoRemoveContainer(true);
+      helper.AddApplicationArgument("true");
+      helper.SetRunTimeout(std::chrono::milliseconds(timeout));
+      helper.SetStopGracePeriod(std::chrono::seconds(1));
+      try
+      {
+        helper.GetResults();
+        CPPUNIT_ASSERT(!helper.IsTimedOut());
+        CPPUNIT_ASSERT_EQUAL(0, helper.GetRunReport().exitCode);
+      }
+      catch (const mitk::DockerTimeoutException &)
+      {
+        CPPUNIT_ASSERT(helper.GetRunReport().exitCode != 0);
+      }
+    }
+  }
+
+  void Run_CancelledHelperRunsAgain()
+  {
+    auto image = CreateImage();
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+
+    setenv("MITK_FAKE_DOCKER_RUN_MS", "30000", 1);
+    std::thread canceller([&helper]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      helper.Cancel();
+    });
+    CPPUNIT_ASSERT_THROW(helper.GetResultManifest(), mitk::DockerCancelledException);
+    canceller.join();
+    CPPUNIT_ASSERT(helper.GetWorkingDirectory().empty());
+
+    // the inputs are staged again in a new working directory
+    unsetenv("MITK_FAKE_DOCKER_RUN_MS");
+    const auto manifest = helper.GetResultManifest();
+    CPPUNIT_ASSERT(!helper.IsCancelled());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), manifest.size());
+    CPPUNIT_ASSERT(manifest.front()->Exists());
+    CPPUNIT_ASSERT(boost::filesystem::exists(helper.GetWorkingDirectory() / "input.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), helper.GetRunReport().status);
+  }
+
+  void Run_AsyncHelperRunsAgain()
+  {
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddApplicationArgument("true");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+
+    setenv("MITK_FAKE_DOCKER_RUN_MS", "1000", 1);
+    auto future = helper.GetResultsAsync();
+    CPPUNIT_ASSERT_THROW(helper.GetResultsAsync(), mitk::Exception);
+    CPPUNIT_ASSERT_NO_THROW(future.get());
+    unsetenv("MITK_FAKE_DOCKER_RUN_MS");
+
+    // a finished run does not block the next one
+    CPPUNIT_ASSERT_NO_THROW(helper.GetResultsAsync().get());
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), helper.GetRunReport().status);
+    CPPUNIT_ASSERT(!helper.IsCancelled());
+  }
+
+  void Run_ResultCacheHit()
+  {
+    auto &cache = mitk::DockerResultCache::GetInstance();
+    const auto cacheDirectory = cache.GetDirectory();
+    cache.SetDirectory(m_Root / "cache");
+
+    for (int i = 0; i < 2; ++i)
+    {
+      mitk::DockerHelper helper("alpine");
+      helper.EnableAutoRemoveContainer(true);
+      helper.EnableResultCache(true);
+      helper.AddApplicationArgument("true");
+      helper.AddLoadLaterOutput("--output", "result.txt");
+      helper.GetResultManifest();
+      CPPUNIT_ASSERT_EQUAL(i == 1, helper.IsResultCacheHit());
+      CPPUNIT_ASSERT(boost::filesystem::exists(helper.GetWorkingDirectory() / "result.txt"));
+    }
+    cache.SetDirectory(cacheDirectory);
+  }
+
+  void Run_ResultCacheMissesRewrittenInput()
+  {
+    auto &cache = mitk::DockerResultCache::GetInstance();
+    const auto cacheDirectory = cache.GetDirectory();
+    cache.SetDirectory(m_Root / "cache");
+
+    // the modified image is written to the same path with the same size, usually within the same second
+    auto image = CreateImage();
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.EnableResultCache(true);
+    helper.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+    helper.GetResultManifest();
+    const auto stagedFile = helper.GetWorkingDirectory() / "input.nrrd";
+    const auto size = boost::filesystem::file_size(stagedFile);
+
+    {
+      mitk::ImageWriteAccessor accessor(image);
+      std::fill_n(static_cast<float *>(accessor.GetData()), 16 * 16 * 16, 2.0f);
+    }
+    image->Modified();
+    helper.GetResultManifest();
+    CPPUNIT_ASSERT_EQUAL(stagedFile, helper.GetWorkingDirectory() / "input.nrrd");
+    CPPUNIT_ASSERT_EQUAL(size, boost::filesystem::file_size(stagedFile));
+    CPPUNIT_ASSERT(!helper.IsResultCacheHit());
+    cache.SetDirectory(cacheDirectory);
+  }
+
+  void Rerun_ReusesUnchangedInputs()
+  {
+    auto image = CreateImage();
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    helper.AddLoadLaterOutput("--output", "result.txt");
+    helper.GetResultManifest();
+
+    const auto stagedFile = helper.GetWorkingDirectory() / "input.nrrd";
+    CPPUNIT_ASSERT(boost::filesystem::exists(stagedFile));
+    boost::filesystem::resize_file(stagedFile, 1);
+    boost::filesystem::resize_file(helper.GetWorkingDirectory() / "result.txt", 1);
+
+    // unchanged object: not written again, the output of the previous run is replaced
+    const auto manifest = helper.GetResultManifest();
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(1), boost::filesystem::file_size(stagedFile));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), manifest.size());
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(1024), manifest.front()->GetSize());
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), helper.GetRunReport().status);
+
+    image->Modified();
+    helper.GetResultManifest();
+    CPPUNIT_ASSERT(boost::filesystem::file_size(stagedFile) > 1);
+  }
+
+  void Staging_LinksObjectBoundTwice()
+  {
+    auto image = CreateImage();
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.AddAutoSaveData(image.GetPointer(), "--image", "image", ".nrrd");
+    helper.AddAutoSaveData(image.GetPointer(), "--reference", "reference", ".nrrd");
+    helper.GetResults();
+
+    CPPUNIT_ASSERT(boost::filesystem::equivalent(helper.GetWorkingDirectory() / "image.nrrd",
+                                                 helper.GetWorkingDirectory() / "reference.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), helper.GetRunReport().stagingFilesReused);
+  }
+
+  void Staging_LinksFileOfOtherHelper()
+  {
+    auto image = CreateImage();
+    mitk::DockerHelper first("alpine");
+    first.EnableAutoRemoveContainer(true);
+    first.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    first.GetResults();
+
+    mitk::DockerHelper second("alpine");
+    second.EnableAutoRemoveContainer(true);
+    second.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    second.GetResults();
+    CPPUNIT_ASSERT(boost::filesystem::equivalent(first.GetWorkingDirectory() / "input.nrrd",
+                                                 second.GetWorkingDirectory() / "input.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), second.GetRunReport().stagingFilesReused);
+
+    // a modified object is written again
+    image->Modified();
+    mitk::DockerHelper third("alpine");
+    third.EnableAutoRemoveContainer(true);
+    third.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    third.GetResults();
+    CPPUNIT_ASSERT(!boost::filesystem::equivalent(first.GetWorkingDirectory() / "input.nrrd",
+                                                  third.GetWorkingDirectory() / "input.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), third.GetRunReport().stagingFilesReused);
+  }
+
+  void Staging_InputStoreIsShared()
+  {
+    auto &store = mitk::DockerInputStore::GetInstance();
+    const auto storeDirectory = store.GetDirectory();
+    store.SetDirectory(m_Root / "input_store");
+
+    auto image = CreateImage();
+    std::vector<std::unique_ptr<mitk::DockerHelper>> helpers;
+    for (const auto *name : {"first", "second"})
+    {
+      helpers.push_back(std::make_unique<mitk::DockerHelper>("alpine"));
+      auto &helper = *helpers.back();
+      helper.EnableAutoRemoveContainer(true);
+      helper.EnableInputStore(true);
+      helper.AddAutoSaveData(image.GetPointer(), "--input", name, ".nrrd");
+      helper.GetResults();
+    }
+
+    // both working directories link to the same stored file
+    const auto first = helpers[0]->GetWorkingDirectory() / "first.nrrd";
+    const auto second = helpers[1]->GetWorkingDirectory() / "second.nrrd";
+    CPPUNIT_ASSERT(boost::filesystem::is_symlink(first));
+    CPPUNIT_ASSERT(boost::filesystem::is_symlink(second));
+    CPPUNIT_ASSERT_EQUAL(boost::filesystem::read_symlink(first).filename(), boost::filesystem::read_symlink(second).filename());
+    CPPUNIT_ASSERT(boost::filesystem::exists(m_Root / "input_store" / "files" / boost::filesystem::read_symlink(first).filename()));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), helpers[1]->GetRunReport().stagingFilesReused);
+    helpers.clear();
+    store.SetDirectory(storeDirectory);
+  }
+
+  void Staging_LinksFilesOnDiskWithFewMounts()
+  {
+    std::vector<mitk::BaseData::Pointer> images;
+    for (int i = 0; i < 6; ++i)
+    {
+      const auto file = m_Root / "data" / ("sample_" + std::to_string(i % 3)) / ("image_" + std::to_string(i) + ".nrrd");
+      boost::filesystem::create_directories(file.parent_path());
+      boost::filesystem::ofstream(file) << "nrrd";
+      auto image = CreateImage();
+      image->GetPropertyList()->SetStringProperty("MITK.IO.reader.inputlocation", file.string().c_str());
+      images.push_back(image.GetPointer());
+    }
+
+    mitk::DockerHelper helper("alpine");
+    helper.EnableAutoRemoveContainer(true);
+    helper.SetMaxInputMounts(1);
+    helper.AddAutoSaveData(images, "--inputs", "inputs/image_%1%", ".nrrd");
+    helper.GetResults();
+
+    // all links point into the single mount of the common ancestor
+    for (int i = 0; i < 6; ++i)
+    {
+      const auto link = helper.GetWorkingDirectory() / "inputs" / ("image_" + std::to_string(i) + ".nrrd");
+      CPPUNIT_ASSERT(boost::filesystem::is_symlink(link));
+      const auto target = boost::filesystem::read_symlink(link).generic_string();
+      CPPUNIT_ASSERT(target.find("_volume0/sample_" + std::to_string(i % 3) + "/image_") != std::string::npos);
+    }
+    CPPUNIT_ASSERT_EQUAL(std::size_t(6), helper.GetRunReport().stagingFilesLinked);
+  }
+
+  void Executor_RunsSpecRepeatedly()
+  {
+    auto image = CreateImage();
+    mitk::DockerJobSpec spec;
+    spec.image = "alpine";
+    spec.autoRemoveContainer = true;
+    spec.inputs.try_emplace("--input", "input", ".nrrd", std::vector<mitk::BaseData::Pointer>{image.GetPointer()}, true, true);
+    spec.outputs.emplace_back("--output", "result.txt");
+
+    mitk::DockerJobExecutor executor;
+    std::vector<mitk::DockerResultManifest> manifests;
+    for (int i = 0; i < 2; ++i)
+    {
+      manifests.push_back(executor.ExecuteLazily(spec));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), manifests.back().size());
+      CPPUNIT_ASSERT(manifests.back().front()->Exists());
+    }
+
+    // the held manifest of the first run stays valid, the unchanged input moved along
+    CPPUNIT_ASSERT(manifests[0].front()->Exists());
+    CPPUNIT_ASSERT(manifests[0].front()->GetPath() != manifests[1].front()->GetPath());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), executor.GetHelper().GetRunReport().stagingFilesReused);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), executor.GetNumberOfRuns());
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine"), executor.GetHelper().GetJobSpec().image);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), executor.GetHelper().GetJobSpec().inputs.size());
+  }
+
+  void Batch_RunsJobsFromManifest()
+  {
+    // the outputs written by the fake are loadable images
+    const auto outputSource = m_Root / "output_source.nrrd";
+    mitk::IOUtil::Save(CreateImage(), outputSource.string());
+    setenv("MITK_FAKE_DOCKER_OUTPUT_SOURCE", outputSource.string().c_str(), 1);
+
+    mitk::DockerBatchHelper batch("alpine");
+    batch.EnableAutoRemoveContainer(true);
+    batch.AddAutoSaveData(CreateImage().GetPointer(), "--reference", "reference", ".nrrd");
+    for (int i = 0; i < 2; ++i)
+      batch.AddJobAutoSaveData(batch.AddJob(), CreateImage().GetPointer(), "--input", "input", ".nrrd");
+    batch.AddAutoLoadOutput("--output", "result.nrrd");
+    const auto results = batch.GetBatchResults();
+
+    // one directory per job with its inputs and outputs
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), results.size());
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+      CPPUNIT_ASSERT_EQUAL(batch.GetWorkingDirectory() / ("job_000" + std::to_string(i)), batch.GetJobDirectory(i));
+      CPPUNIT_ASSERT(boost::filesystem::exists(batch.GetJobDirectory(i) / "input.nrrd"));
+      CPPUNIT_ASSERT(boost::filesystem::exists(batch.GetJobDirectory(i) / "result.nrrd"));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), results[i].size());
+      CPPUNIT_ASSERT(dynamic_cast<mitk::Image *>(results[i].front().GetPointer()));
+    }
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), batch.GetResultHandles().size());
+    CPPUNIT_ASSERT(boost::filesystem::exists(batch.GetWorkingDirectory() / "reference.nrrd"));
+
+    boost::filesystem::ifstream stream(batch.GetWorkingDirectory() / "batch_manifest.json");
+    const auto manifest = nlohmann::json::parse(stream);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), manifest["jobs"].size());
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+      const auto &job = manifest["jobs"][i];
+      const auto jobName = "job_000" + std::to_string(i);
+      const auto workdir = job["workdir"].get<std::string>();
+      const auto args = job["args"].get<std::vector<std::string>>();
+      CPPUNIT_ASSERT_EQUAL(jobName, job["id"].get<std::string>());
+      CPPUNIT_ASSERT_EQUAL(jobName, boost::filesystem::path(workdir).filename().string());
+      CPPUNIT_ASSERT((std::vector<std::string>{"--input", workdir + "/input.nrrd", "--output", workdir + "/result.nrrd"}) == args);
+    }
+  }
+
+  void Sweep_RunsGridOnSharedInputs()
+  {
+    auto image = CreateImage();
+    mitk::DockerParameterSweep sweep("alpine");
+    sweep.EnableAutoRemoveContainer(true);
+    sweep.AddAutoSaveData(image.GetPointer(), "--input", "input", ".nrrd");
+    sweep.AddLoadLaterOutput("--output", "result.txt");
+    sweep.AddGrid({{"--alpha", {"1", "2"}}, {"--beta", {"a", "b"}}});
+    sweep.SetMaxParallelVariants(2);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(4), sweep.GetVariants().size());
+
+    const auto results = sweep.RunSweep();
+    CPPUNIT_ASSERT_EQUAL(std::size_t(4), results.size());
+    CPPUNIT_ASSERT(results.count("--alpha=2,--beta=a"));
+    for (const auto &kv : results)
+      CPPUNIT_ASSERT_EQUAL(std::string(), kv.second.error);
+
+    // the inputs were staged once
+    CPPUNIT_ASSERT(boost::filesystem::exists(sweep.GetWorkingDirectory() / "input.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), sweep.GetRunReport().status);
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerFake)
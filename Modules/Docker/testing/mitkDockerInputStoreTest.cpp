@@ -0,0 +1,145 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerInputStore.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <memory>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <unistd.h>
+
+class mitkDockerInputStoreTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerInputStoreTestSuite);
+
+  MITK_TEST(Deposit_MovesFileIntoStore);
+  MITK_TEST(Deposit_SameContentIsStoredOnce);
+  MITK_TEST(Deposit_RewrittenPathIsHashedAgain);
+  MITK_TEST(Acquire_MissingFileIsInvalid);
+  MITK_TEST(Evict_KeepsReferencedFiles);
+  MITK_TEST(Evict_IgnoresReferencesOfDeadProcesses);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+  std::unique_ptr<mitk::DockerInputStore> m_Store;
+
+  boost::filesystem::path CreateFile(const std::string &name, std::size_t size, char content)
+  {
+    const auto path = m_Root / "workdir" / name;
+    boost::filesystem::ofstream(path) << std::string(size, content);
+    return path;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_input_store_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root / "workdir");
+    m_Store = std::make_unique<mitk::DockerInputStore>(m_Root / "store");
+  }
+
+  void tearDown() override
+  {
+    m_Store.reset();
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void Deposit_MovesFileIntoStore()
+  {
+    const auto file = CreateFile("input.nii.gz", 100, 'a');
+    const auto reference = m_Store->Deposit(file);
+    CPPUNIT_ASSERT(reference.IsValid());
+    CPPUNIT_ASSERT(!boost::filesystem::exists(file));
+    CPPUNIT_ASSERT(boost::filesystem::exists(reference.GetPath()));
+    CPPUNIT_ASSERT_EQUAL(m_Store->GetFilesDirectory(), reference.GetPath().parent_path());
+    const auto name = reference.GetPath().filename().string();
+    CPPUNIT_ASSERT_EQUAL(std::string(".nii.gz"), name.substr(name.find('.')));
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(100), m_Store->GetUsedBytes());
+  }
+
+  void Deposit_SameContentIsStoredOnce()
+  {
+    const auto first = m_Store->Deposit(CreateFile("first.nrrd", 100, 'a'));
+    const auto second = m_Store->Deposit(CreateFile("second.nrrd", 100, 'a'));
+    const auto other = m_Store->Deposit(CreateFile("other.nrrd", 100, 'b'));
+    CPPUNIT_ASSERT_EQUAL(first.GetPath(), second.GetPath());
+    CPPUNIT_ASSERT(first.GetPath() != other.GetPath());
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(200), m_Store->GetUsedBytes());
+  }
+
+  void Deposit_RewrittenPathIsHashedAgain()
+  {
+    // the same path with the same size and time stamp, written twice in a row
+    const auto first = m_Store->Deposit(CreateFile("input.nrrd", 100, 'a'));
+    const auto file = CreateFile("input.nrrd", 100, 'b');
+    boost::filesystem::last_write_time(file, boost::filesystem::last_write_time(first.GetPath()));
+    const auto second = m_Store->Deposit(file);
+
+    CPPUNIT_ASSERT(first.GetPath() != second.GetPath());
+    boost::filesystem::ifstream stream(second.GetPath());
+    std::string content;
+    stream >> content;
+    CPPUNIT_ASSERT_EQUAL(std::string(100, 'b'), content);
+  }
+
+  void Acquire_MissingFileIsInvalid()
+  {
+    CPPUNIT_ASSERT(!m_Store->Acquire("0123.nrrd").IsValid());
+    const auto stored = m_Store->Deposit(CreateFile("input.nrrd", 10, 'a'));
+    CPPUNIT_ASSERT(m_Store->Acquire(stored.GetPath().filename().string()).IsValid());
+  }
+
+  void Evict_KeepsReferencedFiles()
+  {
+    auto first = m_Store->Deposit(CreateFile("first.nrrd", 1000, 'a'));
+    auto second = m_Store->Deposit(CreateFile("second.nrrd", 1000, 'b'));
+    m_Store->SetBudget(1500);
+    m_Store->Evict();
+    CPPUNIT_ASSERT(boost::filesystem::exists(first.GetPath()));
+    CPPUNIT_ASSERT(boost::filesystem::exists(second.GetPath()));
+
+    first.Release();
+    m_Store->Evict();
+    CPPUNIT_ASSERT(!boost::filesystem::exists(first.GetPath()));
+    CPPUNIT_ASSERT(boost::filesystem::exists(second.GetPath()));
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(1000), m_Store->GetUsedBytes());
+  }
+
+  void Evict_IgnoresReferencesOfDeadProcesses()
+  {
+    auto reference = m_Store->Deposit(CreateFile("input.nrrd", 1000, 'a'));
+    const auto name = reference.GetPath().filename().string();
+    const auto path = reference.GetPath();
+    reference.Release();
+
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    const auto marker = m_Root / "store" / "references" / name / (std::string(hostname) + "_999999999_0");
+    boost::filesystem::ofstream(marker).close();
+
+    m_Store->SetBudget(0);
+    m_Store->Evict();
+    CPPUNIT_ASSERT(!boost::filesystem::exists(path));
+    CPPUNIT_ASSERT(!boost::filesystem::exists(marker));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerInputStore)
@@ -0,0 +1,176 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerJobScheduler.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+class mitkDockerJobSchedulerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerJobSchedulerTestSuite);
+
+  MITK_TEST(TestAdmitWithinBudget);
+  MITK_TEST(TestQueueWhenBudgetExceeded);
+  MITK_TEST(TestMemoryBudget);
+  MITK_TEST(TestOversizedJobRunsAlone);
+  MITK_TEST(TestCancelWhileQueued);
+  MITK_TEST(TestReleaseOnDestruction);
+  MITK_TEST(TestStatistics);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  using Requirements = mitk::DockerJobScheduler::Requirements;
+
+  static Requirements MakeRequirements(double cpus, std::uint64_t memoryBytes = 0)
+  {
+    Requirements requirements;
+    requirements.cpus = cpus;
+    requirements.memoryBytes = memoryBytes;
+    return requirements;
+  }
+
+  // waits until the condition holds or the timeout expired
+  template <class Condition>
+  static bool WaitFor(Condition condition)
+  {
+    for (int i = 0; i < 200 && !condition(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return condition();
+  }
+
+public:
+  void TestAdmitWithinBudget()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(4, 0);
+
+    auto a = scheduler.Acquire(MakeRequirements(2));
+    auto b = scheduler.Acquire(MakeRequirements(2));
+
+    CPPUNIT_ASSERT(a.IsValid());
+    CPPUNIT_ASSERT(b.IsValid());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), scheduler.GetNumberOfRunningJobs());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), scheduler.GetQueueDepth());
+  }
+
+  void TestQueueWhenBudgetExceeded()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(2, 0);
+
+    auto first = scheduler.Acquire(MakeRequirements(2));
+    std::atomic<bool> admitted{false};
+    std::thread waiting([&]() {
+      auto second = scheduler.Acquire(MakeRequirements(1));
+      admitted = second.IsValid();
+    });
+
+    CPPUNIT_ASSERT(WaitFor([&]() { return scheduler.GetQueueDepth() == 1; }));
+    CPPUNIT_ASSERT(!admitted);
+
+    first.Release();
+    waiting.join();
+
+    CPPUNIT_ASSERT(admitted);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), scheduler.GetQueueDepth());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), scheduler.GetNumberOfRunningJobs());
+  }
+
+  void TestMemoryBudget()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(16, 1000);
+
+    auto first = scheduler.Acquire(MakeRequirements(1, 800));
+    std::atomic<bool> admitted{false};
+    std::thread waiting([&]() {
+      auto second = scheduler.Acquire(MakeRequirements(1, 400));
+      admitted = true;
+    });
+
+    CPPUNIT_ASSERT(WaitFor([&]() { return scheduler.GetQueueDepth() == 1; }));
+    CPPUNIT_ASSERT(!admitted);
+
+    first.Release();
+    waiting.join();
+    CPPUNIT_ASSERT(admitted);
+  }
+
+  void TestOversizedJobRunsAlone()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(2, 0);
+
+    auto oversized = scheduler.Acquire(MakeRequirements(8));
+    CPPUNIT_ASSERT(oversized.IsValid());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), scheduler.GetNumberOfRunningJobs());
+  }
+
+  void TestCancelWhileQueued()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(1, 0);
+
+    auto first = scheduler.Acquire(MakeRequirements(1));
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> valid{true};
+    std::thread waiting([&]() {
+      auto second = scheduler.Acquire(MakeRequirements(1), [&]() { return cancelled.load(); });
+      valid = second.IsValid();
+    });
+
+    CPPUNIT_ASSERT(WaitFor([&]() { return scheduler.GetQueueDepth() == 1; }));
+    cancelled = true;
+    waiting.join();
+
+    CPPUNIT_ASSERT(!valid);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), scheduler.GetQueueDepth());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), scheduler.GetNumberOfRunningJobs());
+  }
+
+  void TestReleaseOnDestruction()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(1, 0);
+    {
+      auto admission = scheduler.Acquire(MakeRequirements(1));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), scheduler.GetNumberOfRunningJobs());
+    }
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), scheduler.GetNumberOfRunningJobs());
+  }
+
+  void TestStatistics()
+  {
+    mitk::DockerJobScheduler scheduler;
+    scheduler.SetBudget(4, 1000);
+
+    auto a = scheduler.Acquire(MakeRequirements(1.5, 100));
+    auto b = scheduler.Acquire(MakeRequirements(0.5, 200));
+
+    auto statistics = scheduler.GetStatistics();
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), statistics.admittedJobs);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), statistics.runningJobs);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, statistics.usedCpus, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(300), statistics.usedMemoryBytes);
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerJobScheduler)
@@ -0,0 +1,87 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerMountPlanner.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+class mitkDockerMountPlannerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerMountPlannerTestSuite);
+
+  MITK_TEST(Plan_RemovesNestedDirectories);
+  MITK_TEST(Plan_MergesDeepestAncestorFirst);
+  MITK_TEST(Plan_WithoutLimitMountsNoAncestors);
+  MITK_TEST(Plan_KeepsShallowAncestorsApart);
+  MITK_TEST(Plan_ManyDirectoriesConstantMounts);
+  MITK_TEST(IsWithin_ComparesElements);
+
+  CPPUNIT_TEST_SUITE_END();
+
+  using Paths = std::vector<boost::filesystem::path>;
+
+public:
+  void Plan_RemovesNestedDirectories()
+  {
+    const auto mounts = mitk::DockerMountPlanner::Plan({"/data/a/b", "/data/c", "/data/a", "/data/c/"}, 10);
+    CPPUNIT_ASSERT(mounts == Paths({"/data/a", "/data/c"}));
+  }
+
+  void Plan_MergesDeepestAncestorFirst()
+  {
+    const auto mounts =
+      mitk::DockerMountPlanner::Plan({"/data/p1/s1", "/data/p2/s1", "/data/p1/s2", "/data/p1/s3/x"}, 2);
+    CPPUNIT_ASSERT(mounts == Paths({"/data/p1", "/data/p2/s1"}));
+  }
+
+  void Plan_WithoutLimitMountsNoAncestors()
+  {
+    const auto mounts = mitk::DockerMountPlanner::Plan({"/home/user/a", "/home/user/b", "/home/user/a/x"}, 0);
+    CPPUNIT_ASSERT(mounts == Paths({"/home/user/a", "/home/user/b"}));
+  }
+
+  void Plan_KeepsShallowAncestorsApart()
+  {
+    // "/" and "/home" are never mounted
+    CPPUNIT_ASSERT(mitk::DockerMountPlanner::Plan({"/data/x", "/home/y"}, 1) == Paths({"/data/x", "/home/y"}));
+    CPPUNIT_ASSERT(mitk::DockerMountPlanner::Plan({"/home/a/x", "/home/b/y"}, 1) ==
+                   Paths({"/home/a/x", "/home/b/y"}));
+    CPPUNIT_ASSERT(mitk::DockerMountPlanner::Plan({"/home/a/x", "/home/b/y"}, 1, 1) == Paths({"/home"}));
+  }
+
+  void Plan_ManyDirectoriesConstantMounts()
+  {
+    Paths directories;
+    for (int i = 0; i < 1000; ++i)
+      directories.push_back(boost::filesystem::path("/data/study") / ("sample_" + std::to_string(i)) / "msi");
+    directories.push_back("/scratch/user/reference");
+
+    const auto mounts = mitk::DockerMountPlanner::Plan(directories, 4);
+    CPPUNIT_ASSERT(mounts == Paths({"/data/study", "/scratch/user/reference"}));
+  }
+
+  void IsWithin_ComparesElements()
+  {
+    CPPUNIT_ASSERT(mitk::DockerMountPlanner::IsWithin("/data/a/file.nrrd", "/data/a"));
+    CPPUNIT_ASSERT(mitk::DockerMountPlanner::IsWithin("/data/a", "/data/a"));
+    CPPUNIT_ASSERT(!mitk::DockerMountPlanner::IsWithin("/data/ab/file.nrrd", "/data/a"));
+    CPPUNIT_ASSERT(!mitk::DockerMountPlanner::IsWithin("/data", "/data/a"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), mitk::DockerMountPlanner::GetDepth("/data/study"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), mitk::DockerMountPlanner::GetDepth("/"));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerMountPlanner)
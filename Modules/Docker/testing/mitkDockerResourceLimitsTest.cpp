@@ -0,0 +1,141 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerEngineClient.h>
+#include <mitkDockerResourceLimits.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <algorithm>
+
+class mitkDockerResourceLimitsTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerResourceLimitsTestSuite);
+
+  MITK_TEST(TestEmptyLimits);
+  MITK_TEST(TestRunArguments);
+  MITK_TEST(TestParseCpuSet);
+  MITK_TEST(TestEffectiveCpus);
+  MITK_TEST(TestInvalidLimitsThrow);
+  MITK_TEST(TestEngineApiTranslation);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void TestEmptyLimits()
+  {
+    mitk::DockerResourceLimits limits;
+    CPPUNIT_ASSERT(limits.IsEmpty());
+    CPPUNIT_ASSERT(limits.ToRunArguments().empty());
+    CPPUNIT_ASSERT(limits.ToJson().empty());
+    CPPUNIT_ASSERT_NO_THROW(limits.Validate());
+  }
+
+  void TestRunArguments()
+  {
+    mitk::DockerResourceLimits limits;
+    limits.cpus = 0.5;
+    limits.memoryBytes = 64 * 1024 * 1024;
+    limits.memorySwapBytes = -1;
+    limits.shmSizeBytes = 1024;
+    limits.pidsLimit = 100;
+    limits.tmpfs.push_back({"/scratch", 4096});
+    limits.Validate();
+
+    const std::vector<std::string> expected = {"--cpus", "0.5",
+                                               "--memory", "67108864",
+                                               "--memory-swap", "-1",
+                                               "--shm-size", "1024",
+                                               "--pids-limit", "100",
+                                               "--tmpfs", "/scratch:size=4096"};
+    CPPUNIT_ASSERT(expected == limits.ToRunArguments());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(64 * 1024 * 1024), limits.ToJson()["memoryBytes"].get<std::uint64_t>());
+  }
+
+  void TestParseCpuSet()
+  {
+    const auto cpus = mitk::DockerResourceLimits::ParseCpuSet("0-2,5,1");
+    CPPUNIT_ASSERT(std::vector<unsigned int>({0, 1, 2, 5}) == cpus);
+    CPPUNIT_ASSERT_THROW(mitk::DockerResourceLimits::ParseCpuSet("3-1"), mitk::Exception);
+    CPPUNIT_ASSERT_THROW(mitk::DockerResourceLimits::ParseCpuSet("a"), mitk::Exception);
+    CPPUNIT_ASSERT_THROW(mitk::DockerResourceLimits::ParseCpuSet(""), mitk::Exception);
+  }
+
+  void TestEffectiveCpus()
+  {
+    mitk::DockerResourceLimits limits;
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, limits.GetEffectiveCpus(), 1e-9);
+    limits.cpusetCpus = "0-3";
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(4.0, limits.GetEffectiveCpus(), 1e-9);
+    limits.cpus = 1.5;
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.5, limits.GetEffectiveCpus(), 1e-9);
+  }
+
+  void TestInvalidLimitsThrow()
+  {
+    mitk::DockerResourceLimits limits;
+    limits.cpus = 100000;
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.cpusetCpus = "100000";
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.memoryBytes = 1024;
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.memorySwapBytes = 1024 * 1024 * 1024;
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.hostIpc = true;
+    limits.shmSizeBytes = 1024;
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.tmpfs.push_back({"relative", 0});
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+
+    limits = mitk::DockerResourceLimits();
+    limits.tmpfs.push_back({"/tmp", 0});
+    limits.tmpfs.push_back({"/tmp", 0});
+    CPPUNIT_ASSERT_THROW(limits.Validate(), mitk::Exception);
+  }
+
+  void TestEngineApiTranslation()
+  {
+    mitk::DockerResourceLimits limits;
+    limits.cpus = 1;
+    limits.cpusetCpus = "0";
+    limits.memoryBytes = 64 * 1024 * 1024;
+    limits.pidsLimit = 50;
+    limits.tmpfs.push_back({"/scratch", 0});
+
+    nlohmann::json config;
+    std::string name;
+    CPPUNIT_ASSERT(mitk::DockerEngineClient::TranslateRunArguments(limits.ToRunArguments(), "alpine", {}, config, name));
+    const auto &hostConfig = config["HostConfig"];
+    CPPUNIT_ASSERT_EQUAL(std::int64_t(1000000000), hostConfig["NanoCpus"].get<std::int64_t>());
+    CPPUNIT_ASSERT_EQUAL(std::string("0"), hostConfig["CpusetCpus"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(std::int64_t(64 * 1024 * 1024), hostConfig["Memory"].get<std::int64_t>());
+    CPPUNIT_ASSERT_EQUAL(std::int64_t(50), hostConfig["PidsLimit"].get<std::int64_t>());
+    CPPUNIT_ASSERT(hostConfig["Tmpfs"].contains("/scratch"));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerResourceLimits)
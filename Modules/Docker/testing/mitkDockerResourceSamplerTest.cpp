@@ -0,0 +1,155 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResourceSampler.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerResourceSamplerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerResourceSamplerTestSuite);
+
+  MITK_TEST(TestFindCgroupDirectory);
+  MITK_TEST(TestReadCgroup);
+  MITK_TEST(TestReadCgroupWithoutPeak);
+  MITK_TEST(TestParseEngineStats);
+  MITK_TEST(TestMerge);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+  const std::string m_Id = "0123456789abcdef";
+
+  void WriteFile(const boost::filesystem::path &path, const std::string &content)
+  {
+    boost::filesystem::create_directories(path.parent_path());
+    boost::filesystem::ofstream file(path);
+    file << content;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_cgroup_%%%%%%");
+    WriteFile(m_Root / "cgroup.controllers", "cpu io memory pids\n");
+  }
+
+  void tearDown() override { boost::filesystem::remove_all(m_Root); }
+
+  void TestFindCgroupDirectory()
+  {
+    CPPUNIT_ASSERT(mitk::DockerResourceSampler::FindCgroupDirectory(m_Id, m_Root).empty());
+
+    const auto rootless = m_Root / "user.slice" / "user-1000.slice" / ("docker-" + m_Id + ".scope");
+    boost::filesystem::create_directories(rootless);
+    CPPUNIT_ASSERT_EQUAL(rootless.string(), mitk::DockerResourceSampler::FindCgroupDirectory(m_Id, m_Root).string());
+
+    const auto systemd = m_Root / "system.slice" / ("docker-" + m_Id + ".scope");
+    boost::filesystem::create_directories(systemd);
+    CPPUNIT_ASSERT_EQUAL(systemd.string(), mitk::DockerResourceSampler::FindCgroupDirectory(m_Id, m_Root).string());
+
+    // cgroup v1 hierarchy
+    boost::filesystem::remove(m_Root / "cgroup.controllers");
+    CPPUNIT_ASSERT(mitk::DockerResourceSampler::FindCgroupDirectory(m_Id, m_Root).empty());
+  }
+
+  void TestReadCgroup()
+  {
+    const auto directory = m_Root / "docker" / m_Id;
+    WriteFile(directory / "memory.peak", "1048576\n");
+    WriteFile(directory / "memory.current", "4096\n");
+    WriteFile(directory / "cpu.stat",
+              "usage_usec 2500000\nuser_usec 2000000\nsystem_usec 500000\n"
+              "nr_periods 100\nnr_throttled 7\nthrottled_usec 300000\n");
+    WriteFile(directory / "io.stat",
+              "8:0 rbytes=1000 wbytes=2000 rios=1 wios=2 dbytes=0 dios=0\n"
+              "8:16 rbytes=24 wbytes=48 rios=1 wios=1 dbytes=0 dios=0\n");
+
+    mitk::DockerResourceUsage sample;
+    CPPUNIT_ASSERT(mitk::DockerResourceSampler::ReadCgroup(directory, sample));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1048576), sample.peakMemoryBytes);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2.5, sample.cpuSeconds, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(7), sample.throttledPeriods);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.3, sample.throttledSeconds, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1024), sample.blockReadBytes);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2048), sample.blockWriteBytes);
+  }
+
+  void TestReadCgroupWithoutPeak()
+  {
+    const auto directory = m_Root / "docker" / m_Id;
+    mitk::DockerResourceUsage sample;
+    CPPUNIT_ASSERT(!mitk::DockerResourceSampler::ReadCgroup(directory, sample));
+
+    WriteFile(directory / "memory.current", "4096\n");
+    CPPUNIT_ASSERT(mitk::DockerResourceSampler::ReadCgroup(directory, sample));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(4096), sample.peakMemoryBytes);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), sample.blockReadBytes);
+  }
+
+  void TestParseEngineStats()
+  {
+    const auto stats = nlohmann::json::parse(R"({
+      "memory_stats": {"usage": 5000, "max_usage": 8000},
+      "cpu_stats": {"cpu_usage": {"total_usage": 1500000000},
+                    "throttling_data": {"periods": 10, "throttled_periods": 3, "throttled_time": 250000000}},
+      "blkio_stats": {"io_service_bytes_recursive": [
+        {"major": 8, "minor": 0, "op": "read", "value": 100},
+        {"major": 8, "minor": 0, "op": "Write", "value": 200}]}
+    })");
+
+    mitk::DockerResourceUsage sample;
+    mitk::DockerResourceSampler::ParseEngineStats(stats, sample);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(8000), sample.peakMemoryBytes);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.5, sample.cpuSeconds, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), sample.throttledPeriods);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, sample.throttledSeconds, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(100), sample.blockReadBytes);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(200), sample.blockWriteBytes);
+
+    // blkio_stats entries are null on some hosts
+    mitk::DockerResourceUsage empty;
+    mitk::DockerResourceSampler::ParseEngineStats(
+      nlohmann::json::parse(R"({"blkio_stats": {"io_service_bytes_recursive": null}})"), empty);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), empty.blockReadBytes);
+  }
+
+  void TestMerge()
+  {
+    mitk::DockerResourceUsage usage;
+    mitk::DockerResourceUsage first;
+    first.source = "cgroup-v2";
+    first.peakMemoryBytes = 300;
+    first.cpuSeconds = 1.0;
+    mitk::DockerResourceUsage second;
+    second.source = "cgroup-v2";
+    second.peakMemoryBytes = 200;
+    second.cpuSeconds = 2.0;
+
+    usage.Merge(first);
+    usage.Merge(second);
+    CPPUNIT_ASSERT_EQUAL(std::string("cgroup-v2"), usage.source);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), usage.samples);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(300), usage.peakMemoryBytes);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, usage.cpuSeconds, 1e-9);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(300), usage.ToJson()["peakMemoryBytes"].get<std::uint64_t>());
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerResourceSampler)
@@ -0,0 +1,174 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResultCache.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerResultCacheTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerResultCacheTestSuite);
+
+  MITK_TEST(TestMissOnEmptyCache);
+  MITK_TEST(TestStoreAndRestore);
+  MITK_TEST(TestEvictLeastRecentlyUsed);
+  MITK_TEST(TestClaimCoalescesJobs);
+  MITK_TEST(TestCancelWhileWaitingForClaim);
+  MITK_TEST(TestHashFileDetectsChanges);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+
+  static void WriteFile(const boost::filesystem::path &path, const std::string &content)
+  {
+    boost::filesystem::create_directories(path.parent_path());
+    boost::filesystem::ofstream file(path);
+    file << content;
+  }
+
+  static std::string ReadFile(const boost::filesystem::path &path)
+  {
+    boost::filesystem::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_cache_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+  }
+
+  void tearDown() override
+  {
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void TestMissOnEmptyCache()
+  {
+    mitk::DockerResultCache cache;
+    cache.SetDirectory(m_Root / "cache");
+    CPPUNIT_ASSERT(!cache.Contains("abc"));
+    CPPUNIT_ASSERT(!cache.Restore("abc", m_Root / "work"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), cache.GetStatistics().misses);
+  }
+
+  void TestStoreAndRestore()
+  {
+    mitk::DockerResultCache cache;
+    cache.SetDirectory(m_Root / "cache");
+
+    const auto run = m_Root / "run";
+    WriteFile(run / "results.nii", "segmentation");
+    WriteFile(run / "results" / "liver.nii.gz", "liver");
+    WriteFile(run / "input.nii", "input");
+    cache.Store("key", run, {"results.nii", "results", "missing.json"});
+    CPPUNIT_ASSERT(cache.Contains("key"));
+
+    const auto rerun = m_Root / "rerun";
+    boost::filesystem::create_directories(rerun / "results");
+    CPPUNIT_ASSERT(cache.Restore("key", rerun));
+    CPPUNIT_ASSERT_EQUAL(std::string("segmentation"), ReadFile(rerun / "results.nii"));
+    CPPUNIT_ASSERT_EQUAL(std::string("liver"), ReadFile(rerun / "results" / "liver.nii.gz"));
+    CPPUNIT_ASSERT(!boost::filesystem::exists(rerun / "input.nii"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), cache.GetStatistics().hits);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), cache.GetStatistics().stores);
+  }
+
+  void TestEvictLeastRecentlyUsed()
+  {
+    mitk::DockerResultCache cache;
+    cache.SetDirectory(m_Root / "cache");
+    cache.SetMaxSize(250);
+
+    const auto run = m_Root / "run";
+    WriteFile(run / "out.bin", std::string(100, 'x'));
+    cache.Store("old", run, {"out.bin"});
+    boost::filesystem::last_write_time(m_Root / "cache" / "old" / "entry.json", std::time(nullptr) - 100);
+
+    // storing the second entry exceeds the limit, the older entry is removed
+    cache.Store("new", run, {"out.bin"});
+    CPPUNIT_ASSERT(!cache.Contains("old"));
+    CPPUNIT_ASSERT(cache.Contains("new"));
+  }
+
+  void TestClaimCoalescesJobs()
+  {
+    mitk::DockerResultCache cache;
+    cache.SetDirectory(m_Root / "cache");
+
+    auto first = cache.ClaimKey("key");
+    CPPUNIT_ASSERT(first.IsValid());
+
+    std::atomic<bool> secondClaimed{false};
+    std::thread second([&]() {
+      auto claim = cache.ClaimKey("key");
+      secondClaimed = claim.IsValid();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CPPUNIT_ASSERT(!secondClaimed);
+    first.Release();
+    second.join();
+    CPPUNIT_ASSERT(secondClaimed);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), cache.GetStatistics().coalesced);
+
+    // other keys are not blocked
+    auto other = cache.ClaimKey("other");
+    CPPUNIT_ASSERT(other.IsValid());
+  }
+
+  void TestCancelWhileWaitingForClaim()
+  {
+    mitk::DockerResultCache cache;
+    auto first = cache.ClaimKey("key");
+    auto second = cache.ClaimKey("key", []() { return true; });
+    CPPUNIT_ASSERT(!second.IsValid());
+  }
+
+  void TestHashFileDetectsChanges()
+  {
+    mitk::DockerResultCache cache;
+    const auto file = m_Root / "input.nii";
+    WriteFile(file, "a");
+    const auto hashA = cache.HashFile(file);
+    CPPUNIT_ASSERT_EQUAL(hashA, cache.HashFile(file));
+
+    WriteFile(file, "bb");
+    const auto hashB = cache.HashFile(file);
+    CPPUNIT_ASSERT(hashA != hashB);
+
+    // same size and modification time (one second resolution), different content
+    const auto modified = boost::filesystem::last_write_time(file);
+    WriteFile(file, "cc");
+    boost::filesystem::last_write_time(file, modified);
+    CPPUNIT_ASSERT(hashB != cache.HashFile(file));
+    CPPUNIT_ASSERT_EQUAL(mitk::DockerResultCache::HashFileContent(file), cache.HashFile(file));
+    CPPUNIT_ASSERT_EQUAL(mitk::DockerResultCache::HashString("x"), mitk::DockerResultCache::HashString("x"));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerResultCache)
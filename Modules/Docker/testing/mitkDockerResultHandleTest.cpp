@@ -0,0 +1,90 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerResultHandle.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerResultHandleTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerResultHandleTestSuite);
+
+  MITK_TEST(TestFileProperties);
+  MITK_TEST(TestCompoundFormat);
+  MITK_TEST(TestMissingFile);
+  MITK_TEST(TestHeaderOfNonImage);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Directory;
+
+public:
+  void setUp() override
+  {
+    m_Directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_result_handle_%%%%%%");
+    boost::filesystem::create_directories(m_Directory);
+  }
+
+  void tearDown() override { boost::filesystem::remove_all(m_Directory); }
+
+  void WriteFile(const boost::filesystem::path &path, const std::string &content)
+  {
+    boost::filesystem::ofstream file(path);
+    file << content;
+  }
+
+  void TestFileProperties()
+  {
+    WriteFile(m_Directory / "out.txt", "12345");
+    mitk::DockerResultHandle handle("--output", m_Directory / "out.txt", false);
+    CPPUNIT_ASSERT_EQUAL(std::string("--output"), handle.GetArgument());
+    CPPUNIT_ASSERT(handle.Exists());
+    CPPUNIT_ASSERT(!handle.IsAutoLoad());
+    CPPUNIT_ASSERT(!handle.IsLoaded());
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(5), handle.GetSize());
+    CPPUNIT_ASSERT_EQUAL(std::string(".txt"), handle.GetFormat());
+  }
+
+  void TestCompoundFormat()
+  {
+    mitk::DockerResultHandle handle("", m_Directory / "seg.nii.gz", true);
+    CPPUNIT_ASSERT_EQUAL(std::string(".nii.gz"), handle.GetFormat());
+    mitk::DockerResultHandle nrrd("", m_Directory / "image.v2.nrrd", true);
+    CPPUNIT_ASSERT_EQUAL(std::string(".nrrd"), nrrd.GetFormat());
+  }
+
+  void TestMissingFile()
+  {
+    mitk::DockerResultHandle handle("--output", m_Directory / "missing.nrrd", true);
+    CPPUNIT_ASSERT(!handle.Exists());
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(0), handle.GetSize());
+    CPPUNIT_ASSERT_THROW(handle.GetData(), mitk::Exception);
+    CPPUNIT_ASSERT(!handle.IsLoaded());
+  }
+
+  void TestHeaderOfNonImage()
+  {
+    WriteFile(m_Directory / "log.txt", "no image");
+    mitk::DockerResultHandle handle("", m_Directory / "log.txt", false);
+    CPPUNIT_ASSERT(!handle.GetImageHeader().valid);
+    CPPUNIT_ASSERT(!handle.IsLoaded());
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerResultHandle)
@@ -0,0 +1,87 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerRunReport.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerRunReportTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerRunReportTestSuite);
+
+  MITK_TEST(TestDefaults);
+  MITK_TEST(TestToJson);
+  MITK_TEST(TestWriteJson);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void TestDefaults()
+  {
+    mitk::DockerRunReport report;
+    CPPUNIT_ASSERT_EQUAL(-1, report.exitCode);
+    CPPUNIT_ASSERT(report.containerStartSeconds < 0);
+    CPPUNIT_ASSERT(report.firstOutputSeconds < 0);
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(0), report.stagingBytesWritten);
+  }
+
+  void TestToJson()
+  {
+    mitk::DockerRunReport report;
+    report.image = "alpine:latest";
+    report.backend = "cli";
+    report.status = "finished";
+    report.stagingSeconds = 1.5;
+    report.runningSeconds = 2.0;
+    report.exitCode = 0;
+    report.stagingBytesWritten = 1024;
+    report.stagingFilesWritten = 2;
+    report.stagingFilesLinked = 1;
+    report.stagingFilesReused = 1;
+    report.loadingBytesRead = 512;
+    report.loadingFilesRead = 1;
+
+    const auto json = report.ToJson();
+    CPPUNIT_ASSERT_EQUAL(std::string("alpine:latest"), json["image"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(std::string("finished"), json["status"].get<std::string>());
+    CPPUNIT_ASSERT_EQUAL(1.5, json["phases"]["staging"].get<double>());
+    CPPUNIT_ASSERT_EQUAL(2.0, json["phases"]["running"].get<double>());
+    CPPUNIT_ASSERT_EQUAL(0, json["container"]["exitCode"].get<int>());
+    CPPUNIT_ASSERT_EQUAL(1024, json["staging"]["bytesWritten"].get<int>());
+    CPPUNIT_ASSERT_EQUAL(1, json["staging"]["filesLinked"].get<int>());
+    CPPUNIT_ASSERT_EQUAL(1, json["staging"]["filesReused"].get<int>());
+    CPPUNIT_ASSERT_EQUAL(512, json["loading"]["bytesRead"].get<int>());
+  }
+
+  void TestWriteJson()
+  {
+    const auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_report_%%%%%%.json");
+    mitk::DockerRunReport report;
+    report.status = "failed";
+    report.WriteJson(path);
+
+    boost::filesystem::ifstream file(path);
+    const auto json = nlohmann::json::parse(file);
+    CPPUNIT_ASSERT_EQUAL(std::string("failed"), json["status"].get<std::string>());
+    boost::filesystem::remove(path);
+
+    CPPUNIT_ASSERT_THROW(report.WriteJson("/nonexistent_directory/report.json"), mitk::Exception);
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerRunReport)
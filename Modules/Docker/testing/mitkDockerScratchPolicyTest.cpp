@@ -0,0 +1,138 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerScratchPolicy.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <cstdlib>
+
+class mitkDockerScratchPolicyTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerScratchPolicyTestSuite);
+
+  MITK_TEST(Select_DefaultIsDisk);
+  MITK_TEST(Select_RamWithinBudget);
+  MITK_TEST(Select_FastAboveBudget);
+  MITK_TEST(Reserve_SharesBudget);
+  MITK_TEST(Reserve_MissingRootSpills);
+  MITK_TEST(FromEnvironment_ParsesSizes);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+  mitk::DockerScratchPolicy m_Policy;
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_scratch_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root / "ram");
+    boost::filesystem::create_directories(m_Root / "fast");
+    boost::filesystem::create_directories(m_Root / "disk");
+
+    m_Policy = mitk::DockerScratchPolicy();
+    m_Policy.ramRoot = m_Root / "ram";
+    m_Policy.fastRoot = m_Root / "fast";
+    m_Policy.diskRoot = m_Root / "disk";
+    m_Policy.outputFactor = 1.0;
+  }
+
+  void tearDown() override
+  {
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void Select_DefaultIsDisk()
+  {
+    const mitk::DockerScratchPolicy policy;
+    CPPUNIT_ASSERT(policy.Select(1024) == mitk::DockerScratchPolicy::Location::Disk);
+    CPPUNIT_ASSERT(!policy.GetRoot(mitk::DockerScratchPolicy::Location::Disk).empty());
+  }
+
+  void Select_RamWithinBudget()
+  {
+    m_Policy.ramBudgetBytes = 4096;
+    // inputs plus the same amount of outputs
+    CPPUNIT_ASSERT(m_Policy.Select(2048) == mitk::DockerScratchPolicy::Location::Ram);
+    CPPUNIT_ASSERT(m_Policy.Select(2049) == mitk::DockerScratchPolicy::Location::Fast);
+  }
+
+  void Select_FastAboveBudget()
+  {
+    m_Policy.ramBudgetBytes = 0;
+    CPPUNIT_ASSERT(m_Policy.Select(1) == mitk::DockerScratchPolicy::Location::Fast);
+
+    m_Policy.fastRoot.clear();
+    CPPUNIT_ASSERT(m_Policy.Select(1) == mitk::DockerScratchPolicy::Location::Disk);
+    CPPUNIT_ASSERT_EQUAL(m_Root / "disk", m_Policy.GetRoot(mitk::DockerScratchPolicy::Location::Disk));
+  }
+
+  void Reserve_SharesBudget()
+  {
+    m_Policy.ramBudgetBytes = 4096;
+    const auto reservedBefore = mitk::DockerScratchPolicy::GetReservedRamBytes();
+
+    auto first = m_Policy.Reserve(1024);
+    CPPUNIT_ASSERT(first.GetLocation() == mitk::DockerScratchPolicy::Location::Ram);
+    CPPUNIT_ASSERT_EQUAL(m_Policy.ramRoot, first.GetRoot());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2048), first.GetBytes());
+    CPPUNIT_ASSERT_EQUAL(reservedBefore + 2048, mitk::DockerScratchPolicy::GetReservedRamBytes());
+
+    auto second = m_Policy.Reserve(1024);
+    CPPUNIT_ASSERT(second.GetLocation() == mitk::DockerScratchPolicy::Location::Ram);
+
+    // the budget is used up by the first two runs
+    auto third = m_Policy.Reserve(1024);
+    CPPUNIT_ASSERT(third.GetLocation() == mitk::DockerScratchPolicy::Location::Fast);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), third.GetBytes());
+
+    auto moved = std::move(first);
+    first.Release();
+    CPPUNIT_ASSERT_EQUAL(reservedBefore + 4096, mitk::DockerScratchPolicy::GetReservedRamBytes());
+    moved.Release();
+    second.Release();
+    CPPUNIT_ASSERT_EQUAL(reservedBefore, mitk::DockerScratchPolicy::GetReservedRamBytes());
+    CPPUNIT_ASSERT(m_Policy.Reserve(1024).GetLocation() == mitk::DockerScratchPolicy::Location::Ram);
+  }
+
+  void Reserve_MissingRootSpills()
+  {
+    m_Policy.ramBudgetBytes = 4096;
+    m_Policy.ramRoot = m_Root / "missing";
+    m_Policy.fastRoot = m_Root / "missing";
+    const auto reservation = m_Policy.Reserve(1024);
+    CPPUNIT_ASSERT(reservation.GetLocation() == mitk::DockerScratchPolicy::Location::Disk);
+    CPPUNIT_ASSERT_EQUAL(m_Root / "disk", reservation.GetRoot());
+  }
+
+  void FromEnvironment_ParsesSizes()
+  {
+    setenv("MITK_DOCKER_SCRATCH_RAM_BUDGET", "2G", 1);
+    setenv("MITK_DOCKER_SCRATCH_FAST_ROOT", m_Root.string().c_str(), 1);
+    const auto policy = mitk::DockerScratchPolicy::FromEnvironment();
+    unsetenv("MITK_DOCKER_SCRATCH_RAM_BUDGET");
+    unsetenv("MITK_DOCKER_SCRATCH_FAST_ROOT");
+
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2) * 1024 * 1024 * 1024, policy.ramBudgetBytes);
+    CPPUNIT_ASSERT_EQUAL(boost::filesystem::path("/dev/shm"), policy.ramRoot);
+    CPPUNIT_ASSERT_EQUAL(m_Root, policy.fastRoot);
+    CPPUNIT_ASSERT(policy.diskRoot.empty());
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerScratchPolicy)
@@ -0,0 +1,110 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerStagingCache.h>
+#include <mitkImage.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerStagingCacheTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerStagingCacheTestSuite);
+
+  MITK_TEST(GetFormat_CompoundExtension);
+  MITK_TEST(LinkTo_UnchangedObject);
+  MITK_TEST(LinkTo_ModifiedObjectMisses);
+  MITK_TEST(LinkTo_ChangedFileMisses);
+  MITK_TEST(LinkTo_OtherFormatMisses);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+  mitk::Image::Pointer m_Data;
+
+  boost::filesystem::path Stage(const std::string &fileName, const std::string &content)
+  {
+    const auto path = m_Root / fileName;
+    boost::filesystem::ofstream(path) << content;
+    mitk::DockerStagingCache::GetInstance().Add(m_Data, path);
+    return path;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_staging_cache_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root / "next");
+    m_Data = mitk::Image::New();
+    mitk::DockerStagingCache::GetInstance().Clear();
+    mitk::DockerStagingCache::GetInstance().SetEnabled(true);
+  }
+
+  void tearDown() override
+  {
+    mitk::DockerStagingCache::GetInstance().Clear();
+    m_Data = nullptr;
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void GetFormat_CompoundExtension()
+  {
+    CPPUNIT_ASSERT_EQUAL(std::string(".nii.gz"), mitk::DockerStagingCache::GetFormat("/tmp/x/input_image.nii.gz"));
+    CPPUNIT_ASSERT_EQUAL(std::string(".nrrd"), mitk::DockerStagingCache::GetFormat("image_0.nrrd"));
+    CPPUNIT_ASSERT_EQUAL(std::string(), mitk::DockerStagingCache::GetFormat("input"));
+  }
+
+  void LinkTo_UnchangedObject()
+  {
+    const auto source = Stage("input.nrrd", "data");
+    const auto target = m_Root / "next" / "other_name.nrrd";
+    CPPUNIT_ASSERT(mitk::DockerStagingCache::GetInstance().LinkTo(m_Data, target));
+    CPPUNIT_ASSERT(boost::filesystem::equivalent(source, target));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), mitk::DockerStagingCache::GetInstance().GetNumberOfFiles());
+  }
+
+  void LinkTo_ModifiedObjectMisses()
+  {
+    Stage("input.nrrd", "data");
+    m_Data->Modified();
+    CPPUNIT_ASSERT(!mitk::DockerStagingCache::GetInstance().LinkTo(m_Data, m_Root / "next" / "input.nrrd"));
+
+    // the file of the earlier state is dropped when the new state is staged
+    Stage("modified.nrrd", "modified data");
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), mitk::DockerStagingCache::GetInstance().GetNumberOfFiles());
+  }
+
+  void LinkTo_ChangedFileMisses()
+  {
+    const auto source = Stage("input.nrrd", "data");
+    boost::filesystem::ofstream(source, std::ios::app) << " changed by the container";
+    CPPUNIT_ASSERT(!mitk::DockerStagingCache::GetInstance().LinkTo(m_Data, m_Root / "next" / "input.nrrd"));
+
+    boost::filesystem::remove(source);
+    CPPUNIT_ASSERT(!mitk::DockerStagingCache::GetInstance().LinkTo(m_Data, m_Root / "next" / "input.nrrd"));
+  }
+
+  void LinkTo_OtherFormatMisses()
+  {
+    Stage("input.nii", "data");
+    CPPUNIT_ASSERT(!mitk::DockerStagingCache::GetInstance().LinkTo(m_Data, m_Root / "next" / "input.nii.gz"));
+    CPPUNIT_ASSERT(!mitk::DockerStagingCache::GetInstance().LinkTo(mitk::Image::New(), m_Root / "next" / "input.nii"));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerStagingCache)
@@ -0,0 +1,132 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerStagingWriter.h>
+#include <mitkIOUtil.h>
+#include <mitkImage.h>
+#include <mitkImageWriteAccessor.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+class mitkDockerStagingWriterTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerStagingWriterTestSuite);
+
+  MITK_TEST(CanWrite_SupportedFormats);
+  MITK_TEST(Write_NiftiRoundTrip);
+  MITK_TEST(Write_NiftiGzRoundTrip);
+  MITK_TEST(Write_NrrdRoundTrip);
+  MITK_TEST(Write_NrrdGzipIsSmaller);
+  MITK_TEST(CodecFromString_RejectsUnknown);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+  mitk::Image::Pointer m_Image;
+
+  void CheckRoundTrip(const std::string &fileName, mitk::DockerStagingWriter::Codec codec)
+  {
+    mitk::DockerStagingWriter::Options options;
+    options.codec = codec;
+    const auto path = m_Root / fileName;
+    const auto bytes = mitk::DockerStagingWriter::Write(m_Image, path, options);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(boost::filesystem::file_size(path)), bytes);
+
+    auto loaded = mitk::IOUtil::Load<mitk::Image>(path.string());
+    // NIfTI stores the geometry with float precision
+    CPPUNIT_ASSERT(mitk::Equal(*m_Image, *loaded, 1e-4, true));
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_staging_writer_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+
+    m_Image = mitk::Image::New();
+    unsigned int dimensions[3] = {24, 20, 16};
+    m_Image->Initialize(mitk::MakeScalarPixelType<short>(), 3, dimensions);
+    {
+      mitk::ImageWriteAccessor accessor(m_Image);
+      auto *data = static_cast<short *>(accessor.GetData());
+      for (unsigned int i = 0; i < 24 * 20 * 16; ++i)
+        data[i] = static_cast<short>(i % 16 < 8 ? -1000 : i % 97);
+    }
+    mitk::Vector3D spacing;
+    spacing[0] = 0.75;
+    spacing[1] = 0.8;
+    spacing[2] = 2.5;
+    m_Image->GetGeometry()->SetSpacing(spacing);
+    mitk::Point3D origin;
+    origin[0] = -120.5;
+    origin[1] = 33.0;
+    origin[2] = 7.25;
+    m_Image->GetGeometry()->SetOrigin(origin);
+  }
+
+  void tearDown() override
+  {
+    m_Image = nullptr;
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void CanWrite_SupportedFormats()
+  {
+    CPPUNIT_ASSERT(mitk::DockerStagingWriter::CanWrite(m_Image, "input.nii"));
+    CPPUNIT_ASSERT(mitk::DockerStagingWriter::CanWrite(m_Image, "input.nii.gz"));
+    CPPUNIT_ASSERT(mitk::DockerStagingWriter::CanWrite(m_Image, "input.nrrd"));
+    CPPUNIT_ASSERT(!mitk::DockerStagingWriter::CanWrite(m_Image, "input.mha"));
+    CPPUNIT_ASSERT(!mitk::DockerStagingWriter::CanWrite(m_Image, ".nii"));
+    CPPUNIT_ASSERT(!mitk::DockerStagingWriter::CanWrite(nullptr, "input.nrrd"));
+  }
+
+  void Write_NiftiRoundTrip()
+  {
+    CheckRoundTrip("image.nii", mitk::DockerStagingWriter::Codec::Gzip);
+    // the codec does not apply to ".nii"
+    CPPUNIT_ASSERT_EQUAL(std::uintmax_t(352 + 24 * 20 * 16 * sizeof(short)), boost::filesystem::file_size(m_Root / "image.nii"));
+  }
+
+  void Write_NiftiGzRoundTrip()
+  {
+    CheckRoundTrip("image.nii.gz", mitk::DockerStagingWriter::Codec::Raw);
+  }
+
+  void Write_NrrdRoundTrip()
+  {
+    CheckRoundTrip("raw.nrrd", mitk::DockerStagingWriter::Codec::Raw);
+    CheckRoundTrip("gzip.nrrd", mitk::DockerStagingWriter::Codec::Gzip);
+  }
+
+  void Write_NrrdGzipIsSmaller()
+  {
+    mitk::DockerStagingWriter::Options options;
+    const auto raw = mitk::DockerStagingWriter::Write(m_Image, m_Root / "raw.nrrd", options);
+    options.codec = mitk::DockerStagingWriter::Codec::Gzip;
+    const auto gzip = mitk::DockerStagingWriter::Write(m_Image, m_Root / "gzip.nrrd", options);
+    CPPUNIT_ASSERT(gzip < raw / 2);
+  }
+
+  void CodecFromString_RejectsUnknown()
+  {
+    CPPUNIT_ASSERT(mitk::DockerStagingWriter::CodecFromString("gzip") == mitk::DockerStagingWriter::Codec::Gzip);
+    CPPUNIT_ASSERT_EQUAL(std::string("raw"), mitk::DockerStagingWriter::ToString(mitk::DockerStagingWriter::Codec::Raw));
+    CPPUNIT_ASSERT_THROW(mitk::DockerStagingWriter::CodecFromString("zstd"), mitk::Exception);
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerStagingWriter)
@@ -0,0 +1,196 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerProcess.h>
+#include <mitkDockerWorker.h>
+#include <mitkExceptionMacro.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+// runs DockerWorker against the worker loop of the MitkDockerFake executable
+class mitkDockerWorkerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerWorkerTestSuite);
+
+  MITK_TEST(Submit_CompletesJobs);
+  MITK_TEST(Submit_ErrorRecordThrows);
+  MITK_TEST(Submit_WorkerTerminatedThrows);
+  MITK_TEST(Submit_ExitedWorkerThrows);
+  MITK_TEST(Submit_CancelStopsOnlyTheJob);
+  MITK_TEST(Submit_UnansweredCancelDiscardsWorker);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+
+  // every test gets its own worker configuration, the environment is read when the worker starts
+  static mitk::DockerWorker::Pointer GetWorker(const std::string &name)
+  {
+    return mitk::DockerWorker::GetWorker("alpine", {}, {"m2-worker", name});
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_worker_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+    setenv("MITK_FAKE_DOCKER_STATE_DIR", (m_Root / "state").string().c_str(), 1);
+    mitk::DockerProcess::SetExecutable(MITK_DOCKER_FAKE_EXECUTABLE);
+  }
+
+  void tearDown() override
+  {
+    mitk::DockerWorker::ShutdownAll();
+    mitk::DockerProcess::SetExecutable("");
+    for (const auto *name : {"MITK_FAKE_DOCKER_STATE_DIR",
+                             "MITK_FAKE_DOCKER_EXIT_CODE",
+                             "MITK_FAKE_DOCKER_WORKER_EXIT_AFTER",
+                             "MITK_FAKE_DOCKER_WORKER_IGNORE_CANCEL"})
+      unsetenv(name);
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void Submit_CompletesJobs()
+  {
+    auto worker = GetWorker("complete");
+    std::vector<std::string> lines;
+    for (int i = 0; i < 2; ++i)
+      CPPUNIT_ASSERT(worker->Submit("/m2_pool", {"true"}, [&lines](const std::string &line) { lines.push_back(line); }));
+
+    // output lines on stdout and stderr are forwarded, completion records are not
+    CPPUNIT_ASSERT_EQUAL(std::size_t(4), lines.size());
+    CPPUNIT_ASSERT_EQUAL(std::ptrdiff_t(2), std::count(lines.begin(), lines.end(), "fake container output 1/1"));
+    CPPUNIT_ASSERT_EQUAL(std::ptrdiff_t(2), std::count_if(lines.begin(), lines.end(), [](const std::string &line) {
+                           return line.find("fake docker: read") == 0;
+                         }));
+    CPPUNIT_ASSERT(worker->IsRunning());
+    CPPUNIT_ASSERT(GetWorker("complete") == worker);
+  }
+
+  void Submit_ErrorRecordThrows()
+  {
+    setenv("MITK_FAKE_DOCKER_EXIT_CODE", "3", 1);
+    auto worker = GetWorker("error");
+    try
+    {
+      worker->Submit("/m2_pool", {"false"});
+      CPPUNIT_FAIL("error record did not throw");
+    }
+    catch (const mitk::Exception &e)
+    {
+      CPPUNIT_ASSERT(std::string(e.GetDescription()).find("exit code 3") != std::string::npos);
+    }
+    // a failed job does not stop the worker
+    CPPUNIT_ASSERT(worker->IsRunning());
+  }
+
+  void Submit_WorkerTerminatedThrows()
+  {
+    setenv("MITK_FAKE_DOCKER_WORKER_EXIT_AFTER", "2", 1);
+    auto worker = GetWorker("terminate");
+    CPPUNIT_ASSERT(worker->Submit("/m2_pool", {"true"}));
+    try
+    {
+      worker->Submit("/m2_pool", {"true"});
+      CPPUNIT_FAIL("terminated worker did not throw");
+    }
+    catch (const mitk::Exception &e)
+    {
+      // the stderr of the worker tells why it terminated
+      CPPUNIT_ASSERT(std::string(e.GetDescription()).find("fake docker: worker terminated") != std::string::npos);
+    }
+    CPPUNIT_ASSERT(!worker->IsRunning());
+
+    // the next job is not sent to the terminated worker, a new one is started
+    CPPUNIT_ASSERT(!worker->Submit("/m2_pool", {"true"}));
+    auto next = GetWorker("terminate");
+    CPPUNIT_ASSERT(next != worker);
+    CPPUNIT_ASSERT(next->Submit("/m2_pool", {"true"}));
+  }
+
+  void Submit_ExitedWorkerThrows()
+  {
+    // the container exits without reading jobs, so the job is written to a closed pipe
+    auto worker = mitk::DockerWorker::GetWorker("alpine", {}, {"true"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CPPUNIT_ASSERT_THROW(worker->Submit("/m2_pool", {"true"}), mitk::Exception);
+    CPPUNIT_ASSERT(!worker->IsRunning());
+  }
+
+  void Submit_CancelStopsOnlyTheJob()
+  {
+    auto worker = GetWorker("cancel");
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> queuedSent{false};
+
+    // a job of another caller waits for the worker while the cancelled job runs
+    std::thread queued([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      queuedSent = worker->Submit("/m2_pool", {"true"});
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::thread canceller([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      cancelled = true;
+    });
+    CPPUNIT_ASSERT_THROW(worker->Submit("/m2_pool", {"sleep", "30"}, nullptr, [&]() { return cancelled.load(); }),
+                         mitk::Exception);
+    canceller.join();
+    queued.join();
+
+    CPPUNIT_ASSERT(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+    CPPUNIT_ASSERT(worker->IsRunning());
+    CPPUNIT_ASSERT(queuedSent);
+  }
+
+  void Submit_UnansweredCancelDiscardsWorker()
+  {
+    setenv("MITK_FAKE_DOCKER_WORKER_IGNORE_CANCEL", "1", 1);
+    auto worker = GetWorker("discard");
+    std::atomic<bool> cancelled{false};
+    bool queuedSent = true;
+    std::thread queued([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      queuedSent = worker->Submit("/m2_pool", {"true"});
+    });
+    std::thread canceller([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      cancelled = true;
+    });
+    CPPUNIT_ASSERT_THROW(worker->Submit("/m2_pool", {"sleep", "30"}, nullptr, [&]() { return cancelled.load(); },
+                                        std::chrono::milliseconds(500)),
+                         mitk::Exception);
+    canceller.join();
+    queued.join();
+
+    // the waiting job was not sent and can run on a new worker
+    CPPUNIT_ASSERT(!worker->IsRunning());
+    CPPUNIT_ASSERT(!queuedSent);
+    CPPUNIT_ASSERT(GetWorker("discard")->Submit("/m2_pool", {"true"}));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerWorker)
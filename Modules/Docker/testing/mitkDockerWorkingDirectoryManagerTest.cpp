@@ -0,0 +1,228 @@
+/*===================================================================
+
+MSI applications for interactive analysis in MITK (M2aia)
+
+Copyright (c) Jonas Cordes
+
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE.
+
+See LICENSE.txt for details.
+
+===================================================================*/
+
+#include <mitkDockerWorkingDirectoryManager.h>
+#include <mitkTestFixture.h>
+#include <mitkTestingMacros.h>
+
+#include <chrono>
+#include <ctime>
+#include <string>
+
+#include <boost/filesystem/fstream.hpp>
+
+class mitkDockerWorkingDirectoryManagerTestSuite : public mitk::TestFixture
+{
+  CPPUNIT_TEST_SUITE(mitkDockerWorkingDirectoryManagerTestSuite);
+
+  MITK_TEST(Release_RemovesDirectory);
+  MITK_TEST(Release_WaitsForLastReference);
+  MITK_TEST(Keep_SurvivesRelease);
+  MITK_TEST(Reservation_HeldUntilDirectoryIsRemoved);
+  MITK_TEST(Quota_EvictsLeastRecentlyUsed);
+  MITK_TEST(Sweep_RemovesDirectoriesOfExitedSessions);
+  MITK_TEST(Sweep_RemovesOldKeptDirectoriesOfExitedSessions);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+  boost::filesystem::path m_Root;
+
+  boost::filesystem::path CreateDirectory(const std::string &name, std::size_t bytes = 0)
+  {
+    const auto directory = m_Root / name;
+    boost::filesystem::create_directories(directory);
+    if (bytes > 0)
+    {
+      boost::filesystem::ofstream file(directory / "output.bin", std::ios::binary);
+      file << std::string(bytes, 'x');
+    }
+    return directory;
+  }
+
+public:
+  void setUp() override
+  {
+    m_Root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("m2_workdir_test_%%%%%%");
+    boost::filesystem::create_directories(m_Root);
+  }
+
+  void tearDown() override
+  {
+    boost::filesystem::remove_all(m_Root);
+  }
+
+  void Release_RemovesDirectory()
+  {
+    mitk::DockerWorkingDirectoryManager manager(m_Root / "sessions", false);
+    const auto directory = CreateDirectory("m2_aaaaaa", 16);
+    {
+      auto reference = manager.Register(directory);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), manager.GetNumberOfDirectories());
+      CPPUNIT_ASSERT(boost::filesystem::exists(manager.GetSessionFilePath()));
+    }
+    CPPUNIT_ASSERT(!boost::filesystem::exists(directory));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), manager.GetNumberOfDirectories());
+  }
+
+  void Release_WaitsForLastReference()
+  {
+    mitk::DockerWorkingDirectoryManager manager(m_Root / "sessions", false);
+    const auto directory = CreateDirectory("m2_bbbbbb", 16);
+    auto reference = manager.Register(directory);
+    // e.g. held by a lazily loaded result handle
+    auto handleReference = reference;
+    reference.reset();
+    CPPUNIT_ASSERT(boost::filesystem::exists(directory));
+    handleReference.reset();
+    CPPUNIT_ASSERT(!boost::filesystem::exists(directory));
+  }
+
+  void Keep_SurvivesRelease()
+  {
+    const auto directory = CreateDirectory("m2_cccccc", 16);
+    boost::filesystem::path keptFile;
+    {
+      mitk::DockerWorkingDirectoryManager manager(m_Root / "sessions", false);
+      manager.Register(directory);
+      CPPUNIT_ASSERT(!boost::filesystem::exists(directory));
+
+      CreateDirectory("m2_cccccc", 16);
+      auto reference = manager.Register(directory);
+      manager.Keep(directory);
+      CPPUNIT_ASSERT(manager.IsKept(directory));
+      reference.reset();
+      CPPUNIT_ASSERT(boost::filesystem::exists(directory));
+      CPPUNIT_ASSERT_EQUAL(std::uint64_t(16), manager.GetUsedBytes());
+      keptFile = manager.GetKeptFilePath();
+    }
+    // kept directories also outlive the manager and stay listed for the sweep
+    CPPUNIT_ASSERT(boost::filesystem::exists(directory));
+    CPPUNIT_ASSERT(boost::filesystem::exists(keptFile));
+  }
+
+  void Reservation_HeldUntilDirectoryIsRemoved()
+  {
+    mitk::DockerScratchPolicy policy;
+    policy.ramRoot = m_Root;
+    policy.ramBudgetBytes = 1000;
+    const auto reservedBytes = mitk::DockerScratchPolicy::GetReservedRamBytes();
+
+    mitk::DockerWorkingDirectoryManager manager(m_Root / "sessions", false);
+    const auto directory = CreateDirectory("m2_rrrrrr", 16);
+    auto reservation = policy.Reserve(100);
+    CPPUNIT_ASSERT(reservation.GetLocation() == mitk::DockerScratchPolicy::Location::Ram);
+    auto reference = manager.Register(directory, std::move(reservation));
+
+    // the helper is gone, a result handle still reads from the directory
+    auto handleReference = reference;
+    reference.reset();
+    CPPUNIT_ASSERT_EQUAL(reservedBytes + 200, mitk::DockerScratchPolicy::GetReservedRamBytes());
+
+    manager.Keep(directory);
+    handleReference.reset();
+    CPPUNIT_ASSERT(boost::filesystem::exists(directory));
+    CPPUNIT_ASSERT_EQUAL(reservedBytes + 200, mitk::DockerScratchPolicy::GetReservedRamBytes());
+
+    manager.Keep(directory, false);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(directory));
+    CPPUNIT_ASSERT_EQUAL(reservedBytes, mitk::DockerScratchPolicy::GetReservedRamBytes());
+  }
+
+  void Quota_EvictsLeastRecentlyUsed()
+  {
+    mitk::DockerWorkingDirectoryManager manager(m_Root / "sessions", false);
+    const auto first = CreateDirectory("m2_dddddd", 100);
+    const auto second = CreateDirectory("m2_eeeeee", 100);
+    const auto third = CreateDirectory("m2_ffffff", 100);
+
+    for (const auto &directory : {first, second})
+    {
+      auto reference = manager.Register(directory);
+      manager.Keep(directory);
+    }
+    auto inUse = manager.Register(third);
+    manager.Touch(third);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(300), manager.GetUsedBytes());
+
+    // the referenced directory is never evicted, the oldest kept one goes first
+    manager.SetQuota(250);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(first));
+    CPPUNIT_ASSERT(boost::filesystem::exists(second));
+    CPPUNIT_ASSERT(boost::filesystem::exists(third));
+
+    manager.SetQuota(50);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(second));
+    CPPUNIT_ASSERT(boost::filesystem::exists(third));
+  }
+
+  void Sweep_RemovesDirectoriesOfExitedSessions()
+  {
+    const auto sessions = m_Root / "sessions";
+    const auto orphan = CreateDirectory("m2_gggggg", 16);
+    const auto live = CreateDirectory("m2_hhhhhh", 16);
+
+    mitk::DockerWorkingDirectoryManager manager(sessions, false);
+    const auto hostPrefix = manager.GetSessionFilePath().filename().string();
+    const auto host = hostPrefix.substr(0, hostPrefix.rfind('_'));
+    boost::filesystem::create_directories(sessions);
+    {
+      // no process has this id
+      boost::filesystem::ofstream file(sessions / (host + "_99999999"));
+      file << orphan.string() << "\n";
+    }
+    auto reference = manager.Register(live);
+
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), manager.SweepOrphans());
+    CPPUNIT_ASSERT(!boost::filesystem::exists(orphan));
+    CPPUNIT_ASSERT(!boost::filesystem::exists(sessions / (host + "_99999999")));
+    CPPUNIT_ASSERT(boost::filesystem::exists(live));
+  }
+
+  void Sweep_RemovesOldKeptDirectoriesOfExitedSessions()
+  {
+    const auto sessions = m_Root / "sessions";
+    const auto old = CreateDirectory("m2_iiiiii");
+    const auto recent = CreateDirectory("m2_jjjjjj");
+    // e.g. of HelperUtils::TempDirPath, never registered
+    const auto untracked = CreateDirectory("m2_kkkkkk");
+    for (const auto &directory : {old, untracked})
+      boost::filesystem::last_write_time(directory, std::time(nullptr) - 2 * 24 * 60 * 60);
+
+    mitk::DockerWorkingDirectoryManager manager(sessions, false);
+    const auto hostPrefix = manager.GetSessionFilePath().filename().string();
+    const auto keptFile = sessions / (hostPrefix.substr(0, hostPrefix.rfind('_')) + "_99999999.kept");
+    boost::filesystem::create_directories(sessions);
+    {
+      boost::filesystem::ofstream file(keptFile);
+      file << old.string() << "\n" << recent.string() << "\n";
+    }
+
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), manager.SweepOrphans());
+    CPPUNIT_ASSERT(!boost::filesystem::exists(old));
+    CPPUNIT_ASSERT(boost::filesystem::exists(recent));
+    CPPUNIT_ASSERT(boost::filesystem::exists(untracked));
+
+    // the younger directory stays listed until it is old enough
+    manager.SetOrphanAge(std::chrono::seconds(0));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), manager.SweepOrphans());
+    CPPUNIT_ASSERT(!boost::filesystem::exists(recent));
+    CPPUNIT_ASSERT(!boost::filesystem::exists(keptFile));
+    CPPUNIT_ASSERT(boost::filesystem::exists(untracked));
+  }
+};
+
+MITK_TEST_SUITE_REGISTRATION(mitkDockerWorkingDirectoryManager)
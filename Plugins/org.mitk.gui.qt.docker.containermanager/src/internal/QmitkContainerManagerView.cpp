@@ -22,6 +22,7 @@ found in the LICENSE file.
 #include <QTextStream>
 #include <QDesktopServices>
 #include <QUrl>
+#include <mitkDockerEngineClient.h>
 #include <mitkDockerHelper.h>
 #include <mitkDockerImageManager.h>
 #include <mitkProgressBar.h>
@@ -322,15 +323,35 @@ void QmitkContainerManagerView::OnPullImage()
   
   mitk::ProgressBar::GetInstance()->AddStepsToDo(1);
   
-  m_DockerProcess->start("docker", arguments);
+  m_DockerProcess->start(QString::fromStdString(mitk::DockerProcess::GetExecutable()), arguments);
 }
 
 void QmitkContainerManagerView::CheckLocalImages()
 {
+  // query the daemon directly if its socket is accessible
+  mitk::DockerEngineClient client;
+  if (!mitk::DockerProcess::HasCustomExecutable() && client.IsAvailable())
+  {
+    try
+    {
+      m_LocalImages.clear();
+      for (const auto &image : client.ListImages())
+        m_LocalImages << QString::fromStdString(image);
+
+      m_Controls.outputTextEdit->append(QString("Found %1 local image(s)").arg(m_LocalImages.size()));
+      UpdatePullButtons();
+      return;
+    }
+    catch (const mitk::Exception &e)
+    {
+      MITK_WARN << "Listing images via the Engine API failed, fall back to the docker CLI: " << e.GetDescription();
+    }
+  }
+
   QStringList arguments;
   arguments << "images" << "--format" << "{{.Repository}}:{{.Tag}}";
   
-  m_CheckProcess->start("docker", arguments);
+  m_CheckProcess->start(QString::fromStdString(mitk::DockerProcess::GetExecutable()), arguments);
 }
 
 void QmitkContainerManagerView::OnCheckLocalImagesFinished(int exitCode, QProcess::ExitStatus exitStatus)
@@ -994,7 +1015,7 @@ void QmitkContainerManagerView::OnFetchHelp()
   m_Controls.outputTextEdit->append(QString("<span style='color: blue;'>Fetching help for %1...</span>")
                                    .arg(fullImageName));
   
-  m_HelpProcess->start("docker", arguments);
+  m_HelpProcess->start(QString::fromStdString(mitk::DockerProcess::GetExecutable()), arguments);
 }
 
 void QmitkContainerManagerView::OnHelpProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
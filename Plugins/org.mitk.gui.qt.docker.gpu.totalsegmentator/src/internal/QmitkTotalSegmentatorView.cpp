@@ -55,20 +55,51 @@ void QmitkTotalSegmentatorView::CreateQtPartControl(QWidget *parent) {
           SLOT(OnStartTotalSegmentator()));
 }
 
+QmitkTotalSegmentatorView::~QmitkTotalSegmentatorView()
+{
+  // cancels and joins a running segmentation
+  m_Helper.reset();
+}
+
 void QmitkTotalSegmentatorView::SetFocus() {
   m_Controls.btnRunTotalSegmentator->setFocus();
 }
 
+void QmitkTotalSegmentatorView::EnableWidgets(bool enable)
+{
+  m_Controls.selectionWidget->setEnabled(enable);
+  m_Controls.cbMultiLabel->setEnabled(enable);
+  m_Controls.cbPreview->setEnabled(enable);
+  m_Controls.cbStatistics->setEnabled(enable);
+  m_Controls.cbRadiomics->setEnabled(enable);
+  m_Controls.textEdit->setEnabled(enable);
+}
+
 void QmitkTotalSegmentatorView::OnStartTotalSegmentator()
 {
-  using namespace itksys;
+  // the button cancels a running segmentation
+  if (m_Helper)
+  {
+    m_Controls.lblStatus->setText("Cancelling ...");
+    m_Helper->Cancel();
+    return;
+  }
+
   auto selectedDataNode = m_Controls.selectionWidget->GetSelectedNode();
+  if (selectedDataNode.IsNull())
+    return;
+
   auto data = selectedDataNode->GetData();
   mitk::Image::Pointer image = dynamic_cast<mitk::Image *>(data);
 
-  mitk::DockerHelper helper("wasserth/totalsegmentator:2.0.0");
+  m_Helper = std::make_unique<mitk::DockerHelper>("wasserth/totalsegmentator:2.0.0");
+  auto &helper = *m_Helper;
   helper.AddRunArgument("--gpus", "device=0");
-  helper.AddRunArgument("--ipc=host");
+
+  // the PyTorch data loaders exchange data through shared memory
+  mitk::DockerResourceLimits limits;
+  limits.hostIpc = true;
+  helper.SetResourceLimits(limits);
   helper.AddApplicationArgument("TotalSegmentator");
   if (m_Controls.cbMultiLabel->isChecked())
   {
@@ -98,8 +129,68 @@ void QmitkTotalSegmentatorView::OnStartTotalSegmentator()
     helper.AddAutoLoadOutput("--preview", "preview.png", helper.FLAG_ONLY);
 
   helper.EnableAutoRemoveContainer(true);
-  auto results = helper.GetResults();
-  if (m_Controls.cbMultiLabel->isChecked())
+
+  // re-opened cases with unchanged inputs and options are answered from the cache
+  helper.EnableResultCache(true);
+
+  // the callback is invoked on the worker thread, forward everything to the GUI thread
+  helper.SetProgressCallback([this](mitk::DockerHelper::Phase phase, const std::string &message) {
+    const auto text = QString::fromStdString(message);
+    const bool done = phase == mitk::DockerHelper::Phase::Finished ||
+                      phase == mitk::DockerHelper::Phase::Cancelled ||
+                      phase == mitk::DockerHelper::Phase::Failed;
+    QMetaObject::invokeMethod(
+      this,
+      [this, text, done]() {
+        m_Controls.lblStatus->setText(text);
+        if (done)
+          OnTotalSegmentatorFinished();
+      },
+      Qt::QueuedConnection);
+  });
+
+  // show the latest container output while the segmentation runs
+  helper.SetLogCallback([this](mitk::DockerProcess::Stream, const std::string &line) {
+    const auto text = QString::fromStdString(line);
+    QMetaObject::invokeMethod(
+      this, [this, text]() { m_Controls.lblStatus->setText(text); }, Qt::QueuedConnection);
+  });
+
+  m_InputNode = selectedDataNode;
+  m_MultiLabel = m_Controls.cbMultiLabel->isChecked();
+  EnableWidgets(false);
+  m_Controls.btnRunTotalSegmentator->setText("Cancel TotalSegmentator");
+  m_Results = helper.GetResultsAsync();
+}
+
+void QmitkTotalSegmentatorView::OnTotalSegmentatorFinished()
+{
+  using namespace itksys;
+
+  std::vector<mitk::BaseData::Pointer> results;
+  try
+  {
+    results = m_Results.get();
+  }
+  catch (const mitk::DockerCancelledException &)
+  {
+    MITK_INFO << "TotalSegmentator was cancelled";
+  }
+  catch (const std::exception &e)
+  {
+    QMessageBox::warning(nullptr, "TotalSegmentator", QString("TotalSegmentator failed:\n%1").arg(e.what()));
+  }
+
+  auto selectedDataNode = m_InputNode;
+  m_InputNode = nullptr;
+  m_Helper.reset();
+  EnableWidgets(true);
+  m_Controls.btnRunTotalSegmentator->setText("Run TotalSegmentator");
+
+  if (results.empty())
+    return;
+
+  if (m_MultiLabel)
   {
     auto lsImage = mitk::MultiLabelSegmentation::New();
     lsImage->InitializeByLabeledImage(
@@ -114,8 +205,8 @@ void QmitkTotalSegmentatorView::OnStartTotalSegmentator()
     std::string filePath;
     for (auto image : results)
     {
-      data->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation", filePath);
-      data->GetPropertyList()->RemoveProperty("MITK.IO.reader.inputlocation");
+      image->GetPropertyList()->GetStringProperty("MITK.IO.reader.inputlocation", filePath);
+      image->GetPropertyList()->RemoveProperty("MITK.IO.reader.inputlocation");
       auto node = mitk::DataNode::New();
       node->SetData(image);
       node->SetName(SystemTools::GetFilenameWithoutExtension(filePath));
@@ -18,6 +18,14 @@ found in the LICENSE file.
 #include <QmitkSingleNodeSelectionWidget.h>
 #include <ui_QmitkTotalSegmentatorViewControls.h>
 
+#include <future>
+#include <memory>
+
+namespace mitk
+{
+  class DockerHelper;
+}
+
 // All views in MITK derive from QmitkAbstractView. You have to override
 // at least the two methods CreateQtPartControl() and SetFocus().
 class QmitkTotalSegmentatorView : public QmitkAbstractView
@@ -35,6 +43,8 @@ public:
   // to initialize it in the implementation file.
   static const std::string VIEW_ID;
 
+  ~QmitkTotalSegmentatorView() override;
+
   // In this method we initialize the GUI components and connect the
   // associated signals and slots.
   void CreateQtPartControl(QWidget* parent) override;
@@ -48,6 +58,15 @@ private:
 
   void EnableWidgets(bool enable);
 
+  // Called in the GUI thread after the asynchronous docker run has ended
+  void OnTotalSegmentatorFinished();
+
+  // The helper runs on a worker thread and has to outlive the future
+  std::unique_ptr<mitk::DockerHelper> m_Helper;
+  std::future<std::vector<mitk::BaseData::Pointer>> m_Results;
+  mitk::DataNode::Pointer m_InputNode;
+  bool m_MultiLabel = true;
+
   // Generated from the associated UI file, it encapsulates all the widgets
   // of our view.
   Ui::QmitkTotalSegmentatorViewControls m_Controls;